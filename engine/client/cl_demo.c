@@ -1553,7 +1553,7 @@ void CL_PlayDemo_f( void )
 		return;
 	}
 
-	cls.demofile = FS_Open( filename, "rb", true );
+	cls.demofile = FS_Open( filename, "rbS", true );
 	Q_strncpy( cls.demoname, demoname, sizeof( cls.demoname ));
 	Q_strncpy( gameui.globals->demoname, demoname, sizeof( gameui.globals->demoname ));
 
@@ -311,7 +311,7 @@ stream_t *Stream_OpenMPG( const char *filename )
 	int	ret;
 	wavinfo_t	sc;
 
-	file = FS_Open( filename, "rb", false );
+	file = FS_Open( filename, "rbS", false );
 	if( !file ) return NULL;
 
 	// at this point we have valid stream
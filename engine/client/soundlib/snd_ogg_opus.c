@@ -198,7 +198,7 @@ stream_t *Stream_OpenOggOpus( const char *filename )
 	const OpusHead       *opusHead;
 
 	ctx = (opus_streaming_ctx_t *)Mem_Calloc( host.soundpool, sizeof( opus_streaming_ctx_t ));
-	ctx->file = FS_Open( filename, "rb", false );
+	ctx->file = FS_Open( filename, "rbS", false );
 	if( !ctx->file )
 	{
 		Mem_Free( ctx );
@@ -179,7 +179,7 @@ stream_t *Stream_OpenOggVorbis( const char *filename )
 	vorbis_streaming_ctx_t *ctx;
 
 	ctx = (vorbis_streaming_ctx_t *)Mem_Calloc( host.soundpool, sizeof( vorbis_streaming_ctx_t ));
-	ctx->file = FS_Open( filename, "rb", false );
+	ctx->file = FS_Open( filename, "rbS", false );
 	if( !ctx->file )
 	{
 		Mem_Free( ctx );
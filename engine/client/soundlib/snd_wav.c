@@ -354,7 +354,7 @@ stream_t *Stream_OpenWAV( const char *filename )
 		return NULL;
 
 	// open
-	file = FS_Open( filename, "rb", false );
+	file = FS_Open( filename, "rbS", false );
 	if( !file ) return NULL;
 
 	// find "RIFF" chunk
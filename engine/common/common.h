@@ -374,6 +374,8 @@ typedef void (*xcommand_t)( void );
 //
 // zone.c
 //
+#define MEMPOOL_ARENA	BIT( 0 )	// pack small blocks together, freed memory is reused only when pool is emptied
+
 void Memory_Init( void );
 void _Mem_Free( void *data, const char *filename, int fileline );
 void *_Mem_Realloc( poolhandle_t poolptr, void *memptr, size_t size, qboolean clear, const char *filename, int fileline )
@@ -382,18 +384,22 @@ void *_Mem_Alloc( poolhandle_t poolptr, size_t size, qboolean clear, const char
 	ALLOC_CHECK( 2 ) MALLOC_LIKE( _Mem_Free, 1 ) WARN_UNUSED_RESULT;
 poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int fileline )
 	WARN_UNUSED_RESULT;
+poolhandle_t _Mem_AllocPoolExt( const char *name, uint flags, const char *filename, int fileline )
+	WARN_UNUSED_RESULT;
 void _Mem_FreePool( poolhandle_t *poolptr, const char *filename, int fileline );
 void _Mem_EmptyPool( poolhandle_t poolptr, const char *filename, int fileline );
 void _Mem_Check( const char *filename, int fileline );
 qboolean Mem_IsAllocatedExt( poolhandle_t poolptr, void *data );
 void Mem_PrintList( size_t minallocationsize );
 void Mem_PrintStats( void );
+void Mem_Profile_f( void );
 
 #define Mem_Malloc( pool, size ) _Mem_Alloc( pool, size, false, __FILE__, __LINE__ )
 #define Mem_Calloc( pool, size ) _Mem_Alloc( pool, size, true, __FILE__, __LINE__ )
 #define Mem_Realloc( pool, ptr, size ) _Mem_Realloc( pool, ptr, size, true, __FILE__, __LINE__ )
 #define Mem_Free( mem ) _Mem_Free( mem, __FILE__, __LINE__ )
 #define Mem_AllocPool( name ) _Mem_AllocPool( name, __FILE__, __LINE__ )
+#define Mem_AllocPoolExt( name, flags ) _Mem_AllocPoolExt( name, flags, __FILE__, __LINE__ )
 #define Mem_FreePool( pool ) _Mem_FreePool( pool, __FILE__, __LINE__ )
 #define Mem_EmptyPool( pool ) _Mem_EmptyPool( pool, __FILE__, __LINE__ )
 #define Mem_IsAllocated( mem ) Mem_IsAllocatedExt( NULL, mem )
@@ -414,6 +420,9 @@ byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamediro
 	MALLOC_LIKE( _Mem_Free, 1 ) WARN_UNUSED_RESULT;
 byte *FS_LoadDirectFile( const char *path, fs_offset_t *filesizeptr )
 	MALLOC_LIKE( _Mem_Free, 1 ) WARN_UNUSED_RESULT;
+void FS_UnmapFile( byte *data );
+byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
+	MALLOC_LIKE( FS_UnmapFile, 1 ) WARN_UNUSED_RESULT;
 
 //
 // cmd.c
@@ -576,6 +585,7 @@ void SV_Shutdown( const char *finalmsg );
 void SV_ShutdownFilter( void );
 void Host_ServerFrame( void );
 qboolean SV_Active( void );
+double SV_NextTickTime( void );
 
 /*
 ==============================================================
@@ -657,6 +667,7 @@ int CSCR_WriteGameCVars( file_t *cfg, const char *scriptfilename );
 // hpak.c
 //
 void HPAK_Init( void );
+void HPAK_Shutdown( void );
 qboolean HPAK_GetDataPointer( const char *filename, struct resource_s *pRes, byte **buffer, int *size );
 qboolean HPAK_ResourceForHash( const char *filename, byte *hash, struct resource_s *pRes );
 void HPAK_AddLump( qboolean queue, const char *filename, struct resource_s *pRes, byte *data, file_t *f );
@@ -839,6 +850,27 @@ void ID_Init( void );
 const char *ID_GetMD5( void );
 void GAME_EXPORT ID_SetCustomClientID( const char *id );
 
+//
+// jobs.c
+//
+typedef void (*pfnJob_t)( void *data, int index );
+typedef struct jobtask_s
+{
+	pfnJob_t	job;
+	void	*data;
+	int	state;
+	struct jobtask_s	*next;
+} jobtask_t;
+void Jobs_Init( void );
+void Jobs_Shutdown( void );
+int Jobs_NumThreads( void );
+void Jobs_RunParallel( pfnJob_t job, void *data, int count );
+void Jobs_Post( jobtask_t *task, pfnJob_t job, void *data );
+qboolean Jobs_IsDone( jobtask_t *task );
+void Jobs_Wait( jobtask_t *task );
+void Jobs_EnterCritical( void );
+void Jobs_LeaveCritical( void );
+
 //
 // masterlist.c
 //
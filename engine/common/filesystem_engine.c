@@ -52,6 +52,16 @@ byte *FS_LoadDirectFile( const char *path, fs_offset_t *filesizeptr )
 	return g_fsapi.LoadDirectFile( path, filesizeptr );
 }
 
+byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
+{
+	return g_fsapi.MapFile( path, filesizeptr, gamedironly );
+}
+
+void FS_UnmapFile( byte *data )
+{
+	g_fsapi.UnmapFile( data );
+}
+
 static void COM_StripDirectorySlash( char *pname )
 {
 	size_t len;
@@ -84,6 +94,25 @@ static void FS_Path_f_( void )
 	FS_Path_f();
 }
 
+static void *FS_JobsPostTask( pfnJob_t job, void *data )
+{
+	jobtask_t *task = Mem_Malloc( host.mempool, sizeof( *task ));
+
+	Jobs_Post( task, job, data );
+	return task;
+}
+
+static qboolean FS_JobsIsTaskDone( void *task )
+{
+	return Jobs_IsDone( task );
+}
+
+static void FS_JobsWaitTask( void *task )
+{
+	Jobs_Wait( task );
+	Mem_Free( task );
+}
+
 static const fs_interface_t fs_memfuncs =
 {
 	Con_Printf,
@@ -98,6 +127,16 @@ static const fs_interface_t fs_memfuncs =
 	_Mem_Free,
 
 	Sys_GetNativeObject,
+
+	Jobs_RunParallel,
+	Jobs_EnterCritical,
+	Jobs_LeaveCritical,
+
+	Sys_DoubleTime,
+
+	FS_JobsPostTask,
+	FS_JobsIsTaskDone,
+	FS_JobsWaitTask,
 };
 
 static void FS_UnloadProgs( void )
@@ -60,6 +60,7 @@ CVAR_DEFINE_AUTO( fps_override, "1", FCVAR_FILTERABLE, "unlock higher framerate
 static CVAR_DEFINE_AUTO( host_framerate, "0", FCVAR_FILTERABLE, "locks frame timing to this value in seconds" );
 static CVAR_DEFINE( host_sleeptime, "sleeptime", "1", FCVAR_ARCHIVE|FCVAR_FILTERABLE, "milliseconds to sleep for each frame. higher values reduce fps accuracy" );
 static CVAR_DEFINE_AUTO( host_sleeptime_debug, "0", 0, "print sleeps between frames" );
+static CVAR_DEFINE_AUTO( host_netsleep, "0", FCVAR_ARCHIVE, "dedicated server waits on network sockets until next frame or server tick, and runs a frame as soon as a packet arrives" );
 CVAR_DEFINE_AUTO( host_allow_materials, "0", FCVAR_LATCH|FCVAR_ARCHIVE, "allow texture replacements from materials/ folder" );
 CVAR_DEFINE( con_gamemaps, "con_mapfilter", "1", FCVAR_ARCHIVE, "when true show only maps in game folder" );
 
@@ -647,6 +648,27 @@ static double Host_CalcFPS( void )
 	return fps;
 }
 
+/*
+===================
+Host_NetSleep
+
+event driven sleep for dedicated server, wakes up
+on incoming packets instead of polling every frame
+===================
+*/
+static qboolean Host_NetSleep( double dt, double targetframetime, double scale )
+{
+	double timeout;
+
+	if( dt >= targetframetime * scale )
+		return true;
+
+	// nothing but packets can happen before next physics frame
+	timeout = ( Q_max( targetframetime * scale, SV_NextTickTime( )) - dt ) / scale;
+
+	return NET_Sleep( timeout );
+}
+
 static qboolean Host_Autosleep( double dt, double scale )
 {
 	double targetframetime, fps;
@@ -664,6 +686,9 @@ static qboolean Host_Autosleep( double dt, double scale )
 		targetframetime = ( 1.0 / ( fps + 1.0 ));
 	else targetframetime = ( 1.0 / fps );
 
+	if( Host_IsDedicated( ) && host_netsleep.value && scale > 0.0 )
+		return Host_NetSleep( dt, targetframetime, scale );
+
 	sleep = Host_CalcSleep();
 	if( sleep == 0 ) // no sleeps between frames, much simpler code
 	{
@@ -781,6 +806,7 @@ void Host_Frame( double time )
 	Host_ServerFrame (); // server frame
 	Host_ClientFrame (); // client frame
 	HTTP_Run();			 // both server and client
+	FS_AsyncUpdate();	 // deliver loaded files
 
 	host.framecount++;
 	host.pureframetime = Sys_DoubleTime() - t1;
@@ -1131,6 +1157,7 @@ static void Host_InitCommon( int argc, char **argv, const char *progname, qboole
 
 	Cmd_AddCommand( "exec", Host_Exec_f, "execute a script file" );
 	Cmd_AddCommand( "memlist", Host_MemStats_f, "prints memory pool information" );
+	Cmd_AddRestrictedCommand( "memprofile", Mem_Profile_f, "count memory by call site, write and compare snapshots" );
 	Cmd_AddRestrictedCommand( "userconfigd", Host_Userconfigd_f, "execute all scripts from userconfig.d" );
 
 	Image_Init();
@@ -1163,7 +1190,7 @@ static void Host_FreeCommon( void )
 	Image_Shutdown();
 	Sound_Shutdown();
 	Netchan_Shutdown();
-	HPAK_FlushHostQueue();
+	HPAK_Shutdown();
 	FS_Shutdown();
 }
 
@@ -1198,6 +1225,7 @@ int EXPORT Host_Main( int argc, char **argv, const char *progname, int bChangeGa
 	Cvar_RegisterVariable( &host_framerate );
 	Cvar_RegisterVariable( &host_sleeptime );
 	Cvar_RegisterVariable( &host_sleeptime_debug );
+	Cvar_RegisterVariable( &host_netsleep );
 	Cvar_RegisterVariable( &host_gameloaded );
 	Cvar_RegisterVariable( &host_clientloaded );
 	Cvar_RegisterVariable( &host_limitlocal );
@@ -1209,6 +1237,7 @@ int EXPORT Host_Main( int argc, char **argv, const char *progname, int bChangeGa
 	Cvar_Getf( "host_ver", FCVAR_READ_ONLY, "detailed info about this build", "%i " XASH_VERSION " %s %s %s", Q_buildnum(), Q_buildos(), Q_buildarch(), Q_buildcommit());
 	Cvar_Getf( "host_lowmemorymode", FCVAR_READ_ONLY, "indicates if engine compiled for low RAM consumption (0 - normal, 1 - low engine limits, 2 - low protocol limits)", "%i", XASH_LOW_MEMORY );
 
+	Jobs_Init();
 	Mod_Init();
 	NET_Init();
 	NET_InitMasters();
@@ -1349,6 +1378,7 @@ void EXPORT Host_Shutdown( void )
 	SV_UnloadProgs();
 	SV_ShutdownFilter();
 	CL_Shutdown();
+	Jobs_Shutdown();
 
 	SoundList_Shutdown();
 	Mod_Shutdown();
@@ -33,6 +33,22 @@ static hash_pack_queue_t	*gp_hpak_queue = NULL;
 static hpak_header_t	hash_pack_header;
 static hpak_info_t	hash_pack_info;
 
+// last directory read by HPAK_ResourceForHash, valid while file size and time match
+static struct
+{
+	string		pakname;
+	fs_offset_t	size;
+	int		time;
+	hpak_info_t	directory;
+} hpak_dircache;
+
+static void HPAK_InvalidateDirCache( void )
+{
+	if( hpak_dircache.directory.entries )
+		Mem_Free( hpak_dircache.directory.entries );
+	memset( &hpak_dircache, 0, sizeof( hpak_dircache ));
+}
+
 static void HPAK_MaxSize_f( void )
 {
 	Con_Printf( S_ERROR "hpk_maxsize is deprecated, use hpk_max_size\n" );
@@ -98,6 +114,12 @@ void HPAK_FlushHostQueue( void )
 	gp_hpak_queue = NULL;
 }
 
+void HPAK_Shutdown( void )
+{
+	HPAK_FlushHostQueue();
+	HPAK_InvalidateDirCache();
+}
+
 static void HPAK_CreatePak( const char *filename, resource_t *pResource, byte *pData, file_t *fin )
 {
 	int		filelocation;
@@ -112,6 +134,8 @@ static void HPAK_CreatePak( const char *filename, resource_t *pResource, byte *p
 	if(( fin != NULL && pData != NULL ) || ( fin == NULL && pData == NULL ))
 		return;
 
+	HPAK_InvalidateDirCache();
+
 	Q_strncpy( pakname, filename, sizeof( pakname ));
 	COM_ReplaceExtension( pakname, ".hpk", sizeof( pakname ));
 
@@ -219,6 +243,8 @@ void HPAK_AddLump( qboolean bUseQueue, const char *name, resource_t *pResource,
 	if( pData == NULL && pFile == NULL )
 		return;
 
+	HPAK_InvalidateDirCache();
+
 	if( pResource->nDownloadSize < HPAK_ENTRY_MIN_SIZE || pResource->nDownloadSize > HPAK_ENTRY_MAX_SIZE )
 	{
 		Con_Printf( S_ERROR "%s: invalid size %s\n", name, Q_pretifymem( pResource->nDownloadSize, 2 ));
@@ -535,6 +561,8 @@ qboolean HPAK_ResourceForHash( const char *filename, byte *hash, resource_t *pRe
 	hpak_header_t	header;
 	string		pakname;
 	qboolean		bFound;
+	fs_offset_t	size;
+	int		time;
 	file_t		*f;
 	hash_pack_queue_t	*p;
 
@@ -554,6 +582,13 @@ qboolean HPAK_ResourceForHash( const char *filename, byte *hash, resource_t *pRe
 	Q_strncpy( pakname, filename, sizeof( pakname ));
 	COM_ReplaceExtension( pakname, ".hpk", sizeof( pakname ));
 
+	size = FS_FileSize( pakname, true );
+	time = FS_FileTime( pakname, true );
+
+	if( hpak_dircache.directory.entries && !Q_stricmp( hpak_dircache.pakname, pakname )
+		&& hpak_dircache.size == size && hpak_dircache.time == time )
+		return HPAK_FindResource( &hpak_dircache.directory, hash, pResource );
+
 	f = FS_Open( pakname, "rb", true );
 	if( !f ) return false;
 
@@ -583,9 +618,15 @@ qboolean HPAK_ResourceForHash( const char *filename, byte *hash, resource_t *pRe
 	directory.entries = Z_Malloc( sizeof( hpak_lump_t ) * directory.count );
 	FS_Read( f, directory.entries, sizeof( hpak_lump_t ) * directory.count );
 	bFound = HPAK_FindResource( &directory, hash, pResource );
-	Mem_Free( directory.entries );
 	FS_Close( f );
 
+	// keep it, clients usually ask for many resources from the same file
+	HPAK_InvalidateDirCache();
+	Q_strncpy( hpak_dircache.pakname, pakname, sizeof( hpak_dircache.pakname ));
+	hpak_dircache.size = size;
+	hpak_dircache.time = time;
+	hpak_dircache.directory = directory;
+
 	return bFound;
 }
 
@@ -766,6 +807,8 @@ void HPAK_RemoveLump( const char *name, resource_t *pResource )
 	if( !COM_CheckString( name ) || !pResource )
 		return;
 
+	HPAK_InvalidateDirCache();
+
 	HPAK_FlushHostQueue();
 
 	Q_strncpy( read_path, name, sizeof( read_path ));
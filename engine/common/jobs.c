@@ -0,0 +1,580 @@
+/*
+jobs.c - worker thread pool
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "xash3d_mathlib.h"
+
+#define MAX_JOB_THREADS	16
+
+// jobtask_t states
+#define JOB_QUEUED		1
+#define JOB_RUNNING		2
+#define JOB_DONE		3
+
+#if XASH_DOS4GW || XASH_EMSCRIPTEN
+#define JOBS_NO_THREADS
+#endif
+
+#if defined( JOBS_NO_THREADS )
+// everything runs on the calling thread
+#elif XASH_SDL == 2
+#include <SDL_thread.h>
+#include <SDL_cpuinfo.h>
+#define mutex_create( x )     (( x ) = SDL_CreateMutex( ))
+#define mutex_destroy( x )    SDL_DestroyMutex(( x ))
+#define mutex_lock( x )       SDL_LockMutex(( x ))
+#define mutex_unlock( x )     SDL_UnlockMutex(( x ))
+#define cond_create( x )      (( x ) = SDL_CreateCond( ))
+#define cond_destroy( x )     SDL_DestroyCond(( x ))
+#define cond_wait( c, m )     SDL_CondWait(( c ), ( m ))
+#define cond_broadcast( x )   SDL_CondBroadcast(( x ))
+#define create_thread( thread, pfn ) ((( thread ) = SDL_CreateThread(( pfn ), "Job thread", NULL )) != NULL )
+#define join_thread( x )      SDL_WaitThread(( x ), NULL )
+typedef SDL_mutex *mutex_t;
+typedef SDL_cond *cond_t;
+typedef SDL_Thread *thread_t;
+#elif !XASH_WIN32
+#include <pthread.h>
+#include <unistd.h>
+#define mutex_create( x )     pthread_mutex_init( &( x ), NULL )
+#define mutex_destroy( x )    pthread_mutex_destroy( &( x ))
+#define mutex_lock( x )       pthread_mutex_lock( &( x ))
+#define mutex_unlock( x )     pthread_mutex_unlock( &( x ))
+#define cond_create( x )      pthread_cond_init( &( x ), NULL )
+#define cond_destroy( x )     pthread_cond_destroy( &( x ))
+#define cond_wait( c, m )     pthread_cond_wait( &( c ), &( m ))
+#define cond_broadcast( x )   pthread_cond_broadcast( &( x ))
+#define create_thread( thread, pfn ) !pthread_create( &( thread ), NULL, ( pfn ), NULL )
+#define join_thread( x )      pthread_join(( x ), NULL )
+typedef pthread_mutex_t mutex_t;
+typedef pthread_cond_t cond_t;
+typedef pthread_t thread_t;
+#else // WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define mutex_create( x )     InitializeCriticalSection( &( x ))
+#define mutex_destroy( x )    DeleteCriticalSection( &( x ))
+#define mutex_lock( x )       EnterCriticalSection( &( x ))
+#define mutex_unlock( x )     LeaveCriticalSection( &( x ))
+#define cond_create( x )      InitializeConditionVariable( &( x ))
+#define cond_destroy( x )     (void)( x )
+#define cond_wait( c, m )     SleepConditionVariableCS( &( c ), &( m ), INFINITE )
+#define cond_broadcast( x )   WakeAllConditionVariable( &( x ))
+#define create_thread( thread, pfn ) ((( thread ) = CreateThread( NULL, 0, ( pfn ), NULL, 0, NULL )) != NULL )
+#define join_thread( x )      ( WaitForSingleObject(( x ), INFINITE ), CloseHandle(( x )))
+typedef CRITICAL_SECTION mutex_t;
+typedef CONDITION_VARIABLE cond_t;
+typedef HANDLE thread_t;
+#endif
+
+static CVAR_DEFINE_AUTO( host_jobthreads, "0", FCVAR_ARCHIVE, "number of worker threads used by parallel engine jobs, 0 - autodetect, 1 - disable" );
+
+#if !defined( JOBS_NO_THREADS )
+static struct
+{
+	qboolean	initialized;
+	int	numthreads;	// not including the main thread
+	thread_t	threads[MAX_JOB_THREADS];
+
+	mutex_t	lock;		// protects everything below
+	cond_t	wake;		// new batch was posted
+	cond_t	done;		// last job of the batch is finished
+	mutex_t	critical;		// see Jobs_EnterCritical
+
+	int	generation;	// incremented for every batch
+	qboolean	quit;
+	qboolean	parallel;		// batch is in flight
+
+	pfnJob_t	job;
+	void	*data;
+	int	count;
+	int	next;
+	int	finished;
+
+	jobtask_t	*tasks;		// background tasks, see Jobs_Post
+	jobtask_t	*lasttask;
+} jobs;
+
+/*
+=================
+Jobs_CPUCount
+=================
+*/
+static int Jobs_CPUCount( void )
+{
+#if XASH_SDL == 2
+	return SDL_GetCPUCount();
+#elif XASH_WIN32
+	SYSTEM_INFO info;
+
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors;
+#elif defined( _SC_NPROCESSORS_ONLN )
+	return sysconf( _SC_NPROCESSORS_ONLN );
+#else
+	return 1;
+#endif
+}
+
+/*
+=================
+Jobs_Drain
+
+runs jobs from the current batch until
+nothing is left, called with lock held
+=================
+*/
+static void Jobs_Drain( void )
+{
+	while( jobs.next < jobs.count )
+	{
+		int index = jobs.next++;
+
+		mutex_unlock( jobs.lock );
+		jobs.job( jobs.data, index );
+		mutex_lock( jobs.lock );
+
+		if( ++jobs.finished == jobs.count )
+			cond_broadcast( jobs.done );
+	}
+}
+
+/*
+=================
+Jobs_RunTask
+
+runs the oldest background task, called with lock held
+=================
+*/
+static void Jobs_RunTask( void )
+{
+	jobtask_t *task = jobs.tasks;
+
+	jobs.tasks = task->next;
+	if( !jobs.tasks )
+		jobs.lasttask = NULL;
+
+	task->next = NULL;
+	task->state = JOB_RUNNING;
+
+	mutex_unlock( jobs.lock );
+	task->job( task->data, 0 );
+	mutex_lock( jobs.lock );
+
+	task->state = JOB_DONE;
+	cond_broadcast( jobs.done );
+}
+
+static void Jobs_WorkerLoop( void )
+{
+	int generation = 0;
+
+	mutex_lock( jobs.lock );
+
+	while( true )
+	{
+		while( !jobs.quit && jobs.generation == generation && !jobs.tasks )
+			cond_wait( jobs.wake, jobs.lock );
+
+		if( jobs.quit )
+			break;
+
+		// parallel batches have priority over background tasks
+		if( jobs.generation != generation )
+		{
+			generation = jobs.generation;
+			Jobs_Drain();
+		}
+		else Jobs_RunTask();
+	}
+
+	mutex_unlock( jobs.lock );
+}
+
+#if XASH_SDL == 2
+static int Jobs_ThreadStart( void *unused )
+{
+	Jobs_WorkerLoop();
+	return 0;
+}
+#elif !XASH_WIN32
+static void *Jobs_ThreadStart( void *unused )
+{
+	Jobs_WorkerLoop();
+	return NULL;
+}
+#else
+static DWORD WINAPI Jobs_ThreadStart( LPVOID unused )
+{
+	Jobs_WorkerLoop();
+	return 0;
+}
+#endif
+
+/*
+=================
+Jobs_StopThreads
+=================
+*/
+static void Jobs_StopThreads( void )
+{
+	int i;
+
+	if( !jobs.initialized )
+		return;
+
+	mutex_lock( jobs.lock );
+	jobs.quit = true;
+	cond_broadcast( jobs.wake );
+	mutex_unlock( jobs.lock );
+
+	for( i = 0; i < jobs.numthreads; i++ )
+		join_thread( jobs.threads[i] );
+
+	// nobody is left to run queued tasks, finish them here
+	while( jobs.tasks )
+	{
+		jobtask_t *task = jobs.tasks;
+
+		jobs.tasks = task->next;
+		task->next = NULL;
+		task->job( task->data, 0 );
+		task->state = JOB_DONE;
+	}
+
+	cond_destroy( jobs.wake );
+	cond_destroy( jobs.done );
+	mutex_destroy( jobs.lock );
+	mutex_destroy( jobs.critical );
+
+	memset( &jobs, 0, sizeof( jobs ));
+}
+
+/*
+=================
+Jobs_StartThreads
+=================
+*/
+static void Jobs_StartThreads( void )
+{
+	int i, numthreads = host_jobthreads.value;
+
+	if( numthreads <= 0 )
+		numthreads = Jobs_CPUCount();
+
+	// main thread takes part in every batch too
+	numthreads = bound( 0, numthreads - 1, MAX_JOB_THREADS );
+
+	memset( &jobs, 0, sizeof( jobs ));
+	mutex_create( jobs.lock );
+	mutex_create( jobs.critical );
+	cond_create( jobs.wake );
+	cond_create( jobs.done );
+	jobs.initialized = true;
+
+	for( i = 0; i < numthreads; i++ )
+	{
+		if( !create_thread( jobs.threads[i], Jobs_ThreadStart ))
+		{
+			Con_Printf( S_WARN "%s: can't create worker thread, only %i available\n", __func__, i );
+			break;
+		}
+	}
+
+	jobs.numthreads = i;
+	Con_Reportf( "%s: %i worker threads\n", __func__, jobs.numthreads );
+}
+#endif // !JOBS_NO_THREADS
+
+/*
+=================
+Jobs_NumThreads
+
+returns how many threads can run a batch at once
+=================
+*/
+int Jobs_NumThreads( void )
+{
+#if !defined( JOBS_NO_THREADS )
+	if( !jobs.initialized || FBitSet( host_jobthreads.flags, FCVAR_CHANGED ))
+	{
+		ClearBits( host_jobthreads.flags, FCVAR_CHANGED );
+		Jobs_StopThreads();
+		Jobs_StartThreads();
+	}
+
+	return jobs.numthreads + 1;
+#else
+	return 1;
+#endif
+}
+
+/*
+=================
+Jobs_RunParallel
+
+calls job( data, i ) for every i in [0, count) and waits
+until all of them are finished, the caller thread takes part too
+=================
+*/
+void Jobs_RunParallel( pfnJob_t job, void *data, int count )
+{
+	int i;
+
+#if !defined( JOBS_NO_THREADS )
+	if( count > 1 && Jobs_NumThreads() > 1 )
+	{
+		mutex_lock( jobs.lock );
+		jobs.job = job;
+		jobs.data = data;
+		jobs.count = count;
+		jobs.next = 0;
+		jobs.finished = 0;
+		jobs.parallel = true;
+		jobs.generation++;
+		cond_broadcast( jobs.wake );
+
+		Jobs_Drain();
+
+		while( jobs.finished < jobs.count )
+			cond_wait( jobs.done, jobs.lock );
+
+		jobs.parallel = false;
+		jobs.job = NULL;
+		jobs.data = NULL;
+		mutex_unlock( jobs.lock );
+		return;
+	}
+#endif
+
+	for( i = 0; i < count; i++ )
+		job( data, i );
+}
+
+/*
+=================
+Jobs_Post
+
+queues task->job( task->data, 0 ) to run on a worker thread
+in background, the task memory is owned by the caller and must
+stay valid until Jobs_IsDone returns true or Jobs_Wait is called
+=================
+*/
+void Jobs_Post( jobtask_t *task, pfnJob_t job, void *data )
+{
+	task->job = job;
+	task->data = data;
+	task->next = NULL;
+	task->state = JOB_QUEUED;
+
+#if !defined( JOBS_NO_THREADS )
+	if( Jobs_NumThreads() > 1 )
+	{
+		mutex_lock( jobs.lock );
+		if( jobs.lasttask )
+			jobs.lasttask->next = task;
+		else jobs.tasks = task;
+		jobs.lasttask = task;
+		cond_broadcast( jobs.wake );
+		mutex_unlock( jobs.lock );
+		return;
+	}
+#endif
+
+	// no workers, run it right away
+	job( data, 0 );
+	task->state = JOB_DONE;
+}
+
+/*
+=================
+Jobs_IsDone
+=================
+*/
+qboolean Jobs_IsDone( jobtask_t *task )
+{
+#if !defined( JOBS_NO_THREADS )
+	if( jobs.initialized )
+	{
+		qboolean done;
+
+		mutex_lock( jobs.lock );
+		done = task->state == JOB_DONE;
+		mutex_unlock( jobs.lock );
+		return done;
+	}
+#endif
+
+	return task->state == JOB_DONE;
+}
+
+/*
+=================
+Jobs_Wait
+
+blocks until the task is finished, a task that
+wasn't picked up yet runs on the calling thread
+=================
+*/
+void Jobs_Wait( jobtask_t *task )
+{
+#if !defined( JOBS_NO_THREADS )
+	if( jobs.initialized )
+	{
+		mutex_lock( jobs.lock );
+
+		if( task->state == JOB_QUEUED )
+		{
+			jobtask_t **pp = &jobs.tasks, *prev = NULL;
+
+			while( *pp != task )
+			{
+				prev = *pp;
+				pp = &prev->next;
+			}
+
+			*pp = task->next;
+			if( jobs.lasttask == task )
+				jobs.lasttask = prev;
+
+			task->next = NULL;
+			task->state = JOB_RUNNING;
+
+			mutex_unlock( jobs.lock );
+			task->job( task->data, 0 );
+			mutex_lock( jobs.lock );
+
+			task->state = JOB_DONE;
+		}
+
+		while( task->state != JOB_DONE )
+			cond_wait( jobs.done, jobs.lock );
+
+		mutex_unlock( jobs.lock );
+		return;
+	}
+#endif
+
+	Assert( task->state == JOB_DONE );
+}
+
+/*
+=================
+Jobs_EnterCritical
+
+serializes calls into code that isn't thread-safe (mostly game dlls)
+while a batch is in flight, does nothing otherwise
+=================
+*/
+void Jobs_EnterCritical( void )
+{
+#if !defined( JOBS_NO_THREADS )
+	if( jobs.parallel )
+		mutex_lock( jobs.critical );
+#endif
+}
+
+void Jobs_LeaveCritical( void )
+{
+#if !defined( JOBS_NO_THREADS )
+	if( jobs.parallel )
+		mutex_unlock( jobs.critical );
+#endif
+}
+
+/*
+=================
+Jobs_Init
+=================
+*/
+void Jobs_Init( void )
+{
+	Cvar_RegisterVariable( &host_jobthreads );
+}
+
+/*
+=================
+Jobs_Shutdown
+=================
+*/
+void Jobs_Shutdown( void )
+{
+#if !defined( JOBS_NO_THREADS )
+	Jobs_StopThreads();
+#endif
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static void Test_JobsMark( void *data, int index )
+{
+	int *marks = data;
+
+	marks[index]++;
+}
+
+void Test_RunJobs( void )
+{
+	int marks[1000];
+	const int nummarks = sizeof( marks ) / sizeof( marks[0] );
+	string oldthreads;
+	int i, j, errors = 0;
+
+	// force a few workers even on single core machines
+	Q_strncpy( oldthreads, host_jobthreads.string, sizeof( oldthreads ));
+	Cvar_DirectSet( &host_jobthreads, "4" );
+	TASSERT_EQi( Jobs_NumThreads(), 4 );
+
+	for( j = 0; j < 16; j++ )
+	{
+		memset( marks, 0, sizeof( marks ));
+		Jobs_RunParallel( Test_JobsMark, marks, nummarks );
+
+		for( i = 0; i < nummarks; i++ )
+		{
+			if( marks[i] != 1 )
+				errors++;
+		}
+	}
+
+	TASSERT_EQi( errors, 0 );
+
+	// background tasks, some are waited for before a worker gets to them
+	{
+		jobtask_t tasks[64];
+		int taskmarks[64];
+
+		memset( taskmarks, 0, sizeof( taskmarks ));
+
+		for( i = 0; i < 64; i++ )
+			Jobs_Post( &tasks[i], Test_JobsMark, &taskmarks[i] );
+
+		for( i = 63; i >= 0; i-- )
+			Jobs_Wait( &tasks[i] );
+
+		for( i = 0, errors = 0; i < 64; i++ )
+		{
+			if( taskmarks[i] != 1 || !Jobs_IsDone( &tasks[i] ))
+				errors++;
+		}
+
+		TASSERT_EQi( errors, 0 );
+	}
+
+	Cvar_DirectSet( &host_jobthreads, oldthreads );
+	TASSERT( Jobs_NumThreads() >= 1 );
+}
+#endif // XASH_ENGINE_TESTS
@@ -1610,6 +1610,224 @@ static int RemapClipNodes_r( dclipnode32_t *srcnodes, hull_t *hull, int nodenum
 	return c;
 }
 
+/*
+===============================================================================
+
+			FLATTENED HULLS
+
+clipnodes with planes inlined and sorted in depth-first order, so
+traces walk a single array. looked up by the clipnodes pointer,
+because hull_t layout is shared with game and renderer
+
+===============================================================================
+*/
+static struct
+{
+	mflathull_t	**slots;
+	int		numslots;		// power of two
+	int		count;
+} mod_flathulls;
+
+static uint Mod_FlatHullHash( const mclipnode_t *clipnodes )
+{
+	return (uint)((uintptr_t)clipnodes >> 3 ) * 2654435761u;
+}
+
+static void Mod_InsertFlatHull( mflathull_t *flat )
+{
+	uint	mask = mod_flathulls.numslots - 1;
+	uint	i = Mod_FlatHullHash( flat->clipnodes ) & mask;
+
+	while( mod_flathulls.slots[i] )
+		i = ( i + 1 ) & mask;
+
+	mod_flathulls.slots[i] = flat;
+	mod_flathulls.count++;
+}
+
+static void Mod_RehashFlatHulls( int numslots )
+{
+	mflathull_t	**slots = mod_flathulls.slots;
+	int		i, oldnumslots = mod_flathulls.numslots;
+
+	mod_flathulls.slots = Z_Calloc( numslots * sizeof( *slots ));
+	mod_flathulls.numslots = numslots;
+	mod_flathulls.count = 0;
+
+	for( i = 0; i < oldnumslots; i++ )
+	{
+		if( slots[i] )
+			Mod_InsertFlatHull( slots[i] );
+	}
+
+	if( slots ) Z_Free( slots );
+}
+
+/*
+=================
+Mod_FlatHullForHull
+
+returns NULL if hull wasn't flattened
+=================
+*/
+mflathull_t *Mod_FlatHullForHull( const hull_t *hull )
+{
+	mflathull_t	*flat;
+	uint		mask, i;
+
+	if( !mod_flathulls.count )
+		return NULL;
+
+	mask = mod_flathulls.numslots - 1;
+
+	for( i = Mod_FlatHullHash( hull->clipnodes ) & mask; ( flat = mod_flathulls.slots[i] ) != NULL; i = ( i + 1 ) & mask )
+	{
+		if( flat->clipnodes == hull->clipnodes && flat->planes == hull->planes )
+			return flat;
+	}
+
+	return NULL;
+}
+
+/*
+=================
+Mod_FreeFlatHulls
+
+forget hulls that are freed with the pool
+=================
+*/
+void Mod_FreeFlatHulls( poolhandle_t mempool )
+{
+	qboolean	removed = false;
+	int	i;
+
+	for( i = 0; i < mod_flathulls.numslots; i++ )
+	{
+		if( mod_flathulls.slots[i] && mod_flathulls.slots[i]->mempool == mempool )
+		{
+			mod_flathulls.slots[i] = NULL;
+			removed = true;
+		}
+	}
+
+	// open addressing needs the rest to be reinserted
+	if( removed )
+		Mod_RehashFlatHulls( mod_flathulls.numslots );
+}
+
+/*
+=================
+Mod_FlattenHull
+
+nodes reachable from roots are laid out first,
+then anything that was left in the clipnodes
+=================
+*/
+mflathull_t *Mod_FlattenHull( const hull_t *hull, int numnodes, const int *roots, int numroots, poolhandle_t mempool )
+{
+	mflathull_t	*flat;
+	int		*stack, *remap;
+	int		i, j, sp, num, depth, child;
+	int		count = 0, maxdepth = 0;
+
+	if( numnodes <= 0 || !hull->clipnodes || !hull->planes )
+		return NULL;
+
+	// broken children are left to recursive trace to report
+	for( i = 0; i < numnodes; i++ )
+	{
+		for( j = 0; j < 2; j++ )
+		{
+			if( hull->clipnodes[i].children[j] >= numnodes )
+				return NULL;
+		}
+	}
+
+	remap = Mem_Malloc( mempool, numnodes * sizeof( int ));
+	stack = Z_Malloc(( numnodes * 2 + 1 ) * 2 * sizeof( int ));
+
+	for( i = 0; i < numnodes; i++ )
+		remap[i] = -1;
+
+	for( i = 0; i < numroots + numnodes; i++ )
+	{
+		num = ( i < numroots ) ? roots[i] : i - numroots;
+
+		if( num < 0 || num >= numnodes || remap[num] != -1 )
+			continue;
+
+		sp = 0;
+		stack[sp++] = num;
+		stack[sp++] = 1;
+
+		while( sp > 0 )
+		{
+			depth = stack[--sp];
+			num = stack[--sp];
+
+			if( remap[num] != -1 )
+				continue;
+
+			remap[num] = count++;
+			maxdepth = Q_max( maxdepth, depth );
+
+			// front child goes right after the node
+			for( j = 1; j >= 0; j-- )
+			{
+				child = hull->clipnodes[num].children[j];
+
+				if( child >= 0 && remap[child] == -1 )
+				{
+					stack[sp++] = child;
+					stack[sp++] = depth + 1;
+				}
+			}
+		}
+	}
+
+	Z_Free( stack );
+
+	if( maxdepth > MAX_FLATHULL_DEPTH )
+	{
+		Con_Reportf( "%s: hull is %i nodes deep, not flattened\n", __func__, maxdepth );
+		Mem_Free( remap );
+		return NULL;
+	}
+
+	flat = Mem_Calloc( mempool, sizeof( *flat ));
+	flat->clipnodes = hull->clipnodes;
+	flat->planes = hull->planes;
+	flat->mempool = mempool;
+	flat->numnodes = numnodes;
+	flat->remap = remap;
+	flat->nodes = Mem_Malloc( mempool, numnodes * sizeof( mflatnode_t ));
+
+	for( i = 0; i < numnodes; i++ )
+	{
+		const mclipnode_t	*in = &hull->clipnodes[i];
+		const mplane_t	*plane = &hull->planes[in->planenum];
+		mflatnode_t	*out = &flat->nodes[remap[i]];
+
+		VectorCopy( plane->normal, out->normal );
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->planenum = in->planenum;
+
+		for( j = 0; j < 2; j++ )
+		{
+			child = in->children[j];
+			out->children[j] = ( child >= 0 ) ? remap[child] : child;
+		}
+	}
+
+	if(( mod_flathulls.count + 1 ) * 2 > mod_flathulls.numslots )
+		Mod_RehashFlatHulls( Q_max( mod_flathulls.numslots * 2, 64 ));
+
+	Mod_InsertFlatHull( flat );
+
+	return flat;
+}
+
 /*
 =================
 Mod_MakeHull0
@@ -1622,6 +1840,7 @@ static void Mod_MakeHull0( model_t *mod )
 	mnode_t		*in, *child;
 	mclipnode_t	*out;
 	hull_t		*hull;
+	int		*roots;
 	int		i, j;
 
 	hull = &mod->hulls[0];
@@ -1645,6 +1864,14 @@ static void Mod_MakeHull0( model_t *mod )
 			else out->children[j] = child - mod->nodes;
 		}
 	}
+
+	// hull 0 is shared by all submodels
+	roots = Mem_Malloc( mod->mempool, Q_max( mod->numsubmodels, 1 ) * sizeof( int ));
+	for( i = 0; i < mod->numsubmodels; i++ )
+		roots[i] = mod->submodels[i].headnode[0];
+
+	Mod_FlattenHull( hull, mod->numnodes, roots, mod->numsubmodels, mod->mempool );
+	Mem_Free( roots );
 }
 
 /*
@@ -1697,6 +1924,9 @@ static void Mod_SetupHull( dbspmodel_t *bmod, model_t *mod, poolhandle_t mempool
 
 	// remap clipnodes to 16-bit indexes
 	RemapClipNodes_r( bmod->clipnodes_out, hull, headnode );
+
+	// remapped nodes are already depth-first, inline the planes
+	Mod_FlattenHull( hull, hull->lastclipnode, &hull->firstclipnode, 1, mempool );
 }
 
 static qboolean Mod_LoadLitfile( model_t *mod, const char *ext, size_t expected_size, color24 **out, size_t *outsize )
@@ -83,6 +83,28 @@ typedef struct
 	uint		num_polys;
 } hull_model_t;
 
+#define MAX_FLATHULL_DEPTH	128	// deeper hulls are traced recursively
+
+// clipnode with inlined plane, see Mod_FlattenHull
+typedef struct mflatnode_s
+{
+	vec3_t		normal;
+	float		dist;
+	int		type;		// plane type, same as mplane_t for PlaneDiff
+	int		children[2];	// flat node numbers, negative numbers are contents
+	int		planenum;		// keeps node size at 32 bytes
+} mflatnode_t;
+
+typedef struct mflathull_s
+{
+	const mclipnode_t	*clipnodes;	// source hull
+	const mplane_t	*planes;
+	poolhandle_t	mempool;		// flat hull is freed with it
+	int		numnodes;
+	int		*remap;		// clipnode number to flat node number
+	mflatnode_t	*nodes;		// in depth-first order
+} mflathull_t;
+
 typedef struct wadlist_s
 {
 	char wadnames[MAX_MAP_WADS][36]; // including .wad extension
@@ -178,6 +200,9 @@ int Mod_SampleSizeForFace( const msurface_t *surf );
 byte *Mod_GetPVSForPoint( const vec3_t p );
 void Mod_UnloadBrushModel( model_t *mod );
 void Mod_PrintWorldStats_f( void );
+mflathull_t *Mod_FlattenHull( const hull_t *hull, int numnodes, const int *roots, int numroots, poolhandle_t mempool );
+mflathull_t *Mod_FlatHullForHull( const hull_t *hull );
+void Mod_FreeFlatHulls( poolhandle_t mempool );
 
 //
 // mod_dbghulls.c
@@ -203,6 +228,7 @@ void *R_StudioGetAnim( studiohdr_t *m_pStudioHeader, model_t *m_pSubModel, mstud
 void Mod_StudioComputeBounds( void *buffer, vec3_t mins, vec3_t maxs, qboolean ignore_sequences );
 int Mod_HitgroupForStudioHull( int index );
 void Mod_ClearStudioCache( void );
+void Mod_StudioCacheStats_f( void );
 
 //
 // mod_sprite.c
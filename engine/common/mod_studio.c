@@ -22,6 +22,12 @@ GNU General Public License for more details.
 
 typedef int (*STUDIOAPI)( int, sv_blending_interface_t**, server_studio_api_t*,  float (*transform)[3][4], float (*bones)[MAXSTUDIOBONES][3][4] );
 
+#define STUDIO_CACHESIZE		256	// cached hitbox setups
+#define STUDIO_CACHEHASHSIZE		512	// must be power of two
+#define STUDIO_CACHESLABS		512	// hitbox storage is bounded by slabs count
+#define STUDIO_SLABHITBOXES		8
+#define STUDIO_CACHE_NULL		-1
+
 typedef struct mstudiocache_s
 {
 	model_t *model;
@@ -32,32 +38,47 @@ typedef struct mstudiocache_s
 	vec3_t  size;
 	byte    controller[4];
 	byte    blending[2];
-	uint    current_hull;
-	uint    current_plane;
 	uint    numhitboxes;
+	uint    hash;
+	int     firstslab;
+	int     hashnext;	// also links free entries
+	int     lruprev;
+	int     lrunext;
 } mstudiocache_t;
 
-#define STUDIO_CACHESIZE		16
-#define STUDIO_CACHEMASK		(STUDIO_CACHESIZE - 1)
+typedef struct mstudiocacheslab_s
+{
+	mplane_t	planes[STUDIO_SLABHITBOXES * 6];
+	uint	hitgroup[STUDIO_SLABHITBOXES];
+	int	next;
+} mstudiocacheslab_t;
 
 // trace global variables
 static sv_blending_interface_t	*pBlendAPI = NULL;
 static studiohdr_t			*mod_studiohdr;
 static matrix3x4			studio_transform;
-static hull_t			cache_hull[MAXSTUDIOBONES];
 static hull_t			studio_hull[MAXSTUDIOBONES];
 static matrix3x4			studio_bones[MAXSTUDIOBONES];
 static uint			studio_hull_hitgroup[MAXSTUDIOBONES];
-static uint			cache_hull_hitgroup[MAXSTUDIOBONES];
-static mstudiocache_t		cache_studio[STUDIO_CACHESIZE];
 static mclipnode_t			studio_clipnodes[6];
 static mplane_t			studio_planes[768];
-static mplane_t			cache_planes[768];
 
-// current cache state
-static int			cache_current;
-static int			cache_current_hull;
-static int			cache_current_plane;
+// hitbox cache, entries are kept in least recently used order
+static struct
+{
+	mstudiocache_t		entries[STUDIO_CACHESIZE];
+	mstudiocacheslab_t		*slabs;		// [STUDIO_CACHESLABS], allocated when cache is used
+	int			hash[STUDIO_CACHEHASHSIZE];
+	int			lruhead;		// most recently used
+	int			lrutail;
+	int			freeentry;
+	int			freeslab;
+	int			numentries;
+	int			numslabs;
+	uint			lookups;
+	uint			hits;
+	uint			evictions;
+} studio_cache;
 
 /*
 ====================
@@ -101,14 +122,151 @@ void Mod_InitStudioHull( void )
 /*
 ====================
 ClearStudioCache
+
+must be called before com_studiocache is emptied
 ====================
 */
 void Mod_ClearStudioCache( void )
 {
-	memset( cache_studio, 0, sizeof( cache_studio ));
-	cache_current_hull = cache_current_plane = 0;
+	int	i;
+
+	if( studio_cache.slabs )
+		Mem_Free( studio_cache.slabs );
+
+	memset( &studio_cache, 0, sizeof( studio_cache ));
+
+	for( i = 0; i < STUDIO_CACHEHASHSIZE; i++ )
+		studio_cache.hash[i] = STUDIO_CACHE_NULL;
+
+	for( i = 0; i < STUDIO_CACHESIZE; i++ )
+		studio_cache.entries[i].hashnext = i + 1;
+	studio_cache.entries[STUDIO_CACHESIZE - 1].hashnext = STUDIO_CACHE_NULL;
 
-	cache_current = 0;
+	studio_cache.lruhead = studio_cache.lrutail = STUDIO_CACHE_NULL;
+}
+
+/*
+====================
+AllocStudioCacheSlabs
+
+hitbox storage is big, so don't keep it around
+when mod_studiocache is disabled
+====================
+*/
+static void Mod_AllocStudioCacheSlabs( void )
+{
+	int	i;
+
+	studio_cache.slabs = Mem_Malloc( com_studiocache, STUDIO_CACHESLABS * sizeof( mstudiocacheslab_t ));
+
+	for( i = 0; i < STUDIO_CACHESLABS; i++ )
+		studio_cache.slabs[i].next = i + 1;
+	studio_cache.slabs[STUDIO_CACHESLABS - 1].next = STUDIO_CACHE_NULL;
+
+	studio_cache.freeslab = 0;
+}
+
+/*
+====================
+StudioCacheHash
+====================
+*/
+static uint Mod_StudioCacheHash( model_t *model, float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *controller, byte *blending )
+{
+	const byte	*data[8];
+	size_t		sizes[8];
+	uint		hash = 2166136261u;
+	size_t		i, j;
+
+	data[0] = (const byte *)&model;	sizes[0] = sizeof( model );
+	data[1] = (const byte *)&frame;	sizes[1] = sizeof( frame );
+	data[2] = (const byte *)&sequence;	sizes[2] = sizeof( sequence );
+	data[3] = (const byte *)angles;	sizes[3] = sizeof( vec3_t );
+	data[4] = (const byte *)origin;	sizes[4] = sizeof( vec3_t );
+	data[5] = (const byte *)size;	sizes[5] = sizeof( vec3_t );
+	data[6] = controller;		sizes[6] = 4;
+	data[7] = blending;			sizes[7] = 2;
+
+	// FNV-1a, keys differing only by -0.0 just won't share an entry
+	for( i = 0; i < 8; i++ )
+	{
+		for( j = 0; j < sizes[i]; j++ )
+			hash = ( hash ^ data[i][j] ) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+====================
+StudioCacheUnlinkLRU
+====================
+*/
+static void Mod_StudioCacheUnlinkLRU( int index )
+{
+	mstudiocache_t	*entry = &studio_cache.entries[index];
+
+	if( entry->lruprev != STUDIO_CACHE_NULL )
+		studio_cache.entries[entry->lruprev].lrunext = entry->lrunext;
+	else studio_cache.lruhead = entry->lrunext;
+
+	if( entry->lrunext != STUDIO_CACHE_NULL )
+		studio_cache.entries[entry->lrunext].lruprev = entry->lruprev;
+	else studio_cache.lrutail = entry->lruprev;
+}
+
+/*
+====================
+StudioCacheLinkLRU
+====================
+*/
+static void Mod_StudioCacheLinkLRU( int index )
+{
+	mstudiocache_t	*entry = &studio_cache.entries[index];
+
+	entry->lruprev = STUDIO_CACHE_NULL;
+	entry->lrunext = studio_cache.lruhead;
+
+	if( studio_cache.lruhead != STUDIO_CACHE_NULL )
+		studio_cache.entries[studio_cache.lruhead].lruprev = index;
+	else studio_cache.lrutail = index;
+
+	studio_cache.lruhead = index;
+}
+
+/*
+====================
+StudioCacheEvict
+
+frees least recently used entry
+====================
+*/
+static void Mod_StudioCacheEvict( void )
+{
+	int		index = studio_cache.lrutail;
+	mstudiocache_t	*entry = &studio_cache.entries[index];
+	int		*link, slab;
+
+	Mod_StudioCacheUnlinkLRU( index );
+
+	for( link = &studio_cache.hash[entry->hash & ( STUDIO_CACHEHASHSIZE - 1 )]; *link != index; )
+		link = &studio_cache.entries[*link].hashnext;
+	*link = entry->hashnext;
+
+	while( entry->firstslab != STUDIO_CACHE_NULL )
+	{
+		slab = entry->firstslab;
+		entry->firstslab = studio_cache.slabs[slab].next;
+		studio_cache.slabs[slab].next = studio_cache.freeslab;
+		studio_cache.freeslab = slab;
+		studio_cache.numslabs--;
+	}
+
+	entry->model = NULL;
+	entry->hashnext = studio_cache.freeentry;
+	studio_cache.freeentry = index;
+	studio_cache.numentries--;
+	studio_cache.evictions++;
 }
 
 /*
@@ -116,15 +274,25 @@ void Mod_ClearStudioCache( void )
 AddToStudioCache
 ====================
 */
-static void Mod_AddToStudioCache( float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *pcontroller, byte *pblending, model_t *model, hull_t *hull, int numhitboxes )
+static void Mod_AddToStudioCache( uint hash, float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *pcontroller, byte *pblending, model_t *model, int numhitboxes )
 {
-	mstudiocache_t *pCache;
+	int		numslabs = ( numhitboxes + STUDIO_SLABHITBOXES - 1 ) / STUDIO_SLABHITBOXES;
+	mstudiocache_t	*pCache;
+	int		i, index, *link;
+
+	if( numhitboxes < 0 || numslabs > STUDIO_CACHESLABS )
+		return;
 
-	if( numhitboxes + cache_current_hull >= MAXSTUDIOBONES )
-		Mod_ClearStudioCache();
+	if( !studio_cache.slabs )
+		Mod_AllocStudioCacheSlabs();
 
-	cache_current++;
-	pCache = &cache_studio[cache_current & STUDIO_CACHEMASK];
+	while( studio_cache.freeentry == STUDIO_CACHE_NULL || studio_cache.numslabs + numslabs > STUDIO_CACHESLABS )
+		Mod_StudioCacheEvict();
+
+	index = studio_cache.freeentry;
+	pCache = &studio_cache.entries[index];
+	studio_cache.freeentry = pCache->hashnext;
+	studio_cache.numentries++;
 
 	pCache->frame = frame;
 	pCache->sequence = sequence;
@@ -136,16 +304,34 @@ static void Mod_AddToStudioCache( float frame, int sequence, vec3_t angles, vec3
 	memcpy( pCache->blending, pblending, 2 );
 
 	pCache->model = model;
-	pCache->current_hull = cache_current_hull;
-	pCache->current_plane = cache_current_plane;
+	pCache->numhitboxes = numhitboxes;
+	pCache->hash = hash;
 
-	memcpy( &cache_hull[cache_current_hull], hull, numhitboxes * sizeof( hull_t ));
-	memcpy( &cache_planes[cache_current_plane], studio_planes, numhitboxes * sizeof( mplane_t ) * 6 );
-	memcpy( &cache_hull_hitgroup[cache_current_hull], studio_hull_hitgroup, numhitboxes * sizeof( uint ));
+	// copy hitboxes to slabs, keeping their order
+	link = &pCache->firstslab;
 
-	cache_current_hull += numhitboxes;
-	cache_current_plane += numhitboxes * 6;
-	pCache->numhitboxes = numhitboxes;
+	for( i = 0; i < numslabs; i++ )
+	{
+		int			slab = studio_cache.freeslab;
+		int			count = Q_min( numhitboxes - i * STUDIO_SLABHITBOXES, STUDIO_SLABHITBOXES );
+		mstudiocacheslab_t	*out = &studio_cache.slabs[slab];
+
+		studio_cache.freeslab = out->next;
+		studio_cache.numslabs++;
+
+		memcpy( out->planes, &studio_planes[i * STUDIO_SLABHITBOXES * 6], count * sizeof( mplane_t ) * 6 );
+		memcpy( out->hitgroup, &studio_hull_hitgroup[i * STUDIO_SLABHITBOXES], count * sizeof( uint ));
+
+		*link = slab;
+		link = &out->next;
+	}
+	*link = STUDIO_CACHE_NULL;
+
+	link = &studio_cache.hash[hash & ( STUDIO_CACHEHASHSIZE - 1 )];
+	pCache->hashnext = *link;
+	*link = index;
+
+	Mod_StudioCacheLinkLRU( index );
 }
 
 /*
@@ -153,14 +339,19 @@ static void Mod_AddToStudioCache( float frame, int sequence, vec3_t angles, vec3
 CheckStudioCache
 ====================
 */
-static mstudiocache_t *Mod_CheckStudioCache( model_t *model, float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *controller, byte *blending )
+static mstudiocache_t *Mod_CheckStudioCache( uint hash, model_t *model, float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *controller, byte *blending )
 {
 	mstudiocache_t	*pCached;
-	int		i;
+	int		index;
 
-	for( i = 0; i < STUDIO_CACHESIZE; i++ )
+	studio_cache.lookups++;
+
+	for( index = studio_cache.hash[hash & ( STUDIO_CACHEHASHSIZE - 1 )]; index != STUDIO_CACHE_NULL; index = pCached->hashnext )
 	{
-		pCached = &cache_studio[(cache_current - i) & STUDIO_CACHEMASK];
+		pCached = &studio_cache.entries[index];
+
+		if( pCached->hash != hash )
+			continue;
 
 		if( pCached->model != model )
 			continue;
@@ -186,12 +377,53 @@ static mstudiocache_t *Mod_CheckStudioCache( model_t *model, float frame, int se
 		if( memcmp( pCached->blending, blending, 2 ) != 0 )
 			continue;
 
+		// move to the head of LRU list
+		Mod_StudioCacheUnlinkLRU( index );
+		Mod_StudioCacheLinkLRU( index );
+		studio_cache.hits++;
+
 		return pCached;
 	}
 
 	return NULL;
 }
 
+/*
+====================
+RestoreFromStudioCache
+====================
+*/
+static void Mod_RestoreFromStudioCache( const mstudiocache_t *pCached )
+{
+	const mstudiocacheslab_t	*in;
+	int			i, slab, count;
+
+	for( i = 0, slab = pCached->firstslab; slab != STUDIO_CACHE_NULL; i += STUDIO_SLABHITBOXES, slab = in->next )
+	{
+		in = &studio_cache.slabs[slab];
+		count = Q_min( (int)pCached->numhitboxes - i, STUDIO_SLABHITBOXES );
+
+		memcpy( &studio_planes[i * 6], in->planes, count * sizeof( mplane_t ) * 6 );
+		memcpy( &studio_hull_hitgroup[i], in->hitgroup, count * sizeof( uint ));
+	}
+}
+
+/*
+====================
+StudioCacheStats_f
+====================
+*/
+void Mod_StudioCacheStats_f( void )
+{
+	uint	misses = studio_cache.lookups - studio_cache.hits;
+
+	Con_Printf( "%u lookups, %u hits, %u misses, %.1f%% hit rate\n", studio_cache.lookups, studio_cache.hits, misses,
+		studio_cache.lookups ? studio_cache.hits * 100.0 / studio_cache.lookups : 0.0 );
+	Con_Printf( "%i/%i entries, %i/%i hitbox slabs, %u evictions\n", studio_cache.numentries, STUDIO_CACHESIZE,
+		studio_cache.numslabs, STUDIO_CACHESLABS, studio_cache.evictions );
+	Con_Printf( "%s of cache memory\n", Q_memprint( sizeof( studio_cache ) + ( studio_cache.slabs ? STUDIO_CACHESLABS * sizeof( mstudiocacheslab_t ) : 0 )));
+}
+
 /*
 ===============================================================================
 
@@ -234,6 +466,7 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 	mstudiocache_t	*bonecache;
 	mstudiobbox_t	*phitbox;
 	qboolean		bSkipShield;
+	uint		hash = 0;
 	int		i, j;
 
 	bSkipShield = false;
@@ -241,13 +474,12 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 
 	if( mod_studiocache.value )
 	{
-		bonecache = Mod_CheckStudioCache( model, frame, sequence, angles, origin, size, pcontroller, pblending );
+		hash = Mod_StudioCacheHash( model, frame, sequence, angles, origin, size, pcontroller, pblending );
+		bonecache = Mod_CheckStudioCache( hash, model, frame, sequence, angles, origin, size, pcontroller, pblending );
 
 		if( bonecache != NULL )
 		{
-			memcpy( studio_planes, &cache_planes[bonecache->current_plane], bonecache->numhitboxes * sizeof( mplane_t ) * 6 );
-			memcpy( studio_hull_hitgroup, &cache_hull_hitgroup[bonecache->current_hull], bonecache->numhitboxes * sizeof( uint ));
-			memcpy( studio_hull, &cache_hull[bonecache->current_hull], bonecache->numhitboxes * sizeof( hull_t ));
+			Mod_RestoreFromStudioCache( bonecache );
 
 			*numhitboxes = bonecache->numhitboxes;
 			return studio_hull;
@@ -287,7 +519,7 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 	*numhitboxes = (bSkipShield) ? (mod_studiohdr->numhitboxes - 1) : (mod_studiohdr->numhitboxes);
 
 	if( mod_studiocache.value )
-		Mod_AddToStudioCache( frame, sequence, angles, origin, size, pcontroller, pblending, model, studio_hull, *numhitboxes );
+		Mod_AddToStudioCache( hash, frame, sequence, angles, origin, size, pcontroller, pblending, model, *numhitboxes );
 
 	return studio_hull;
 }
@@ -1013,3 +1245,103 @@ void Mod_ResetStudioAPI( void )
 {
 	pBlendAPI = &gBlendAPI;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static model_t	test_studiomodel;
+
+static mstudiocache_t *Test_CheckStudioCache( int frame )
+{
+	vec3_t	angles = { 0.0f, 90.0f, 0.0f }, origin = { 128.0f, 0.0f, 0.0f }, size = { 0 };
+	byte	controller[4] = { 127, 127, 127, 127 }, blending[2] = { 0 };
+	uint	hash = Mod_StudioCacheHash( &test_studiomodel, frame, 1, angles, origin, size, controller, blending );
+
+	return Mod_CheckStudioCache( hash, &test_studiomodel, frame, 1, angles, origin, size, controller, blending );
+}
+
+static void Test_AddToStudioCache( int frame, int numhitboxes )
+{
+	vec3_t	angles = { 0.0f, 90.0f, 0.0f }, origin = { 128.0f, 0.0f, 0.0f }, size = { 0 };
+	byte	controller[4] = { 127, 127, 127, 127 }, blending[2] = { 0 };
+	uint	hash = Mod_StudioCacheHash( &test_studiomodel, frame, 1, angles, origin, size, controller, blending );
+	int	i;
+
+	for( i = 0; i < numhitboxes * 6; i++ )
+		studio_planes[i].dist = frame * 1000 + i;
+
+	for( i = 0; i < numhitboxes; i++ )
+		studio_hull_hitgroup[i] = frame + i;
+
+	Mod_AddToStudioCache( hash, frame, 1, angles, origin, size, controller, blending, &test_studiomodel, numhitboxes );
+}
+
+static void Test_StudioCache( void )
+{
+	mstudiocache_t	*cached;
+	int		i, mismatches = 0;
+
+	Mod_ClearStudioCache();
+	TASSERT( studio_cache.slabs == NULL );
+
+	for( i = 0; i < STUDIO_CACHESIZE; i++ )
+		Test_AddToStudioCache( i, 1 + i % 16 );
+
+	TASSERT_EQi( studio_cache.numentries, STUDIO_CACHESIZE );
+	TASSERT_EQi( studio_cache.evictions, 0 );
+
+	// restored hitboxes must match what was stored
+	cached = Test_CheckStudioCache( 31 );
+	TASSERT( cached != NULL );
+
+	if( cached )
+	{
+		memset( studio_planes, 0, sizeof( studio_planes ));
+		Mod_RestoreFromStudioCache( cached );
+
+		TASSERT_EQi( cached->numhitboxes, 16 );
+		for( i = 0; i < 16 * 6; i++ )
+		{
+			if( studio_planes[i].dist != 31 * 1000 + i )
+				mismatches++;
+		}
+		TASSERT_EQi( mismatches, 0 );
+		TASSERT_EQi( studio_hull_hitgroup[15], 31 + 15 );
+	}
+
+	// frame 0 was used recently, so frame 1 is evicted
+	TASSERT( Test_CheckStudioCache( 0 ) != NULL );
+	Test_AddToStudioCache( STUDIO_CACHESIZE, 1 );
+	TASSERT( Test_CheckStudioCache( 0 ) != NULL );
+	TASSERT( Test_CheckStudioCache( 1 ) == NULL );
+	TASSERT( Test_CheckStudioCache( STUDIO_CACHESIZE ) != NULL );
+	TASSERT_EQi( studio_cache.evictions, 1 );
+
+	// big models are limited by hitbox storage
+	for( i = 0; i < STUDIO_CACHESIZE; i++ )
+		Test_AddToStudioCache( STUDIO_CACHESIZE * 2 + i, MAXSTUDIOBONES );
+
+	TASSERT( studio_cache.numslabs <= STUDIO_CACHESLABS );
+	TASSERT_EQi( studio_cache.numentries, STUDIO_CACHESLABS / ( MAXSTUDIOBONES / STUDIO_SLABHITBOXES ));
+	TASSERT( Test_CheckStudioCache( STUDIO_CACHESIZE * 3 - 1 ) != NULL );
+	TASSERT( Test_CheckStudioCache( STUDIO_CACHESIZE * 2 ) == NULL );
+
+	Mod_ClearStudioCache();
+	TASSERT( Test_CheckStudioCache( 0 ) == NULL );
+	TASSERT( studio_cache.slabs == NULL );
+	Mod_ClearStudioCache();
+}
+
+void Test_RunStudioCache( void )
+{
+	poolhandle_t oldpool = com_studiocache;
+
+	// tests run before Mod_Init
+	com_studiocache = Mem_AllocPool( "Studio Cache Test" );
+
+	TRUN( Test_StudioCache() );
+
+	Mem_FreePool( &com_studiocache );
+	com_studiocache = oldpool;
+}
+#endif /* XASH_ENGINE_TESTS */
@@ -106,6 +106,7 @@ void Mod_FreeModel( model_t *mod )
 	if( mod->type != mod_brush || mod->name[0] != '*' )
 	{
 		Mod_FreeUserData( mod );
+		Mod_FreeFlatHulls( mod->mempool );
 		Mem_FreePool( &mod->mempool );
 	}
 
@@ -138,16 +139,18 @@ Mod_Init
 */
 void Mod_Init( void )
 {
-	com_studiocache = Mem_AllocPool( "Studio Cache" );
+	com_studiocache = Mem_AllocPoolExt( "Studio Cache", MEMPOOL_ARENA );
 	Cvar_RegisterVariable( &mod_studiocache );
 	Cvar_RegisterVariable( &r_wadtextures );
 	Cvar_RegisterVariable( &r_showhull );
 
 	Cmd_AddCommand( "mapstats", Mod_PrintWorldStats_f, "show stats for currently loaded map" );
 	Cmd_AddCommand( "modellist", Mod_Modellist_f, "display loaded models list" );
+	Cmd_AddCommand( "studiocachestats", Mod_StudioCacheStats_f, "show studio hitbox cache hit rate" );
 
 	Mod_ResetStudioAPI ();
 	Mod_InitStudioHull ();
+	Mod_ClearStudioCache ();
 }
 
 /*
@@ -188,6 +191,7 @@ Mod_Shutdown
 void Mod_Shutdown( void )
 {
 	Mod_FreeAll();
+	Mod_ClearStudioCache();
 	Mem_FreePool( &com_studiocache );
 }
 
@@ -277,7 +281,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	Q_strncpy( tempname, mod->name, sizeof( tempname ));
 	COM_FixSlashes( tempname );
 
-	buf = FS_LoadFile( tempname, &length, false );
+	buf = FS_MapFile( tempname, &length, false );
 
 	if( !buf )
 	{
@@ -311,7 +315,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 		Mod_LoadBrushModel( mod, buf, &loaded );
 		break;
 	default:
-		Mem_Free( buf );
+		FS_UnmapFile( buf );
 		if( crash ) Host_Error( "%s has unknown format\n", tempname );
 		else Con_Printf( S_ERROR "%s has unknown format\n", tempname );
 		return NULL;
@@ -348,7 +352,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	if( !loaded )
 	{
 		Mod_FreeModel( mod );
-		Mem_Free( buf );
+		FS_UnmapFile( buf );
 
 		if( crash ) Host_Error( "Could not load model %s\n", tempname );
 		else Con_Printf( S_ERROR "Could not load model %s\n", tempname );
@@ -378,7 +382,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 			p->initialCRC = currentCRC;
 		}
 	}
-	Mem_Free( buf );
+	FS_UnmapFile( buf );
 
 	return mod;
 }
@@ -431,8 +435,8 @@ static void Mod_PurgeStudioCache( void )
 		mod_known[i].needload = NL_UNREFERENCED;
 	}
 
-	Mem_EmptyPool( com_studiocache );
 	Mod_ClearStudioCache();
+	Mem_EmptyPool( com_studiocache );
 }
 
 /*
@@ -31,10 +31,12 @@ GNU General Public License for more details.
 #define FLOW_AVG			( 2.0f / 3.0f )	// how fast to converge flow estimates
 #define FLOW_INTERVAL		0.1		// don't compute more often than this
 #define MAX_RELIABLE_PAYLOAD		1400		// biggest packet that has frag and or reliable data
+#define NET_COMPRESS_CACHE		16		// recently compressed split packets
 
 // forward declarations
 void Netchan_FlushIncoming( netchan_t *chan, int stream );
 void Netchan_AddBufferToList( fragbuf_t **pplist, fragbuf_t *pbuf );
+static qboolean Netchan_FinishCompress( netchan_t *chan, fragbufwaiting_t *wait );
 
 /*
 packet header ( size in bits )
@@ -93,12 +95,30 @@ static CVAR_DEFINE_AUTO( net_showdrop, "0", 0, "show packets that are dropped" )
 static CVAR_DEFINE_AUTO( net_qport, "0", FCVAR_READ_ONLY, "current quake netport" );
 CVAR_DEFINE_AUTO( net_send_debug, "0", FCVAR_PRIVILEGED, "enable debugging output for outgoing messages" );
 CVAR_DEFINE_AUTO( net_recv_debug, "0", FCVAR_PRIVILEGED, "enable debugging output for incoming messages" );
+static CVAR_DEFINE_AUTO( net_compress_async, "0", 0, "compress split packets on worker threads, fragments are sent when it's done" );
+
+// compressed split packet, shared by every channel that sends the same payload
+typedef struct netcompress_s
+{
+	jobtask_t	task;
+	qboolean	pending;		// posted to a worker and not collected yet
+	qboolean	cached;		// lives in net_compress, otherwise freed with last reference
+	qboolean	bz2;
+	uint32_t	crc;
+	uint	size;
+	byte	*source;
+	byte	*compressed;
+	uint	compsize;		// 0 if compression didn't help
+	int	refcount;		// waitlists that need the result
+	double	lastused;
+} netcompress_t;
 
 int	net_drop;
 netadr_t	net_from;
 sizebuf_t	net_message;
 static poolhandle_t net_mempool;
 byte	net_message_buffer[NET_MAX_MESSAGE];
+static netcompress_t *net_compress[NET_COMPRESS_CACHE];
 
 static const char *const ns_strings[NS_COUNT] =
 {
@@ -269,6 +289,7 @@ void Netchan_Init( void )
 	Cvar_RegisterVariable( &net_qport );
 	Cvar_RegisterVariable( &net_send_debug );
 	Cvar_RegisterVariable( &net_recv_debug );
+	Cvar_RegisterVariable( &net_compress_async );
 	Cvar_FullSet( net_qport.name, buf, net_qport.flags );
 
 	net_mempool = Mem_AllocPool( "Network Pool" );
@@ -276,8 +297,11 @@ void Netchan_Init( void )
 	MSG_InitMasks();	// initialize bit-masks
 }
 
+static void Netchan_ClearCompressCache( void );
+
 void Netchan_Shutdown( void )
 {
+	Netchan_ClearCompressCache();
 	Mem_FreePool( &net_mempool );
 }
 
@@ -424,6 +448,206 @@ static void Netchan_UnlinkFragment( fragbuf_t *buf, fragbuf_t **list )
 	}
 }
 
+/*
+=================================
+
+SPLIT PACKET COMPRESSION
+
+=================================
+*/
+
+/*
+==============================
+Netchan_CompressJob
+
+runs on a worker thread when net_compress_async is set,
+must not touch anything but the netcompress_t
+==============================
+*/
+static void Netchan_CompressJob( void *data, int unused )
+{
+	netcompress_t	*c = data;
+
+	c->compsize = 0;
+
+	if( c->bz2 )
+	{
+#if !XASH_DEDICATED
+		uint uCompressedSize = c->size - 4;
+
+		if( BZ2_bzBuffToBuffCompress( (char *)c->compressed + 4, &uCompressedSize, (char *)c->source, c->size, 9, 0, 30 ) == BZ_OK )
+		{
+			if( uCompressedSize < c->size )
+			{
+				memcpy( c->compressed, "BZ2", 4 );
+				c->compsize = uCompressedSize + 4;
+			}
+		}
+#endif
+	}
+	else
+	{
+		uint uCompressedSize = 0;
+		byte *pbOut = LZSS_Compress( c->source, c->size, &uCompressedSize );
+
+		if( pbOut && uCompressedSize > 0 && uCompressedSize < c->size )
+		{
+			memcpy( c->compressed, pbOut, uCompressedSize );
+			c->compsize = uCompressedSize;
+		}
+		if( pbOut ) free( pbOut );
+	}
+}
+
+/*
+==============================
+Netchan_IsCompressDone
+
+==============================
+*/
+static qboolean Netchan_IsCompressDone( netcompress_t *c )
+{
+	if( c->pending && Jobs_IsDone( &c->task ))
+		c->pending = false;
+
+	return !c->pending;
+}
+
+/*
+==============================
+Netchan_FreeCompress
+
+==============================
+*/
+static void Netchan_FreeCompress( netcompress_t *c )
+{
+	if( c->pending )
+		Jobs_Wait( &c->task );
+
+	Mem_Free( c->source );
+	Mem_Free( c->compressed );
+	Mem_Free( c );
+}
+
+/*
+==============================
+Netchan_ReleaseCompress
+
+==============================
+*/
+static void Netchan_ReleaseCompress( netcompress_t *c )
+{
+	c->refcount--;
+
+	if( c->refcount <= 0 && !c->cached )
+		Netchan_FreeCompress( c );
+}
+
+/*
+==============================
+Netchan_Compress
+
+returns the compression result for this payload, identical
+payloads (signon data, server reliable datagram) are compressed
+only once and shared between channels
+==============================
+*/
+static netcompress_t *Netchan_Compress( qboolean bz2, const byte *data, uint size )
+{
+	netcompress_t	*c;
+	uint32_t		crc;
+	int		i, empty = -1, evict = -1;
+
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, data, size );
+	crc = CRC32_Final( crc );
+
+	for( i = 0; i < NET_COMPRESS_CACHE; i++ )
+	{
+		c = net_compress[i];
+
+		if( !c )
+		{
+			if( empty == -1 )
+				empty = i;
+			continue;
+		}
+
+		if( c->bz2 == bz2 && c->size == size && c->crc == crc && !memcmp( c->source, data, size ))
+		{
+			c->refcount++;
+			c->lastused = host.realtime;
+			return c;
+		}
+
+		// least recently used entry that nobody waits for
+		if( c->refcount <= 0 && Netchan_IsCompressDone( c ))
+		{
+			if( evict == -1 || c->lastused < net_compress[evict]->lastused )
+				evict = i;
+		}
+	}
+
+	if( empty == -1 && evict != -1 )
+	{
+		Netchan_FreeCompress( net_compress[evict] );
+		net_compress[evict] = NULL;
+		empty = evict;
+	}
+
+	c = (netcompress_t *)Mem_Calloc( net_mempool, sizeof( *c ));
+	c->bz2 = bz2;
+	c->crc = crc;
+	c->size = size;
+	c->source = (byte *)Mem_Malloc( net_mempool, size );
+	c->compressed = (byte *)Mem_Malloc( net_mempool, size );
+	c->refcount = 1;
+	c->lastused = host.realtime;
+	memcpy( c->source, data, size );
+
+	// all slots are busy with unsent results, don't cache this one
+	if( empty != -1 )
+	{
+		c->cached = true;
+		net_compress[empty] = c;
+	}
+
+	if( net_compress_async.value )
+	{
+		c->pending = true;
+		Jobs_Post( &c->task, Netchan_CompressJob, c );
+	}
+	else Netchan_CompressJob( c, 0 );
+
+	return c;
+}
+
+/*
+==============================
+Netchan_ClearCompressCache
+
+==============================
+*/
+static void Netchan_ClearCompressCache( void )
+{
+	int	i;
+
+	for( i = 0; i < NET_COMPRESS_CACHE; i++ )
+	{
+		netcompress_t *c = net_compress[i];
+
+		if( !c )
+			continue;
+
+		net_compress[i] = NULL;
+
+		// still referenced by some waitlist, will be freed with it
+		if( c->refcount > 0 )
+			c->cached = false;
+		else Netchan_FreeCompress( c );
+	}
+}
+
 /*
 ==============================
 Netchan_ClearFragbufs
@@ -467,6 +691,8 @@ static void Netchan_ClearFragments( netchan_t *chan )
 		while( wait )
 		{
 			next = wait->next;
+			if( wait->compress )
+				Netchan_ReleaseCompress( wait->compress );
 			Netchan_ClearFragbufs( &wait->fragbufs );
 			Mem_Free( wait );
 			wait = next;
@@ -668,6 +894,10 @@ void Netchan_FragSend( netchan_t *chan )
 		// nothing to queue?
 		if( !wait ) continue;
 
+		// still compressing, try again next time
+		if( wait->compress && !Netchan_FinishCompress( chan, wait ))
+			continue;
+
 		chan->waitlist[i] = wait->next;
 
 		wait->next = NULL;
@@ -728,62 +958,21 @@ void Netchan_AddBufferToList( fragbuf_t **pplist, fragbuf_t *pbuf )
 
 /*
 ==============================
-Netchan_CreateFragments_
+Netchan_SplitFragments
 
+cuts the payload into fragment sized buffers
 ==============================
 */
-static void Netchan_CreateFragments_( netchan_t *chan, sizebuf_t *msg )
+static void Netchan_SplitFragments( netchan_t *chan, fragbufwaiting_t *wait, const byte *data, int size )
 {
 	fragbuf_t		*buf;
 	int		chunksize;
 	int		remaining;
 	int		bytes, pos;
 	int		bufferid = 1;
-	fragbufwaiting_t	*wait, *p;
-
-	if( MSG_GetNumBytesWritten( msg ) == 0 )
-		return;
 
 	chunksize = chan->pfnBlockSize( chan->client, FRAGSIZE_FRAG );
-
-	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
-
-	if( chan->use_bz2 && memcmp( MSG_GetData( msg ), "BZ2", 4 ))
-	{
-#if !XASH_DEDICATED
-		byte pbOut[0x10000];
-		uint uSourceSize = MSG_GetNumBytesWritten( msg );
-		uint uCompressedSize = MSG_GetNumBytesWritten( msg ) - 4;
-		if( BZ2_bzBuffToBuffCompress( pbOut, &uCompressedSize, MSG_GetData( msg ), uSourceSize, 9, 0, 30 ) == BZ_OK )
-		{
-			if( uCompressedSize < uSourceSize )
-			{
-				Con_Reportf( "Compressing split packet with BZip2 (%d -> %d bytes)\n", uSourceSize, uCompressedSize );
-				memcpy( msg->pData, "BZ2", 4 );
-				memcpy( msg->pData + 4, pbOut, uCompressedSize );
-				MSG_SeekToBit( msg, ( uCompressedSize + 4 ) << 3, SEEK_SET );
-			}
-		}
-#else
-		Host_Error( "%s: BZ2 compression is not supported for server", __func__ );
-#endif
-	}
-	else if( !chan->use_bz2 && !LZSS_IsCompressed( MSG_GetData( msg ), MSG_GetMaxBytes( msg )))
-	{
-		uint uCompressedSize = 0;
-		uint uSourceSize = MSG_GetNumBytesWritten( msg );
-		byte *pbOut = LZSS_Compress( msg->pData, uSourceSize, &uCompressedSize );
-
-		if( pbOut && uCompressedSize > 0 && uCompressedSize < uSourceSize )
-		{
-			Con_Reportf( "Compressing split packet with LZSS (%d -> %d bytes)\n", uSourceSize, uCompressedSize );
-			memcpy( msg->pData, pbOut, uCompressedSize );
-			MSG_SeekToBit( msg, uCompressedSize << 3, SEEK_SET );
-		}
-		if( pbOut ) free( pbOut );
-	}
-
-	remaining = MSG_GetNumBytesWritten( msg );
+	remaining = size;
 	pos = 0;	// current position in bytes
 
 	while( remaining > 0 )
@@ -796,11 +985,73 @@ static void Netchan_CreateFragments_( netchan_t *chan, sizebuf_t *msg )
 
 		// Copy in data
 		MSG_Clear( &buf->frag_message );
-		MSG_WriteBits( &buf->frag_message, &msg->pData[pos], bytes << 3 );
+		MSG_WriteBits( &buf->frag_message, &data[pos], bytes << 3 );
 
 		Netchan_AddFragbufToTail( wait, buf );
 		pos += bytes;
 	}
+}
+
+/*
+==============================
+Netchan_FinishCompress
+
+builds fragments from the compressed payload
+once it's ready, returns false if it's not
+==============================
+*/
+static qboolean Netchan_FinishCompress( netchan_t *chan, fragbufwaiting_t *wait )
+{
+	netcompress_t	*c = wait->compress;
+
+	if( !Netchan_IsCompressDone( c ))
+		return false;
+
+	if( c->compsize > 0 )
+	{
+		Con_Reportf( "Compressing split packet with %s (%d -> %d bytes)\n", c->bz2 ? "BZip2" : "LZSS", c->size, c->compsize );
+		Netchan_SplitFragments( chan, wait, c->compressed, c->compsize );
+	}
+	else Netchan_SplitFragments( chan, wait, c->source, c->size );
+
+	wait->compress = NULL;
+	Netchan_ReleaseCompress( c );
+
+	return true;
+}
+
+/*
+==============================
+Netchan_CreateFragments_
+
+==============================
+*/
+static void Netchan_CreateFragments_( netchan_t *chan, sizebuf_t *msg )
+{
+	fragbufwaiting_t	*wait, *p;
+
+	if( MSG_GetNumBytesWritten( msg ) == 0 )
+		return;
+
+	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
+
+	if( chan->use_bz2 && memcmp( MSG_GetData( msg ), "BZ2", 4 ))
+	{
+#if !XASH_DEDICATED
+		wait->compress = Netchan_Compress( true, MSG_GetData( msg ), MSG_GetNumBytesWritten( msg ));
+#else
+		Host_Error( "%s: BZ2 compression is not supported for server", __func__ );
+#endif
+	}
+	else if( !chan->use_bz2 && !LZSS_IsCompressed( MSG_GetData( msg ), MSG_GetMaxBytes( msg )))
+	{
+		wait->compress = Netchan_Compress( false, MSG_GetData( msg ), MSG_GetNumBytesWritten( msg ));
+	}
+
+	// pending waitlist is split in Netchan_FragSend when compression is finished
+	if( !wait->compress )
+		Netchan_SplitFragments( chan, wait, MSG_GetData( msg ), MSG_GetNumBytesWritten( msg ));
+	else Netchan_FinishCompress( chan, wait );
 
 	// now add waiting list item to end of buffer queue
 	if( !chan->waitlist[FRAG_NORMAL_STREAM] )
@@ -1567,8 +1818,9 @@ void Netchan_TransmitBits( netchan_t *chan, int length, const byte *data )
 				send_from_frag[i] = 1;
 		}
 
-		// stall reliable payloads if sending from frag buffer
-		if( send_from_regular && ( send_from_frag[FRAG_NORMAL_STREAM] ))
+		// stall reliable payloads if sending from frag buffer or if older
+		// message is still being compressed, it must be received first
+		if( send_from_regular && ( send_from_frag[FRAG_NORMAL_STREAM] || chan->waitlist[FRAG_NORMAL_STREAM] ))
 		{
 			int maxsize = chan->pfnBlockSize( chan->client, FRAGSIZE_SPLIT );
 			send_from_regular = false;
@@ -2008,3 +2260,67 @@ qboolean Netchan_Process( netchan_t *chan, sizebuf_t *msg )
 
 	return true;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static void Test_CompressCache( void )
+{
+	byte data[4096], other[4096], out[4096];
+	netcompress_t *c1, *c2, *c3;
+	int i;
+
+	for( i = 0; i < sizeof( data ); i++ )
+	{
+		data[i] = ( i / 16 ) & 0x7;
+		other[i] = ( i / 8 ) & 0x3;
+	}
+
+	net_compress_async.value = 0.0f;
+	c1 = Netchan_Compress( false, data, sizeof( data ));
+	c2 = Netchan_Compress( false, data, sizeof( data ));
+	TASSERT( c1 == c2 );
+	TASSERT_EQi( c1->refcount, 2 );
+	TASSERT( c1->compsize > 0 && c1->compsize < sizeof( data ));
+	TASSERT_EQi( LZSS_Decompress( c1->compressed, out, c1->compsize, sizeof( out )), (int)sizeof( data ));
+	TASSERT( !memcmp( out, data, sizeof( data )));
+
+	// same result must come out of a worker
+	net_compress_async.value = 1.0f;
+	c3 = Netchan_Compress( false, other, sizeof( other ));
+	TASSERT( c3 != c1 );
+	if( c3->pending )
+		Jobs_Wait( &c3->task );
+	TASSERT( Netchan_IsCompressDone( c3 ));
+	TASSERT_EQi( LZSS_Decompress( c3->compressed, out, c3->compsize, sizeof( out )), (int)sizeof( other ));
+	TASSERT( !memcmp( out, other, sizeof( other )));
+	net_compress_async.value = 0.0f;
+
+	Netchan_ReleaseCompress( c1 );
+	Netchan_ReleaseCompress( c2 );
+	Netchan_ReleaseCompress( c3 );
+	TASSERT_EQi( c1->refcount, 0 );
+
+	// released entries stay around for the next client
+	c2 = Netchan_Compress( false, data, sizeof( data ));
+	TASSERT( c1 == c2 );
+	Netchan_ReleaseCompress( c2 );
+
+	Netchan_ClearCompressCache();
+	for( i = 0; i < NET_COMPRESS_CACHE; i++ )
+		TASSERT( net_compress[i] == NULL );
+}
+
+void Test_RunNetchan( void )
+{
+	poolhandle_t oldpool = net_mempool;
+
+	// tests run before Netchan_Init
+	net_mempool = Mem_AllocPool( "Netchan Test" );
+
+	TRUN( Test_CompressCache( ));
+
+	Mem_FreePool( &net_mempool );
+	net_mempool = oldpool;
+}
+#endif // XASH_ENGINE_TESTS
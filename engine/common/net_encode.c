@@ -41,6 +41,8 @@ GNU General Public License for more details.
 
 #define NUM_FIELDS( x )	((sizeof( x ) / sizeof( x[0] )) - 1)
 
+#define DELTA_FIELD_INACTIVE( mask, i )	FBitSet(( mask )[( i ) >> 5], BIT(( i ) & 31 ))
+
 // helper macroses
 #define ENTS_DEF( x )	#x, offsetof( entity_state_t, x ), sizeof( ((entity_state_t *)0)->x )
 #define UCMD_DEF( x )	#x, offsetof( usercmd_t, x ), sizeof( ((usercmd_t *)0)->x )
@@ -51,6 +53,7 @@ GNU General Public License for more details.
 #define DESC_DEF( x )	#x, offsetof( goldsrc_delta_t, x ), sizeof( ((goldsrc_delta_t *)0)->x )
 
 static qboolean		delta_init = false;
+static int		delta_encodeclient = -1;	// receiving client while custom encoder runs
 
 // list of all the struct names
 static const delta_field_t cmd_fields[] =
@@ -329,6 +332,8 @@ static const delta_field_t meta_fields[] =
 { NULL },
 };
 
+STATIC_ASSERT( NUM_FIELDS( ent_fields ) <= DELTA_MAX_ENTITY_FIELDS, "increase DELTA_MAX_ENTITY_FIELDS" );
+
 #if XASH_ENGINE_TESTS
 typedef struct delta_test_struct_t
 {
@@ -382,6 +387,52 @@ static delta_info_t dt_info[] =
 [DT_STRUCT_COUNT]          = { NULL },
 };
 
+// see Delta_BuildLayout
+typedef struct
+{
+	qboolean	valid;	// false if table has strings or too many fields
+	int	numgroups;
+	int	groupbits[33];	// 0..32 bits
+	uint32_t	groupmask[33][DELTA_MASK_WORDS];
+} delta_layout_t;
+
+static delta_layout_t	dt_layouts[DT_STRUCT_COUNT];
+
+// field types, resolved from flags in the same order as Delta_WriteField_ does
+enum
+{
+	DOP_NONE = 0,
+	DOP_UBYTE,
+	DOP_SBYTE,
+	DOP_USHORT,
+	DOP_SSHORT,
+	DOP_UINT,
+	DOP_SINT,
+	DOP_FLOAT,
+	DOP_ANGLE,
+	DOP_TIMEWINDOW_8,
+	DOP_TIMEWINDOW_BIG,
+	DOP_STRING,
+};
+
+// one compiled field, see Delta_CompileTable
+typedef struct delta_op_s
+{
+	byte	op;
+	byte	bits;
+	byte	signbit;		// DT_SIGNED
+	byte	scaled;		// multiplier isn't 1.0
+	byte	postscaled;	// post_multiplier isn't 1.0
+	qboolean	clamp;		// bits < 32
+	int	maxnum;		// clamp range
+	int	minnum;
+	int	offset;
+	int	size;
+	float	multiplier;
+	float	post_multiplier;
+	delta_t	*field;		// for debug messages
+} delta_op_t;
+
 // meta description is special, it cannot be overriden
 static const delta_info_t dt_goldsrc_meta =
 {
@@ -518,6 +569,57 @@ static void Delta_CustomEncode( delta_info_t *dt, const void *from, const void *
 		dt->userCallback( dt->pFields, from, to );
 }
 
+/*
+=====================
+Delta_EncodeClient
+
+client the entity is being encoded for, -1 if unknown
+valid only inside of custom encode callback
+=====================
+*/
+int Delta_EncodeClient( void )
+{
+	return delta_encodeclient;
+}
+
+/*
+=====================
+Delta_CustomEncodeEntity
+
+same as Delta_CustomEncode, but the result is copied into
+caller-owned mask, so entities can be encoded by worker threads
+=====================
+*/
+static void Delta_CustomEncodeEntity( delta_info_t *dt, const void *from, const void *to, uint32_t *inactive, int client )
+{
+	int	i;
+
+	memset( inactive, 0, sizeof( uint32_t ) * DELTA_MASK_WORDS );
+
+	// all fields are active, don't touch the shared table
+	if( !dt->userCallback )
+		return;
+
+	// custom encoders live in game dll and share the field table,
+	// never call them concurrently, only this is serialized while
+	// comparing and writing the fields runs on all workers at once
+	Jobs_EnterCritical();
+
+	// encoders may ask for current player, which
+	// is not the right one on worker threads
+	delta_encodeclient = client;
+	Delta_CustomEncode( dt, from, to );
+	delta_encodeclient = -1;
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		if( dt->pFields[i].bInactive )
+			SetBits( inactive[i >> 5], BIT( i & 31 ));
+	}
+
+	Jobs_LeaveCritical();
+}
+
 static delta_field_t *Delta_FindFieldInfo( const delta_field_t *pInfo, const char *fieldName )
 {
 	if( !fieldName || !*fieldName )
@@ -546,12 +648,30 @@ static int Delta_IndexForFieldInfo( const delta_field_t *pInfo, const char *fiel
 	return -1;
 }
 
+/*
+=====================
+Delta_FreeProgram
+
+=====================
+*/
+static void Delta_FreeProgram( delta_info_t *dt )
+{
+	if( dt->pOps )
+	{
+		Z_Free( dt->pOps );
+		dt->pOps = NULL;
+	}
+}
+
 static qboolean Delta_AddField( delta_info_t *dt, const char *pName, int flags, int bits, float mul, float post_mul )
 {
 	delta_field_t	*pFieldInfo;
 	delta_t		*pField;
 	int		i;
 
+	// table changed, compiled version is invalid now
+	Delta_FreeProgram( dt );
+
 	// check for coexisting field
 	for( i = 0, pField = dt->pFields; i < dt->numFields && pField; i++, pField++ )
 	{
@@ -916,6 +1036,131 @@ static void Delta_InitFields( void )
 	Mem_Free( afile );
 }
 
+/*
+=====================
+Delta_CompileTable
+
+resolves field flags, multipliers and clamp ranges once,
+so entity deltas don't have to interpret them for every field
+=====================
+*/
+static void Delta_CompileTable( delta_info_t *dt )
+{
+	delta_op_t	*op;
+	delta_t		*pField;
+	int		i;
+
+	Delta_FreeProgram( dt );
+
+	if( !dt->bInitialized || dt->numFields <= 0 )
+		return;
+
+	dt->pOps = op = Z_Calloc( dt->numFields * sizeof( delta_op_t ));
+
+	for( i = 0, pField = dt->pFields; i < dt->numFields; i++, pField++, op++ )
+	{
+		op->signbit = FBitSet( pField->flags, DT_SIGNED ) ? 1 : 0;
+
+		if( FBitSet( pField->flags, DT_BYTE ))
+			op->op = op->signbit ? DOP_SBYTE : DOP_UBYTE;
+		else if( FBitSet( pField->flags, DT_SHORT ))
+			op->op = op->signbit ? DOP_SSHORT : DOP_USHORT;
+		else if( FBitSet( pField->flags, DT_INTEGER ))
+			op->op = op->signbit ? DOP_SINT : DOP_UINT;
+		else if( FBitSet( pField->flags, DT_FLOAT ))
+			op->op = DOP_FLOAT;
+		else if( FBitSet( pField->flags, DT_ANGLE ))
+			op->op = DOP_ANGLE;
+		else if( FBitSet( pField->flags, DT_TIMEWINDOW_8 ))
+			op->op = DOP_TIMEWINDOW_8;
+		else if( FBitSet( pField->flags, DT_TIMEWINDOW_BIG ))
+			op->op = DOP_TIMEWINDOW_BIG;
+		else if( FBitSet( pField->flags, DT_STRING ))
+			op->op = DOP_STRING;
+		else op->op = DOP_NONE;
+
+		// time windows are always signed on the wire
+		if( op->op == DOP_TIMEWINDOW_8 || op->op == DOP_TIMEWINDOW_BIG )
+			op->signbit = 1;
+
+		op->bits = pField->bits;
+		op->clamp = pField->bits < 32;
+		op->maxnum = op->clamp ? BIT( pField->bits - op->signbit ) - 1 : INT_MAX;
+		op->minnum = op->signbit ? -op->maxnum - 1 : INT_MIN;
+		op->offset = pField->offset;
+		op->size = pField->size;
+		op->multiplier = pField->multiplier;
+		op->post_multiplier = pField->post_multiplier;
+		op->scaled = !Q_equal( pField->multiplier, 1.0 );
+		op->postscaled = !Q_equal( pField->post_multiplier, 1.0 );
+		op->field = pField;
+	}
+}
+
+/*
+=====================
+Delta_BuildLayout
+
+fields of entity table grouped by their bit size, so encoded
+size of changed fields can be counted without walking them
+=====================
+*/
+static void Delta_BuildLayout( int index )
+{
+	delta_info_t	*dt = Delta_FindStructByIndex( index );
+	delta_layout_t	*layout = &dt_layouts[index];
+	int		i, j;
+
+	memset( layout, 0, sizeof( *layout ));
+
+	if( !dt->bInitialized || dt->numFields > DELTA_MAX_ENTITY_FIELDS )
+		return;
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		delta_t	*pField = &dt->pFields[i];
+
+		// string length depends on the value
+		if( FBitSet( pField->flags, DT_STRING ))
+			return;
+
+		for( j = 0; j < layout->numgroups; j++ )
+		{
+			if( layout->groupbits[j] == pField->bits )
+				break;
+		}
+
+		if( j == layout->numgroups )
+		{
+			if( layout->numgroups == ARRAYSIZE( layout->groupbits ))
+				return;
+
+			layout->groupbits[layout->numgroups++] = pField->bits;
+		}
+
+		SetBits( layout->groupmask[j][i >> 5], BIT( i & 31 ));
+	}
+
+	layout->valid = true;
+}
+
+/*
+=====================
+Delta_CompileEntityTables
+
+=====================
+*/
+static void Delta_CompileEntityTables( void )
+{
+	Delta_BuildLayout( DT_ENTITY_STATE_T );
+	Delta_BuildLayout( DT_ENTITY_STATE_PLAYER_T );
+	Delta_BuildLayout( DT_CUSTOM_ENTITY_STATE_T );
+
+	Delta_CompileTable( Delta_FindStructByIndex( DT_ENTITY_STATE_T ));
+	Delta_CompileTable( Delta_FindStructByIndex( DT_ENTITY_STATE_PLAYER_T ));
+	Delta_CompileTable( Delta_FindStructByIndex( DT_CUSTOM_ENTITY_STATE_T ));
+}
+
 void Delta_Init( void )
 {
 	delta_info_t	*dt;
@@ -926,6 +1171,8 @@ void Delta_Init( void )
 	Delta_InitFields ();	// initialize fields
 	delta_init = true;
 
+	Delta_CompileEntityTables();
+
 	dt = Delta_FindStructByIndex( DT_MOVEVARS_T );
 
 	Assert( dt != NULL );
@@ -985,7 +1232,11 @@ void Delta_InitClient( void )
 		}
 	}
 
-	if( numActive ) delta_init = true;
+	if( numActive )
+	{
+		Delta_CompileEntityTables();
+		delta_init = true;
+	}
 }
 
 void Delta_Shutdown( void )
@@ -1007,9 +1258,12 @@ void Delta_Shutdown( void )
 			dt_info[i].pFields = NULL;
 		}
 
+		Delta_FreeProgram( &dt_info[i] );
+
 		dt_info[i].bInitialized = false;
 	}
 
+	memset( dt_layouts, 0, sizeof( dt_layouts ));
 	delta_init = false;
 }
 
@@ -1024,7 +1278,12 @@ static int Delta_ClampIntegerField( delta_t *pField, int iValue, int signbit, in
 {
 #ifdef _DEBUG
 	if( numbits < 32 && abs( iValue ) >= (uint)BIT( numbits ))
+	{
+		// may be called from worker threads
+		Jobs_EnterCritical();
 		Con_Reportf( S_WARN "Delta_ClampIntegerField: field %s = %d overflowed %d\n", pField->name, abs( iValue ), (uint)BIT( numbits ));
+		Jobs_LeaveCritical();
+	}
 #endif
 	if( numbits < 32 )
 	{
@@ -1042,124 +1301,151 @@ static int Delta_ClampIntegerField( delta_t *pField, int iValue, int signbit, in
 
 /*
 =====================
-Delta_CompareField
+Delta_FieldKey
 
-compare fields by offsets
-assume from and to is valid
+returns field value as it will be compared,
+doesn't depend on the other side, so it can be cached
+strings aren't supported
 =====================
 */
-static qboolean Delta_CompareField( delta_t *pField, const void *from, const void *to )
+static int Delta_FieldKey( delta_t *pField, const void *base )
 {
-	int		signbit = ( pField->flags & DT_SIGNED ) ? 1 : 0;
-	float	val_a, val_b;
-	int	fromF, toF;
-
-	Assert( pField != NULL );
-	Assert( from != NULL );
-	Assert( to != NULL );
-
-	if( pField->bInactive )
-		return true;
-
-	fromF = toF = 0;
+	int	signbit = ( pField->flags & DT_SIGNED ) ? 1 : 0;
+	int	value = 0;
 
 	if( pField->flags & DT_BYTE )
 	{
 		if( signbit )
-		{
-			fromF = *(int8_t *)((int8_t *)from + pField->offset );
-			toF = *(int8_t *)((int8_t *)to + pField->offset );
-		}
-		else
-		{
-			fromF = *(uint8_t *)((int8_t *)from + pField->offset );
-			toF = *(uint8_t *)((int8_t *)to + pField->offset );
-		}
+			value = *(int8_t *)((int8_t *)base + pField->offset );
+		else value = *(uint8_t *)((int8_t *)base + pField->offset );
 
-		if( !Q_equal(pField->multiplier, 1.0f ))
-		{
-			fromF *= pField->multiplier;
-			toF *= pField->multiplier;
-		}
+		if( !Q_equal( pField->multiplier, 1.0f ))
+			value *= pField->multiplier;
 
-		fromF = Delta_ClampIntegerField( pField, fromF, signbit, pField->bits );
-		toF = Delta_ClampIntegerField( pField, toF, signbit, pField->bits );
+		value = Delta_ClampIntegerField( pField, value, signbit, pField->bits );
 	}
 	else if( pField->flags & DT_SHORT )
 	{
 		if( signbit )
-		{
-			fromF = *(int16_t *)((int8_t *)from + pField->offset );
-			toF = *(int16_t *)((int8_t *)to + pField->offset );
-		}
-		else
-		{
-			fromF = *(uint16_t *)((int8_t *)from + pField->offset );
-			toF = *(uint16_t *)((int8_t *)to + pField->offset );
-		}
+			value = *(int16_t *)((int8_t *)base + pField->offset );
+		else value = *(uint16_t *)((int8_t *)base + pField->offset );
 
-		if( !Q_equal(pField->multiplier, 1.0f ))
-		{
-			fromF *= pField->multiplier;
-			toF *= pField->multiplier;
-		}
+		if( !Q_equal( pField->multiplier, 1.0f ))
+			value *= pField->multiplier;
 
-		fromF = Delta_ClampIntegerField( pField, fromF, signbit, pField->bits );
-		toF = Delta_ClampIntegerField( pField, toF, signbit, pField->bits );
+		value = Delta_ClampIntegerField( pField, value, signbit, pField->bits );
 	}
 	else if( pField->flags & DT_INTEGER )
 	{
 		if( signbit )
-		{
-			fromF = *(int32_t *)((int8_t *)from + pField->offset );
-			toF = *(int32_t *)((int8_t *)to + pField->offset );
-		}
-		else
-		{
-			fromF = *(uint32_t *)((int8_t *)from + pField->offset );
-			toF = *(uint32_t *)((int8_t *)to + pField->offset );
-		}
+			value = *(int32_t *)((int8_t *)base + pField->offset );
+		else value = *(uint32_t *)((int8_t *)base + pField->offset );
 
-		if( !Q_equal(pField->multiplier, 1.0f ))
-		{
-			fromF *= pField->multiplier;
-			toF *= pField->multiplier;
-		}
+		if( !Q_equal( pField->multiplier, 1.0f ))
+			value *= pField->multiplier;
 
-		fromF = Delta_ClampIntegerField( pField, fromF, signbit, pField->bits );
-		toF = Delta_ClampIntegerField( pField, toF, signbit, pField->bits );
+		value = Delta_ClampIntegerField( pField, value, signbit, pField->bits );
 	}
 	else if( pField->flags & ( DT_ANGLE|DT_FLOAT ))
 	{
 		// don't convert floats to integers
-		fromF = *((int *)((byte *)from + pField->offset ));
-		toF = *((int *)((byte *)to + pField->offset ));
+		value = *((int *)((byte *)base + pField->offset ));
 	}
 	else if( pField->flags & DT_TIMEWINDOW_8 )
 	{
-		val_a = *(float *)((byte *)from + pField->offset );
-		val_b = *(float *)((byte *)to + pField->offset );
-		fromF = Q_rint( val_a * 100.0 );
-		toF = Q_rint( val_b * 100.0 );
+		value = Q_rint( *(float *)((byte *)base + pField->offset ) * 100.0 );
 	}
 	else if( pField->flags & DT_TIMEWINDOW_BIG )
 	{
-		val_a = *(float *)((byte *)from + pField->offset );
-		val_b = *(float *)((byte *)to + pField->offset );
-		fromF = Q_rint( val_a * pField->multiplier );
-		toF = Q_rint( val_b * pField->multiplier );
+		value = Q_rint( *(float *)((byte *)base + pField->offset ) * pField->multiplier );
 	}
-	else if( pField->flags & DT_STRING )
+
+	return value;
+}
+
+/*
+=====================
+Delta_CompareFieldValue
+
+compare fields by offsets, ignoring custom encoder state
+assume from and to is valid
+=====================
+*/
+static qboolean Delta_CompareFieldValue( delta_t *pField, const void *from, const void *to )
+{
+	Assert( pField != NULL );
+	Assert( from != NULL );
+	Assert( to != NULL );
+
+	if( pField->flags & DT_STRING )
 	{
 		// compare strings
 		char	*s1 = (char *)((byte *)from + pField->offset );
 		char	*s2 = (char *)((byte *)to + pField->offset );
 
 		// 0 is equal, otherwise not equal
-		toF = Q_strcmp( s1, s2 );
+		return !Q_strcmp( s1, s2 );
+	}
+
+	return Delta_FieldKey( pField, from ) == Delta_FieldKey( pField, to );
+}
+
+/*
+=====================
+Delta_CompareField
+
+compare fields by offsets
+assume from and to is valid
+=====================
+*/
+static qboolean Delta_CompareField( delta_t *pField, const void *from, const void *to )
+{
+	if( pField->bInactive )
+		return true;
+
+	return Delta_CompareFieldValue( pField, from, to );
+}
+
+/*
+=====================
+Delta_EntityTable
+
+=====================
+*/
+static delta_info_t *Delta_EntityTable( const entity_state_t *to, qboolean player )
+{
+	if( FBitSet( to->entityType, ENTITY_BEAM ))
+		return Delta_FindStructByIndex( DT_CUSTOM_ENTITY_STATE_T );
+	else if( player )
+		return Delta_FindStructByIndex( DT_ENTITY_STATE_PLAYER_T );
+	return Delta_FindStructByIndex( DT_ENTITY_STATE_T );
+}
+
+/*
+=====================
+Delta_EncodeEntity
+
+runs custom encoder for the entity, inactive fields
+are the only thing the delta can depend on besides
+the states themselves, the receiving client included
+=====================
+*/
+void Delta_EncodeEntity( const entity_state_t *from, const entity_state_t *to, int delta_type, int client, uint32_t *inactive )
+{
+	delta_info_t	*dt;
+
+	// static entities won't to be custom encoded
+	if( delta_type == DELTA_STATIC )
+	{
+		memset( inactive, 0, sizeof( uint32_t ) * DELTA_MASK_WORDS );
+		return;
 	}
 
-	return fromF == toF;
+	dt = Delta_EntityTable( to, delta_type == DELTA_PLAYER );
+	Assert( dt && dt->bInitialized );
+
+	// activate fields and call custom encode func
+	Delta_CustomEncodeEntity( dt, from, to, inactive, client );
 }
 
 /*
@@ -1169,10 +1455,11 @@ Delta_TestBaseline
 compare baselines to find optimal
 =====================
 */
-int Delta_TestBaseline( const entity_state_t *from, const entity_state_t *to, qboolean player, double timebase )
+static int Delta_TestBaseline_( const entity_state_t *from, const entity_state_t *to, qboolean player, double timebase, int client )
 {
 	delta_info_t	*dt = NULL;
 	delta_t		*pField;
+	uint32_t		inactive[DELTA_MASK_WORDS];
 	int		i, countBits;
 
 	countBits = MAX_ENTITY_BITS + 2;
@@ -1183,12 +1470,7 @@ int Delta_TestBaseline( const entity_state_t *from, const entity_state_t *to, qb
 		return countBits;
 	}
 
-	if( FBitSet( to->entityType, ENTITY_BEAM ))
-		dt = Delta_FindStructByIndex( DT_CUSTOM_ENTITY_STATE_T );
-	else if( player )
-		dt = Delta_FindStructByIndex( DT_ENTITY_STATE_PLAYER_T );
-	else dt = Delta_FindStructByIndex( DT_ENTITY_STATE_T );
-
+	dt = Delta_EntityTable( to, player );
 	Assert( dt && dt->bInitialized );
 
 	countBits++; // entityType flag
@@ -1197,7 +1479,7 @@ int Delta_TestBaseline( const entity_state_t *from, const entity_state_t *to, qb
 	Assert( pField != NULL );
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	Delta_CustomEncodeEntity( dt, from, to, inactive, client );
 
 	// process fields
 	for( i = 0; i < dt->numFields; i++, pField++ )
@@ -1205,7 +1487,7 @@ int Delta_TestBaseline( const entity_state_t *from, const entity_state_t *to, qb
 		// flag about field change (sets always)
 		countBits++;
 
-		if( !Delta_CompareField( pField, from, to ))
+		if( !DELTA_FIELD_INACTIVE( inactive, i ) && !Delta_CompareFieldValue( pField, from, to ))
 		{
 			// strings are handled differently
 			if( FBitSet( pField->flags, DT_STRING ))
@@ -1218,6 +1500,112 @@ int Delta_TestBaseline( const entity_state_t *from, const entity_state_t *to, qb
 	return countBits;
 }
 
+int Delta_TestBaseline( const entity_state_t *from, const entity_state_t *to, qboolean player, double timebase )
+{
+	return Delta_TestBaseline_( from, to, player, timebase, -1 );
+}
+
+/*
+=====================
+Delta_CountBits
+
+=====================
+*/
+static int Delta_CountBits( uint32_t v )
+{
+#if __GNUC__ >= 4
+	return __builtin_popcount( v );
+#else
+	v = v - (( v >> 1 ) & 0x55555555 );
+	v = ( v & 0x33333333 ) + (( v >> 2 ) & 0x33333333 );
+	return ((( v + ( v >> 4 )) & 0x0F0F0F0F ) * 0x01010101 ) >> 24;
+#endif
+}
+
+/*
+=====================
+Delta_MakeKeys
+
+=====================
+*/
+static void Delta_MakeKeys( delta_keys_t *keys, delta_info_t *dt, const entity_state_t *state )
+{
+	delta_t	*pField = dt->pFields;
+	int	i;
+
+	for( i = 0; i < dt->numFields; i++, pField++ )
+		keys->keys[i] = Delta_FieldKey( pField, state );
+
+	keys->table = dt;
+}
+
+/*
+=====================
+Delta_TestBaselineKeys
+
+same as Delta_TestBaseline, but field values are
+converted only once and kept in caller-owned keys,
+keys with NULL table are filled on demand,
+client is passed to custom encoder, -1 if unknown
+=====================
+*/
+int Delta_TestBaselineKeys( const entity_state_t *from, delta_keys_t *fromkeys, const entity_state_t *to, delta_keys_t *tokeys, qboolean player, double timebase, int client )
+{
+	uint32_t		changed[DELTA_MASK_WORDS];
+	uint32_t		inactive[DELTA_MASK_WORDS];
+	delta_layout_t	*layout;
+	delta_info_t	*dt;
+	int		i, j, countBits;
+
+	if( !from || !to )
+		return Delta_TestBaseline_( from, to, player, timebase, client );
+
+	dt = Delta_EntityTable( to, player );
+	Assert( dt && dt->bInitialized );
+
+	layout = &dt_layouts[dt - dt_info];
+
+	if( !layout->valid )
+		return Delta_TestBaseline_( from, to, player, timebase, client );
+
+	if( fromkeys->table != dt )
+		Delta_MakeKeys( fromkeys, dt, from );
+
+	if( tokeys->table != dt )
+		Delta_MakeKeys( tokeys, dt, to );
+
+	memset( changed, 0, sizeof( changed ));
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		if( fromkeys->keys[i] != tokeys->keys[i] )
+			SetBits( changed[i >> 5], BIT( i & 31 ));
+	}
+
+	if( dt->userCallback )
+	{
+		Delta_CustomEncodeEntity( dt, from, to, inactive, client );
+
+		for( i = 0; i < DELTA_MASK_WORDS; i++ )
+			changed[i] &= ~inactive[i];
+	}
+
+	// entity number, remove flag, entityType flag and change flags of every field
+	countBits = MAX_ENTITY_BITS + 3 + dt->numFields;
+
+	for( i = 0; i < layout->numgroups; i++ )
+	{
+		int	count = 0;
+
+		for( j = 0; j < DELTA_MASK_WORDS; j++ )
+			count += Delta_CountBits( changed[j] & layout->groupmask[i][j] );
+
+		countBits += count * layout->groupbits[i];
+	}
+
+	return countBits;
+}
+
 /*
 =====================
 Delta_WriteField
@@ -1484,6 +1872,307 @@ static qboolean Delta_ReadField( sizebuf_t *msg, delta_t *pField, const void *fr
 	return true;
 }
 
+/*
+=====================
+Delta_ClampOp
+
+same as Delta_ClampIntegerField, but with precomputed range
+=====================
+*/
+static int Delta_ClampOp( const delta_op_t *op, int value )
+{
+#ifdef _DEBUG
+	return Delta_ClampIntegerField( op->field, value, op->signbit, op->bits );
+#else
+	if( value > op->maxnum )
+		return op->maxnum;
+	if( value < op->minnum )
+		return op->minnum;
+	return value;
+#endif
+}
+
+/*
+=====================
+Delta_LoadOp
+
+integer field value, extended to 32 bits
+=====================
+*/
+static uint Delta_LoadOp( const delta_op_t *op, const byte *p )
+{
+	switch( op->op )
+	{
+	case DOP_UBYTE: return *(uint8_t *)p;
+	case DOP_SBYTE: return *(int8_t *)p;
+	case DOP_USHORT: return *(uint16_t *)p;
+	case DOP_SSHORT: return *(int16_t *)p;
+	case DOP_UINT: return *(uint32_t *)p;
+	case DOP_SINT: return *(int32_t *)p;
+	}
+
+	return 0;
+}
+
+/*
+=====================
+Delta_CompareOp
+
+compiled version of Delta_CompareFieldValue
+=====================
+*/
+static qboolean Delta_CompareOp( const delta_op_t *op, const byte *from, const byte *to )
+{
+	int	fromF, toF;
+
+	from += op->offset;
+	to += op->offset;
+
+	switch( op->op )
+	{
+	case DOP_UBYTE:
+	case DOP_SBYTE:
+	case DOP_USHORT:
+	case DOP_SSHORT:
+	case DOP_UINT:
+	case DOP_SINT:
+		fromF = Delta_LoadOp( op, from );
+		toF = Delta_LoadOp( op, to );
+
+		if( fromF == toF )
+			return true;
+
+		if( op->scaled )
+		{
+			fromF *= op->multiplier;
+			toF *= op->multiplier;
+		}
+
+		return Delta_ClampOp( op, fromF ) == Delta_ClampOp( op, toF );
+	case DOP_FLOAT:
+	case DOP_ANGLE:
+		// don't convert floats to integers
+		return *(int *)from == *(int *)to;
+	case DOP_TIMEWINDOW_8:
+		return Q_rint( *(float *)from * 100.0 ) == Q_rint( *(float *)to * 100.0 );
+	case DOP_TIMEWINDOW_BIG:
+		return Q_rint( *(float *)from * op->multiplier ) == Q_rint( *(float *)to * op->multiplier );
+	case DOP_STRING:
+		return !Q_strcmp( (char *)from, (char *)to );
+	}
+
+	return true;
+}
+
+/*
+=====================
+Delta_WriteOp
+
+compiled version of Delta_WriteField_
+=====================
+*/
+static void Delta_WriteOp( sizebuf_t *msg, const delta_op_t *op, const byte *to, double timebase )
+{
+	uint	iValue;
+	int	dt;
+
+	to += op->offset;
+
+	switch( op->op )
+	{
+	case DOP_UBYTE:
+	case DOP_SBYTE:
+	case DOP_USHORT:
+	case DOP_SSHORT:
+	case DOP_UINT:
+	case DOP_SINT:
+		iValue = Delta_LoadOp( op, to );
+		if( op->scaled )
+			iValue *= op->multiplier;
+		iValue = Delta_ClampOp( op, iValue );
+		MSG_WriteBitLong( msg, iValue, op->bits, op->signbit );
+		break;
+	case DOP_FLOAT:
+		iValue = (int)((double)*(float *)to * op->multiplier );
+		iValue = Delta_ClampOp( op, iValue );
+		MSG_WriteBitLong( msg, iValue, op->bits, op->signbit );
+		break;
+	case DOP_ANGLE:
+		// NOTE: never applies multipliers to angle because
+		// result may be wrong on client-side
+		MSG_WriteBitAngle( msg, *(float *)to, op->bits );
+		break;
+	case DOP_TIMEWINDOW_8:
+		dt = Q_rint(( timebase - *(float *)to ) * 100.0 );
+		dt = Delta_ClampOp( op, dt );
+		MSG_WriteSBitLong( msg, dt, op->bits );
+		break;
+	case DOP_TIMEWINDOW_BIG:
+		dt = Q_rint(( timebase - *(float *)to ) * op->multiplier );
+		dt = Delta_ClampOp( op, dt );
+		MSG_WriteSBitLong( msg, dt, op->bits );
+		break;
+	case DOP_STRING:
+		MSG_WriteString( msg, (char *)to );
+		break;
+	}
+}
+
+/*
+=====================
+Delta_WriteProgram
+
+writes all fields of compiled table,
+returns number of changed fields
+=====================
+*/
+static int Delta_WriteProgram( sizebuf_t *msg, const delta_info_t *dt, const uint32_t *inactive, const void *from, const void *to, double timebase )
+{
+	const delta_op_t	*op = dt->pOps;
+	int		i, numChanges = 0;
+
+	for( i = 0; i < dt->numFields; i++, op++ )
+	{
+		if( DELTA_FIELD_INACTIVE( inactive, i ) || Delta_CompareOp( op, from, to ))
+		{
+			MSG_WriteOneBit( msg, 0 );	// unchanged
+			continue;
+		}
+
+		MSG_WriteOneBit( msg, 1 );	// changed
+		Delta_WriteOp( msg, op, to, timebase );
+		numChanges++;
+	}
+
+	return numChanges;
+}
+
+#if !XASH_DEDICATED || XASH_ENGINE_TESTS
+/*
+=====================
+Delta_ReadOp
+
+compiled version of Delta_ReadField_
+=====================
+*/
+static void Delta_ReadOp( sizebuf_t *msg, const delta_op_t *op, byte *to, double timebase )
+{
+	uint	iValue;
+	float	flValue;
+
+	to += op->offset;
+
+	switch( op->op )
+	{
+	case DOP_UBYTE:
+	case DOP_SBYTE:
+	case DOP_USHORT:
+	case DOP_SSHORT:
+	case DOP_UINT:
+	case DOP_SINT:
+		iValue = MSG_ReadBitLong( msg, op->bits, op->signbit );
+		if( op->scaled )
+			iValue /= op->multiplier;
+		if( op->postscaled )
+			iValue *= op->post_multiplier;
+
+		switch( op->op )
+		{
+		case DOP_UBYTE: *(uint8_t *)to = iValue; break;
+		case DOP_SBYTE: *(int8_t *)to = iValue; break;
+		case DOP_USHORT: *(uint16_t *)to = iValue; break;
+		case DOP_SSHORT: *(int16_t *)to = iValue; break;
+		case DOP_UINT: *(uint32_t *)to = iValue; break;
+		case DOP_SINT: *(int32_t *)to = iValue; break;
+		}
+		break;
+	case DOP_FLOAT:
+		iValue = MSG_ReadBitLong( msg, op->bits, op->signbit );
+		if( op->signbit )
+			flValue = (int)iValue;
+		else flValue = iValue;
+
+		if( op->scaled )
+			flValue /= op->multiplier;
+		if( op->postscaled )
+			flValue *= op->post_multiplier;
+
+		*(float *)to = flValue;
+		break;
+	case DOP_ANGLE:
+		*(float *)to = MSG_ReadBitAngle( msg, op->bits );
+		break;
+	case DOP_TIMEWINDOW_8:
+		iValue = MSG_ReadSBitLong( msg, op->bits );
+		*(float *)to = ( timebase * 100.0 - (int)iValue ) / 100.0;
+		break;
+	case DOP_TIMEWINDOW_BIG:
+		iValue = MSG_ReadSBitLong( msg, op->bits );
+		*(float *)to = ( timebase * op->multiplier - (int)iValue ) / op->multiplier;
+		break;
+	case DOP_STRING:
+		Q_strncpy( (char *)to, MSG_ReadString( msg ), op->size );
+		break;
+	}
+}
+
+/*
+=====================
+Delta_CopyOp
+
+compiled version of Delta_CopyField
+=====================
+*/
+static void Delta_CopyOp( const delta_op_t *op, const byte *from, byte *to )
+{
+	from += op->offset;
+	to += op->offset;
+
+	switch( op->op )
+	{
+	case DOP_UBYTE:
+	case DOP_SBYTE:
+		*(uint8_t *)to = *(uint8_t *)from;
+		break;
+	case DOP_USHORT:
+	case DOP_SSHORT:
+		*(uint16_t *)to = *(uint16_t *)from;
+		break;
+	case DOP_UINT:
+	case DOP_SINT:
+	case DOP_FLOAT:
+	case DOP_ANGLE:
+	case DOP_TIMEWINDOW_8:
+	case DOP_TIMEWINDOW_BIG:
+		*(uint32_t *)to = *(uint32_t *)from;
+		break;
+	case DOP_STRING:
+		Q_strncpy( (char *)to, (char *)from, op->size );
+		break;
+	}
+}
+
+/*
+=====================
+Delta_ReadProgram
+
+=====================
+*/
+static void Delta_ReadProgram( sizebuf_t *msg, const delta_info_t *dt, const void *from, void *to, double timebase )
+{
+	const delta_op_t	*op = dt->pOps;
+	int		i;
+
+	for( i = 0; i < dt->numFields; i++, op++ )
+	{
+		if( MSG_ReadOneBit( msg ))
+			Delta_ReadOp( msg, op, to, timebase );
+		else Delta_CopyOp( op, from, to );
+	}
+}
+
+#endif // !XASH_DEDICATED || XASH_ENGINE_TESTS
+
 static void Delta_ParseGSFields( sizebuf_t *msg, const delta_info_t *dt, const void *from, void *to, double timebase )
 {
 	uint8_t bits[8] = { 0 };
@@ -1905,9 +2594,28 @@ Can delta from either a baseline or a previous packet_entity
 If to is NULL, a remove entity update will be sent
 If force is not set, then nothing at all will be generated if the entity is
 identical, under the assumption that the in-order delta code will catch it.
+Client is the receiver passed to custom encoder, -1 if unknown
 ==================
 */
-void MSG_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, double timebase, int baseline )
+void MSG_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, double timebase, int baseline, int client )
+{
+	uint32_t	inactive[DELTA_MASK_WORDS];
+
+	if( to != NULL )
+		Delta_EncodeEntity( from, to, delta_type, client, inactive );
+
+	MSG_WriteDeltaEntityEncoded( from, to, msg, force, delta_type, timebase, baseline, inactive );
+}
+
+/*
+==================
+MSG_WriteDeltaEntityEncoded
+
+same as MSG_WriteDeltaEntity, but custom encoder was already
+called by Delta_EncodeEntity, so the result can be cached
+==================
+*/
+void MSG_WriteDeltaEntityEncoded( const entity_state_t *from, const entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, double timebase, int baseline, const uint32_t *inactive )
 {
 	delta_info_t	*dt = NULL;
 	delta_t		*pField;
@@ -1975,23 +2683,25 @@ void MSG_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to,
 	pField = dt->pFields;
 	Assert( pField != NULL );
 
-	if( delta_type == DELTA_STATIC )
+	// process fields
+	if( dt->pOps )
 	{
-		// static entities won't to be custom encoded
-		for( i = 0; i < dt->numFields; i++ )
-			dt->pFields[i].bInactive = false;
+		numChanges += Delta_WriteProgram( msg, dt, inactive, from, to, timebase );
 	}
 	else
 	{
-		// activate fields and call custom encode func
-		Delta_CustomEncode( dt, from, to );
-	}
+		for( i = 0; i < dt->numFields; i++, pField++ )
+		{
+			if( DELTA_FIELD_INACTIVE( inactive, i ) || Delta_CompareFieldValue( pField, from, to ))
+			{
+				MSG_WriteOneBit( msg, 0 );	// unchanged
+				continue;
+			}
 
-	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
+			MSG_WriteOneBit( msg, 1 );	// changed
+			Delta_WriteField_( msg, pField, from, to, timebase );
 			numChanges++;
+		}
 	}
 
 	// if we have no changes - kill the message
@@ -2102,9 +2812,14 @@ qboolean MSG_ReadDeltaEntity( sizebuf_t *msg, const entity_state_t *from, entity
 	Assert( pField != NULL );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
+	if( dt->pOps )
 	{
-		Delta_ReadField( msg, pField, from, to, timebase );
+		Delta_ReadProgram( msg, dt, from, to, timebase );
+	}
+	else
+	{
+		for( i = 0; i < dt->numFields; i++, pField++ )
+			Delta_ReadField( msg, pField, from, to, timebase );
 	}
 #endif // XASH_DEDICATED
 	// message parsed
@@ -2282,6 +2997,99 @@ void GAME_EXPORT Delta_UnsetFieldByIndex( delta_t *pFields, int fieldNumber )
 #if XASH_ENGINE_TESTS
 #include "tests.h"
 
+static void Test_RandomDeltaStruct( delta_test_struct_t *s, double timebase )
+{
+	Q_snprintf( s->dt_string, sizeof( s->dt_string ), "str%d", COM_RandomLong( 0, 2 ));
+	s->dt_timewindow_big = timebase + COM_RandomFloat( -2.0f, 2.0f );
+	s->dt_timewindow_8 = timebase + COM_RandomLong( 0, 1 ) * 0.05f;
+	s->dt_angle = COM_RandomFloat( -180.0f, 180.0f );
+	s->dt_float_signed = COM_RandomLong( 0, 1 ) ? -15.123f : COM_RandomFloat( -1000.0f, 1000.0f );
+	s->dt_float_unsigned = COM_RandomFloat( 0.0f, 1500.0f );
+	s->dt_integer_signed = COM_RandomLong( -9000000, 9000000 );
+	s->dt_integer_unsigned = COM_RandomLong( 0, 20000000 ); // may overflow 24 bits
+	s->dt_short_signed = COM_RandomLong( -32768, 32767 );
+	s->dt_short_unsigned = COM_RandomLong( 0, 65535 );
+	s->dt_byte_signed = COM_RandomLong( -128, 127 ); // overflows 6 bits
+	s->dt_byte_unsigned = COM_RandomLong( 0, 1 ) ? 218 : COM_RandomLong( 0, 255 );
+}
+
+static void Test_RunDeltaProgram( delta_info_t *dt, const delta_test_struct_t *base, double timebase )
+{
+	delta_test_struct_t states[32], read1, read2;
+	uint32_t inactive[DELTA_MASK_WORDS] = { 0 };
+	byte buf1[1024], buf2[1024];
+	sizebuf_t msg1, msg2;
+	int i, j, k, mismatches = 0;
+	double start, interp, compiled;
+	const int iterations = 2000;
+
+	dt->bInitialized = true;
+	Delta_CompileTable( dt );
+	TASSERT( dt->pOps != NULL );
+
+	states[0] = *base;
+	for( i = 1; i < ARRAYSIZE( states ); i++ )
+		Test_RandomDeltaStruct( &states[i], timebase );
+
+	// compiled program must be wire-identical to the interpreter
+	for( i = 0; i < ARRAYSIZE( states ); i++ )
+	{
+		for( j = 0; j < ARRAYSIZE( states ); j++ )
+		{
+			MSG_Init( &msg1, "interpreter", buf1, sizeof( buf1 ));
+			MSG_Init( &msg2, "compiled", buf2, sizeof( buf2 ));
+
+			for( k = 0; k < dt->numFields; k++ )
+				Delta_WriteField( &msg1, &dt->pFields[k], &states[i], &states[j], timebase );
+			Delta_WriteProgram( &msg2, dt, inactive, &states[i], &states[j], timebase );
+
+			if( MSG_GetNumBitsWritten( &msg1 ) != MSG_GetNumBitsWritten( &msg2 )
+				|| memcmp( buf1, buf2, MSG_GetNumBytesWritten( &msg1 )))
+			{
+				mismatches++;
+				continue;
+			}
+
+			MSG_SeekToBit( &msg1, 0, SEEK_SET );
+			MSG_SeekToBit( &msg2, 0, SEEK_SET );
+			memset( &read1, 0, sizeof( read1 ));
+			memset( &read2, 0, sizeof( read2 ));
+
+			for( k = 0; k < dt->numFields; k++ )
+				Delta_ReadField( &msg1, &dt->pFields[k], &states[i], &read1, timebase );
+			Delta_ReadProgram( &msg2, dt, &states[i], &read2, timebase );
+
+			if( memcmp( &read1, &read2, sizeof( read1 )))
+				mismatches++;
+		}
+	}
+
+	TASSERT_EQi( mismatches, 0 );
+
+	// microbenchmark, just for information
+	start = Sys_DoubleTime();
+	for( i = 0; i < iterations; i++ )
+	{
+		MSG_Init( &msg1, "interpreter", buf1, sizeof( buf1 ));
+		for( j = 0; j < dt->numFields; j++ )
+			Delta_WriteField( &msg1, &dt->pFields[j], &states[i % 31], &states[i % 31 + 1], timebase );
+	}
+	interp = Sys_DoubleTime() - start;
+
+	start = Sys_DoubleTime();
+	for( i = 0; i < iterations; i++ )
+	{
+		MSG_Init( &msg2, "compiled", buf2, sizeof( buf2 ));
+		Delta_WriteProgram( &msg2, dt, inactive, &states[i % 31], &states[i % 31 + 1], timebase );
+	}
+	compiled = Sys_DoubleTime() - start;
+
+	Con_Printf( "delta write: interpreter %.3f ms, compiled %.3f ms (%d iterations)\n", interp * 1000.0, compiled * 1000.0, iterations );
+
+	Delta_FreeProgram( dt );
+	dt->bInitialized = false;
+}
+
 void Test_RunDelta( void )
 {
 	delta_info_t *dt = &dt_info[DT_DELTA_TEST_STRUCT_T];
@@ -2376,5 +3184,222 @@ void Test_RunDelta( void )
 	Con_Printf( "to.dt_byte_signed   = %i\n", to.dt_byte_signed );
 	Con_Printf( "from.dt_byte_unsigned = %i\n", from.dt_byte_unsigned );
 	Con_Printf( "to.dt_byte_unsigned   = %i\n", to.dt_byte_unsigned );
+
+	Test_RunDeltaProgram( dt, &from, timebase );
+}
+
+void Test_RunDeltaBaseline( void )
+{
+	delta_info_t *dt = &dt_info[DT_ENTITY_STATE_T];
+	delta_t *savedFields = dt->pFields;
+	int savedNumFields = dt->numFields;
+	pfnDeltaEncode savedCallback = dt->userCallback;
+	qboolean savedInitialized = dt->bInitialized;
+	entity_state_t states[16];
+	delta_keys_t keys[16];
+	int i, j, mismatches = 0;
+
+	// build a small table, entity tables aren't loaded in tests
+	dt->pFields = NULL;
+	dt->numFields = 0;
+	dt->userCallback = NULL;
+	Delta_AddField( dt, "origin[0]", DT_FLOAT|DT_SIGNED, 21, 8.0f, 1.0f );
+	Delta_AddField( dt, "origin[1]", DT_FLOAT|DT_SIGNED, 21, 8.0f, 1.0f );
+	Delta_AddField( dt, "angles[1]", DT_ANGLE, 16, 1.0f, 1.0f );
+	Delta_AddField( dt, "modelindex", DT_SHORT, 10, 1.0f, 1.0f );
+	Delta_AddField( dt, "frame", DT_FLOAT, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "animtime", DT_TIMEWINDOW_8, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "body", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "skin", DT_SHORT|DT_SIGNED, 9, 1.0f, 1.0f );
+	dt->bInitialized = true;
+	Delta_BuildLayout( DT_ENTITY_STATE_T );
+	TASSERT( dt_layouts[DT_ENTITY_STATE_T].valid );
+
+	memset( states, 0, sizeof( states ));
+
+	for( i = 0; i < ARRAYSIZE( states ); i++ )
+	{
+		// few distinct values, so some fields match
+		states[i].entityType = ENTITY_NORMAL;
+		states[i].origin[0] = COM_RandomLong( 0, 2 ) * 16.5f;
+		states[i].origin[1] = COM_RandomLong( 0, 2 ) * -3.25f;
+		states[i].angles[1] = COM_RandomLong( 0, 1 ) * 90.0f;
+		states[i].modelindex = COM_RandomLong( 1, 2 );
+		states[i].frame = COM_RandomLong( 0, 1 );
+		states[i].animtime = COM_RandomLong( 0, 1 ) * 0.5f;
+		states[i].body = COM_RandomLong( 0, 3 );
+		states[i].skin = -COM_RandomLong( 0, 1 );
+		keys[i].table = NULL;
+	}
+
+	for( i = 0; i < ARRAYSIZE( states ); i++ )
+	{
+		for( j = 0; j < ARRAYSIZE( states ); j++ )
+		{
+			if( Delta_TestBaseline( &states[j], &states[i], false, 0.0 ) != Delta_TestBaselineKeys( &states[j], &keys[j], &states[i], &keys[i], false, 0.0, -1 ))
+				mismatches++;
+		}
+	}
+
+	TASSERT_EQi( mismatches, 0 );
+
+	Z_Free( dt->pFields );
+	dt->pFields = savedFields;
+	dt->numFields = savedNumFields;
+	dt->userCallback = savedCallback;
+	dt->bInitialized = savedInitialized;
+	Delta_BuildLayout( DT_ENTITY_STATE_T );
+}
+
+#define TEST_ENCODE_CLIENTS	8
+
+typedef struct
+{
+	const entity_state_t	*from;
+	const entity_state_t	*to;
+	sizebuf_t		msg;
+	byte		buf[512];
+} test_encode_client_t;
+
+static void Test_PlayerEncode( delta_t *pFields, const byte *from, const byte *to )
+{
+	const entity_state_t *t = (const entity_state_t *)to;
+
+	// same as game dlls, which don't send own origin to the player
+	if( Delta_EncodeClient() == t->number - 1 )
+	{
+		Delta_UnsetFieldByIndex( pFields, 0 );
+		Delta_UnsetFieldByIndex( pFields, 1 );
+	}
+}
+
+static void Test_EncodeClient( test_encode_client_t *tc, int client )
+{
+	int i;
+
+	memset( tc->buf, 0, sizeof( tc->buf ));
+	MSG_Init( &tc->msg, "TestEncode", tc->buf, sizeof( tc->buf ));
+
+	for( i = 0; i < TEST_ENCODE_CLIENTS; i++ )
+		MSG_WriteDeltaEntity( &tc->from[i], &tc->to[i], &tc->msg, true, DELTA_PLAYER, 0.0, 0, client );
+}
+
+static void Test_EncodeClientJob( void *data, int index )
+{
+	Test_EncodeClient( (test_encode_client_t *)data + index, index );
+}
+
+void Test_RunDeltaCustomEncode( void )
+{
+	delta_info_t *dt = &dt_info[DT_ENTITY_STATE_PLAYER_T];
+	delta_t *savedFields = dt->pFields;
+	int savedNumFields = dt->numFields;
+	pfnDeltaEncode savedCallback = dt->userCallback;
+	qboolean savedInitialized = dt->bInitialized;
+	struct delta_op_s *savedOps = dt->pOps;
+	convar_t *threads = Cvar_FindVar( "host_jobthreads" );
+	gameinfo_t *savedGameInfo = GI, testinfo;
+	test_encode_client_t serial[TEST_ENCODE_CLIENTS];
+	test_encode_client_t parallel[TEST_ENCODE_CLIENTS];
+	test_encode_client_t nobody, encoded;
+	entity_state_t from[TEST_ENCODE_CLIENTS], to[TEST_ENCODE_CLIENTS];
+	uint32_t mask[DELTA_MASK_WORDS], ownmask[DELTA_MASK_WORDS], nobodymask[DELTA_MASK_WORDS];
+	string oldthreads;
+	int i, mismatches = 0;
+
+	dt->pFields = NULL;
+	dt->numFields = 0;
+	dt->pOps = NULL;
+	Delta_AddField( dt, "origin[0]", DT_FLOAT|DT_SIGNED, 21, 8.0f, 1.0f );
+	Delta_AddField( dt, "origin[1]", DT_FLOAT|DT_SIGNED, 21, 8.0f, 1.0f );
+	Delta_AddField( dt, "angles[1]", DT_ANGLE, 16, 1.0f, 1.0f );
+	Delta_AddField( dt, "frame", DT_FLOAT, 8, 1.0f, 1.0f );
+	dt->userCallback = Test_PlayerEncode;
+	dt->bInitialized = true;
+
+	// entity numbers are checked against game limits
+	if( !savedGameInfo )
+	{
+		memset( &testinfo, 0, sizeof( testinfo ));
+		testinfo.max_edicts = DEFAULT_MAX_EDICTS;
+		FI->GameInfo = &testinfo;
+	}
+
+	memset( from, 0, sizeof( from ));
+	memset( to, 0, sizeof( to ));
+
+	for( i = 0; i < TEST_ENCODE_CLIENTS; i++ )
+	{
+		from[i].number = to[i].number = i + 1;
+		to[i].origin[0] = i * 16.5f;
+		to[i].origin[1] = -i * 3.25f - 1.0f;
+		to[i].angles[1] = 90.0f;
+		to[i].frame = i;
+	}
+
+	for( i = 0; i < TEST_ENCODE_CLIENTS; i++ )
+	{
+		serial[i].from = parallel[i].from = from;
+		serial[i].to = parallel[i].to = to;
+		Test_EncodeClient( &serial[i], i );
+	}
+
+	nobody.from = from;
+	nobody.to = to;
+
+	// force a few workers even on single core machines
+	Q_strncpy( oldthreads, threads->string, sizeof( oldthreads ));
+	Cvar_DirectSet( threads, "4" );
+	Jobs_RunParallel( Test_EncodeClientJob, parallel, TEST_ENCODE_CLIENTS );
+	Cvar_DirectSet( threads, oldthreads );
+
+	for( i = 0; i < TEST_ENCODE_CLIENTS; i++ )
+	{
+		if( MSG_GetNumBitsWritten( &serial[i].msg ) != MSG_GetNumBitsWritten( &parallel[i].msg )
+			|| memcmp( serial[i].buf, parallel[i].buf, MSG_GetNumBytesWritten( &serial[i].msg )))
+			mismatches++;
+	}
+
+	TASSERT_EQi( mismatches, 0 );
+
+	// every client must get own player without origin
+	Test_EncodeClient( &nobody, -1 );
+
+	for( i = 0; i < TEST_ENCODE_CLIENTS; i++ )
+		TASSERT( MSG_GetNumBitsWritten( &serial[i].msg ) < MSG_GetNumBitsWritten( &nobody.msg ));
+
+	TASSERT( memcmp( serial[1].buf, serial[2].buf, MSG_GetNumBytesWritten( &serial[1].msg )));
+	TASSERT_EQi( Delta_EncodeClient(), -1 );
+
+	// the mask is all the delta depends on, so other players can be
+	// shared between clients while own player is encoded separately
+	Delta_EncodeEntity( &from[3], &to[3], DELTA_PLAYER, -1, nobodymask );
+	Delta_EncodeEntity( &from[3], &to[3], DELTA_PLAYER, 3, ownmask );
+	TASSERT( memcmp( nobodymask, ownmask, sizeof( ownmask )));
+
+	for( i = 0; i < TEST_ENCODE_CLIENTS; i++ )
+	{
+		Delta_EncodeEntity( &from[3], &to[3], DELTA_PLAYER, i, mask );
+		TASSERT( !memcmp( mask, i == 3 ? ownmask : nobodymask, sizeof( mask )));
+	}
+
+	memset( encoded.buf, 0, sizeof( encoded.buf ));
+	MSG_Init( &encoded.msg, "TestEncode", encoded.buf, sizeof( encoded.buf ));
+	for( i = 0; i < TEST_ENCODE_CLIENTS; i++ )
+	{
+		Delta_EncodeEntity( &from[i], &to[i], DELTA_PLAYER, 5, mask );
+		MSG_WriteDeltaEntityEncoded( &from[i], &to[i], &encoded.msg, true, DELTA_PLAYER, 0.0, 0, mask );
+	}
+
+	TASSERT_EQi( MSG_GetNumBitsWritten( &encoded.msg ), MSG_GetNumBitsWritten( &serial[5].msg ));
+	TASSERT( !memcmp( encoded.buf, serial[5].buf, MSG_GetNumBytesWritten( &serial[5].msg )));
+
+	Z_Free( dt->pFields );
+	dt->pFields = savedFields;
+	dt->numFields = savedNumFields;
+	dt->userCallback = savedCallback;
+	dt->bInitialized = savedInitialized;
+	dt->pOps = savedOps;
+	FI->GameInfo = savedGameInfo;
 }
 #endif // XASH_ENGINE_TESTS
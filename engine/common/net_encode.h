@@ -81,6 +81,16 @@ typedef struct goldsrc_delta_s
 	float postmultiply;
 } goldsrc_delta_t;
 
+#define DELTA_MAX_ENTITY_FIELDS	128	// for inactive fields bitmask
+#define DELTA_MASK_WORDS	( DELTA_MAX_ENTITY_FIELDS / 32 )
+
+// per-field values of entity state, precomputed for Delta_TestBaselineKeys
+typedef struct
+{
+	const void	*table;		// delta table keys belong to, NULL if not computed yet
+	int		keys[DELTA_MAX_ENTITY_FIELDS];
+} delta_keys_t;
+
 typedef void (*pfnDeltaEncode)( struct delta_s *pFields, const byte *from, const byte *to );
 
 typedef struct
@@ -96,6 +106,8 @@ typedef struct
 	char		funcName[32];
 	pfnDeltaEncode	userCallback;
 	qboolean		bInitialized;
+
+	struct delta_op_s	*pOps;		// compiled fields, see Delta_CompileTable
 } delta_info_t;
 
 //
@@ -110,6 +122,7 @@ void Delta_SetField( delta_t *pFields, const char *fieldname );
 void Delta_UnsetField( delta_t *pFields, const char *fieldname );
 void Delta_SetFieldByIndex( delta_t *pFields, int fieldNumber );
 void Delta_UnsetFieldByIndex( delta_t *pFields, int fieldNumber );
+int Delta_EncodeClient( void );
 
 // send table over network
 void Delta_WriteDescriptionToClient( sizebuf_t *msg );
@@ -134,9 +147,12 @@ void MSG_WriteClientData( sizebuf_t *msg, const struct clientdata_s *from, const
 void MSG_ReadClientData( sizebuf_t *msg, const struct clientdata_s *from, struct clientdata_s *to, double timebase );
 void MSG_WriteWeaponData( sizebuf_t *msg, const struct weapon_data_s *from, const struct weapon_data_s *to, double timebase, int index );
 void MSG_ReadWeaponData( sizebuf_t *msg, const struct weapon_data_s *from, struct weapon_data_s *to, double timebase );
-void MSG_WriteDeltaEntity( const struct entity_state_s *from, const struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, double timebase, int ofs );
+void MSG_WriteDeltaEntity( const struct entity_state_s *from, const struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, double timebase, int ofs, int client );
+void MSG_WriteDeltaEntityEncoded( const struct entity_state_s *from, const struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, double timebase, int ofs, const uint32_t *inactive );
 qboolean MSG_ReadDeltaEntity( sizebuf_t *msg, const struct entity_state_s *from, struct entity_state_s *to, int num, int type, double timebase );
+void Delta_EncodeEntity( const struct entity_state_s *from, const struct entity_state_s *to, int type, int client, uint32_t *inactive );
 int Delta_TestBaseline( const struct entity_state_s *from, const struct entity_state_s *to, qboolean player, double timebase );
+int Delta_TestBaselineKeys( const struct entity_state_s *from, delta_keys_t *fromkeys, const struct entity_state_s *to, delta_keys_t *tokeys, qboolean player, double timebase, int client );
 void Delta_ReadGSFields( sizebuf_t *msg, int index, const void *from, void *to, double timebase );
 void Delta_WriteGSFields( sizebuf_t *msg, int index, const void *from, const void *to, double timebase );
 
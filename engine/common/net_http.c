@@ -912,6 +912,31 @@ void HTTP_Run( void )
 	HTTP_AutoClean();
 }
 
+/*
+==============
+HTTP_GetSockets
+
+Sockets that HTTP_Run is waiting on and whether
+they wait to become writable, for NET_Sleep
+==============
+*/
+int HTTP_GetSockets( int *sockets, qboolean *write, int maxsockets )
+{
+	httpfile_t *curfile;
+	int count = 0;
+
+	for( curfile = http.first_file; curfile && count < maxsockets; curfile = curfile->next )
+	{
+		if( curfile->socket == -1 )
+			continue;
+
+		write[count] = curfile->pfn_process == HTTP_FileConnect || curfile->pfn_process == HTTP_FileSendRequest;
+		sockets[count++] = curfile->socket;
+	}
+
+	return count;
+}
+
 /*
 ===================
 HTTP_AddDownload
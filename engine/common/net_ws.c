@@ -12,6 +12,9 @@ but WITHOUT ANY WARRANTY; without even the implied warranty of
 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
 GNU General Public License for more details.
 */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // recvmmsg, sendmmsg
+#endif
 
 #include "common.h"
 #include "client.h" // ConnectionProgress
@@ -26,6 +29,17 @@ GNU General Public License for more details.
 
 #define NET_USE_FRAGMENTS
 
+#if XASH_LINUX && !XASH_ANDROID && !XASH_NO_NETWORK
+#define NET_USE_MMSG // batched server socket I/O, see net_batchio
+#define NET_USE_EPOLL // NET_Sleep on all server sockets
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/time.h> // gettimeofday
+#include <linux/sockios.h> // SIOCGSTAMP
+#endif
+
+#define NET_MAX_WAIT_SOCKETS	16
+
 #define MAX_LOOPBACK		4
 #define MASK_LOOPBACK		(MAX_LOOPBACK - 1)
 
@@ -87,6 +101,38 @@ typedef struct
 } SPLITPACKETGS;
 #pragma pack(pop)
 
+#if defined( NET_USE_MMSG )
+#define NET_MMSG_RECV_BATCH	32
+#define NET_MMSG_SEND_BATCH	256
+#define NET_MMSG_SEND_BYTES	( 512 * 1024 )
+
+// datagrams received by a single recvmmsg call
+typedef struct
+{
+	struct mmsghdr		msgs[NET_MMSG_RECV_BATCH];
+	struct iovec		iov[NET_MMSG_RECV_BATCH];
+	struct sockaddr_storage	addrs[NET_MMSG_RECV_BATCH];
+	byte			control[NET_MMSG_RECV_BATCH][CMSG_SPACE( sizeof( struct timeval ))];
+	byte			data[NET_MMSG_RECV_BATCH][NET_MAX_FRAGMENT];
+	int			count;	// how many was received
+	int			next;	// next one to be handed out
+	qboolean			timestamps;	// SO_TIMESTAMP was enabled on the socket
+} net_recvbatch_t;
+
+// datagrams waiting for a single sendmmsg call
+typedef struct
+{
+	struct mmsghdr		msgs[NET_MMSG_SEND_BATCH];
+	struct iovec		iov[NET_MMSG_SEND_BATCH];
+	struct sockaddr_storage	addrs[NET_MMSG_SEND_BATCH];
+	netadr_t			to[NET_MMSG_SEND_BATCH];	// for error messages
+	int			sockets[NET_MMSG_SEND_BATCH];
+	byte			data[NET_MMSG_SEND_BYTES];
+	int			count;
+	size_t			used;
+} net_sendbatch_t;
+#endif // NET_USE_MMSG
+
 typedef struct
 {
 	net_loopback_t	loopbacks[NS_COUNT];
@@ -103,6 +149,22 @@ typedef struct
 	qboolean		configured;
 	qboolean		allow_ip;
 	qboolean		allow_ip6;
+	int		recvcalls;		// socket syscalls counters
+	int		sendcalls;
+	double		packettime;	// when the last packet was received, Sys_DoubleTime based
+	qboolean		tracktimes;	// ask the kernel when packets were received
+#if defined( NET_USE_EPOLL )
+	int		epollfd;
+	int		timerfd;
+	qboolean		epolldirty;	// sockets were reopened
+	int		httpsockets[NET_MAX_WAIT_SOCKETS];	// registered in epollfd
+	int		numhttpsockets;
+#endif
+#if defined( NET_USE_MMSG )
+	net_recvbatch_t	*recvbatch[2];	// server ip and ip6 sockets
+	net_sendbatch_t	*sendbatch;
+	qboolean		batching;		// between NET_BeginSendBatch and NET_EndSendBatch
+#endif
 #if XASH_WIN32
 	WSADATA		winsockdata;
 #endif
@@ -118,6 +180,9 @@ static CVAR_DEFINE( net_clientport, "clientport", "0", FCVAR_READ_ONLY, "network
 static CVAR_DEFINE( net_fakelag, "fakelag", "0", FCVAR_PRIVILEGED, "lag all incoming network data (including loopback) by xxx ms." );
 static CVAR_DEFINE( net_fakeloss, "fakeloss", "0", FCVAR_PRIVILEGED, "act like we dropped the packet this % of the time." );
 static CVAR_DEFINE_AUTO( net_resolve_debug, "0", FCVAR_PRIVILEGED, "print resolve thread debug messages" );
+#if defined( NET_USE_MMSG )
+static CVAR_DEFINE_AUTO( net_batchio, "0", FCVAR_PRIVILEGED, "read and send server datagrams with recvmmsg/sendmmsg" );
+#endif
 CVAR_DEFINE( net_clockwindow, "clockwindow", "0.5", FCVAR_PRIVILEGED, "timewindow to execute client moves" );
 
 netadr_t			net_local;
@@ -707,6 +772,56 @@ qboolean NET_CompareBaseAdr( const netadr_t a, const netadr_t b )
 	return false;
 }
 
+/*
+====================
+NET_HashBaseAdr
+
+Addresses that are equal by NET_CompareBaseAdr have same hash
+====================
+*/
+uint NET_HashBaseAdr( const netadr_t a )
+{
+	uint	hash = 2166136261u;
+	int	i;
+
+	if( a.type == NA_LOOPBACK )
+		return a.type6;
+
+	if( a.type == NA_IP )
+	{
+		hash = a.ip4 * 2654435761u;
+		return hash ^ ( hash >> 16 ); // low bits are used by hash tables
+	}
+
+	if( a.type6 == NA_IP6 )
+	{
+		// FNV-1a
+		for( i = 0; i < sizeof( a.ip6 ); i++ )
+			hash = ( hash ^ a.ip6[i] ) * 16777619u;
+		return hash ^ ( hash >> 16 );
+	}
+
+	return a.type6;
+}
+
+/*
+====================
+NET_HashAdr
+
+Same for NET_CompareAdr
+====================
+*/
+uint NET_HashAdr( const netadr_t a )
+{
+	uint hash;
+
+	if( a.type == NA_LOOPBACK )
+		return NET_HashBaseAdr( a );
+
+	hash = NET_HashBaseAdr( a ) ^ ( a.port * 2246822519u );
+	return hash ^ ( hash >> 16 );
+}
+
 /*
 ====================
 NET_CompareClassBAdr
@@ -1363,6 +1478,157 @@ static qboolean NET_GetLong( byte *pData, int size, size_t *outSize, int splitsi
 	return false;
 }
 
+#if defined( NET_USE_MMSG )
+/*
+==================
+NET_RecvBatch
+
+hands out datagrams from the last recvmmsg call,
+drains the socket again when they are over
+==================
+*/
+static int NET_RecvBatch( int protocol, int net_socket, struct sockaddr_storage *addr, const byte **packet, double *stamp )
+{
+	net_recvbatch_t	*batch = net.recvbatch[protocol];
+	struct mmsghdr	*msg;
+	struct cmsghdr	*cmsg;
+	int		i, ret;
+
+	if( !batch )
+	{
+		batch = net.recvbatch[protocol] = Z_Calloc( sizeof( *batch ));
+
+		for( i = 0; i < NET_MMSG_RECV_BATCH; i++ )
+		{
+			batch->iov[i].iov_base = batch->data[i];
+			batch->iov[i].iov_len = sizeof( batch->data[i] );
+			batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+			batch->msgs[i].msg_hdr.msg_iovlen = 1;
+			batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+		}
+	}
+
+	if( batch->next >= batch->count )
+	{
+		if( net.tracktimes && !batch->timestamps )
+		{
+			int on = 1;
+
+			setsockopt( net_socket, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof( on ));
+			batch->timestamps = true;
+		}
+
+		for( i = 0; i < NET_MMSG_RECV_BATCH; i++ )
+		{
+			batch->msgs[i].msg_hdr.msg_namelen = sizeof( batch->addrs[i] );
+			batch->msgs[i].msg_hdr.msg_control = batch->timestamps ? batch->control[i] : NULL;
+			batch->msgs[i].msg_hdr.msg_controllen = batch->timestamps ? sizeof( batch->control[i] ) : 0;
+			batch->msgs[i].msg_hdr.msg_flags = 0;
+		}
+
+		batch->count = batch->next = 0;
+		ret = recvmmsg( net_socket, batch->msgs, NET_MMSG_RECV_BATCH, MSG_DONTWAIT, NULL );
+		net.recvcalls++;
+
+		if( ret <= 0 )
+		{
+			if( ret == 0 )
+				errno = EWOULDBLOCK;
+			return SOCKET_ERROR;
+		}
+
+		batch->count = ret;
+	}
+
+	msg = &batch->msgs[batch->next];
+	*addr = batch->addrs[batch->next];
+	*packet = batch->data[batch->next];
+	batch->next++;
+
+	for( cmsg = CMSG_FIRSTHDR( &msg->msg_hdr ); cmsg; cmsg = CMSG_NXTHDR( &msg->msg_hdr, cmsg ))
+	{
+		if( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP )
+		{
+			struct timeval tv;
+
+			memcpy( &tv, CMSG_DATA( cmsg ), sizeof( tv ));
+			*stamp = tv.tv_sec + tv.tv_usec * 0.000001;
+		}
+	}
+
+	// same as recvfrom into NET_MAX_FRAGMENT buffer, treated as oversize
+	if( FBitSet( msg->msg_hdr.msg_flags, MSG_TRUNC ))
+		return NET_MAX_FRAGMENT;
+
+	return msg->msg_len;
+}
+
+/*
+==================
+NET_RecvBatchPending
+==================
+*/
+static qboolean NET_RecvBatchPending( int protocol )
+{
+	return net.recvbatch[protocol] && net.recvbatch[protocol]->next < net.recvbatch[protocol]->count;
+}
+
+/*
+==================
+NET_ClearRecvBatches
+
+forget received datagrams when sockets are closed
+==================
+*/
+static void NET_ClearRecvBatches( qboolean free )
+{
+	int i;
+
+	for( i = 0; i < ARRAYSIZE( net.recvbatch ); i++ )
+	{
+		if( !net.recvbatch[i] )
+			continue;
+
+		if( free )
+		{
+			Mem_Free( net.recvbatch[i] );
+			net.recvbatch[i] = NULL;
+		}
+		else
+		{
+			net.recvbatch[i]->count = net.recvbatch[i]->next = 0;
+			net.recvbatch[i]->timestamps = false;
+		}
+	}
+}
+#endif // NET_USE_MMSG
+
+/*
+==================
+NET_ReceiveTime
+
+converts kernel receive timestamp into Sys_DoubleTime,
+falls back to the current time if there isn't any
+==================
+*/
+static double NET_ReceiveTime( int net_socket, double stamp )
+{
+	double now = Sys_DoubleTime();
+#if defined( NET_USE_EPOLL )
+	struct timeval tv;
+
+	if( stamp == 0.0 && net.tracktimes && ioctl( net_socket, SIOCGSTAMP, &tv ) == 0 )
+		stamp = tv.tv_sec + tv.tv_usec * 0.000001;
+
+	if( stamp != 0.0 )
+	{
+		gettimeofday( &tv, NULL );
+		return now - bound( 0.0, tv.tv_sec + tv.tv_usec * 0.000001 - stamp, 1.0 );
+	}
+#endif
+	return now;
+}
+
 /*
 ==================
 NET_QueuePacket
@@ -1373,6 +1639,8 @@ queue normal and lagged packets
 static qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size_t *length )
 {
 	byte		buf[NET_MAX_FRAGMENT];
+	const byte	*packet;
+	double		stamp = 0.0;
 	int		ret, protocol;
 	int		net_socket;
 	WSAsize_t	addr_len;
@@ -1391,8 +1659,19 @@ static qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size
 		if( !NET_IsSocketValid( net_socket ))
 			continue;
 
-		addr_len = sizeof( addr );
-		ret = recvfrom( net_socket, buf, sizeof( buf ), 0, (struct sockaddr *)&addr, &addr_len );
+#if defined( NET_USE_MMSG )
+		if( sock == NS_SERVER && ( net_batchio.value || NET_RecvBatchPending( protocol )))
+		{
+			ret = NET_RecvBatch( protocol, net_socket, &addr, &packet, &stamp );
+		}
+		else
+#endif
+		{
+			addr_len = sizeof( addr );
+			ret = recvfrom( net_socket, buf, sizeof( buf ), 0, (struct sockaddr *)&addr, &addr_len );
+			packet = buf;
+			net.recvcalls++;
+		}
 
 		NET_SockadrToNetadr( &addr, from );
 
@@ -1401,7 +1680,8 @@ static qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size
 			if( ret < NET_MAX_FRAGMENT )
 			{
 				// Transfer data
-				memcpy( data, buf, ret );
+				memcpy( data, packet, ret );
+				net.packettime = NET_ReceiveTime( net_socket, stamp );
 				*length = ret;
 #if !XASH_DEDICATED
 				{
@@ -1461,6 +1741,7 @@ qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *lengt
 
 	if( NET_GetLoopPacket( sock, from, data, length ))
 	{
+		net.packettime = Sys_DoubleTime();
 		return NET_LagPacket( true, sock, from, length, data );
 	}
 	else
@@ -1469,6 +1750,32 @@ qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *lengt
 	}
 }
 
+/*
+==================
+NET_PacketTime
+
+when the packet returned by last NET_GetPacket call
+was received, in Sys_DoubleTime units
+==================
+*/
+double NET_PacketTime( void )
+{
+	return net.packettime;
+}
+
+/*
+==================
+NET_TrackPacketTimes
+
+makes NET_PacketTime use kernel timestamps where possible,
+costs an extra syscall per packet without batched I/O
+==================
+*/
+void NET_TrackPacketTimes( qboolean enable )
+{
+	net.tracktimes = enable;
+}
+
 /*
 ==================
 NET_SendLong
@@ -1517,6 +1824,7 @@ static int NET_SendLong( netsrc_t sock, int net_socket, const char *buf, size_t
 			}
 
 			ret = sendto( net_socket, packet, size + sizeof( SPLITPACKET ), flags, (const struct sockaddr *)to, tolen );
+			net.sendcalls++;
 			if( ret < 0 ) return ret; // error
 
 			if( ret >= size )
@@ -1532,10 +1840,168 @@ static int NET_SendLong( netsrc_t sock, int net_socket, const char *buf, size_t
 #endif
 	{
 		// no fragmenantion for client connection
+		net.sendcalls++;
 		return sendto( net_socket, buf, len, flags, (const struct sockaddr *)to, tolen );
 	}
 }
 
+/*
+==================
+NET_SendError
+==================
+*/
+static void NET_SendError( netadr_t to )
+{
+	int err = WSAGetLastError();
+
+	// WSAEWOULDBLOCK is silent
+	if( err == WSAEWOULDBLOCK )
+		return;
+
+	// some PPP links don't allow broadcasts
+	if( err == WSAEADDRNOTAVAIL && ( to.type == NA_BROADCAST || to.type6 == NA_MULTICAST_IP6 ))
+		return;
+
+	if( Host_IsDedicated( ))
+	{
+		Con_DPrintf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
+	}
+	else if( err == WSAEADDRNOTAVAIL || err == WSAENOBUFS )
+	{
+		Con_DPrintf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
+	}
+	else
+	{
+		Con_Printf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
+	}
+}
+
+#if defined( NET_USE_MMSG )
+/*
+==================
+NET_FlushSendBatch
+
+sends everything that was queued, one sendmmsg per socket run
+==================
+*/
+static void NET_FlushSendBatch( void )
+{
+	net_sendbatch_t	*batch = net.sendbatch;
+	int		start, end, ret;
+
+	if( !batch )
+		return;
+
+	for( start = 0; start < batch->count; )
+	{
+		for( end = start; end < batch->count && batch->sockets[end] == batch->sockets[start]; end++ );
+
+		while( start < end )
+		{
+			ret = sendmmsg( batch->sockets[start], &batch->msgs[start], end - start, 0 );
+			net.sendcalls++;
+
+			// skip the datagram that failed and try the rest
+			if( ret <= 0 )
+			{
+				if( ret < 0 )
+					NET_SendError( batch->to[start] );
+				start++;
+			}
+			else start += ret;
+		}
+	}
+
+	batch->count = 0;
+	batch->used = 0;
+}
+
+/*
+==================
+NET_QueueSendBatch
+
+returns false if datagram should be sent right away
+==================
+*/
+static qboolean NET_QueueSendBatch( int net_socket, const void *data, size_t length, netadr_t to, const struct sockaddr_storage *addr )
+{
+	net_sendbatch_t	*batch;
+	struct mmsghdr	*msg;
+	int		i;
+
+	if( length > NET_MAX_FRAGMENT )
+		return false;
+
+	if( !net.sendbatch )
+		net.sendbatch = Z_Calloc( sizeof( *net.sendbatch ));
+
+	batch = net.sendbatch;
+
+	if( batch->count == NET_MMSG_SEND_BATCH || batch->used + length > sizeof( batch->data ))
+		NET_FlushSendBatch();
+
+	i = batch->count++;
+	memcpy( batch->data + batch->used, data, length );
+	batch->addrs[i] = *addr;
+	batch->to[i] = to;
+	batch->sockets[i] = net_socket;
+	batch->iov[i].iov_base = batch->data + batch->used;
+	batch->iov[i].iov_len = length;
+	batch->used += length;
+
+	msg = &batch->msgs[i];
+	memset( msg, 0, sizeof( *msg ));
+	msg->msg_hdr.msg_name = &batch->addrs[i];
+	msg->msg_hdr.msg_namelen = NET_SockAddrLen( addr );
+	msg->msg_hdr.msg_iov = &batch->iov[i];
+	msg->msg_hdr.msg_iovlen = 1;
+
+	return true;
+}
+#endif // NET_USE_MMSG
+
+/*
+==================
+NET_BeginSendBatch
+
+server datagrams are queued until NET_EndSendBatch,
+if batched I/O is available and enabled
+==================
+*/
+void NET_BeginSendBatch( void )
+{
+#if defined( NET_USE_MMSG )
+	NET_FlushSendBatch();
+	net.batching = net_batchio.value != 0.0f;
+#endif
+}
+
+/*
+==================
+NET_EndSendBatch
+==================
+*/
+void NET_EndSendBatch( void )
+{
+#if defined( NET_USE_MMSG )
+	NET_FlushSendBatch();
+	net.batching = false;
+#endif
+}
+
+/*
+==================
+NET_GetSyscallCounts
+
+how many times sockets were read and written since startup
+==================
+*/
+void NET_GetSyscallCounts( int *recvcalls, int *sendcalls )
+{
+	*recvcalls = net.recvcalls;
+	*sendcalls = net.sendcalls;
+}
+
 /*
 ==================
 NET_SendPacketEx
@@ -1571,33 +2037,21 @@ void NET_SendPacketEx( netsrc_t sock, size_t length, const void *data, netadr_t
 
 	NET_NetadrToSockadr( &to, &addr );
 
-	ret = NET_SendLong( sock, net_socket, data, length, 0, &addr, NET_SockAddrLen( &addr ), splitsize );
-
-	if( NET_IsSocketError( ret ))
+#if defined( NET_USE_MMSG )
+	if( net.batching && sock == NS_SERVER )
 	{
-		int err = WSAGetLastError();
-
-		// WSAEWOULDBLOCK is silent
-		if( err == WSAEWOULDBLOCK )
+		// split packets go out right away, so keep the order
+		if( splitsize > sizeof( SPLITPACKET ) && length > splitsize )
+			NET_FlushSendBatch();
+		else if( NET_QueueSendBatch( net_socket, data, length, to, &addr ))
 			return;
+	}
+#endif
 
-		// some PPP links don't allow broadcasts
-		if( err == WSAEADDRNOTAVAIL && ( to.type == NA_BROADCAST || to.type6 == NA_MULTICAST_IP6 ))
-			return;
+	ret = NET_SendLong( sock, net_socket, data, length, 0, &addr, NET_SockAddrLen( &addr ), splitsize );
 
-		if( Host_IsDedicated( ))
-		{
-			Con_DPrintf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
-		}
-		else if( err == WSAEADDRNOTAVAIL || err == WSAENOBUFS )
-		{
-			Con_DPrintf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
-		}
-		else
-		{
-			Con_Printf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
-		}
-	}
+	if( NET_IsSocketError( ret ))
+		NET_SendError( to );
 
 }
 
@@ -1928,6 +2382,11 @@ void NET_Config( qboolean multiplayer, qboolean changeport )
 	{
 		int	i;
 
+#if defined( NET_USE_MMSG )
+		NET_EndSendBatch();
+		NET_ClearRecvBatches( false );
+#endif
+
 		// shut down any existing sockets
 		for( i = 0; i < NS_COUNT; i++ )
 		{
@@ -1947,6 +2406,9 @@ void NET_Config( qboolean multiplayer, qboolean changeport )
 
 	NET_ClearLoopback ();
 
+#if defined( NET_USE_EPOLL )
+	net.epolldirty = true;
+#endif
 	net.configured = multiplayer ? true : false;
 }
 
@@ -1972,34 +2434,237 @@ qboolean NET_IsActive( void )
 	return net.initialized;
 }
 
+#if !XASH_NO_NETWORK
+/*
+====================
+NET_WaitSockets
+
+collects every socket that dedicated server should wake up on
+====================
+*/
+static int NET_WaitSockets( int *sockets, qboolean *write, int maxsockets )
+{
+	int count = 0;
+
+	if( NET_IsSocketValid( net.ip_sockets[NS_SERVER] ))
+	{
+		write[count] = false;
+		sockets[count++] = net.ip_sockets[NS_SERVER];
+	}
+
+	if( NET_IsSocketValid( net.ip6_sockets[NS_SERVER] ))
+	{
+		write[count] = false;
+		sockets[count++] = net.ip6_sockets[NS_SERVER];
+	}
+
+	return count + HTTP_GetSockets( sockets + count, write + count, maxsockets - count );
+}
+#endif // !XASH_NO_NETWORK
+
+#if defined( NET_USE_EPOLL )
+/*
+====================
+NET_CloseEpoll
+====================
+*/
+static void NET_CloseEpoll( void )
+{
+	if( net.epollfd >= 0 )
+		close( net.epollfd );
+
+	if( net.timerfd >= 0 )
+		close( net.timerfd );
+
+	net.epollfd = net.timerfd = -1;
+	net.numhttpsockets = 0;
+}
+
+/*
+====================
+NET_OpenEpoll
+
+server sockets are only registered once, sockets are
+removed from epoll set automatically when they are closed
+====================
+*/
+static qboolean NET_OpenEpoll( void )
+{
+	struct epoll_event	ev = { 0 };
+	int		i, sockets[2] = { net.ip_sockets[NS_SERVER], net.ip6_sockets[NS_SERVER] };
+
+	NET_CloseEpoll();
+	net.epolldirty = false;
+
+	net.epollfd = epoll_create1( EPOLL_CLOEXEC );
+	if( net.epollfd < 0 )
+		return false;
+
+	// not fatal, epoll_wait timeout is just less precise
+	net.timerfd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC );
+	if( net.timerfd >= 0 )
+	{
+		ev.events = EPOLLIN;
+		ev.data.fd = net.timerfd;
+		epoll_ctl( net.epollfd, EPOLL_CTL_ADD, net.timerfd, &ev );
+	}
+
+	for( i = 0; i < ARRAYSIZE( sockets ); i++ )
+	{
+		if( !NET_IsSocketValid( sockets[i] ))
+			continue;
+
+		ev.events = EPOLLIN;
+		ev.data.fd = sockets[i];
+		epoll_ctl( net.epollfd, EPOLL_CTL_ADD, sockets[i], &ev );
+	}
+
+	return true;
+}
+
+/*
+====================
+NET_SyncEpollHTTP
+
+http sockets come and go, so they are synced on every sleep
+====================
+*/
+static void NET_SyncEpollHTTP( const int *sockets, const qboolean *write, int count )
+{
+	struct epoll_event	ev = { 0 };
+	int		i, j;
+
+	for( i = 0; i < net.numhttpsockets; i++ )
+	{
+		for( j = 0; j < count; j++ )
+		{
+			if( sockets[j] == net.httpsockets[i] )
+				break;
+		}
+
+		// might be already closed, so errors are fine
+		if( j == count )
+			epoll_ctl( net.epollfd, EPOLL_CTL_DEL, net.httpsockets[i], &ev );
+	}
+
+	for( i = 0; i < count; i++ )
+	{
+		ev.events = write[i] ? EPOLLOUT : EPOLLIN;
+		ev.data.fd = sockets[i];
+
+		if( epoll_ctl( net.epollfd, EPOLL_CTL_MOD, sockets[i], &ev ) < 0 )
+			epoll_ctl( net.epollfd, EPOLL_CTL_ADD, sockets[i], &ev );
+
+		net.httpsockets[i] = sockets[i];
+	}
+
+	net.numhttpsockets = count;
+}
+
+/*
+====================
+NET_EpollWait
+====================
+*/
+static int NET_EpollWait( const int *sockets, const qboolean *write, int count, double timeout )
+{
+	struct epoll_event	events[NET_MAX_WAIT_SOCKETS + 1];
+	int		i, ret, msec = -1, numservers = 0;
+	qboolean		ready = false;
+
+	if(( net.epollfd < 0 || net.epolldirty ) && !NET_OpenEpoll( ))
+		return -1;
+
+	// server sockets always come first
+	while( numservers < count && !write[numservers] && ( sockets[numservers] == net.ip_sockets[NS_SERVER] || sockets[numservers] == net.ip6_sockets[NS_SERVER] ))
+		numservers++;
+
+	if( net.numhttpsockets || count > numservers )
+		NET_SyncEpollHTTP( sockets + numservers, write + numservers, count - numservers );
+
+	if( net.timerfd >= 0 )
+	{
+		struct itimerspec	its = { 0 };
+
+		its.it_value.tv_sec = (time_t)timeout;
+		its.it_value.tv_nsec = (long)(( timeout - its.it_value.tv_sec ) * 1000000000.0 );
+		if( its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0 )
+			its.it_value.tv_nsec = 1; // zero disarms the timer
+
+		if( timerfd_settime( net.timerfd, 0, &its, NULL ) < 0 )
+			msec = (int)ceil( timeout * 1000.0 );
+	}
+	else msec = (int)ceil( timeout * 1000.0 );
+
+	do ret = epoll_wait( net.epollfd, events, ARRAYSIZE( events ), msec );
+	while( ret < 0 && errno == EINTR );
+
+	for( i = 0; i < ret; i++ )
+	{
+		if( events[i].data.fd == net.timerfd )
+		{
+			uint64_t expirations;
+
+			if( read( net.timerfd, &expirations, sizeof( expirations )) < 0 )
+				continue; // already reset
+		}
+		else ready = true;
+	}
+
+	return ready;
+}
+#endif // NET_USE_EPOLL
+
 /*
 ====================
 NET_Sleep
 
-sleeps msec or until net socket is ready
+sleeps until timeout expires or any server socket
+has something to do, returns true in the latter case
 ====================
 */
-void NET_Sleep( int msec )
+qboolean NET_Sleep( double timeout )
 {
-#ifndef XASH_NO_NETWORK
-	struct timeval	timeout;
-	fd_set		fdset;
-	int		i = 0;
+#if !XASH_NO_NETWORK
+	int		sockets[NET_MAX_WAIT_SOCKETS];
+	qboolean		write[NET_MAX_WAIT_SOCKETS];
+	struct timeval	tv;
+	fd_set		readfds, writefds;
+	int		i, count, maxfd = 0;
 
-	if( !net.initialized || host.type == HOST_NORMAL )
-		return; // we're not a dedicated server, just run full speed
+	if( !net.initialized )
+	{
+		Platform_Sleep( (int)ceil( timeout * 1000.0 ));
+		return false;
+	}
 
-	FD_ZERO( &fdset );
+	count = NET_WaitSockets( sockets, write, ARRAYSIZE( sockets ));
 
-	if( net.ip_sockets[NS_SERVER] != INVALID_SOCKET )
+#if defined( NET_USE_EPOLL )
 	{
-		FD_SET( net.ip_sockets[NS_SERVER], &fdset ); // network socket
-		i = net.ip_sockets[NS_SERVER];
+		int ret = NET_EpollWait( sockets, write, count, timeout );
+
+		if( ret >= 0 )
+			return ret;
 	}
+#endif
+
+	FD_ZERO( &readfds );
+	FD_ZERO( &writefds );
+
+	for( i = 0; i < count; i++ )
+	{
+		FD_SET( sockets[i], write[i] ? &writefds : &readfds );
+		maxfd = Q_max( maxfd, sockets[i] );
+	}
+
+	tv.tv_sec = (long)timeout;
+	tv.tv_usec = (long)(( timeout - tv.tv_sec ) * 1000000.0 );
 
-	timeout.tv_sec = msec / 1000;
-	timeout.tv_usec = (msec % 1000) * 1000;
-	select( i+1, &fdset, NULL, NULL, &timeout );
+	return select( maxfd + 1, &readfds, &writefds, NULL, &tv ) > 0;
+#else
+	Platform_Sleep( (int)ceil( timeout * 1000.0 ));
+	return false;
 #endif
 }
 
@@ -2037,6 +2702,9 @@ void NET_Init( void )
 	Cvar_RegisterVariable( &net_fakelag );
 	Cvar_RegisterVariable( &net_fakeloss );
 	Cvar_RegisterVariable( &net_resolve_debug );
+#if defined( NET_USE_MMSG )
+	Cvar_RegisterVariable( &net_batchio );
+#endif
 
 	Q_snprintf( cmd, sizeof( cmd ), "%i", PORT_SERVER );
 	Cvar_FullSet( "hostport", cmd, FCVAR_READ_ONLY );
@@ -2056,6 +2724,10 @@ void NET_Init( void )
 		net.ip6_sockets[i] = INVALID_SOCKET;
 	}
 
+#if defined( NET_USE_EPOLL )
+	net.epollfd = net.timerfd = -1;
+#endif
+
 #if XASH_WIN32
 	if( WSAStartup( MAKEWORD( 2, 0 ), &net.winsockdata ))
 	{
@@ -2119,6 +2791,19 @@ void NET_Shutdown( void )
 
 	NET_Config( false, false );
 
+#if defined( NET_USE_EPOLL )
+	NET_CloseEpoll();
+#endif
+
+#if defined( NET_USE_MMSG )
+	NET_ClearRecvBatches( true );
+	if( net.sendbatch )
+	{
+		Mem_Free( net.sendbatch );
+		net.sendbatch = NULL;
+	}
+#endif
+
 #ifdef CAN_ASYNC_NS_RESOLVE
 	NET_DeleteCriticalSections();
 #endif
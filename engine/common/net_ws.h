@@ -57,7 +57,7 @@ extern convar_t net_recv_debug;
 
 void NET_Init( void );
 void NET_Shutdown( void );
-void NET_Sleep( int msec );
+qboolean NET_Sleep( double timeout );
 qboolean NET_IsActive( void );
 qboolean NET_IsConfigured( void );
 void NET_Config( qboolean net_enable, qboolean changeport );
@@ -71,10 +71,17 @@ net_gai_state_t NET_StringToAdrNB( const char *string, netadr_t *adr, qboolean v
 int NET_CompareAdrSort( const void *_a, const void *_b );
 qboolean NET_CompareAdr( const netadr_t a, const netadr_t b );
 qboolean NET_CompareBaseAdr( const netadr_t a, const netadr_t b );
+uint NET_HashBaseAdr( const netadr_t a );
+uint NET_HashAdr( const netadr_t a );
 qboolean NET_CompareAdrByMask( const netadr_t a, const netadr_t b, uint prefixlen );
 qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *length );
 void NET_SendPacket( netsrc_t sock, size_t length, const void *data, netadr_t to );
 void NET_SendPacketEx( netsrc_t sock, size_t length, const void *data, netadr_t to, size_t splitsize );
+void NET_BeginSendBatch( void );
+void NET_EndSendBatch( void );
+void NET_GetSyscallCounts( int *recvcalls, int *sendcalls );
+double NET_PacketTime( void );
+void NET_TrackPacketTimes( qboolean enable );
 void NET_IP6BytesToNetadr( netadr_t *adr, const uint8_t *ip6 );
 void NET_NetadrToIP6Bytes( uint8_t *ip6, const netadr_t *adr );
 
@@ -94,5 +101,6 @@ void HTTP_Shutdown( void );
 void HTTP_ResetProcessState( void );
 void HTTP_Init( void );
 void HTTP_Run( void );
+int HTTP_GetSockets( int *sockets, qboolean *write, int maxsockets );
 
 #endif//NET_WS_H
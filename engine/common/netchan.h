@@ -199,6 +199,7 @@ typedef struct fbufqueue_s
 	struct fbufqueue_s	*next;		// next chain in waiting list
 	int		fragbufcount;	// number of buffers in this chain
 	fragbuf_t		*fragbufs;	// the actual buffers
+	struct netcompress_s	*compress;	// payload is still being compressed, fragbufs are empty
 } fragbufwaiting_t;
 
 typedef enum fragsize_e
@@ -24,6 +24,15 @@ GNU General Public License for more details.
 
 #define PM_AllowHitBoxTrace( model, hull ) ( model && model->type == mod_studio && ( FBitSet( model->flags, STUDIO_TRACE_HITBOX ) || hull == 2 ))
 
+typedef struct pmflatframe_s
+{
+	const mflatnode_t	*node;
+	int		side;
+	float		frac, midf;
+	float		p1f, p2f;
+	vec3_t		p1, p2, mid;
+} pmflatframe_t;
+
 static mplane_t	pm_boxplanes[6];
 static mclipnode_t	pm_boxclipnodes[6];
 static hull_t	pm_boxhull;
@@ -109,6 +118,24 @@ static hull_t *PM_HullForBox( const vec3_t mins, const vec3_t maxs )
 	return &pm_boxhull;
 }
 
+/*
+==================
+PM_FlatHullPointContents
+
+==================
+*/
+static int PM_FlatHullPointContents( const mflathull_t *flat, int num, const vec3_t p )
+{
+	const mflatnode_t	*node;
+
+	while( num >= 0 )
+	{
+		node = &flat->nodes[num];
+		num = node->children[PlaneDiff( p, node ) < 0];
+	}
+	return num;
+}
+
 /*
 ==================
 PM_HullPointContents
@@ -117,11 +144,15 @@ PM_HullPointContents
 */
 int GAME_EXPORT PM_HullPointContents( hull_t *hull, int num, const vec3_t p )
 {
+	const mflathull_t	*flat;
 	mplane_t		*plane;
 
 	if( !hull || !hull->planes )	// fantom bmodels?
 		return CONTENTS_NONE;
 
+	if( num >= 0 && ( flat = Mod_FlatHullForHull( hull )) != NULL && num < flat->numnodes )
+		return PM_FlatHullPointContents( flat, flat->remap[num], p );
+
 	while( num >= 0 )
 	{
 		plane = &hull->planes[hull->clipnodes[num].planenum];
@@ -188,10 +219,10 @@ static hull_t *PM_HullForStudio( physent_t *pe, playermove_t *pmove, int *numhit
 
 /*
 ==================
-PM_RecursiveHullCheck
+PM_HullCheck_r
 ==================
 */
-qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+static qboolean PM_HullCheck_r( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
 {
 	mclipnode_t	*node;
 	mplane_t		*plane;
@@ -257,14 +288,14 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 	VectorLerp( p1, frac, p2, mid );
 
 	// move up to the node
-	if( !PM_RecursiveHullCheck( hull, node->children[side], p1f, midf, p1, mid, trace ))
+	if( !PM_HullCheck_r( hull, node->children[side], p1f, midf, p1, mid, trace ))
 		return false;
 
 	// this recursion can not be optimized because mid would need to be duplicated on a stack
 	if( PM_HullPointContents( hull, node->children[side^1], mid ) != CONTENTS_SOLID )
 	{
 		// go past the node
-		return PM_RecursiveHullCheck( hull, node->children[side^1], midf, p2f, mid, p2, trace );
+		return PM_HullCheck_r( hull, node->children[side^1], midf, p2f, mid, p2, trace );
 	}
 
 	// never got out of the solid area
@@ -306,6 +337,178 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 	return false;
 }
 
+/*
+==================
+PM_FlatHullImpact
+
+the other side of the node is solid, back up
+from it the same way as PM_HullCheck_r does
+==================
+*/
+static qboolean PM_FlatHullImpact( const mflathull_t *flat, int headnode, const pmflatframe_t *frame, pmtrace_t *trace )
+{
+	float	frac = frame->frac;
+	float	midf = frame->midf;
+	vec3_t	mid;
+
+	// never got out of the solid area
+	if( trace->allsolid )
+		return false;
+
+	if( !frame->side )
+	{
+		VectorCopy( frame->node->normal, trace->plane.normal );
+		trace->plane.dist = frame->node->dist;
+	}
+	else
+	{
+		VectorNegate( frame->node->normal, trace->plane.normal );
+		trace->plane.dist = -frame->node->dist;
+	}
+
+	VectorCopy( frame->mid, mid );
+
+	while( PM_FlatHullPointContents( flat, headnode, mid ) == CONTENTS_SOLID )
+	{
+		// shouldn't really happen, but does occasionally
+		frac -= 0.1f;
+
+		if( frac < 0.0f )
+		{
+			trace->fraction = midf;
+			VectorCopy( mid, trace->endpos );
+			Con_Reportf( S_WARN "trace backed up past 0.0\n" );
+			return false;
+		}
+
+		midf = frame->p1f + ( frame->p2f - frame->p1f ) * frac;
+		VectorLerp( frame->p1, frac, frame->p2, mid );
+	}
+
+	trace->fraction = midf;
+	VectorCopy( mid, trace->endpos );
+
+	return false;
+}
+
+/*
+==================
+PM_FlatHullCheck
+
+iterative version of PM_HullCheck_r, nodes that are crossed
+by the segment are kept on stack until the near side is done
+==================
+*/
+static qboolean PM_FlatHullCheck( const mflathull_t *flat, int headnode, int num, float p1f, float p2f, const vec3_t start, const vec3_t end, pmtrace_t *trace )
+{
+	pmflatframe_t	stack[MAX_FLATHULL_DEPTH];
+	pmflatframe_t	*frame;
+	const mflatnode_t	*node = NULL;
+	float		t1 = 0.0f, t2 = 0.0f;
+	float		frac, midf;
+	vec3_t		p1, p2;
+	int		depth = 0;
+
+	VectorCopy( start, p1 );
+	VectorCopy( end, p2 );
+
+	while( 1 )
+	{
+		// find the node that the segment crosses
+		while( num >= 0 )
+		{
+			node = &flat->nodes[num];
+			t1 = PlaneDiff( p1, node );
+			t2 = PlaneDiff( p2, node );
+
+			if( t1 >= 0.0f && t2 >= 0.0f )
+				num = node->children[0];
+			else if( t1 < 0.0f && t2 < 0.0f )
+				num = node->children[1];
+			else break;
+		}
+
+		if( num >= 0 )
+		{
+			if( depth == MAX_FLATHULL_DEPTH )
+				Host_Error( "%s: hull is too deep\n", __func__ );
+
+			frame = &stack[depth++];
+			frame->node = node;
+
+			// put the crosspoint DIST_EPSILON pixels on the near side
+			frame->side = (t1 < 0.0f);
+
+			if( frame->side ) frac = ( t1 + DIST_EPSILON ) / ( t1 - t2 );
+			else frac = ( t1 - DIST_EPSILON ) / ( t1 - t2 );
+
+			if( frac < 0.0f ) frac = 0.0f;
+			if( frac > 1.0f ) frac = 1.0f;
+
+			midf = p1f + ( p2f - p1f ) * frac;
+
+			frame->frac = frac;
+			frame->midf = midf;
+			frame->p1f = p1f;
+			frame->p2f = p2f;
+			VectorCopy( p1, frame->p1 );
+			VectorCopy( p2, frame->p2 );
+			VectorLerp( p1, frac, p2, frame->mid );
+
+			// move up to the node
+			num = node->children[frame->side];
+			p2f = midf;
+			VectorCopy( frame->mid, p2 );
+			continue;
+		}
+
+		// reached a leaf
+		if( num != CONTENTS_SOLID )
+		{
+			trace->allsolid = false;
+			if( num == CONTENTS_EMPTY )
+				trace->inopen = true;
+			else trace->inwater = true;
+		}
+		else trace->startsolid = true;
+
+		// the near side of the last crossed node is done
+		if( depth == 0 )
+			return true;
+
+		frame = &stack[--depth];
+		num = frame->node->children[frame->side^1];
+
+		if( PM_FlatHullPointContents( flat, num, frame->mid ) == CONTENTS_SOLID )
+			return PM_FlatHullImpact( flat, headnode, frame, trace );
+
+		// go past the node
+		p1f = frame->midf;
+		p2f = frame->p2f;
+		VectorCopy( frame->mid, p1 );
+		VectorCopy( frame->p2, p2 );
+	}
+}
+
+/*
+==================
+PM_RecursiveHullCheck
+==================
+*/
+qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+{
+	const mflathull_t	*flat;
+
+	// empty hulls, box hulls and hulls that weren't flattened are traced recursively
+	if( num >= 0 && hull->firstclipnode < hull->lastclipnode && ( flat = Mod_FlatHullForHull( hull )) != NULL )
+	{
+		if( num < flat->numnodes && hull->firstclipnode >= 0 && hull->firstclipnode < flat->numnodes )
+			return PM_FlatHullCheck( flat, flat->remap[hull->firstclipnode], flat->remap[num], p1f, p2f, p1, p2, trace );
+	}
+
+	return PM_HullCheck_r( hull, num, p1f, p2f, p1, p2, trace );
+}
+
 pmtrace_t PM_PlayerTraceExt( playermove_t *pmove, vec3_t start, vec3_t end, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter )
 {
 	physent_t	*pe;
@@ -871,3 +1074,131 @@ void PM_StuckTouch( playermove_t *pmove, int hitent, pmtrace_t *tr )
 
 	pmove->touchindex[pmove->numtouch++] = *tr;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_FLATHULL_NODES	256
+#define TEST_FLATHULL_PLANES	64
+
+static void Test_MakeRandomHull( hull_t *hull, poolhandle_t mempool )
+{
+	mplane_t		*planes = Mem_Calloc( mempool, TEST_FLATHULL_PLANES * sizeof( *planes ));
+	mclipnode_t	*clipnodes = Mem_Calloc( mempool, TEST_FLATHULL_NODES * sizeof( *clipnodes ));
+	int		order[TEST_FLATHULL_NODES];
+	int		i, j, tmp;
+
+	for( i = 0; i < TEST_FLATHULL_PLANES; i++ )
+	{
+		mplane_t	*plane = &planes[i];
+
+		plane->type = COM_RandomLong( 0, 3 );
+
+		if( plane->type < 3 )
+			plane->normal[plane->type] = 1.0f;
+		else
+		{
+			VectorSet( plane->normal, COM_RandomFloat( -1.0f, 1.0f ), COM_RandomFloat( -1.0f, 1.0f ), COM_RandomFloat( 0.1f, 1.0f ));
+			VectorNormalize( plane->normal );
+		}
+
+		plane->dist = COM_RandomFloat( -256.0f, 256.0f );
+	}
+
+	// random tree, stored in shuffled order but the head node
+	// stays first as recursive check wants nodes after it
+	for( i = 0; i < TEST_FLATHULL_NODES; i++ )
+		order[i] = i;
+
+	for( i = TEST_FLATHULL_NODES - 1; i > 1; i-- )
+	{
+		j = COM_RandomLong( 1, i );
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	for( i = 0; i < TEST_FLATHULL_NODES; i++ )
+	{
+		clipnodes[i].planenum = COM_RandomLong( 0, TEST_FLATHULL_PLANES - 1 );
+		clipnodes[i].children[0] = COM_RandomLong( 0, 3 ) ? CONTENTS_EMPTY : CONTENTS_WATER;
+		clipnodes[i].children[1] = CONTENTS_SOLID;
+	}
+
+	for( i = 1; i < TEST_FLATHULL_NODES; i++ )
+	{
+		mclipnode_t	*parent;
+
+		// find parent with a free child slot among already placed nodes
+		do
+		{
+			parent = &clipnodes[order[COM_RandomLong( 0, i - 1 )]];
+			j = COM_RandomLong( 0, 1 );
+		} while( parent->children[0] >= 0 && parent->children[1] >= 0 );
+
+		if( parent->children[j] >= 0 )
+			j ^= 1;
+
+		parent->children[j] = order[i];
+	}
+
+	memset( hull, 0, sizeof( *hull ));
+	hull->clipnodes = clipnodes;
+	hull->planes = planes;
+	hull->firstclipnode = order[0];
+	hull->lastclipnode = TEST_FLATHULL_NODES - 1;
+}
+
+static void Test_FlatHull( void )
+{
+	poolhandle_t	mempool = Mem_AllocPool( "Flat Hull Test" );
+	pmtrace_t		trace[2];
+	hull_t		hull;
+	vec3_t		start, end;
+	int		i, j, root, mismatches = 0;
+
+	Test_MakeRandomHull( &hull, mempool );
+	root = hull.firstclipnode;
+
+	TASSERT( Mod_FlatHullForHull( &hull ) == NULL );
+	TASSERT( Mod_FlattenHull( &hull, TEST_FLATHULL_NODES, &root, 1, mempool ) != NULL );
+	TASSERT( Mod_FlatHullForHull( &hull ) != NULL );
+
+	for( i = 0; i < 2048; i++ )
+	{
+		for( j = 0; j < 3; j++ )
+		{
+			start[j] = COM_RandomFloat( -512.0f, 512.0f );
+			end[j] = COM_RandomFloat( -512.0f, 512.0f );
+		}
+
+		for( j = 0; j < 2; j++ )
+		{
+			memset( &trace[j], 0, sizeof( trace[j] ));
+			trace[j].allsolid = true;
+			trace[j].fraction = 1.0f;
+			VectorCopy( end, trace[j].endpos );
+		}
+
+		PM_HullCheck_r( &hull, hull.firstclipnode, 0.0f, 1.0f, start, end, &trace[0] );
+		PM_RecursiveHullCheck( &hull, hull.firstclipnode, 0.0f, 1.0f, start, end, &trace[1] );
+
+		if( trace[0].allsolid != trace[1].allsolid || trace[0].startsolid != trace[1].startsolid
+			|| trace[0].inopen != trace[1].inopen || trace[0].inwater != trace[1].inwater
+			|| trace[0].fraction != trace[1].fraction || !VectorCompare( trace[0].endpos, trace[1].endpos )
+			|| !VectorCompare( trace[0].plane.normal, trace[1].plane.normal ) || trace[0].plane.dist != trace[1].plane.dist )
+			mismatches++;
+	}
+
+	TASSERT_EQi( mismatches, 0 );
+
+	Mod_FreeFlatHulls( mempool );
+	TASSERT( Mod_FlatHullForHull( &hull ) == NULL );
+	Mem_FreePool( &mempool );
+}
+
+void Test_RunPmTrace( void )
+{
+	TRUN( Test_FlatHull() );
+}
+#endif /* XASH_ENGINE_TESTS */
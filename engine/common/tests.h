@@ -40,8 +40,17 @@ void Test_RunVOX( void );
 void Test_RunIPFilter( void );
 void Test_RunGamma( void );
 void Test_RunDelta( void );
+void Test_RunDeltaBaseline( void );
+void Test_RunDeltaCustomEncode( void );
 void Test_RunBuffer( void );
 void Test_RunMunge( void );
+void Test_RunJobs( void );
+void Test_RunNetchan( void );
+void Test_RunZone( void );
+void Test_RunAreaTree( void );
+void Test_RunPmTrace( void );
+void Test_RunStudioCache( void );
+void Test_RunUnlagHistory( void );
 
 #define TEST_LIST_0 \
 	Test_RunLibCommon(); \
@@ -51,14 +60,23 @@ void Test_RunMunge( void );
 	Test_RunIPFilter(); \
 	Test_RunBuffer(); \
 	Test_RunDelta(); \
-	Test_RunMunge();
+	Test_RunDeltaBaseline(); \
+	Test_RunMunge(); \
+	Test_RunJobs(); \
+	Test_RunNetchan(); \
+	Test_RunAreaTree(); \
+	Test_RunPmTrace(); \
+	Test_RunStudioCache(); \
+	Test_RunUnlagHistory();
 
 #define TEST_LIST_0_CLIENT \
 	Test_RunCon(); \
 	Test_RunGamma();
 
 #define TEST_LIST_1 \
-	Test_RunImagelib();
+	Test_RunImagelib(); \
+	Test_RunZone(); \
+	Test_RunDeltaCustomEncode();
 
 #define TEST_LIST_1_CLIENT \
 	Test_RunVOX();
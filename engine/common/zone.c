@@ -17,9 +17,33 @@ GNU General Public License for more details.
 */
 
 #include "common.h"
+#include "xash3d_mathlib.h"
 
 #define MEMHEADER_SENTINEL1	0xDEADF00DU
 #define MEMHEADER_SENTINEL2	0xDFU
+#define MEMHEADER_SENTINEL_FREE	0xF4EEB10CU	// sentinel1 of free slab slots and arena blocks
+
+// small blocks are carved from slabs, one list of them for each size class
+#define MEM_SLAB_CLASSES	10
+#define MEM_SLAB_MIN_SLOTS	4			// first slab of each class, next ones double up
+#define MEM_SLAB_MAX_SIZE	( 32 * 1024 )
+
+// arena pools bump allocate blocks from chunks, larger blocks are still malloc'ed
+#define MEM_ARENA_MIN_SIZE	( 4 * 1024 )
+#define MEM_ARENA_MAX_SIZE	( 64 * 1024 )
+#define MEM_ARENA_MAX_BLOCK	( MEM_ARENA_MAX_SIZE / 4 )
+#define MEM_ARENA_BLOCK	0xFFU			// slabclass of arena blocks
+
+// chunk lists in pool: slabs with free slots, full slabs, arena chunks
+#define MEM_FULL_SLABS	MEM_SLAB_CLASSES
+#define MEM_ARENA_CHUNKS	( MEM_SLAB_CLASSES * 2 )
+#define MEM_CHUNK_LISTS	( MEM_SLAB_CLASSES * 2 + 1 )
+
+#define MEM_ALIGN( x )	((( x ) + 15 ) & ~(size_t)15 )
+
+#ifndef XASH_MEM_DEBUG
+#define XASH_MEM_DEBUG	0 // when set, every block is malloc'ed separately
+#endif
 
 #ifdef XASH_CUSTOM_SWAP
 #include "platform/swap/swap.h"
@@ -53,31 +77,63 @@ static void *Q_realloc( void *mem, size_t size )
 
 typedef struct memheader_s
 {
-	struct memheader_s	*next;		// next and previous memheaders in chain belonging to pool
-	struct memheader_s	*prev;
+	struct memheader_s	*next;		// next and previous memheaders in chain belonging to pool, next free slot in slab
+	union
+	{
+		struct memheader_s	*prev;
+		struct memchunk_s	*chunk;		// slab or arena chunk this block was carved from
+	};
 	const char	*filename;	// file name and line where Mem_Alloc was called
 	size_t		size;		// size of the memory after the header (excluding header and sentinel2)
 	poolhandle_t	poolptr;		// pool this memheader belongs to
 	int		fileline;
-#if !XASH_64BIT
-	uint32_t		pad0; // doesn't have value, only to make Mem_Alloc return aligned addresses on ILP32
-#endif
+	uint32_t		slabclass;	// 0 if malloc'ed and chained, slab class + 1 or MEM_ARENA_BLOCK otherwise, also keeps Mem_Alloc addresses aligned on ILP32
 	uint32_t		sentinel1;	// should always be MEMHEADER_SENTINEL1
 
 	// immediately followed by data, which is followed by a MEMHEADER_SENTINEL2 byte
 } memheader_t;
 
+typedef struct memchunk_s
+{
+	struct memchunk_s	*next;		// next and previous chunks in the same list
+	struct memchunk_s	*prev;
+	memheader_t	*freelist;	// free slots of slab
+	size_t		size;		// size of the memory after the chunk header
+	size_t		used;		// bump offset of arena chunk
+	size_t		blocksize;	// slot size of slab
+	uint		live;		// allocated blocks
+	uint		slabclass;	// same as in memheader
+
+	// immediately followed by blocks, at MEMCHUNK_HEADER_SIZE
+} memchunk_t;
+
+#define MEMCHUNK_HEADER_SIZE	MEM_ALIGN( sizeof( memchunk_t ))
+
 typedef struct mempool_s
 {
 	struct memheader_s	*chain;		// chain of individual memory allocations
+	memchunk_t	*chunks[MEM_CHUNK_LISTS];	// slabs and arena chunks
+	uint		slabslots[MEM_SLAB_CLASSES];	// slot count of next slab
+	size_t		arenasize;	// size of next arena chunk
 	size_t		totalsize;	// total memory allocated in this pool (inside memheaders)
 	size_t		realsize;		// total memory allocated in this pool (actual malloc total)
 	size_t		lastchecksize;	// updated each time the pool is displayed by memlist
 	const char	*filename;	// file name and line where Mem_AllocPool was called
 	int		fileline;
+	uint		flags;		// MEMPOOL_* flags
 	char		name[64];		// name of the pool
 } mempool_t;
 
+// data size of slab slots, including sentinel2
+static const size_t mem_slab_sizes[MEM_SLAB_CLASSES] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512 };
+
+// slab class + 1 by data size in 16 byte units
+static const byte mem_slab_class[33] =
+{
+	0, 1, 2, 3, 4, 5, 5, 6, 6, 7, 7, 7, 7, 8, 8, 8, 8,
+	9, 9, 9, 9, 9, 9, 9, 9, 10, 10, 10, 10, 10, 10, 10, 10
+};
+
 static mempool_t *poolchain = NULL; // critical stuff
 static size_t poolcount = 0;
 
@@ -110,6 +166,16 @@ static inline void Mem_PoolSubtract( mempool_t *pool, size_t size )
 	pool->realsize -= sizeof( memheader_t ) + size + sizeof( byte );
 }
 
+static inline size_t Mem_BlockSize( size_t size )
+{
+	return MEM_ALIGN( sizeof( memheader_t ) + size + sizeof( byte ));
+}
+
+static inline byte *Mem_ChunkData( memchunk_t *chunk )
+{
+	return (byte *)chunk + MEMCHUNK_HEADER_SIZE;
+}
+
 static inline void Mem_PoolLinkAlloc( mempool_t *pool, memheader_t *mem )
 {
 	mem->next = pool->chain;
@@ -149,6 +215,390 @@ static const char *Mem_CheckFilename( const char *filename )
 	return dummy;
 }
 
+/*
+========================
+allocation profiler
+
+when started, live bytes and blocks are counted for each pool and call site,
+otherwise the only cost is a pointer check on alloc and free
+========================
+*/
+typedef struct memsite_s
+{
+	const char	*filename;	// as passed to Mem_Alloc, NULL for empty slot
+	int		fileline;
+	poolhandle_t	poolptr;		// 0 once the pool is freed
+	size_t		live;		// live bytes
+	size_t		peak;		// most live bytes seen
+	uint		count;		// live blocks
+	uint		allocs;		// allocations since profiler start
+	char		file[64];		// copies, filename can be unloaded with the library
+	char		pool[64];
+} memsite_t;
+
+static struct
+{
+	memsite_t	*sites;		// open addressing hash table, NULL if profiler is off
+	size_t	size;		// power of two
+	size_t	count;
+	double	starttime;
+} mem_profiler;
+
+#define Mem_Profile( mem, add ) if( unlikely( mem_profiler.sites != NULL )) Mem_ProfileUpdate( mem, add )
+
+static size_t Mem_ProfileHash( const char *filename, int fileline, poolhandle_t poolptr )
+{
+	size_t hash = (size_t)filename;
+
+	hash ^= hash >> 7;
+	hash = hash * 31 + fileline;
+	hash = hash * 31 + poolptr;
+
+	return hash;
+}
+
+static memsite_t *Mem_ProfileSite( const char *filename, int fileline, poolhandle_t poolptr )
+{
+	size_t i = Mem_ProfileHash( filename, fileline, poolptr ) & ( mem_profiler.size - 1 );
+	memsite_t *site;
+
+	while( 1 )
+	{
+		site = &mem_profiler.sites[i];
+
+		if( !site->filename )
+			break;
+
+		if( site->filename == filename && site->fileline == fileline && site->poolptr == poolptr )
+			return site;
+
+		i = ( i + 1 ) & ( mem_profiler.size - 1 );
+	}
+
+	site->filename = filename;
+	site->fileline = fileline;
+	site->poolptr = poolptr;
+	Q_strncpy( site->file, Mem_CheckFilename( filename ), sizeof( site->file ));
+	Q_strncpy( site->pool, poolchain[poolptr - 1].name, sizeof( site->pool ));
+	mem_profiler.count++;
+
+	return site;
+}
+
+static void Mem_ProfileGrow( void )
+{
+	memsite_t *oldsites = mem_profiler.sites;
+	size_t i, oldsize = mem_profiler.size;
+
+	mem_profiler.size = oldsize ? oldsize * 2 : 1024;
+	mem_profiler.sites = (memsite_t *)Q_malloc( sizeof( memsite_t ) * mem_profiler.size );
+
+	if( !mem_profiler.sites )
+	{
+		Sys_Error( "%s: out of memory\n", __func__ );
+		return;
+	}
+
+	memset( mem_profiler.sites, 0, sizeof( memsite_t ) * mem_profiler.size );
+
+	for( i = 0; i < oldsize; i++ )
+	{
+		size_t j;
+
+		if( !oldsites[i].filename )
+			continue;
+
+		j = Mem_ProfileHash( oldsites[i].filename, oldsites[i].fileline, oldsites[i].poolptr ) & ( mem_profiler.size - 1 );
+		while( mem_profiler.sites[j].filename )
+			j = ( j + 1 ) & ( mem_profiler.size - 1 );
+
+		mem_profiler.sites[j] = oldsites[i];
+	}
+
+	if( oldsites )
+		Q_free( oldsites );
+}
+
+static void Mem_ProfileFreePool( poolhandle_t poolptr )
+{
+	size_t i;
+
+	// handle can be reused by another pool, keep the sites for reports only
+	for( i = 0; mem_profiler.sites && i < mem_profiler.size; i++ )
+	{
+		if( mem_profiler.sites[i].filename && mem_profiler.sites[i].poolptr == poolptr )
+			mem_profiler.sites[i].poolptr = 0;
+	}
+}
+
+static void Mem_ProfileUpdate( const memheader_t *mem, qboolean add )
+{
+	memsite_t *site;
+
+	if( mem_profiler.count * 4 >= mem_profiler.size * 3 )
+		Mem_ProfileGrow();
+
+	site = Mem_ProfileSite( mem->filename, mem->fileline, mem->poolptr );
+
+	if( add )
+	{
+		site->live += mem->size;
+		site->count++;
+		site->allocs++;
+		site->peak = Q_max( site->peak, site->live );
+	}
+	else
+	{
+		site->live -= mem->size;
+		site->count--;
+	}
+}
+
+static void Mem_LinkChunk( memchunk_t **list, memchunk_t *chunk )
+{
+	chunk->prev = NULL;
+	chunk->next = *list;
+	if( chunk->next ) chunk->next->prev = chunk;
+	*list = chunk;
+}
+
+static void Mem_UnlinkChunk( memchunk_t **list, memchunk_t *chunk )
+{
+	if( chunk->next ) chunk->next->prev = chunk->prev;
+	if( chunk->prev ) chunk->prev->next = chunk->next;
+	else *list = chunk->next;
+}
+
+static memchunk_t *Mem_AllocChunk( mempool_t *pool, size_t size, uint slabclass, const char *filename, int fileline )
+{
+	memchunk_t *chunk = (memchunk_t *)Q_malloc( MEMCHUNK_HEADER_SIZE + size );
+
+	if( chunk == NULL )
+	{
+		Sys_Error( "%s: out of memory (alloc size %s at %s:%i)\n", __func__, Q_memprint( size ), filename, fileline );
+		return NULL;
+	}
+
+	memset( chunk, 0, sizeof( *chunk ));
+	chunk->size = size;
+	chunk->slabclass = slabclass;
+	pool->realsize += MEMCHUNK_HEADER_SIZE + size;
+
+	return chunk;
+}
+
+static void Mem_FreeChunk( mempool_t *pool, memchunk_t *chunk )
+{
+	pool->realsize -= MEMCHUNK_HEADER_SIZE + chunk->size;
+	Q_free( chunk );
+}
+
+/*
+========================
+Mem_NextChunkBlock
+
+iterates allocated blocks of slab or arena chunk, starts with NULL
+========================
+*/
+static memheader_t *Mem_NextChunkBlock( memchunk_t *chunk, memheader_t *mem )
+{
+	byte *end;
+
+	if( chunk->slabclass == MEM_ARENA_BLOCK )
+		end = Mem_ChunkData( chunk ) + chunk->used;
+	else end = Mem_ChunkData( chunk ) + chunk->size;
+
+	while( 1 )
+	{
+		if( !mem )
+			mem = (memheader_t *)Mem_ChunkData( chunk );
+		else if( chunk->slabclass == MEM_ARENA_BLOCK )
+			mem = (memheader_t *)((byte *)mem + Mem_BlockSize( mem->size ));
+		else mem = (memheader_t *)((byte *)mem + chunk->blocksize );
+
+		if( (byte *)mem >= end )
+			return NULL;
+
+		if( mem->sentinel1 != MEMHEADER_SENTINEL_FREE )
+			return mem;
+	}
+}
+
+static memheader_t *Mem_AllocSlab( mempool_t *pool, uint slabclass, const char *filename, int fileline )
+{
+	memchunk_t *slab = pool->chunks[slabclass];
+	memheader_t *mem;
+
+	if( !slab )
+	{
+		size_t blocksize = sizeof( memheader_t ) + mem_slab_sizes[slabclass];
+		uint i, slots = Q_max( pool->slabslots[slabclass], MEM_SLAB_MIN_SLOTS );
+
+		slab = Mem_AllocChunk( pool, blocksize * slots, slabclass + 1, filename, fileline );
+		slab->blocksize = blocksize;
+
+		for( i = slots; i-- > 0; )
+		{
+			mem = (memheader_t *)( Mem_ChunkData( slab ) + blocksize * i );
+			mem->chunk = slab;
+			mem->slabclass = slabclass + 1;
+			mem->poolptr = 0;
+			mem->sentinel1 = MEMHEADER_SENTINEL_FREE;
+			mem->next = slab->freelist;
+			slab->freelist = mem;
+		}
+
+		Mem_LinkChunk( &pool->chunks[slabclass], slab );
+
+		if( blocksize * slots * 2 <= MEM_SLAB_MAX_SIZE )
+			pool->slabslots[slabclass] = slots * 2;
+	}
+
+	mem = slab->freelist;
+	slab->freelist = mem->next;
+	slab->live++;
+
+	if( !slab->freelist )
+	{
+		Mem_UnlinkChunk( &pool->chunks[slabclass], slab );
+		Mem_LinkChunk( &pool->chunks[MEM_FULL_SLABS + slabclass], slab );
+	}
+
+	return mem;
+}
+
+static void Mem_FreeSlab( mempool_t *pool, memheader_t *mem )
+{
+	memchunk_t *slab = mem->chunk;
+	uint slabclass = slab->slabclass - 1;
+
+	if( !slab->freelist )
+	{
+		Mem_UnlinkChunk( &pool->chunks[MEM_FULL_SLABS + slabclass], slab );
+		Mem_LinkChunk( &pool->chunks[slabclass], slab );
+	}
+
+	mem->sentinel1 = MEMHEADER_SENTINEL_FREE;
+	mem->poolptr = 0;
+	mem->next = slab->freelist;
+	slab->freelist = mem;
+	slab->live--;
+
+	// keep the last one to not allocate it again and again
+	if( !slab->live && ( slab->prev || slab->next ))
+	{
+		Mem_UnlinkChunk( &pool->chunks[slabclass], slab );
+		Mem_FreeChunk( pool, slab );
+	}
+}
+
+static memheader_t *Mem_AllocArena( mempool_t *pool, size_t size, const char *filename, int fileline )
+{
+	memchunk_t *chunk = pool->chunks[MEM_ARENA_CHUNKS];
+	size_t blocksize = Mem_BlockSize( size );
+	memheader_t *mem;
+
+	if( !chunk || chunk->used + blocksize > chunk->size )
+	{
+		size_t chunksize = Q_max( pool->arenasize, MEM_ARENA_MIN_SIZE );
+
+		chunk = Mem_AllocChunk( pool, Q_max( chunksize, blocksize ), MEM_ARENA_BLOCK, filename, fileline );
+		Mem_LinkChunk( &pool->chunks[MEM_ARENA_CHUNKS], chunk );
+
+		if( chunksize * 2 <= MEM_ARENA_MAX_SIZE )
+			pool->arenasize = chunksize * 2;
+	}
+
+	mem = (memheader_t *)( Mem_ChunkData( chunk ) + chunk->used );
+	mem->chunk = chunk;
+	mem->slabclass = MEM_ARENA_BLOCK;
+	chunk->used += blocksize;
+	chunk->live++;
+
+	return mem;
+}
+
+static qboolean Mem_LastArenaBlock( memheader_t *mem )
+{
+	memchunk_t *chunk = mem->chunk;
+
+	return (byte *)mem + Mem_BlockSize( mem->size ) == Mem_ChunkData( chunk ) + chunk->used;
+}
+
+static void Mem_FreeArena( mempool_t *pool, memheader_t *mem )
+{
+	memchunk_t *chunk = mem->chunk;
+
+	// memory is reused only if it was the last block, size is kept to walk the chunk
+	if( Mem_LastArenaBlock( mem ))
+		chunk->used -= Mem_BlockSize( mem->size );
+
+	mem->sentinel1 = MEMHEADER_SENTINEL_FREE;
+	mem->poolptr = 0;
+	chunk->live--;
+
+	if( !chunk->live )
+	{
+		if( chunk != pool->chunks[MEM_ARENA_CHUNKS] )
+		{
+			Mem_UnlinkChunk( &pool->chunks[MEM_ARENA_CHUNKS], chunk );
+			Mem_FreeChunk( pool, chunk );
+		}
+		else chunk->used = 0;
+	}
+}
+
+static void Mem_FreeChunks( mempool_t *pool )
+{
+	int i;
+
+	for( i = 0; i < MEM_CHUNK_LISTS; i++ )
+	{
+		while( pool->chunks[i] )
+		{
+			memchunk_t *chunk = pool->chunks[i];
+
+			if( unlikely( mem_profiler.sites != NULL ))
+			{
+				memheader_t *mem;
+
+				for( mem = Mem_NextChunkBlock( chunk, NULL ); mem; mem = Mem_NextChunkBlock( chunk, mem ))
+					Mem_ProfileUpdate( mem, false );
+			}
+
+			pool->chunks[i] = chunk->next;
+			Mem_FreeChunk( pool, chunk );
+		}
+	}
+}
+
+static memheader_t *Mem_AllocBlock( mempool_t *pool, size_t size, const char *filename, int fileline )
+{
+	memheader_t *mem;
+
+#if !XASH_MEM_DEBUG
+	size_t units = ( size + sizeof( byte ) + 15 ) / 16;
+
+	if( FBitSet( pool->flags, MEMPOOL_ARENA ) && Mem_BlockSize( size ) <= MEM_ARENA_MAX_BLOCK )
+		return Mem_AllocArena( pool, size, filename, fileline );
+
+	if( units < sizeof( mem_slab_class ))
+		return Mem_AllocSlab( pool, mem_slab_class[units] - 1, filename, fileline );
+#endif
+
+	mem = (memheader_t *)Q_malloc( sizeof( memheader_t ) + size + sizeof( byte ));
+	if( mem == NULL )
+	{
+		Sys_Error( "%s: out of memory (alloc size %s at %s:%i)\n", __func__, Q_memprint( size ), filename, fileline );
+		return NULL;
+	}
+
+	mem->slabclass = 0;
+	Mem_PoolLinkAlloc( pool, mem );
+
+	return mem;
+}
+
 static qboolean Mem_CheckAllocHeader( const char *func, const memheader_t *mem, const char *filename, int fileline )
 {
 	const char *memfilename;
@@ -188,17 +638,17 @@ void *_Mem_Alloc( poolhandle_t poolptr, size_t size, qboolean clear, const char
 	if( !pool )
 		return NULL;
 
-	mem = (memheader_t *)Q_malloc( sizeof( memheader_t ) + size + sizeof( byte ));
+	mem = Mem_AllocBlock( pool, size, filename, fileline );
 	if( mem == NULL )
-	{
-		Sys_Error( "%s: out of memory (alloc size %s at %s:%i)\n", __func__, Q_memprint( size ), filename, fileline );
 		return NULL;
-	}
 
 	Mem_InitAlloc( mem, size, filename, fileline );
+	mem->poolptr = poolptr;
+	Mem_Profile( mem, true );
 
-	Mem_PoolAdd( pool, size );
-	Mem_PoolLinkAlloc( pool, mem );
+	if( mem->slabclass )
+		pool->totalsize += size;
+	else Mem_PoolAdd( pool, size );
 
 	if( clear )
 		memset((void *)((byte *)mem + sizeof( memheader_t )), 0, mem->size );
@@ -210,6 +660,12 @@ static void Mem_FreeBlock( memheader_t *mem, const char *filename, int fileline
 {
 	mempool_t		*pool;
 
+	if( mem->slabclass && mem->sentinel1 == MEMHEADER_SENTINEL_FREE )
+	{
+		Sys_Error( "%s: not allocated or double freed (free at %s:%i)\n", __func__, filename, fileline );
+		return;
+	}
+
 	if( !Mem_CheckAllocHeader( __func__, mem, filename, fileline ))
 		return;
 
@@ -217,6 +673,18 @@ static void Mem_FreeBlock( memheader_t *mem, const char *filename, int fileline
 	if( !pool )
 		return;
 
+	Mem_Profile( mem, false );
+
+	if( mem->slabclass )
+	{
+		pool->totalsize -= mem->size;
+
+		if( mem->slabclass == MEM_ARENA_BLOCK )
+			Mem_FreeArena( pool, mem );
+		else Mem_FreeSlab( pool, mem );
+		return;
+	}
+
 	// unlink memheader from doubly linked list
 	if(( mem->prev ? mem->prev->next != mem : pool->chain != mem ) || ( mem->next && mem->next->prev != mem ))
 	{
@@ -256,6 +724,61 @@ static void Mem_MigratePool( poolhandle_t newpoolptr, memheader_t *mem, const ch
 	Mem_PoolAdd( newpool, mem->size );
 }
 
+static qboolean Mem_ResizeChunkBlock( memheader_t *mem, size_t size )
+{
+	memchunk_t *chunk = mem->chunk;
+	size_t oldblocksize, blocksize;
+
+	if( mem->slabclass != MEM_ARENA_BLOCK )
+		return size + sizeof( byte ) <= mem_slab_sizes[mem->slabclass - 1];
+
+	oldblocksize = Mem_BlockSize( mem->size );
+	blocksize = Mem_BlockSize( size );
+
+	if( blocksize == oldblocksize )
+		return true;
+
+	// last block can grow or shrink in place
+	if( !Mem_LastArenaBlock( mem ) || chunk->used - oldblocksize + blocksize > chunk->size )
+		return false;
+
+	chunk->used = chunk->used - oldblocksize + blocksize;
+	return true;
+}
+
+static void *Mem_ReallocChunkBlock( poolhandle_t poolptr, memheader_t *mem, size_t size, qboolean clear, const char *filename, int fileline )
+{
+	void *data = (byte *)mem + sizeof( memheader_t );
+	size_t oldsize = mem->size;
+	void *newdata;
+
+	if( mem->poolptr == poolptr && Mem_ResizeChunkBlock( mem, size ))
+	{
+		mempool_t *pool = Mem_FindPool( poolptr );
+
+		Mem_Profile( mem, false );
+		pool->totalsize = pool->totalsize - oldsize + size;
+		Mem_InitAlloc( mem, size, filename, fileline );
+		Mem_Profile( mem, true );
+
+		if( clear && size > oldsize )
+			memset((byte *)data + oldsize, 0, size - oldsize );
+
+		return data;
+	}
+
+	// move to another block, or pool
+	newdata = _Mem_Alloc( poolptr, size, false, filename, fileline );
+	memcpy( newdata, data, Q_min( oldsize, size ));
+
+	if( clear && size > oldsize )
+		memset((byte *)newdata + oldsize, 0, size - oldsize );
+
+	Mem_FreeBlock( mem, filename, fileline );
+
+	return newdata;
+}
+
 void *_Mem_Realloc( poolhandle_t poolptr, void *data, size_t size, qboolean clear, const char *filename, int fileline )
 {
 	memheader_t *mem;
@@ -280,13 +803,21 @@ void *_Mem_Realloc( poolhandle_t poolptr, void *data, size_t size, qboolean clea
 	if( !Mem_CheckAllocHeader( __func__, mem, filename, fileline ))
 		return NULL;
 
+	if( mem->slabclass )
+		return Mem_ReallocChunkBlock( poolptr, mem, size, clear, filename, fileline );
+
+	Mem_Profile( mem, false );
+
 	// migrate pool if requested, even if no reallocation needed
 	if( mem->poolptr != poolptr )
 		Mem_MigratePool( poolptr, mem, filename, fileline );
 
 	oldsize = mem->size;
 	if( size == oldsize )
+	{
+		Mem_Profile( mem, true );
 		return data;
+	}
 
 	pool = Mem_FindPool( poolptr );
 
@@ -303,6 +834,7 @@ void *_Mem_Realloc( poolhandle_t poolptr, void *data, size_t size, qboolean clea
 	// __func__, (uintptr_t)mem != oldmem ? "!=" : "==", oldsize, size, filename, fileline );
 
 	Mem_InitAlloc( mem, size, filename, fileline );
+	Mem_Profile( mem, true );
 
 	if( size > oldsize )
 	{
@@ -323,20 +855,21 @@ void *_Mem_Realloc( poolhandle_t poolptr, void *data, size_t size, qboolean clea
 	return (void *)((byte *)mem + sizeof( memheader_t ));
 }
 
-static poolhandle_t Mem_InitPool( mempool_t *pool, const char *name, const char *filename, int fileline )
+static poolhandle_t Mem_InitPool( mempool_t *pool, const char *name, uint flags, const char *filename, int fileline )
 {
 	memset( pool, 0, sizeof( *pool ));
 
 	// fill header
 	pool->filename = filename;
 	pool->fileline = fileline;
+	pool->flags = flags;
 	pool->realsize = sizeof( mempool_t );
 	Q_strncpy( pool->name, name, sizeof( pool->name ));
 
 	return Mem_PoolIndex( pool );
 }
 
-poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int fileline )
+poolhandle_t _Mem_AllocPoolExt( const char *name, uint flags, const char *filename, int fileline )
 {
 	mempool_t *pool;
 	size_t i;
@@ -344,7 +877,7 @@ poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int filelin
 	for( i = 0, pool = poolchain; i < poolcount; i++, pool++ )
 	{
 		if( pool->filename == NULL )
-			return Mem_InitPool( pool, name, filename, fileline );
+			return Mem_InitPool( pool, name, flags, filename, fileline );
 	}
 
 	pool = (mempool_t *)Q_realloc( poolchain, sizeof( *poolchain ) * ( poolcount + 1 ));
@@ -356,7 +889,12 @@ poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int filelin
 
 	poolchain = pool;
 	pool = &poolchain[poolcount++];
-	return Mem_InitPool( pool, name, filename, fileline );
+	return Mem_InitPool( pool, name, flags, filename, fileline );
+}
+
+poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int fileline )
+{
+	return _Mem_AllocPoolExt( name, 0, filename, fileline );
 }
 
 void _Mem_FreePool( poolhandle_t *poolptr, const char *filename, int fileline )
@@ -375,9 +913,12 @@ void _Mem_FreePool( poolhandle_t *poolptr, const char *filename, int fileline )
 		// free memory owned by the pool
 		while( pool->chain )
 			Mem_FreeBlock( pool->chain, filename, fileline );
+		Mem_FreeChunks( pool );
+		Mem_ProfileFreePool( *poolptr );
 
 		// free the pool itself
 		memset( pool, 0xBF, sizeof( mempool_t ));
+		memset( pool->chunks, 0, sizeof( pool->chunks ));
 		pool->chain = NULL;
 		pool->filename = NULL; // mark as reusable
 		*poolptr = 0;
@@ -397,8 +938,10 @@ void _Mem_EmptyPool( poolhandle_t poolptr, const char *filename, int fileline )
 	if( !pool )
 		return;
 
-	// free memory owned by the pool
+	// free memory owned by the pool, slabs and arena chunks are dropped as a whole
 	while( pool->chain ) Mem_FreeBlock( pool->chain, filename, fileline );
+	Mem_FreeChunks( pool );
+	pool->totalsize = 0;
 }
 
 static qboolean Mem_CheckAlloc( mempool_t *pool, void *data )
@@ -407,6 +950,8 @@ static qboolean Mem_CheckAlloc( mempool_t *pool, void *data )
 
 	if( pool )
 	{
+		int j;
+
 		// search only one pool
 		target = (memheader_t *)((byte *)data - sizeof( memheader_t ));
 		for( header = pool->chain; header; header = header->next )
@@ -414,6 +959,25 @@ static qboolean Mem_CheckAlloc( mempool_t *pool, void *data )
 			if( header == target )
 				return true;
 		}
+
+		for( j = 0; j < MEM_CHUNK_LISTS; j++ )
+		{
+			memchunk_t *chunk;
+
+			for( chunk = pool->chunks[j]; chunk; chunk = chunk->next )
+			{
+				if( (byte *)target < Mem_ChunkData( chunk ) || (byte *)target >= Mem_ChunkData( chunk ) + chunk->size )
+					continue;
+
+				for( header = Mem_NextChunkBlock( chunk, NULL ); header; header = Mem_NextChunkBlock( chunk, header ))
+				{
+					if( header == target )
+						return true;
+				}
+
+				return false;
+			}
+		}
 	}
 	else
 	{
@@ -446,39 +1010,83 @@ qboolean Mem_IsAllocatedExt( poolhandle_t poolptr, void *data )
 void _Mem_Check( const char *filename, int fileline )
 {
 	memheader_t *mem;
+	memchunk_t  *chunk;
 	mempool_t   *pool;
 	size_t i;
+	int j;
 
 	for( i = 0, pool = poolchain; i < poolcount; i++, pool++ )
+	{
 		for( mem = pool->chain; mem; mem = mem->next )
 			Mem_CheckAllocHeader( __func__, mem, filename, fileline );
+
+		for( j = 0; j < MEM_CHUNK_LISTS; j++ )
+		{
+			for( chunk = pool->chunks[j]; chunk; chunk = chunk->next )
+			{
+				for( mem = Mem_NextChunkBlock( chunk, NULL ); mem; mem = Mem_NextChunkBlock( chunk, mem ))
+					Mem_CheckAllocHeader( __func__, mem, filename, fileline );
+			}
+		}
+	}
 }
 
 void Mem_PrintStats( void )
 {
 	size_t    count = 0, size = 0, realsize = 0, i;
+	size_t    slabs = 0, slabslots = 0, slablive = 0, slabsize = 0;
+	size_t    arenas = 0, arenaused = 0, arenasize = 0;
 	mempool_t *pool;
+	int j;
 
 	Mem_Check();
 	for( i = 0, pool = poolchain; i < poolcount; i++, pool++ )
 	{
+		memchunk_t *chunk;
+
 		if( !pool->filename )
 			continue;
 
 		count++;
 		size += pool->totalsize;
 		realsize += pool->realsize;
+
+		for( j = 0; j < MEM_CHUNK_LISTS; j++ )
+		{
+			for( chunk = pool->chunks[j]; chunk; chunk = chunk->next )
+			{
+				if( chunk->slabclass == MEM_ARENA_BLOCK )
+				{
+					arenas++;
+					arenaused += chunk->used;
+					arenasize += chunk->size;
+				}
+				else
+				{
+					slabs++;
+					slabslots += chunk->size / chunk->blocksize;
+					slablive += chunk->live;
+					slabsize += chunk->size;
+				}
+			}
+		}
 	}
 
 	Con_Printf( "^3%zu^7 memory pools, totalling: ^1%s\n", count, Q_memprint( size ));
 	Con_Printf( "total allocated size: ^1%s\n", Q_memprint( realsize ));
+	Con_Printf( "overhead and fragmentation: ^1%s^7 (%.1f%%)\n", Q_memprint( realsize - size ), realsize ? ( realsize - size ) * 100.0 / realsize : 0.0 );
+	Con_Printf( "slabs: %zu of %zu slots used (%.1f%%) in %zu slabs of %s\n", slablive, slabslots,
+		slabslots ? slablive * 100.0 / slabslots : 0.0, slabs, Q_memprint( slabsize ));
+	Con_Printf( "arenas: %s of %s used in %zu chunks\n", Q_memprint( arenaused ), Q_memprint( arenasize ), arenas );
 }
 
 void Mem_PrintList( size_t minallocationsize )
 {
 	mempool_t		*pool;
 	memheader_t	*mem;
+	memchunk_t	*chunk;
 	size_t i;
+	int j;
 
 	Mem_Check();
 
@@ -510,6 +1118,18 @@ void Mem_PrintList( size_t minallocationsize )
 			if( mem->size >= minallocationsize )
 				Con_Printf( "%10s allocated at %s:%i\n", Q_memprint( mem->size ), mem->filename, mem->fileline );
 		}
+
+		for( j = 0; j < MEM_CHUNK_LISTS; j++ )
+		{
+			for( chunk = pool->chunks[j]; chunk; chunk = chunk->next )
+			{
+				for( mem = Mem_NextChunkBlock( chunk, NULL ); mem; mem = Mem_NextChunkBlock( chunk, mem ))
+				{
+					if( mem->size >= minallocationsize )
+						Con_Printf( "%10s allocated at %s:%i\n", Q_memprint( mem->size ), mem->filename, mem->fileline );
+				}
+			}
+		}
 	}
 }
 
@@ -522,3 +1142,530 @@ void Memory_Init( void )
 {
 	poolchain = NULL; // init mem chain
 }
+
+/*
+========================
+Mem_ProfileStart
+
+counts blocks already allocated as if they were allocated now
+========================
+*/
+static void Mem_ProfileStart( void )
+{
+	mempool_t *pool;
+	size_t i;
+	int j;
+
+	Mem_ProfileGrow();
+	mem_profiler.starttime = Sys_DoubleTime();
+
+	for( i = 0, pool = poolchain; i < poolcount; i++, pool++ )
+	{
+		memheader_t *mem;
+		memchunk_t *chunk;
+
+		if( !pool->filename )
+			continue;
+
+		for( mem = pool->chain; mem; mem = mem->next )
+			Mem_ProfileUpdate( mem, true );
+
+		for( j = 0; j < MEM_CHUNK_LISTS; j++ )
+		{
+			for( chunk = pool->chunks[j]; chunk; chunk = chunk->next )
+			{
+				for( mem = Mem_NextChunkBlock( chunk, NULL ); mem; mem = Mem_NextChunkBlock( chunk, mem ))
+					Mem_ProfileUpdate( mem, true );
+			}
+		}
+	}
+}
+
+static void Mem_ProfileStop( void )
+{
+	if( mem_profiler.sites )
+		Q_free( mem_profiler.sites );
+	memset( &mem_profiler, 0, sizeof( mem_profiler ));
+}
+
+static int Mem_ProfileSortLive( const void *a, const void *b )
+{
+	const memsite_t *site1 = *(const memsite_t **)a, *site2 = *(const memsite_t **)b;
+
+	return ( site1->live < site2->live ) - ( site1->live > site2->live );
+}
+
+static void Mem_ProfilePrint( size_t count )
+{
+	memsite_t **sorted = (memsite_t **)Q_malloc( sizeof( *sorted ) * mem_profiler.count );
+	size_t i, numsorted = 0, live = 0;
+
+	for( i = 0; i < mem_profiler.size; i++ )
+	{
+		if( mem_profiler.sites[i].filename && mem_profiler.sites[i].count )
+		{
+			sorted[numsorted++] = &mem_profiler.sites[i];
+			live += mem_profiler.sites[i].live;
+		}
+	}
+
+	qsort( sorted, numsorted, sizeof( *sorted ), Mem_ProfileSortLive );
+
+	Con_Printf( "%zu call sites, %s live, profiling for %.0f seconds\n", numsorted, Q_memprint( live ), Sys_DoubleTime() - mem_profiler.starttime );
+	Con_Printf( "\t^3live\t\tblocks\tpeak\t\tallocs\tsite\n" );
+
+	for( i = 0; i < numsorted && i < count; i++ )
+	{
+		memsite_t *site = sorted[i];
+
+		Con_Printf( "%10s\t%6u\t%10s\t%6u\t%s:%i (%s)\n", Q_memprint( site->live ), site->count,
+			Q_memprint( site->peak ), site->allocs, site->file, site->fileline, site->pool );
+	}
+
+	Q_free( sorted );
+}
+
+static qboolean Mem_ProfileWrite( const char *filename )
+{
+	file_t *f = FS_Open( filename, "w", true );
+	size_t i;
+
+	if( !f )
+		return false;
+
+	FS_Printf( f, "// memory profile after %.0f seconds of profiling\n", Sys_DoubleTime() - mem_profiler.starttime );
+	FS_Printf( f, "// live bytes, live blocks, peak bytes, allocations, call site, pool\n" );
+
+	for( i = 0; i < mem_profiler.size; i++ )
+	{
+		const memsite_t *site = &mem_profiler.sites[i];
+
+		if( site->filename )
+			FS_Printf( f, "%zu\t%u\t%zu\t%u\t%s:%i\t%s\n", site->live, site->count, site->peak, site->allocs, site->file, site->fileline, site->pool );
+	}
+
+	FS_Close( f );
+	return true;
+}
+
+typedef struct memsnapshot_s
+{
+	char		key[160];		// call site and pool
+	long long		live;
+	int		count;
+} memsnapshot_t;
+
+static int Mem_ProfileSortKey( const void *a, const void *b )
+{
+	return Q_strcmp( ((const memsnapshot_t *)a)->key, ((const memsnapshot_t *)b)->key );
+}
+
+static int Mem_ProfileSortDelta( const void *a, const void *b )
+{
+	long long delta1 = llabs( ((const memsnapshot_t *)a)->live ), delta2 = llabs( ((const memsnapshot_t *)b)->live );
+
+	return ( delta1 < delta2 ) - ( delta1 > delta2 );
+}
+
+/*
+========================
+Mem_ProfileRead
+
+reads snapshot sorted by key, same sites from different pools are merged
+========================
+*/
+static memsnapshot_t *Mem_ProfileRead( const char *filename, size_t *count )
+{
+	memsnapshot_t *sites = NULL;
+	size_t numsites = 0, maxsites = 0, i;
+	char *data, *line;
+
+	data = (char *)FS_LoadFile( filename, NULL, false );
+	if( !data )
+		return NULL;
+
+	for( line = data; line && *line; )
+	{
+		char *next = Q_strchr( line, '\n' );
+		size_t live, peak;
+		uint blocks, allocs;
+		int n = 0;
+
+		if( next )
+			*next++ = '\0';
+
+		if( line[0] != '/' && sscanf( line, "%zu\t%u\t%zu\t%u\t%n", &live, &blocks, &peak, &allocs, &n ) == 4 && n > 0 )
+		{
+			if( numsites == maxsites )
+			{
+				maxsites = maxsites ? maxsites * 2 : 256;
+				sites = (memsnapshot_t *)Mem_Realloc( host.mempool, sites, sizeof( *sites ) * maxsites );
+			}
+
+			Q_strncpy( sites[numsites].key, line + n, sizeof( sites[numsites].key ));
+			sites[numsites].live = live;
+			sites[numsites].count = blocks;
+			numsites++;
+		}
+
+		line = next;
+	}
+
+	Mem_Free( data );
+
+	if( !sites )
+	{
+		*count = 0;
+		return (memsnapshot_t *)Mem_Calloc( host.mempool, sizeof( *sites ));
+	}
+
+	qsort( sites, numsites, sizeof( *sites ), Mem_ProfileSortKey );
+
+	for( i = 1, *count = 1; i < numsites; i++ )
+	{
+		memsnapshot_t *last = &sites[*count - 1];
+
+		if( !Q_strcmp( last->key, sites[i].key ))
+		{
+			last->live += sites[i].live;
+			last->count += sites[i].count;
+		}
+		else sites[(*count)++] = sites[i];
+	}
+
+	return sites;
+}
+
+static void Mem_ProfileDiff( const char *filename1, const char *filename2, size_t count )
+{
+	memsnapshot_t *sites1, *sites2, *delta;
+	size_t numsites1, numsites2, numdelta = 0, i = 0, j = 0;
+	long long total = 0;
+
+	if( !( sites1 = Mem_ProfileRead( filename1, &numsites1 )))
+	{
+		Con_Printf( S_ERROR "couldn't read %s\n", filename1 );
+		return;
+	}
+
+	if( !( sites2 = Mem_ProfileRead( filename2, &numsites2 )))
+	{
+		Con_Printf( S_ERROR "couldn't read %s\n", filename2 );
+		Mem_Free( sites1 );
+		return;
+	}
+
+	delta = (memsnapshot_t *)Mem_Calloc( host.mempool, sizeof( *delta ) * ( numsites1 + numsites2 + 1 ));
+
+	// both are sorted, merge them
+	while( i < numsites1 || j < numsites2 )
+	{
+		int cmp;
+
+		if( i == numsites1 ) cmp = 1;
+		else if( j == numsites2 ) cmp = -1;
+		else cmp = Q_strcmp( sites1[i].key, sites2[j].key );
+
+		if( cmp <= 0 )
+		{
+			Q_strncpy( delta[numdelta].key, sites1[i].key, sizeof( delta[numdelta].key ));
+			delta[numdelta].live -= sites1[i].live;
+			delta[numdelta].count -= sites1[i].count;
+			i++;
+		}
+
+		if( cmp >= 0 )
+		{
+			Q_strncpy( delta[numdelta].key, sites2[j].key, sizeof( delta[numdelta].key ));
+			delta[numdelta].live += sites2[j].live;
+			delta[numdelta].count += sites2[j].count;
+			j++;
+		}
+
+		numdelta++;
+	}
+
+	qsort( delta, numdelta, sizeof( *delta ), Mem_ProfileSortDelta );
+
+	for( i = 0; i < numdelta; i++ )
+		total += delta[i].live;
+
+	Con_Printf( "%s -> %s: %c%s live\n", filename1, filename2, total < 0 ? '-' : '+', Q_memprint( llabs( total )));
+
+	for( i = 0; i < numdelta && i < count && delta[i].live; i++ )
+	{
+		char size[32];
+
+		Q_snprintf( size, sizeof( size ), "%c%s", delta[i].live < 0 ? '-' : '+', Q_memprint( llabs( delta[i].live )));
+		Con_Printf( "%11s\t%+6i blocks\t%s\n", size, delta[i].count, delta[i].key );
+	}
+
+	Mem_Free( delta );
+	Mem_Free( sites2 );
+	Mem_Free( sites1 );
+}
+
+/*
+========================
+Mem_Profile_f
+========================
+*/
+void Mem_Profile_f( void )
+{
+	const char *cmd = Cmd_Argv( 1 );
+
+	if( !Q_stricmp( cmd, "start" ))
+	{
+		if( !mem_profiler.sites )
+			Mem_ProfileStart();
+		Con_Printf( "memory profiler is on\n" );
+	}
+	else if( !Q_stricmp( cmd, "stop" ))
+	{
+		Mem_ProfileStop();
+		Con_Printf( "memory profiler is off\n" );
+	}
+	else if( !Q_stricmp( cmd, "print" ))
+	{
+		if( mem_profiler.sites )
+			Mem_ProfilePrint( Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 20 );
+		else Con_Printf( "memory profiler is off, use memprofile start\n" );
+	}
+	else if( !Q_stricmp( cmd, "snapshot" ) && Cmd_Argc() == 3 )
+	{
+		qboolean started = mem_profiler.sites != NULL;
+
+		// without profiler there are no peaks, but live heap can still be walked
+		if( !started )
+			Mem_ProfileStart();
+
+		if( Mem_ProfileWrite( Cmd_Argv( 2 )))
+			Con_Printf( "wrote %s\n", Cmd_Argv( 2 ));
+		else Con_Printf( S_ERROR "couldn't write %s\n", Cmd_Argv( 2 ));
+
+		if( !started )
+			Mem_ProfileStop();
+	}
+	else if( !Q_stricmp( cmd, "diff" ) && Cmd_Argc() >= 4 )
+	{
+		Mem_ProfileDiff( Cmd_Argv( 2 ), Cmd_Argv( 3 ), Cmd_Argc() > 4 ? Q_atoi( Cmd_Argv( 4 )) : 30 );
+	}
+	else
+	{
+		Con_Printf( S_USAGE "memprofile start|stop|print [count]|snapshot <file>|diff <file1> <file2> [count]\n" );
+	}
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static void Test_Slabs( void )
+{
+	poolhandle_t poolptr = Mem_AllocPool( "Slab Test" );
+	mempool_t *pool = Mem_FindPool( poolptr );
+	byte *blocks[1024];
+	byte *big;
+	int i;
+
+	for( i = 0; i < (int)( sizeof( blocks ) / sizeof( blocks[0] )); i++ )
+	{
+		blocks[i] = Mem_Malloc( poolptr, 1 + i % 600 );
+		memset( blocks[i], i, 1 + i % 600 );
+	}
+
+	TASSERT_EQi( pool->totalsize > 0, true );
+	TASSERT( Mem_IsAllocatedExt( poolptr, blocks[5] ));
+#if !XASH_MEM_DEBUG
+	TASSERT( pool->chunks[0] != NULL || pool->chunks[MEM_FULL_SLABS] != NULL );
+#endif
+
+	// free every other block, then reuse the slots
+	for( i = 0; i < (int)( sizeof( blocks ) / sizeof( blocks[0] )); i += 2 )
+		Mem_Free( blocks[i] );
+
+	TASSERT( !Mem_IsAllocatedExt( poolptr, blocks[4] ));
+	TASSERT( Mem_IsAllocatedExt( poolptr, blocks[5] ));
+
+	for( i = 0; i < (int)( sizeof( blocks ) / sizeof( blocks[0] )); i += 2 )
+	{
+		blocks[i] = Mem_Malloc( poolptr, 1 + i % 600 );
+		memset( blocks[i], i, 1 + i % 600 );
+	}
+
+	// growing past the size class moves the block
+	blocks[1] = Mem_Realloc( poolptr, blocks[1], 8 );
+	TASSERT( blocks[1][1] == 1 && blocks[1][2] == 0 );
+	blocks[1] = Mem_Realloc( poolptr, blocks[1], 4096 );
+	TASSERT( blocks[1][0] == 1 && blocks[1][4095] == 0 );
+
+	for( i = 2; i < (int)( sizeof( blocks ) / sizeof( blocks[0] )); i++ )
+	{
+		size_t size = 1 + i % 600;
+
+		if( blocks[i][0] != (byte)i || blocks[i][size - 1] != (byte)i )
+			break;
+	}
+	TASSERT_EQi( i, (int)( sizeof( blocks ) / sizeof( blocks[0] )));
+
+	big = Mem_Malloc( poolptr, 100000 );
+	Mem_Check();
+
+	Mem_EmptyPool( poolptr );
+	TASSERT_EQi( (int)pool->totalsize, 0 );
+	TASSERT( pool->chain == NULL );
+	TASSERT( !Mem_IsAllocatedExt( poolptr, big ));
+
+	Mem_FreePool( &poolptr );
+}
+
+static void Test_Arena( void )
+{
+	poolhandle_t poolptr = Mem_AllocPoolExt( "Arena Test", MEMPOOL_ARENA );
+	poolhandle_t otherptr = Mem_AllocPool( "Arena Test 2" );
+	mempool_t *pool = Mem_FindPool( poolptr );
+	char *strings[4096], *temp;
+	int i;
+#if !XASH_MEM_DEBUG
+	size_t used;
+#endif
+
+	for( i = 0; i < (int)( sizeof( strings ) / sizeof( strings[0] )); i++ )
+	{
+		strings[i] = Mem_Malloc( poolptr, 16 );
+		Q_snprintf( strings[i], 16, "string %i", i );
+	}
+
+#if !XASH_MEM_DEBUG
+	TASSERT( pool->chunks[MEM_ARENA_CHUNKS] != NULL );
+	TASSERT( pool->chain == NULL );
+
+	// last block is given back
+	used = pool->chunks[MEM_ARENA_CHUNKS]->used;
+	temp = Mem_Malloc( poolptr, 100 );
+	Mem_Free( temp );
+	TASSERT_EQi( (int)pool->chunks[MEM_ARENA_CHUNKS]->used, (int)used );
+
+	// and can grow in place
+	temp = Mem_Malloc( poolptr, 100 );
+	TASSERT( Mem_Realloc( poolptr, temp, 200 ) == temp );
+#endif
+
+	// moving to another pool
+	strings[0] = Mem_Realloc( otherptr, strings[0], 32 );
+	TASSERT_STR( strings[0], "string 0" );
+	TASSERT( Mem_IsAllocatedExt( otherptr, strings[0] ));
+
+	for( i = 1; i < (int)( sizeof( strings ) / sizeof( strings[0] )); i++ )
+	{
+		char expected[16];
+
+		Q_snprintf( expected, sizeof( expected ), "string %i", i );
+		if( Q_strcmp( strings[i], expected ))
+			break;
+	}
+	TASSERT_EQi( i, (int)( sizeof( strings ) / sizeof( strings[0] )));
+
+	// large blocks aren't packed
+	temp = Mem_Malloc( poolptr, MEM_ARENA_MAX_SIZE );
+	TASSERT( pool->chain != NULL );
+	Mem_Check();
+
+	Mem_EmptyPool( poolptr );
+	TASSERT_EQi( (int)pool->totalsize, 0 );
+	TASSERT( pool->chunks[MEM_ARENA_CHUNKS] == NULL );
+	TASSERT_STR( strings[0], "string 0" );
+
+	Mem_FreePool( &poolptr );
+	Mem_FreePool( &otherptr );
+}
+
+static memsite_t *Test_FindSite( int fileline )
+{
+	size_t i;
+
+	for( i = 0; i < mem_profiler.size; i++ )
+	{
+		if( mem_profiler.sites[i].filename && mem_profiler.sites[i].fileline == fileline )
+			return &mem_profiler.sites[i];
+	}
+
+	return NULL;
+}
+
+static void Test_Profiler( void )
+{
+	poolhandle_t poolptr = Mem_AllocPool( "Profiler Test" );
+	poolhandle_t arenaptr = Mem_AllocPoolExt( "Profiler Test 2", MEMPOOL_ARENA );
+	memsnapshot_t *snapshot1, *snapshot2;
+	size_t count1, count2, i;
+	memsite_t *site, *arenasite;
+	int line = __LINE__ + 6;
+	void *blocks[64];
+
+	Mem_ProfileStart();
+
+	for( i = 0; i < 64; i++ )
+		blocks[i] = _Mem_Alloc( i & 1 ? arenaptr : poolptr, 100 + i * 100, false, __FILE__, line + ( i & 1 ));
+
+	site = Test_FindSite( line );
+	arenasite = Test_FindSite( line + 1 );
+	TASSERT( site != NULL && arenasite != NULL );
+	if( !site || !arenasite )
+		return;
+
+	TASSERT_EQi( site->count, 32 );
+	TASSERT_EQi( site->allocs, 32 );
+	TASSERT_STR( site->pool, "Profiler Test" );
+
+	for( i = 0; i < 64; i += 4 )
+		Mem_Free( blocks[i] );
+
+	TASSERT_EQi( site->count, 16 );
+	TASSERT_EQi( site->peak > site->live, true );
+
+	// realloc moves the block to the new call site
+	blocks[2] = Mem_Realloc( poolptr, blocks[2], 100000 );
+	TASSERT_EQi( site->count, 15 );
+
+	Mem_ProfileWrite( "memprofile_test1.txt" );
+
+	// blocks dropped with arena chunks are counted too
+	Mem_EmptyPool( arenaptr );
+	TASSERT_EQi( arenasite->count, 0 );
+	TASSERT_EQi( (int)arenasite->live, 0 );
+
+	Mem_ProfileWrite( "memprofile_test2.txt" );
+
+	snapshot1 = Mem_ProfileRead( "memprofile_test1.txt", &count1 );
+	snapshot2 = Mem_ProfileRead( "memprofile_test2.txt", &count2 );
+	TASSERT( snapshot1 != NULL && snapshot2 != NULL );
+	TASSERT_EQi( count1 > 0 && count1 == count2, true );
+
+	for( i = 0; snapshot1 && snapshot2 && i < count1; i++ )
+	{
+		if( Q_strstr( snapshot1[i].key, "Profiler Test 2" ))
+		{
+			TASSERT_EQi( snapshot1[i].count, 32 );
+			TASSERT_EQi( snapshot2[i].count, 0 );
+		}
+	}
+
+	if( snapshot1 ) Mem_Free( snapshot1 );
+	if( snapshot2 ) Mem_Free( snapshot2 );
+	FS_Delete( "memprofile_test1.txt" );
+	FS_Delete( "memprofile_test2.txt" );
+
+	Mem_FreePool( &poolptr );
+	TASSERT_EQi( site->poolptr, 0 );
+	Mem_FreePool( &arenaptr );
+
+	Mem_ProfileStop();
+}
+
+void Test_RunZone( void )
+{
+	TRUN( Test_Slabs() );
+	TRUN( Test_Arena() );
+	TRUN( Test_Profiler() );
+}
+#endif
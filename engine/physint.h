@@ -115,6 +115,11 @@ typedef struct server_physics_api_s
 
 	// FWGS extension
 	void       *(*pfnGetNativeObject)( const char *object );
+
+	// moves with the same size and filter, start and end are count * 3 floats.
+	// traces are the same as from pfnTrace for every move, but ShouldCollide
+	// may be called for a different set of entities
+	void		(*pfnTraceBatch)( int count, const float *start, const float *end, float *mins, float *maxs, int type, edict_t *e, trace_t *traces );
 } server_physics_api_t;
 
 // physic callbacks
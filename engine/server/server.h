@@ -186,6 +186,10 @@ typedef struct server_s
 	int		ignored_static_ents;
 	int		ignored_world_decals;
 	int		static_ents_overflow;
+	int		visited_ents;	// passed to AddToFullPack during last frame
+	int		accepted_ents;	// and how many of them was accepted
+	int		recvcalls;	// socket syscalls made since previous frame
+	int		sendcalls;
 } server_t;
 
 typedef struct
@@ -407,8 +411,15 @@ extern convar_t		sv_unlag;
 extern convar_t		sv_maxunlag;
 extern convar_t		sv_unlagpush;
 extern convar_t		sv_unlagsamples;
+extern convar_t		sv_unlaghistory;
 extern convar_t		rcon_enable;
 extern convar_t		sv_instancedbaseline;
+extern convar_t		sv_parallel_snapshots;
+extern convar_t		sv_entity_index;
+extern convar_t		sv_area_tree;
+extern convar_t		sv_deltacache;
+extern convar_t		sv_ratelimit;
+extern convar_t		sv_ratelimit_burst;
 extern convar_t		sv_background_freeze;
 extern convar_t		sv_minupdaterate;
 extern convar_t		sv_maxupdaterate;
@@ -489,6 +500,7 @@ void SV_RemoteCommand( netadr_t from, sizebuf_t *msg );
 void SV_SendResource( resource_t *pResource, sizebuf_t *msg );
 void SV_AddToMaster( netadr_t from, sizebuf_t *msg );
 qboolean SV_ProcessUserAgent( netadr_t from, const char *useragent );
+void SV_Latency_f( void );
 
 //
 // sv_init.c
@@ -529,6 +541,7 @@ void SV_ClientPrintf( sv_client_t *cl, const char *fmt, ... ) FORMAT_CHECK( 2 );
 //
 // sv_client.c
 //
+sv_client_t *SV_ClientFromAddress( netadr_t from, int qport );
 void SV_RefreshUserinfo( void );
 void SV_TogglePause( const char *msg );
 qboolean SV_ShouldUpdatePing( sv_client_t *cl );
@@ -588,6 +601,7 @@ void SV_RequestMissingResources( void );
 void SV_InitFilter( void );
 qboolean SV_CheckIP( netadr_t *adr );
 qboolean SV_CheckID( const char *id );
+qboolean SV_CheckRateLimit( netadr_t *adr );
 
 //
 // sv_frame.c
@@ -595,6 +609,8 @@ qboolean SV_CheckID( const char *id );
 void SV_InactivateClients( void );
 int SV_FindBestBaselineForStatic( int index, entity_state_t **baseline, entity_state_t *to );
 void SV_SkipUpdates( void );
+void SV_FreeSnapshots( void );
+void SV_SnapshotBench_f( void );
 
 //
 // sv_game.c
@@ -673,6 +689,9 @@ void SV_ClearGameState( void );
 void SV_InitClientMove( void );
 qboolean SV_PlayerIsFrozen( edict_t *pClient );
 void SV_RunCmd( sv_client_t *cl, usercmd_t *ucmd, int random_seed );
+void SV_ClearUnlagHistory( void );
+void SV_RecordUnlagHistory( void );
+void SV_UnlagBench_f( void );
 
 //
 // sv_world.c
@@ -682,11 +701,19 @@ void SV_UnlinkEdict( edict_t *ent );
 void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
 void SV_CustomClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
 trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip );
+void SV_MoveBatch( int count, const vec3_t *start, const vec3_t *end, vec3_t mins, vec3_t maxs, int type, edict_t *e, qboolean monsterclip, trace_t *traces );
+void SV_TraceRecord_f( void );
+void SV_TraceBench_f( void );
 trace_t SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e );
 const char *SV_TraceTexture( edict_t *ent, const vec3_t start, const vec3_t end );
 msurface_t *SV_TraceSurface( edict_t *ent, const vec3_t start, const vec3_t end );
 trace_t SV_MoveToss( edict_t *tossent, edict_t *ignore );
 void SV_LinkEdict( edict_t *ent, qboolean touch_triggers );
+void SV_ResetEdictIndex( edict_t *ent );
+void SV_FreeEntityIndex( void );
+void SV_FreeAreaTree( void );
+void SV_UpdateAreaStats( void );
+qboolean SV_EntityIndexCandidates( const byte *pvs, uint32_t *candidates );
 int SV_TruePointContents( const vec3_t p );
 int SV_PointContents( const vec3_t p );
 void SV_SetLightStyle( int style, const char* s, float f );
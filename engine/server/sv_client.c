@@ -41,11 +41,139 @@ typedef struct ucmd_s
 	qboolean		(*func)( sv_client_t *cl );
 } ucmd_t;
 
+#define CLIENT_HASH_SIZE	64	// must be power of two
+#define CHALLENGE_HASH_SIZE	MAX_CHALLENGES
+
+// client slots by base address and qport, see SV_ClientFromAddress
+static struct
+{
+	int		buckets[CLIENT_HASH_SIZE];	// slot + 1, zero means empty
+	int		next[MAX_CLIENTS];
+	int		bucket[MAX_CLIENTS];
+	qboolean		linked[MAX_CLIENTS];
+} sv_clienthash;
+
+// svs.challenges by full address
+static struct
+{
+	int		buckets[CHALLENGE_HASH_SIZE];	// challenge + 1, zero means empty
+	int		next[MAX_CHALLENGES];
+	int		bucket[MAX_CHALLENGES];
+	qboolean		linked[MAX_CHALLENGES];
+	int		oldest;	// challenges are replaced in the order they were made
+} sv_challengehash;
+
 static int	g_userid = 1;
 
 static void SV_UserinfoChanged( sv_client_t *cl );
 static void SV_ExecuteClientCommand( sv_client_t *cl, const char *s );
 
+/*
+=================
+SV_UnlinkClientAddress
+=================
+*/
+static void SV_UnlinkClientAddress( int slot )
+{
+	int	*link;
+
+	if( !sv_clienthash.linked[slot] )
+		return;
+
+	for( link = &sv_clienthash.buckets[sv_clienthash.bucket[slot]]; *link; link = &sv_clienthash.next[*link - 1] )
+	{
+		if( *link == slot + 1 )
+		{
+			*link = sv_clienthash.next[slot];
+			break;
+		}
+	}
+
+	sv_clienthash.linked[slot] = false;
+}
+
+/*
+=================
+SV_LinkClientAddress
+
+must be called every time client netchan gets new address
+=================
+*/
+static void SV_LinkClientAddress( sv_client_t *cl )
+{
+	int	slot = cl - svs.clients;
+	int	bucket;
+
+	SV_UnlinkClientAddress( slot );
+
+	bucket = ( NET_HashBaseAdr( cl->netchan.remote_address ) ^ cl->netchan.qport ) & ( CLIENT_HASH_SIZE - 1 );
+	sv_clienthash.next[slot] = sv_clienthash.buckets[bucket];
+	sv_clienthash.buckets[bucket] = slot + 1;
+	sv_clienthash.bucket[slot] = bucket;
+	sv_clienthash.linked[slot] = true;
+}
+
+/*
+=================
+SV_ClientFromAddress
+
+finds connected client that sent a sequenced packet,
+slots that were freed since they were linked are dropped here
+=================
+*/
+sv_client_t *SV_ClientFromAddress( netadr_t from, int qport )
+{
+	int		bucket = ( NET_HashBaseAdr( from ) ^ qport ) & ( CLIENT_HASH_SIZE - 1 );
+	int		slot, next;
+	sv_client_t	*cl;
+
+	for( slot = sv_clienthash.buckets[bucket] - 1; slot >= 0; slot = next )
+	{
+		next = sv_clienthash.next[slot] - 1;
+
+		if( slot >= svs.maxclients || svs.clients[slot].state == cs_free || FBitSet( svs.clients[slot].flags, FCL_FAKECLIENT ))
+		{
+			SV_UnlinkClientAddress( slot );
+			continue;
+		}
+
+		cl = &svs.clients[slot];
+
+		if( cl->netchan.qport == qport && NET_CompareBaseAdr( from, cl->netchan.remote_address ))
+			return cl;
+	}
+
+	return NULL;
+}
+
+/*
+=================
+SV_LinkChallenge
+=================
+*/
+static void SV_LinkChallenge( int i )
+{
+	int	*link, bucket;
+
+	if( sv_challengehash.linked[i] )
+	{
+		for( link = &sv_challengehash.buckets[sv_challengehash.bucket[i]]; *link; link = &sv_challengehash.next[*link - 1] )
+		{
+			if( *link == i + 1 )
+			{
+				*link = sv_challengehash.next[i];
+				break;
+			}
+		}
+	}
+
+	bucket = NET_HashAdr( svs.challenges[i].adr ) & ( CHALLENGE_HASH_SIZE - 1 );
+	sv_challengehash.next[i] = sv_challengehash.buckets[bucket];
+	sv_challengehash.buckets[bucket] = i + 1;
+	sv_challengehash.bucket[i] = bucket;
+	sv_challengehash.linked[i] = true;
+}
+
 /*
 =================
 SV_GetPlayerCount
@@ -88,32 +216,26 @@ challenge, they must give a valid IP address.
 */
 static void SV_GetChallenge( netadr_t from )
 {
-	int	i, oldest = 0;
-	double	oldestTime;
-
-	oldestTime = 0x7fffffff;
+	int	i, bucket = NET_HashAdr( from ) & ( CHALLENGE_HASH_SIZE - 1 );
 
 	// see if we already have a challenge for this ip
-	for( i = 0; i < MAX_CHALLENGES; i++ )
+	for( i = sv_challengehash.buckets[bucket] - 1; i >= 0; i = sv_challengehash.next[i] - 1 )
 	{
 		if( !svs.challenges[i].connected && NET_CompareAdr( from, svs.challenges[i].adr ))
 			break;
-
-		if( svs.challenges[i].time < oldestTime )
-		{
-			oldestTime = svs.challenges[i].time;
-			oldest = i;
-		}
 	}
 
-	if( i == MAX_CHALLENGES )
+	if( i < 0 )
 	{
 		// this is the first time this client has asked for a challenge
-		svs.challenges[oldest].challenge = (COM_RandomLong( 0, 0x7FFF ) << 16) | COM_RandomLong( 0, 0xFFFF );
-		svs.challenges[oldest].adr = from;
-		svs.challenges[oldest].time = host.realtime;
-		svs.challenges[oldest].connected = false;
-		i = oldest;
+		i = sv_challengehash.oldest;
+		sv_challengehash.oldest = ( i + 1 ) % MAX_CHALLENGES;
+
+		svs.challenges[i].challenge = (COM_RandomLong( 0, 0x7FFF ) << 16) | COM_RandomLong( 0, 0xFFFF );
+		svs.challenges[i].adr = from;
+		svs.challenges[i].time = host.realtime;
+		svs.challenges[i].connected = false;
+		SV_LinkChallenge( i );
 	}
 
 	// send it back
@@ -211,14 +333,16 @@ Make sure connecting client is not spoofing
 */
 static int SV_CheckChallenge( netadr_t from, int challenge )
 {
-	int	i;
+	int	i, bucket;
 
 	// see if the challenge is valid
 	// don't care if it is a local address.
 	if( NET_IsLocalAddress( from ))
 		return 1;
 
-	for( i = 0; i < MAX_CHALLENGES; i++ )
+	bucket = NET_HashAdr( from ) & ( CHALLENGE_HASH_SIZE - 1 );
+
+	for( i = sv_challengehash.buckets[bucket] - 1; i >= 0; i = sv_challengehash.next[i] - 1 )
 	{
 		if( NET_CompareAdr( from, svs.challenges[i].adr ))
 		{
@@ -232,7 +356,7 @@ static int SV_CheckChallenge( netadr_t from, int challenge )
 		}
 	}
 
-	if( i == MAX_CHALLENGES )
+	if( i < 0 )
 	{
 		SV_RejectConnection( from, "no challenge for your address\n" );
 		return 0;
@@ -432,6 +556,7 @@ static void SV_ConnectClient( netadr_t from )
 
 	// initailize netchan
 	Netchan_Setup( NS_SERVER, &newcl->netchan, from, qport, newcl, SV_GetFragmentSize, 0 );
+	SV_LinkClientAddress( newcl );
 	MSG_Init( &newcl->datagram, "Datagram", newcl->datagram_buf, sizeof( newcl->datagram_buf )); // datagram buf
 
 	Q_strncpy( newcl->hashedcdkey, Info_ValueForKey( protinfo, "uuid" ), 32 );
@@ -3105,6 +3230,28 @@ static void SV_ExecuteClientCommand( sv_client_t *cl, const char *s )
 	}
 }
 
+/*
+=================
+SV_IsRateLimitedCommand
+
+connectionless commands that are expensive to answer
+or can be used for floods, see SV_CheckRateLimit
+=================
+*/
+static qboolean SV_IsRateLimitedCommand( const char *pcmd )
+{
+	if( !Q_strcmp( pcmd, C2S_GETCHALLENGE ) || !Q_strcmp( pcmd, C2S_CONNECT ) || !Q_strcmp( pcmd, C2S_RCON ))
+		return true;
+
+	if( !Q_strcmp( pcmd, A2S_GOLDSRC_INFO ) || pcmd[0] == A2S_GOLDSRC_PLAYERS || pcmd[0] == A2S_GOLDSRC_RULES )
+		return true;
+
+	if( !Q_strcmp( pcmd, A2A_INFO ) || !Q_strcmp( pcmd, A2A_NETINFO ))
+		return true;
+
+	return false;
+}
+
 /*
 =================
 SV_ConnectionlessPacket
@@ -3134,6 +3281,9 @@ void SV_ConnectionlessPacket( netadr_t from, sizebuf_t *msg )
 	if( sv_log_outofband.value )
 		Con_Reportf( "%s: %s : %s\n", __func__, NET_AdrToString( from ), pcmd );
 
+	if( SV_IsRateLimitedCommand( pcmd ) && SV_CheckRateLimit( &from ))
+		return;
+
 	if( !svs.initialized )
 	{
 		// only process rcon if server not initialized
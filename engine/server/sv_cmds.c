@@ -637,6 +637,7 @@ static void SV_Status_f( void )
 	}
 
 	Con_Printf( "map: %s\n", sv.name );
+	Con_Printf( "net: %i recv, %i send syscalls per frame\n", sv.recvcalls, sv.sendcalls );
 	Con_Printf( "num score ping    name            lastmsg address               port \n" );
 	Con_Printf( "--- ----- ------- --------------- ------- --------------------- ------\n" );
 
@@ -885,6 +886,8 @@ static void SV_EdictUsage_f( void )
 	Con_Printf( "%5i edicts is used\n", active );
 	Con_Printf( "%5i edicts is free\n", GI->max_edicts - active );
 	Con_Printf( "%5i total\n", GI->max_edicts );
+	Con_Printf( "%5i visited, %i accepted by AddToFullPack in last frame (sv_entity_index %s)\n",
+		sv.visited_ents, sv.accepted_ents, sv_entity_index.value ? "on" : "off" );
 }
 
 /*
@@ -1006,6 +1009,11 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "logaddress", SV_SetLogAddress_f, "sets address and port for remote logging host" );
 	Cmd_AddCommand( "log", SV_ServerLog_f, "enables logging to file" );
 	Cmd_AddCommand( "str64stats", SV_PrintStr64Stats_f, "print engine pool string statistics" );
+	Cmd_AddCommand( "sv_snapshot_bench", SV_SnapshotBench_f, "compare serial and parallel client snapshots building time" );
+	Cmd_AddCommand( "sv_trace_record", SV_TraceRecord_f, "record entity traces to file, no arguments stops recording" );
+	Cmd_AddCommand( "sv_trace_bench", SV_TraceBench_f, "replay recorded traces one by one and batched, compare results and time" );
+	Cmd_AddCommand( "sv_unlag_bench", SV_UnlagBench_f, "replay lag compensation of recent usercmds with client frames and with position history" );
+	Cmd_AddCommand( "sv_latency", SV_Latency_f, "print packet arrival to processing latency histogram, \"reset\" clears it" );
 
 	if( host.type == HOST_NORMAL )
 	{
@@ -1045,6 +1053,11 @@ void SV_KillOperatorCommands( void )
 	Cmd_RemoveCommand( "logaddress" );
 	Cmd_RemoveCommand( "log" );
 	Cmd_RemoveCommand( "str64stats" );
+	Cmd_RemoveCommand( "sv_snapshot_bench" );
+	Cmd_RemoveCommand( "sv_trace_record" );
+	Cmd_RemoveCommand( "sv_trace_bench" );
+	Cmd_RemoveCommand( "sv_unlag_bench" );
+	Cmd_RemoveCommand( "sv_latency" );
 
 	if( host.type == HOST_NORMAL )
 	{
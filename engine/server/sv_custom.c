@@ -193,6 +193,13 @@ void SV_ParseConsistencyResponse( sv_client_t *cl, sizebuf_t *msg )
 	}
 }
 
+static void SV_ConsistencyFilePath( const resource_t *pResource, char *filepath, size_t size )
+{
+	if( pResource->type == t_sound )
+		Q_snprintf( filepath, size, DEFAULT_SOUNDPATH "%s", pResource->szFileName );
+	else Q_strncpy( filepath, pResource->szFileName, size );
+}
+
 void SV_TransferConsistencyInfo( void )
 {
 	vec3_t		mins, maxs;
@@ -201,6 +208,18 @@ void SV_TransferConsistencyInfo( void )
 	string		filepath;
 	consistency_t	*pc;
 
+	// let the filesystem hash the files that aren't in its cache in background
+	for( i = 0; i < sv.num_resources; i++ )
+	{
+		pResource = &sv.resources[i];
+
+		if( FBitSet( pResource->ucFlags, RES_CHECKFILE ) || !SV_FileInConsistencyList( pResource->szFileName, NULL ))
+			continue;
+
+		SV_ConsistencyFilePath( pResource, filepath, sizeof( filepath ));
+		FS_PrecacheFileHash( filepath, false );
+	}
+
 	for( i = 0; i < sv.num_resources; i++ )
 	{
 		pResource = &sv.resources[i];
@@ -213,9 +232,7 @@ void SV_TransferConsistencyInfo( void )
 
 		SetBits( pResource->ucFlags, RES_CHECKFILE );
 
-		if( pResource->type == t_sound )
-			Q_snprintf( filepath, sizeof( filepath ), DEFAULT_SOUNDPATH "%s", pResource->szFileName );
-		else Q_strncpy( filepath, pResource->szFileName, sizeof( filepath ));
+		SV_ConsistencyFilePath( pResource, filepath, sizeof( filepath ));
 
 		MD5_HashFile( pResource->rgucMD5_hash, filepath, NULL );
 
@@ -16,22 +16,185 @@ GNU General Public License for more details.
 #include "common.h"
 #include "server.h"
 
+typedef struct cidfilter_s
+{
+	float endTime;
+	int heapindex; // in sv_filtertimers, -1 for permanent bans
+	struct cidfilter_s *next;
+	string id;
+} cidfilter_t;
+
+typedef struct ipfilter_s
+{
+	float endTime;
+	int heapindex;
+	struct ipfilter_s *next;
+	netadr_t adr;
+	uint prefixlen;
+} ipfilter_t;
+
+static cidfilter_t *cidfilter = NULL;
+static ipfilter_t *ipfilter = NULL;
+
+static void SV_ExpireIDFilter( cidfilter_t *filter );
+static void SV_ExpireIPFilter( ipfilter_t *filter );
 
 /*
 =============================================================================
 
-PLAYER ID FILTER
+FILTER EXPIRATION
 
 =============================================================================
 */
-typedef struct cidfilter_s
+typedef struct
 {
 	float endTime;
-	struct cidfilter_s *next;
-	string id;
-} cidfilter_t;
+	cidfilter_t *id;
+	ipfilter_t *ip;
+} filtertimer_t;
 
-static cidfilter_t *cidfilter = NULL;
+// binary min-heap of temporary bans, soonest to expire is first
+static struct
+{
+	filtertimer_t *timers;
+	int count;
+	int maxcount;
+} sv_filtertimers;
+
+static void SV_SetTimerIndex( int index )
+{
+	filtertimer_t *t = &sv_filtertimers.timers[index];
+
+	if( t->id ) t->id->heapindex = index;
+	else t->ip->heapindex = index;
+}
+
+static void SV_SwapTimers( int a, int b )
+{
+	filtertimer_t tmp = sv_filtertimers.timers[a];
+
+	sv_filtertimers.timers[a] = sv_filtertimers.timers[b];
+	sv_filtertimers.timers[b] = tmp;
+	SV_SetTimerIndex( a );
+	SV_SetTimerIndex( b );
+}
+
+static void SV_SiftTimer( int index )
+{
+	filtertimer_t *timers = sv_filtertimers.timers;
+
+	// up
+	while( index > 0 && timers[index].endTime < timers[( index - 1 ) / 2].endTime )
+	{
+		SV_SwapTimers( index, ( index - 1 ) / 2 );
+		index = ( index - 1 ) / 2;
+	}
+
+	// down
+	while( true )
+	{
+		int child = index * 2 + 1;
+
+		if( child >= sv_filtertimers.count )
+			break;
+
+		if( child + 1 < sv_filtertimers.count && timers[child + 1].endTime < timers[child].endTime )
+			child++;
+
+		if( timers[index].endTime <= timers[child].endTime )
+			break;
+
+		SV_SwapTimers( index, child );
+		index = child;
+	}
+}
+
+static void SV_AddFilterTimer( float endTime, cidfilter_t *id, ipfilter_t *ip )
+{
+	filtertimer_t *t;
+
+	if( sv_filtertimers.count == sv_filtertimers.maxcount )
+	{
+		sv_filtertimers.maxcount = Q_max( 64, sv_filtertimers.maxcount * 2 );
+		sv_filtertimers.timers = Mem_Realloc( host.mempool, sv_filtertimers.timers, sizeof( *t ) * sv_filtertimers.maxcount );
+	}
+
+	t = &sv_filtertimers.timers[sv_filtertimers.count++];
+	t->endTime = endTime;
+	t->id = id;
+	t->ip = ip;
+
+	SV_SetTimerIndex( sv_filtertimers.count - 1 );
+	SV_SiftTimer( sv_filtertimers.count - 1 );
+}
+
+static void SV_RemoveFilterTimer( int index )
+{
+	int last = --sv_filtertimers.count;
+
+	if( index != last )
+	{
+		SV_SwapTimers( index, last );
+		SV_SiftTimer( index );
+	}
+}
+
+/*
+=================
+SV_ExpireFilters
+
+removes temporary bans that are over, so lookups
+don't have to check the time of every entry
+=================
+*/
+static void SV_ExpireFilters( void )
+{
+	while( sv_filtertimers.count && host.realtime > sv_filtertimers.timers[0].endTime )
+	{
+		filtertimer_t t = sv_filtertimers.timers[0];
+
+		// removes the timer as well
+		if( t.id ) SV_ExpireIDFilter( t.id );
+		else SV_ExpireIPFilter( t.ip );
+	}
+}
+
+static void SV_ClearFilterTimers( void )
+{
+	if( sv_filtertimers.timers )
+		Mem_Free( sv_filtertimers.timers );
+	memset( &sv_filtertimers, 0, sizeof( sv_filtertimers ));
+}
+
+/*
+=============================================================================
+
+PLAYER ID FILTER
+
+=============================================================================
+*/
+static void SV_FreeIDFilter( cidfilter_t *filter )
+{
+	if( filter->heapindex >= 0 )
+		SV_RemoveFilterTimer( filter->heapindex );
+	Mem_Free( filter );
+}
+
+static void SV_ExpireIDFilter( cidfilter_t *filter )
+{
+	cidfilter_t **back;
+
+	for( back = &cidfilter; *back; back = &(*back)->next )
+	{
+		if( *back == filter )
+		{
+			*back = filter->next;
+			break;
+		}
+	}
+
+	SV_FreeIDFilter( filter );
+}
 
 static void SV_RemoveID( const char *id )
 {
@@ -48,44 +211,33 @@ static void SV_RemoveID( const char *id )
 		if( filter == cidfilter )
 		{
 			cidfilter = cidfilter->next;
-			Mem_Free( filter );
+			SV_FreeIDFilter( filter );
 			return;
 		}
 
 		if( prevfilter )
 		prevfilter->next = filter->next;
-		Mem_Free( filter );
+		SV_FreeIDFilter( filter );
 		return;
 	}
 }
 
 qboolean SV_CheckID( const char *id )
 {
-	qboolean ret = false;
 	cidfilter_t *filter;
+	int len1 = Q_strlen( id );
+
+	SV_ExpireFilters();
 
 	for( filter = cidfilter; filter; filter = filter->next )
 	{
-		int len1 = Q_strlen( id ), len2 = Q_strlen( filter->id );
-		int len = Q_min( len1, len2 );
-
-		while( filter->endTime && host.realtime > filter->endTime )
-		{
-			char *fid = filter->id;
-			filter = filter->next;
-			SV_RemoveID( fid );
-			if( !filter )
-				return false;
-		}
+		int len = Q_min( len1, Q_strlen( filter->id ));
 
 		if( !Q_strncmp( id, filter->id, len ))
-		{
-			ret = true;
-			break;
-		}
+			return true;
 	}
 
-	return ret;
+	return false;
 }
 
 static void SV_BanID_f( void )
@@ -166,10 +318,14 @@ static void SV_BanID_f( void )
 
 	filter = Mem_Malloc( host.mempool, sizeof( cidfilter_t ));
 	filter->endTime = time;
+	filter->heapindex = -1;
 	filter->next = cidfilter;
 	Q_strncpy( filter->id, id, sizeof( filter->id ));
 	cidfilter = filter;
 
+	if( filter->endTime )
+		SV_AddFilterTimer( filter->endTime, filter, NULL );
+
 	if( cl && !Q_stricmp( Cmd_Argv( Cmd_Argc() - 1 ), "kick" ))
 		Cbuf_AddTextf( "kick #%d \"Kicked and banned\"\n", cl->userid );
 }
@@ -178,6 +334,8 @@ static void SV_ListID_f( void )
 {
 	cidfilter_t *filter;
 
+	SV_ExpireFilters();
+
 	Con_Reportf( "id ban list\n" );
 	Con_Reportf( "-----------\n" );
 
@@ -262,7 +420,7 @@ static void SV_ShutdownIDFilter( void )
 	for( cidList = cidfilter; cidList; cidList = cidNext )
 	{
 		cidNext = cidList->next;
-		Mem_Free( cidList );
+		SV_FreeIDFilter( cidList );
 	}
 
 	cidfilter = NULL;
@@ -276,15 +434,202 @@ CLIENT IP FILTER
 =============================================================================
 */
 
-typedef struct ipfilter_s
+// binary prefix trie over address bits, every filter in the list
+// is counted in the node at the end of its prefix
+typedef struct
 {
-	float endTime;
-	struct ipfilter_s *next;
-	netadr_t adr;
-	uint prefixlen;
-} ipfilter_t;
+	int child[2]; // zero is none
+	int count; // filters with exactly this prefix
+} ipnode_t;
 
-static ipfilter_t *ipfilter = NULL;
+static struct
+{
+	ipnode_t *nodes; // first one is never used
+	int numnodes;
+	int maxnodes;
+	int freenodes; // linked through child[0]
+	int roots[2]; // IPv4, IPv6
+} sv_iptrie;
+
+static int SV_AllocIPNode( void )
+{
+	int node;
+
+	if( sv_iptrie.freenodes )
+	{
+		node = sv_iptrie.freenodes;
+		sv_iptrie.freenodes = sv_iptrie.nodes[node].child[0];
+	}
+	else
+	{
+		if( sv_iptrie.numnodes == sv_iptrie.maxnodes )
+		{
+			sv_iptrie.maxnodes = Q_max( 256, sv_iptrie.maxnodes * 2 );
+			sv_iptrie.nodes = Mem_Realloc( host.mempool, sv_iptrie.nodes, sizeof( ipnode_t ) * sv_iptrie.maxnodes );
+		}
+
+		if( sv_iptrie.numnodes == 0 )
+			sv_iptrie.numnodes = 1; // reserve null node
+
+		node = sv_iptrie.numnodes++;
+	}
+
+	memset( &sv_iptrie.nodes[node], 0, sizeof( ipnode_t ));
+	return node;
+}
+
+/*
+=================
+SV_IPTrieAddress
+
+returns address bytes in network order and how many bits
+there are, or NULL for addresses that can't be filtered
+=================
+*/
+static const uint8_t *SV_IPTrieAddress( const netadr_t *adr, int *family, int *numbits )
+{
+	switch( adr->type6 )
+	{
+	case NA_IP:
+		*family = 0;
+		*numbits = 32;
+		return adr->ip;
+	case NA_IP6:
+		*family = 1;
+		*numbits = 128;
+		return adr->ip6;
+	}
+
+	return NULL;
+}
+
+static void SV_IPTrieInsert( const ipfilter_t *f, int delta )
+{
+	int path[129], depth, family, numbits, node, bit;
+	const uint8_t *bytes = SV_IPTrieAddress( &f->adr, &family, &numbits );
+	int prefixlen = f->prefixlen;
+
+	if( !bytes )
+		return;
+
+	prefixlen = Q_min( prefixlen, numbits );
+
+	if( !sv_iptrie.roots[family] )
+		sv_iptrie.roots[family] = SV_AllocIPNode();
+
+	path[0] = node = sv_iptrie.roots[family];
+
+	for( depth = 0; depth < prefixlen; depth++ )
+	{
+		bit = ( bytes[depth >> 3] >> ( 7 - ( depth & 7 ))) & 1;
+
+		if( !sv_iptrie.nodes[node].child[bit] )
+		{
+			int newnode;
+
+			if( delta < 0 )
+				return; // wasn't inserted
+
+			newnode = SV_AllocIPNode();
+			sv_iptrie.nodes[node].child[bit] = newnode;
+		}
+
+		path[depth + 1] = node = sv_iptrie.nodes[node].child[bit];
+	}
+
+	sv_iptrie.nodes[node].count += delta;
+
+	// release nodes that lead to nothing
+	for( ; delta < 0 && depth > 0; depth-- )
+	{
+		ipnode_t *n = &sv_iptrie.nodes[path[depth]];
+
+		if( n->count || n->child[0] || n->child[1] )
+			break;
+
+		bit = ( bytes[( depth - 1 ) >> 3] >> ( 7 - (( depth - 1 ) & 7 ))) & 1;
+		sv_iptrie.nodes[path[depth - 1]].child[bit] = 0;
+
+		n->child[0] = sv_iptrie.freenodes;
+		sv_iptrie.freenodes = path[depth];
+	}
+}
+
+static qboolean SV_IPTrieMatch( const netadr_t *adr )
+{
+	int depth, family, numbits, node;
+	const uint8_t *bytes = SV_IPTrieAddress( adr, &family, &numbits );
+
+	if( !bytes || !sv_iptrie.roots[family] )
+		return false;
+
+	node = sv_iptrie.roots[family];
+
+	for( depth = 0; node; depth++ )
+	{
+		if( sv_iptrie.nodes[node].count > 0 )
+			return true;
+
+		if( depth == numbits )
+			break;
+
+		node = sv_iptrie.nodes[node].child[( bytes[depth >> 3] >> ( 7 - ( depth & 7 ))) & 1];
+	}
+
+	return false;
+}
+
+static void SV_ClearIPTrie( void )
+{
+	if( sv_iptrie.nodes )
+		Mem_Free( sv_iptrie.nodes );
+	memset( &sv_iptrie, 0, sizeof( sv_iptrie ));
+}
+
+static ipfilter_t *SV_AddIPFilter( const netadr_t *adr, uint prefixlen, float endTime )
+{
+	ipfilter_t *f = Mem_Malloc( host.mempool, sizeof( *f ));
+
+	f->endTime = endTime;
+	f->heapindex = -1;
+	f->adr = *adr;
+	f->prefixlen = prefixlen;
+	f->next = ipfilter;
+	ipfilter = f;
+
+	SV_IPTrieInsert( f, 1 );
+
+	if( f->endTime )
+		SV_AddFilterTimer( f->endTime, NULL, f );
+
+	return f;
+}
+
+static void SV_FreeIPFilter( ipfilter_t *f )
+{
+	SV_IPTrieInsert( f, -1 );
+
+	if( f->heapindex >= 0 )
+		SV_RemoveFilterTimer( f->heapindex );
+
+	Mem_Free( f );
+}
+
+static void SV_ExpireIPFilter( ipfilter_t *filter )
+{
+	ipfilter_t **back;
+
+	for( back = &ipfilter; *back; back = &(*back)->next )
+	{
+		if( *back == filter )
+		{
+			*back = filter->next;
+			break;
+		}
+	}
+
+	SV_FreeIPFilter( filter );
+}
 
 static int SV_FilterToString( char *dest, size_t size, qboolean config, ipfilter_t *f )
 {
@@ -337,9 +682,8 @@ static void SV_RemoveIPFilter( ipfilter_t *toremove, qboolean removeAll, qboolea
 			}
 
 			*back = f->next;
-			back = &f->next;
 
-			Mem_Free( f );
+			SV_FreeIPFilter( f );
 
 			if( !removeAll )
 				break;
@@ -351,25 +695,9 @@ static void SV_RemoveIPFilter( ipfilter_t *toremove, qboolean removeAll, qboolea
 
 qboolean SV_CheckIP( netadr_t *adr )
 {
-	// TODO: ip rate limit
-	ipfilter_t *entry = ipfilter;
+	SV_ExpireFilters();
 
-	for( ; entry; entry = entry->next )
-	{
-		if( entry->endTime && host.realtime > entry->endTime )
-			continue; // expired
-
-		switch( entry->adr.type6 )
-		{
-		case NA_IP:
-		case NA_IP6:
-			if( NET_CompareAdrByMask( *adr, entry->adr, entry->prefixlen ))
-				return true;
-			break;
-		}
-	}
-
-	return false;
+	return SV_IPTrieMatch( adr );
 }
 
 static void SV_AddIP_PrintUsage( void )
@@ -398,7 +726,7 @@ static void SV_AddIP_f( void )
 {
 	const char *szMinutes = Cmd_Argv( 1 );
 	const char *adr = Cmd_Argv( 2 );
-	ipfilter_t filter, *newfilter;
+	ipfilter_t filter;
 	float minutes;
 	int i;
 
@@ -425,13 +753,7 @@ static void SV_AddIP_f( void )
 		return;
 	}
 
-	newfilter = Mem_Malloc( host.mempool, sizeof( *newfilter ));
-	newfilter->endTime = filter.endTime;
-	newfilter->adr = filter.adr;
-	newfilter->prefixlen = filter.prefixlen;
-	newfilter->next = ipfilter;
-
-	ipfilter = newfilter;
+	SV_AddIPFilter( &filter.adr, filter.prefixlen, filter.endTime );
 
 	for( i = 0; i < svs.maxclients; i++ )
 	{
@@ -456,6 +778,8 @@ static void SV_ListIP_f( void )
 		return;
 	}
 
+	SV_ExpireFilters();
+
 	if( ipfilter == NULL )
 	{
 		Con_Printf( "IP filter list is empty\n" );
@@ -558,10 +882,111 @@ static void SV_ShutdownIPFilter( void )
 	for( ipList = ipfilter; ipList; ipList = ipNext )
 	{
 		ipNext = ipList->next;
-		Mem_Free( ipList );
+		SV_FreeIPFilter( ipList );
 	}
 
 	ipfilter = NULL;
+	SV_ClearIPTrie();
+}
+
+/*
+=============================================================================
+
+CONNECTIONLESS RATE LIMIT
+
+=============================================================================
+*/
+#define RATELIMIT_SLOTS	4096 // must be power of two
+#define RATELIMIT_PROBES	8
+
+// token bucket per address
+typedef struct
+{
+	netadr_t adr;
+	double lasttime;
+	float tokens;
+	qboolean used;
+} ratelimit_t;
+
+static struct
+{
+	ratelimit_t *slots;
+	int dropped;
+	double nextreport;
+} sv_ratelimit_state;
+
+/*
+=================
+SV_CheckRateLimit
+
+returns true if address sent too many connectionless packets
+=================
+*/
+qboolean SV_CheckRateLimit( netadr_t *adr )
+{
+	ratelimit_t *slot = NULL, *oldest = NULL;
+	float burst = Q_max( 1.0f, sv_ratelimit_burst.value );
+	uint hash;
+	int i;
+
+	if( sv_ratelimit.value <= 0.0f || NET_IsLocalAddress( *adr ))
+		return false;
+
+	if( !sv_ratelimit_state.slots )
+		sv_ratelimit_state.slots = Mem_Calloc( host.mempool, sizeof( ratelimit_t ) * RATELIMIT_SLOTS );
+
+	hash = NET_HashBaseAdr( *adr );
+
+	for( i = 0; i < RATELIMIT_PROBES; i++ )
+	{
+		ratelimit_t *s = &sv_ratelimit_state.slots[( hash + i ) & ( RATELIMIT_SLOTS - 1 )];
+
+		if( s->used && NET_CompareBaseAdr( s->adr, *adr ))
+		{
+			slot = s;
+			break;
+		}
+
+		if( !oldest || !s->used || ( oldest->used && s->lasttime < oldest->lasttime ))
+			oldest = s;
+	}
+
+	// forget about address that was quiet for the longest time
+	if( !slot )
+	{
+		slot = oldest;
+		slot->used = true;
+		slot->adr = *adr;
+		slot->tokens = burst;
+		slot->lasttime = host.realtime;
+	}
+
+	slot->tokens = Q_min( burst, slot->tokens + ( host.realtime - slot->lasttime ) * sv_ratelimit.value );
+	slot->lasttime = host.realtime;
+
+	if( slot->tokens >= 1.0f )
+	{
+		slot->tokens -= 1.0f;
+		return false;
+	}
+
+	sv_ratelimit_state.dropped++;
+
+	if( sv_ratelimit_state.nextreport < host.realtime )
+	{
+		Con_DPrintf( "%s: dropped %i packets, last from %s\n", __func__, sv_ratelimit_state.dropped, NET_AdrToString( *adr ));
+		sv_ratelimit_state.dropped = 0;
+		sv_ratelimit_state.nextreport = host.realtime + 1.0;
+	}
+
+	return true;
+}
+
+static void SV_ClearRateLimit( void )
+{
+	if( sv_ratelimit_state.slots )
+		Mem_Free( sv_ratelimit_state.slots );
+	memset( &sv_ratelimit_state, 0, sizeof( sv_ratelimit_state ));
 }
 
 void SV_InitFilter( void )
@@ -574,6 +999,8 @@ void SV_ShutdownFilter( void )
 {
 	SV_ShutdownIPFilter();
 	SV_ShutdownIDFilter();
+	SV_ClearFilterTimers();
+	SV_ClearRateLimit();
 }
 
 #if XASH_ENGINE_TESTS
@@ -699,10 +1126,126 @@ static void Test_IPFilterIncludesIPFilter( void )
 	}
 }
 
+static void Test_IPFilterTrie( void )
+{
+	const char *filters[] =
+	{
+		"10.0.0.0/8",
+		"192.168.1.0/24",
+		"192.168.1.77",
+		"2a00:1370:8190:f9eb::/62",
+	};
+	struct
+	{
+		const char *adr;
+		qboolean banned;
+	} tests[] =
+	{
+		{ "10.1.2.3", true },
+		{ "11.0.0.1", false },
+		{ "192.168.1.200", true },
+		{ "192.168.2.1", false },
+		{ "2a00:1370:8190:f9e8::1", true },
+		{ "2a00:1370:8190:f9f0::1", false },
+		{ "::1", false },
+	};
+	double oldtime = host.realtime;
+	ipfilter_t *saved = ipfilter, *f;
+	netadr_t adr;
+	uint prefixlen;
+	int i;
+
+	ipfilter = NULL;
+
+	for( i = 0; i < ARRAYSIZE( filters ); i++ )
+	{
+		NET_StringToFilterAdr( filters[i], &adr, &prefixlen );
+		SV_AddIPFilter( &adr, prefixlen, i == 1 ? host.realtime + 60.0f : 0.0f );
+	}
+
+	for( i = 0; i < ARRAYSIZE( tests ); i++ )
+	{
+		TASSERT( NET_StringToFilterAdr( tests[i].adr, &adr, &prefixlen ));
+		TASSERT_EQi( SV_CheckIP( &adr ), tests[i].banned );
+	}
+
+	// same prefix is still banned by the permanent /32 entry after /24 is expired
+	host.realtime += 120.0;
+	NET_StringToFilterAdr( "192.168.1.77", &adr, &prefixlen );
+	TASSERT_EQi( SV_CheckIP( &adr ), true );
+	NET_StringToFilterAdr( "192.168.1.78", &adr, &prefixlen );
+	TASSERT_EQi( SV_CheckIP( &adr ), false );
+	TASSERT_EQi( sv_filtertimers.count, 0 );
+
+	// removing the address drops every entry that includes it
+	NET_StringToFilterAdr( "192.168.1.77", &adr, &prefixlen );
+	{
+		ipfilter_t toremove;
+
+		toremove.adr = adr;
+		toremove.prefixlen = prefixlen;
+		SV_RemoveIPFilter( &toremove, true, false );
+	}
+	NET_StringToFilterAdr( "192.168.1.77", &adr, &prefixlen );
+	TASSERT_EQi( SV_CheckIP( &adr ), false );
+	NET_StringToFilterAdr( "10.1.2.3", &adr, &prefixlen );
+	TASSERT_EQi( SV_CheckIP( &adr ), true );
+
+	while(( f = ipfilter ) != NULL )
+	{
+		ipfilter = f->next;
+		SV_FreeIPFilter( f );
+	}
+
+	NET_StringToFilterAdr( "10.1.2.3", &adr, &prefixlen );
+	TASSERT_EQi( SV_CheckIP( &adr ), false );
+
+	host.realtime = oldtime;
+	ipfilter = saved;
+}
+
+static void Test_RateLimit( void )
+{
+	double oldtime = host.realtime;
+	float oldrate = sv_ratelimit.value, oldburst = sv_ratelimit_burst.value;
+	netadr_t a, b;
+	uint prefixlen;
+	int i, passed = 0;
+
+	NET_StringToFilterAdr( "203.0.113.5", &a, &prefixlen );
+	NET_StringToFilterAdr( "203.0.113.6", &b, &prefixlen );
+
+	// server cvars aren't registered during tests
+	sv_ratelimit.value = 2.0f;
+	sv_ratelimit_burst.value = 5.0f;
+
+	for( i = 0; i < 10; i++ )
+	{
+		if( !SV_CheckRateLimit( &a ))
+			passed++;
+	}
+
+	TASSERT_EQi( passed, 5 );
+	TASSERT_EQi( SV_CheckRateLimit( &b ), false );
+
+	// two tokens later
+	host.realtime += 1.0;
+	TASSERT_EQi( SV_CheckRateLimit( &a ), false );
+	TASSERT_EQi( SV_CheckRateLimit( &a ), false );
+	TASSERT_EQi( SV_CheckRateLimit( &a ), true );
+
+	SV_ClearRateLimit();
+	sv_ratelimit.value = oldrate;
+	sv_ratelimit_burst.value = oldburst;
+	host.realtime = oldtime;
+}
+
 void Test_RunIPFilter( void )
 {
 	Test_StringToFilterAdr();
 	Test_IPFilterIncludesIPFilter();
+	Test_IPFilterTrie();
+	Test_RateLimit();
 }
 
 #endif // XASH_ENGINE_TESTS
@@ -25,8 +25,66 @@ typedef struct
 	byte		sended[MAX_EDICTS_BYTES];
 } sv_ents_t;
 
+// cached field values of recently sent entities, see SV_FindBestBaseline
+typedef struct
+{
+	int		index;		// entity index in the frame
+	delta_keys_t	keys;
+} sv_basekeys_t;
+
+// per-client datagram, built on the main thread and
+// finished by the worker threads in parallel mode
+typedef struct
+{
+	sv_client_t	*cl;
+	client_frame_t	*frame;
+	int		next_entities;	// svs.next_client_entities to check delta against
+	qboolean		send_pings;
+	qboolean		outdated;		// delta request from out of date entities
+	sizebuf_t		msg;
+	byte		msg_buf[MAX_DATAGRAM];
+	sv_basekeys_t	basekeys[MAX_CUSTOM_BASELINES];
+} sv_snapshot_t;
+
 static int	c_fullsend;	// just a debug counter
 static int	c_notsend;
+static int	c_visited;	// AddToFullPack calls during the frame
+static int	c_accepted;
+
+static sv_snapshot_t *sv_snapshots;	// [svs.maxclients], allocated on demand
+static int		sv_num_snapshots;
+
+#define DELTACACHE_ENTRIES	2048
+#define DELTACACHE_BYTES	( 256 * 1024 )
+#define DELTACACHE_MAXBYTES	2048	// single entity delta can't be larger
+
+// entity delta, encoded once for all clients in the frame
+typedef struct
+{
+	entity_state_t	from;
+	entity_state_t	to;
+	int		type;
+	int		offset;
+	uint32_t		inactive[DELTA_MASK_WORDS];	// fields custom encoder left out
+	qboolean		force;
+	int		numbits;
+	int		data;		// offset in sv_deltas.data
+	int		next;		// next entry for the same entity
+} sv_deltaentry_t;
+
+static struct
+{
+	double		time;		// sv.time entries was encoded with
+	int		numentries;
+	int		datasize;
+	int		heads[MAX_EDICTS];
+	sv_deltaentry_t	*entries;		// [DELTACACHE_ENTRIES], allocated on demand
+	byte		*data;		// [DELTACACHE_BYTES]
+
+	int		hits;		// since last stats update
+	int		misses;
+	double		nextstats;
+} sv_deltas;
 
 /*
 =======================
@@ -49,6 +107,42 @@ static int SV_EntityNumbers( const void *a, const void *b )
 	return 1;
 }
 
+/*
+=============
+SV_NextCandidate
+
+returns next entity to check after e, walks
+everything if visibility index is not used
+=============
+*/
+static int SV_NextCandidate( const uint32_t *candidates, int e )
+{
+	int	word;
+
+	e++;
+
+	if( !candidates )
+		return e;
+
+	for( word = e >> 5; ( word << 5 ) < svgame.numEntities; word++, e = word << 5 )
+	{
+		uint32_t	bits = candidates[word] >> ( e & 31 );
+
+		if( !bits )
+			continue;
+
+		while( !( bits & 1 ))
+		{
+			bits >>= 1;
+			e++;
+		}
+
+		return e;
+	}
+
+	return svgame.numEntities;
+}
+
 /*
 =============
 SV_AddEntitiesToPacket
@@ -64,6 +158,8 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	sv_client_t	*cl = NULL;
 	qboolean		player;
 	entity_state_t	*state;
+	uint32_t		candidates[MAX_EDICTS >> 5];
+	uint32_t		*pcandidates = NULL;
 	int		e;
 
 	// during an error shutdown message we may need to transmit
@@ -91,8 +187,11 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	svgame.dllFuncs.pfnSetupVisibility( pViewEnt, pClient, &clientpvs, &clientphs );
 	if( !clientpvs ) fullvis = true;
 
+	if( sv_entity_index.value && SV_EntityIndexCandidates( clientpvs, candidates ))
+		pcandidates = candidates;
+
 	// g-cont: of course we can send world but not want to do it :-)
-	for( e = 1; e < svgame.numEntities; e++ )
+	for( e = SV_NextCandidate( pcandidates, 0 ); e < svgame.numEntities; e = SV_NextCandidate( pcandidates, e ))
 	{
 		byte	*pset;
 
@@ -122,12 +221,14 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 		else pset = clientpvs;
 
 		state = &ents->entities[ents->num_entities];
+		c_visited++;
 
 		// add entity to the net packet
 		if( svgame.dllFuncs.pfnAddToFullPack( state, e, ent, pClient, sv.hostflags, player, pset ))
 		{
 			// to prevent adds it twice through portals
 			SETVISBIT( ents->sended, e );
+			c_accepted++;
 
 			if( SV_IsValidEdict( ent->v.aiment ) && FBitSet( ent->v.aiment->v.effects, EF_MERGE_VISIBILITY ))
 			{
@@ -173,6 +274,182 @@ Encode a client frame onto the network channel
 
 =============================================================================
 */
+/*
+=============
+SV_FindCachedDelta
+
+must be called inside Jobs_EnterCritical
+=============
+*/
+static sv_deltaentry_t *SV_FindCachedDelta( const entity_state_t *from, const entity_state_t *to, qboolean force, int type, int offset, const uint32_t *inactive )
+{
+	sv_deltaentry_t	*entry;
+	int		i;
+
+	// new frame, previous deltas are encoded with different timebase
+	if( sv_deltas.time != sv.time )
+	{
+		for( i = 0; i < ARRAYSIZE( sv_deltas.heads ); i++ )
+			sv_deltas.heads[i] = -1;
+		sv_deltas.numentries = 0;
+		sv_deltas.datasize = 0;
+		sv_deltas.time = sv.time;
+	}
+
+	for( i = sv_deltas.heads[to->number]; i != -1; i = entry->next )
+	{
+		entry = &sv_deltas.entries[i];
+
+		if( entry->force != force || entry->type != type || entry->offset != offset )
+			continue;
+
+		if( memcmp( entry->inactive, inactive, sizeof( entry->inactive )))
+			continue;
+
+		if( !memcmp( &entry->to, to, sizeof( *to )) && !memcmp( &entry->from, from, sizeof( *from )))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+=============
+SV_WriteDeltaEntity
+
+MSG_WriteDeltaEntity that reuses deltas already encoded
+for other clients in this frame, see sv_deltas
+=============
+*/
+static void SV_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to, sizebuf_t *msg, qboolean force, int type, int offset, int client )
+{
+	sv_deltaentry_t	*entry;
+	byte		buf[DELTACACHE_MAXBYTES];
+	uint32_t		inactive[DELTA_MASK_WORDS];
+	sizebuf_t		delta;
+
+	if( !sv_deltacache.value || !from || !to || to->number < 0 || to->number >= MAX_EDICTS )
+	{
+		MSG_WriteDeltaEntity( from, to, msg, force, type, sv.time, offset, client );
+		return;
+	}
+
+	// game encoders may strip fields depending on who receives
+	// the entity, deltas are shared if they stripped the same
+	Delta_EncodeEntity( from, to, type, client, inactive );
+
+	Jobs_EnterCritical();
+	if( !sv_deltas.entries )
+	{
+		sv_deltas.entries = Z_Malloc( DELTACACHE_ENTRIES * sizeof( sv_deltaentry_t ));
+		sv_deltas.data = Z_Malloc( DELTACACHE_BYTES );
+		sv_deltas.time = -1.0;
+	}
+
+	entry = SV_FindCachedDelta( from, to, force, type, offset, inactive );
+	if( entry ) sv_deltas.hits++;
+	else sv_deltas.misses++;
+	Jobs_LeaveCritical();
+
+	// entries are never changed until next frame
+	if( entry )
+	{
+		MSG_WriteBits( msg, &sv_deltas.data[entry->data], entry->numbits );
+		return;
+	}
+
+	MSG_Init( &delta, "DeltaEntity", buf, sizeof( buf ));
+	MSG_WriteDeltaEntityEncoded( from, to, &delta, force, type, sv.time, offset, inactive );
+
+	if( MSG_CheckOverflow( &delta ))
+	{
+		MSG_WriteDeltaEntityEncoded( from, to, msg, force, type, sv.time, offset, inactive );
+		return;
+	}
+
+	MSG_WriteBits( msg, buf, MSG_GetNumBitsWritten( &delta ));
+
+	Jobs_EnterCritical();
+	if( sv_deltas.time == sv.time && sv_deltas.numentries < DELTACACHE_ENTRIES
+		&& sv_deltas.datasize + MSG_GetNumBytesWritten( &delta ) <= DELTACACHE_BYTES )
+	{
+		entry = &sv_deltas.entries[sv_deltas.numentries];
+		entry->from = *from;
+		entry->to = *to;
+		entry->type = type;
+		entry->offset = offset;
+		memcpy( entry->inactive, inactive, sizeof( entry->inactive ));
+		entry->force = force;
+		entry->numbits = MSG_GetNumBitsWritten( &delta );
+		entry->data = sv_deltas.datasize;
+		memcpy( &sv_deltas.data[entry->data], buf, MSG_GetNumBytesWritten( &delta ));
+
+		entry->next = sv_deltas.heads[to->number];
+		sv_deltas.heads[to->number] = sv_deltas.numentries++;
+		sv_deltas.datasize += MSG_GetNumBytesWritten( &delta );
+	}
+	Jobs_LeaveCritical();
+}
+
+/*
+=============
+SV_UpdateDeltaCacheStats
+
+=============
+*/
+static void SV_UpdateDeltaCacheStats( void )
+{
+	if( sv_deltas.nextstats > host.realtime )
+		return;
+
+	if( sv_deltacache.value )
+	{
+		int total = sv_deltas.hits + sv_deltas.misses;
+
+		Cvar_FullSet( "sv_deltacache_stats", va( "%i hits, %i misses (%.1f%%)", sv_deltas.hits, sv_deltas.misses,
+			total ? sv_deltas.hits * 100.0f / total : 0.0f ), FCVAR_READ_ONLY );
+	}
+
+	sv_deltas.hits = sv_deltas.misses = 0;
+	sv_deltas.nextstats = host.realtime + 1.0;
+}
+
+/*
+=============
+SV_FreeDeltaCache
+
+=============
+*/
+static void SV_FreeDeltaCache( void )
+{
+	if( sv_deltas.entries )
+		Z_Free( sv_deltas.entries );
+	if( sv_deltas.data )
+		Z_Free( sv_deltas.data );
+	memset( &sv_deltas, 0, sizeof( sv_deltas ));
+}
+
+/*
+=============
+SV_BaselineKeys
+
+returns precomputed field values for entity
+in the frame, they are reused by following entities
+=============
+*/
+static delta_keys_t *SV_BaselineKeys( sv_basekeys_t *cache, int index )
+{
+	sv_basekeys_t	*slot = &cache[index % MAX_CUSTOM_BASELINES];
+
+	if( slot->index != index )
+	{
+		slot->index = index;
+		slot->keys.table = NULL;
+	}
+
+	return &slot->keys;
+}
+
 /*
 =============
 SV_FindBestBaseline
@@ -180,13 +457,15 @@ SV_FindBestBaseline
 trying to deltas with previous entities
 =============
 */
-static int SV_FindBestBaseline( sv_client_t *cl, int index, entity_state_t **baseline, entity_state_t *to, client_frame_t *frame, qboolean player )
+static int SV_FindBestBaseline( sv_client_t *cl, int index, entity_state_t **baseline, entity_state_t *to, client_frame_t *frame, qboolean player, sv_basekeys_t *cache )
 {
+	delta_keys_t	basekeys;
 	int	bestBitCount;
 	int	i, bitCount;
 	int	bestfound, j;
 
-	bestBitCount = j = Delta_TestBaseline( *baseline, to, player, sv.time );
+	basekeys.table = NULL;
+	bestBitCount = j = Delta_TestBaselineKeys( *baseline, &basekeys, to, SV_BaselineKeys( cache, index ), player, sv.time, cl - svs.clients );
 	bestfound = index;
 
 	// lookup backward for previous 64 states and try to interpret current delta as baseline
@@ -197,7 +476,7 @@ static int SV_FindBestBaseline( sv_client_t *cl, int index, entity_state_t **bas
 
 		if( to->entityType == test->entityType )
 		{
-			bitCount = Delta_TestBaseline( test, to, player, sv.time );
+			bitCount = Delta_TestBaselineKeys( test, SV_BaselineKeys( cache, i ), to, SV_BaselineKeys( cache, index ), player, sv.time, cl - svs.clients );
 
 			if( bitCount < bestBitCount )
 			{
@@ -255,14 +534,17 @@ int SV_FindBestBaselineForStatic( int index, entity_state_t **baseline, entity_s
 SV_EmitPacketEntities
 
 Writes a delta update of an entity_state_t list to the message->
+Doesn't touch shared server state, so can be called from worker threads.
+Returns false if client requested delta from out of date entities
 =============
 */
-static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg )
+static qboolean SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg, int next_entities, sv_basekeys_t *cache )
 {
 	entity_state_t	*oldent, *newent;
 	int		oldindex, newindex;
 	int		i, oldnum, newnum;
 	qboolean		player;
+	qboolean		valid = true;
 	int		oldmax;
 	client_frame_t	*from;
 
@@ -273,9 +555,9 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 		oldmax = from->num_entities;
 
 		// the snapshot's entities may still have rolled off the buffer, though
-		if( from->first_entity <= ( svs.next_client_entities - svs.num_client_entities ))
+		if( from->first_entity <= ( next_entities - svs.num_client_entities ))
 		{
-			Con_DPrintf( S_WARN "%s: delta request from out of date entities.\n", cl->name );
+			valid = false;
 			MSG_BeginServerCmd( msg, svc_packetentities );
 			MSG_WriteUBitLong( msg, to->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
 
@@ -303,6 +585,9 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 	newindex = 0;
 	oldindex = 0;
 
+	for( i = 0; i < MAX_CUSTOM_BASELINES; i++ )
+		cache[i].index = -1;
+
 	while( newindex < to->num_entities || oldindex < oldmax )
 	{
 		if( newindex >= to->num_entities )
@@ -332,7 +617,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			// delta update from old position
 			// because the force parm is false, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity( oldent, newent, msg, false, player, sv.time, 0 );
+			SV_WriteDeltaEntity( oldent, newent, msg, false, player, 0, cl - svs.clients );
 			oldindex++;
 			newindex++;
 			continue;
@@ -347,7 +632,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			// trying to reduce message by select optimal baseline
 			if( !sv_instancedbaseline.value || !sv.num_instanced || sv.last_valid_baseline > newnum )
 			{
-				offset = SV_FindBestBaseline( cl, newindex, &baseline, newent, to, player );
+				offset = SV_FindBestBaseline( cl, newindex, &baseline, newent, to, player, cache );
 			}
 			else
 			{
@@ -363,7 +648,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			}
 
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( baseline, newent, msg, true, player, sv.time, offset );
+			SV_WriteDeltaEntity( baseline, newent, msg, true, player, offset, cl - svs.clients );
 			newindex++;
 			continue;
 		}
@@ -378,13 +663,15 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 				force = true;
 
 			// remove from message
-			MSG_WriteDeltaEntity( oldent, NULL, msg, force, false, sv.time, 0 );
+			MSG_WriteDeltaEntity( oldent, NULL, msg, force, false, sv.time, 0, -1 );
 			oldindex++;
 			continue;
 		}
 	}
 
 	MSG_WriteUBitLong( msg, LAST_EDICT, MAX_ENTITY_BITS ); // end of packetentities
+
+	return valid;
 }
 
 /*
@@ -630,19 +917,20 @@ static void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 
 /*
 ==================
-SV_WriteEntitiesToClient
+SV_BuildClientFrame
 
+collects entities visible to the client and stores them
+into the circular packet_entities array, calls game dll
 ==================
 */
-static void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
+static client_frame_t *SV_BuildClientFrame( sv_client_t *cl )
 {
 	client_frame_t	*frame;
 	entity_state_t	*state;
 	static sv_ents_t	frame_ents;
-	int		i, send_pings;
+	int		i;
 
 	frame = &cl->frames[cl->netchan.outgoing_sequence & SV_UPDATE_MASK];
-	send_pings = SV_ShouldUpdatePing( cl );
 
 	memset( frame_ents.sended, 0, sizeof( frame_ents.sended ));
 	ClearBits( sv.hostflags, SVF_MERGE_VISIBILITY );
@@ -689,9 +977,7 @@ static void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
 		frame->num_entities++;
 	}
 
-	SV_EmitPacketEntities( cl, frame, msg );
-	SV_EmitEvents( cl, frame, msg );
-	if( send_pings ) SV_EmitPings( msg );
+	return frame;
 }
 
 /*
@@ -703,23 +989,84 @@ FRAME UPDATES
 */
 /*
 =======================
-SV_SendClientDatagram
+SV_BeginSnapshot
+
+everything that needs game dll, must be called on the main thread
 =======================
 */
-static void SV_SendClientDatagram( sv_client_t *cl )
+static void SV_BeginSnapshot( sv_snapshot_t *snap, sv_client_t *cl )
 {
-	byte	msg_buf[MAX_DATAGRAM];
-	sizebuf_t	msg;
+	entity_state_t	*state;
+	int		i;
 
-	memset( msg_buf, 0, sizeof( msg_buf ));
-	MSG_Init( &msg, "Datagram", msg_buf, sizeof( msg_buf ));
+	snap->cl = cl;
+	snap->outdated = false;
+
+	memset( snap->msg_buf, 0, sizeof( snap->msg_buf ));
+	MSG_Init( &snap->msg, "Datagram", snap->msg_buf, sizeof( snap->msg_buf ));
 
 	// always send servertime at new frame
-	MSG_BeginServerCmd( &msg, svc_time );
-	MSG_WriteFloat( &msg, sv.time );
+	MSG_BeginServerCmd( &snap->msg, svc_time );
+	MSG_WriteFloat( &snap->msg, sv.time );
+
+	SV_WriteClientdataToMessage( cl, &snap->msg );
 
-	SV_WriteClientdataToMessage( cl, &msg );
-	SV_WriteEntitiesToClient( cl, &msg );
+	snap->send_pings = SV_ShouldUpdatePing( cl );
+	snap->frame = SV_BuildClientFrame( cl );
+	snap->next_entities = svs.next_client_entities;
+
+	// workers can't stop the server, check it here
+	for( i = 0; i < snap->frame->num_entities; i++ )
+	{
+		state = &svs.packet_entities[(snap->frame->first_entity+i) % svs.num_client_entities];
+
+		if( state->number < 0 || state->number >= GI->max_edicts )
+			Host_Error( "%s: Bad entity number: %i\n", __func__, state->number );
+	}
+}
+
+/*
+=======================
+SV_EmitSnapshot
+
+delta compression, safe to run on worker threads
+=======================
+*/
+static void SV_EmitSnapshot( void *data, int index )
+{
+	sv_snapshot_t *snap = (sv_snapshot_t *)data + index;
+
+	snap->outdated = !SV_EmitPacketEntities( snap->cl, snap->frame, &snap->msg, snap->next_entities, snap->basekeys );
+}
+
+/*
+=======================
+SV_EndSnapshot
+
+events share the delta table with its custom
+encoder, so they are written on the main thread
+=======================
+*/
+static void SV_EndSnapshot( sv_snapshot_t *snap )
+{
+	SV_EmitEvents( snap->cl, snap->frame, &snap->msg );
+
+	if( snap->outdated )
+		Con_DPrintf( S_WARN "%s: delta request from out of date entities.\n", snap->cl->name );
+
+	if( snap->send_pings )
+		SV_EmitPings( &snap->msg );
+}
+
+/*
+=======================
+SV_TransmitSnapshot
+=======================
+*/
+static void SV_TransmitSnapshot( sv_snapshot_t *snap )
+{
+	sv_client_t	*cl = snap->cl;
+	sizebuf_t		*msg = &snap->msg;
 
 	// copy the accumulated multicast datagram
 	// for this client out to the message
@@ -729,22 +1076,120 @@ static void SV_SendClientDatagram( sv_client_t *cl )
 	}
 	else
 	{
-		if( MSG_GetNumBytesWritten( &cl->datagram ) < MSG_GetNumBytesLeft( &msg ))
-			MSG_WriteBits( &msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
+		if( MSG_GetNumBytesWritten( &cl->datagram ) < MSG_GetNumBytesLeft( msg ))
+			MSG_WriteBits( msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
 		else Con_DPrintf( S_WARN "Ignoring unreliable datagram for %s, would overflow on msg\n", cl->name );
 	}
 
 	MSG_Clear( &cl->datagram );
 
-	if( MSG_CheckOverflow( &msg ))
+	if( MSG_CheckOverflow( msg ))
 	{
 		// must have room left for the packet header
-		Con_Printf( S_ERROR "%s overflowed for %s\n", MSG_GetName( &msg ), cl->name );
-		MSG_Clear( &msg );
+		Con_Printf( S_ERROR "%s overflowed for %s\n", MSG_GetName( msg ), cl->name );
+		MSG_Clear( msg );
 	}
 
 	// send the datagram
-	Netchan_TransmitBits( &cl->netchan, MSG_GetNumBitsWritten( &msg ), MSG_GetData( &msg ));
+	Netchan_TransmitBits( &cl->netchan, MSG_GetNumBitsWritten( msg ), MSG_GetData( msg ));
+}
+
+/*
+=======================
+SV_SendClientDatagram
+=======================
+*/
+static void SV_SendClientDatagram( sv_client_t *cl )
+{
+	sv_snapshot_t	snap;
+
+	SV_BeginSnapshot( &snap, cl );
+	SV_EmitSnapshot( &snap, 0 );
+	SV_EndSnapshot( &snap );
+	SV_TransmitSnapshot( &snap );
+}
+
+/*
+=======================
+SV_AllocSnapshots
+=======================
+*/
+static sv_snapshot_t *SV_AllocSnapshots( int count )
+{
+	if( sv_num_snapshots < count )
+	{
+		sv_snapshots = Z_Realloc( sv_snapshots, sizeof( *sv_snapshots ) * count );
+		sv_num_snapshots = count;
+	}
+
+	return sv_snapshots;
+}
+
+/*
+=======================
+SV_FreeSnapshots
+=======================
+*/
+void SV_FreeSnapshots( void )
+{
+	if( sv_snapshots )
+		Z_Free( sv_snapshots );
+
+	sv_snapshots = NULL;
+	sv_num_snapshots = 0;
+
+	SV_FreeDeltaCache();
+}
+
+/*
+=======================
+SV_BuildSnapshots
+
+game dll parts run on the main thread in the same order as
+serial path do, so the result is identical, then the delta
+compression for all clients is spread across worker threads
+=======================
+*/
+static void SV_BuildSnapshots( sv_snapshot_t *snaps, sv_client_t **clients, int count )
+{
+	int	i;
+
+	for( i = 0; i < count; i++ )
+	{
+		sv.current_client = clients[i];
+		SV_BeginSnapshot( &snaps[i], clients[i] );
+	}
+
+	// other clients may have used the packet entities
+	// since the snapshot was started, check against the latest
+	for( i = 0; i < count; i++ )
+		snaps[i].next_entities = svs.next_client_entities;
+
+	// workers don't see current client, it's passed to
+	// custom delta encoders with the entities instead
+	Jobs_RunParallel( SV_EmitSnapshot, snaps, count );
+
+	for( i = 0; i < count; i++ )
+	{
+		sv.current_client = clients[i];
+		SV_EndSnapshot( &snaps[i] );
+	}
+}
+
+/*
+=======================
+SV_SendClientDatagrams
+=======================
+*/
+static void SV_SendClientDatagrams( sv_client_t **clients, int count )
+{
+	sv_snapshot_t	*snaps = SV_AllocSnapshots( count );
+	int		i;
+
+	SV_BuildSnapshots( snaps, clients, count );
+
+	for( i = 0; i < count; i++ )
+		SV_TransmitSnapshot( &snaps[i] );
 }
 
 /*
@@ -832,6 +1277,25 @@ static void SV_UpdateToReliableMessages( void )
 	MSG_Clear( &sv.datagram );
 }
 
+/*
+=======================
+SV_UpdateSyscallStats
+
+count socket syscalls between the frames
+=======================
+*/
+static void SV_UpdateSyscallStats( void )
+{
+	static int	lastrecv, lastsend;
+	int		recvcalls, sendcalls;
+
+	NET_GetSyscallCounts( &recvcalls, &sendcalls );
+	sv.recvcalls = recvcalls - lastrecv;
+	sv.sendcalls = sendcalls - lastsend;
+	lastrecv = recvcalls;
+	lastsend = sendcalls;
+}
+
 /*
 =======================
 SV_SendClientMessages
@@ -840,7 +1304,9 @@ SV_SendClientMessages
 void SV_SendClientMessages( void )
 {
 	sv_client_t *cl;
-	int          i;
+	sv_client_t *batch[MAX_CLIENTS];
+	int          i, numbatch = 0;
+	qboolean     parallel;
 	double       updaterate_time;
 	double       time_until_next_message;
 
@@ -848,6 +1314,10 @@ void SV_SendClientMessages( void )
 		return;
 
 	SV_UpdateToReliableMessages ();
+	NET_BeginSendBatch ();
+
+	c_visited = c_accepted = 0;
+	parallel = sv_parallel_snapshots.value && svs.maxclients > 1 && Jobs_NumThreads() > 1;
 
 	// send a message to each connected client
 	for( i = 0, sv.current_client = svs.clients; i < svs.maxclients; i++, sv.current_client++ )
@@ -917,12 +1387,28 @@ void SV_SendClientMessages( void )
 			ClearBits( cl->flags, FCL_SEND_NET_MESSAGE );
 
 			// NOTE: we should send frame even if server is not simulated to prevent overflow
-			if( cl->state == cs_spawned )
-				SV_SendClientDatagram( cl );
-			else Netchan_TransmitBits( &cl->netchan, 0, NULL ); // just update reliable
+			if( cl->state != cs_spawned )
+				Netchan_TransmitBits( &cl->netchan, 0, NULL ); // just update reliable
+			else if( parallel )
+				batch[numbatch++] = cl;
+			else SV_SendClientDatagram( cl );
 		}
 	}
 
+	if( numbatch > 0 )
+		SV_SendClientDatagrams( batch, numbatch );
+
+	NET_EndSendBatch ();
+	SV_UpdateSyscallStats ();
+	SV_UpdateDeltaCacheStats();
+
+	// keep stats from the last frame that was sent to anyone
+	if( c_visited > 0 )
+	{
+		sv.visited_ents = c_visited;
+		sv.accepted_ents = c_accepted;
+	}
+
 	// reset current client
 	sv.current_client = NULL;
 }
@@ -996,3 +1482,162 @@ void SV_InactivateClients( void )
 		MSG_Clear( &cl->datagram );
 	}
 }
+
+/*
+=======================
+SV_SnapshotBench_f
+
+builds snapshots for spawned clients without sending them
+and compares time spent by serial and parallel paths, both
+take the same packet entities and must write the same bytes,
+except for delta frames that are about to roll off the ring,
+parallel path drops them one batch earlier
+=======================
+*/
+void SV_SnapshotBench_f( void )
+{
+	static const int	counts[] = { 8, 16, 32 };
+	sv_client_t	*clients[MAX_CLIENTS];
+	event_state_t	*events;
+	int		fixangle[MAX_CLIENTS];
+	float		avelocity[MAX_CLIENTS];
+	int		delta_sequence[MAX_CLIENTS];
+	qboolean		tempframes[MAX_CLIENTS];
+	sv_snapshot_t	*serial, *parallel;
+	client_frame_t	serialframes[MAX_CLIENTS];
+	int		i, j, c, numclients = 0;
+	int		first_entity;
+	int		numframes = 100;
+	sv_client_t	*cl;
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "server is not running\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 )
+		numframes = Q_max( 1, Q_atoi( Cmd_Argv( 1 )));
+
+	for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+	{
+		if( cl->state == cs_spawned && cl->edict )
+			clients[numclients++] = cl;
+	}
+
+	if( !numclients )
+	{
+		Con_Printf( "no spawned clients, add some bots first\n" );
+		return;
+	}
+
+	events = Z_Malloc( sizeof( *events ) * numclients );
+	serial = Z_Malloc( sizeof( *serial ) * numclients );
+	parallel = SV_AllocSnapshots( numclients );
+
+	for( i = 0; i < numclients; i++ )
+	{
+		cl = clients[i];
+		events[i] = cl->events;
+		fixangle[i] = cl->edict->v.fixangle;
+		avelocity[i] = cl->edict->v.avelocity[YAW];
+		delta_sequence[i] = cl->delta_sequence;
+		tempframes[i] = false;
+
+		// fakeclients doesn't have frames
+		if( !cl->frames )
+		{
+			cl->frames = Z_Calloc( sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
+			cl->delta_sequence = -1;
+			tempframes[i] = true;
+		}
+	}
+
+	Con_Printf( "building %i frames, %i worker threads\n", numframes, Jobs_NumThreads( ));
+
+	for( c = 0; c < ARRAYSIZE( counts ); c++ )
+	{
+		int	count = counts[c], mismatches = 0;
+		double	serial_time = 0.0, parallel_time = 0.0;
+		double	start;
+
+		if( count > numclients )
+		{
+			Con_Printf( "%2i clients: skipped, only %i clients are spawned\n", count, numclients );
+			continue;
+		}
+
+		for( j = 0; j < numframes; j++ )
+		{
+			for( i = 0; i < count; i++ )
+			{
+				clients[i]->events = events[i];
+				clients[i]->edict->v.fixangle = fixangle[i];
+				clients[i]->edict->v.avelocity[YAW] = avelocity[i];
+			}
+
+			first_entity = svs.next_client_entities;
+			start = Sys_DoubleTime();
+
+			for( i = 0; i < count; i++ )
+			{
+				sv.current_client = clients[i];
+				SV_BeginSnapshot( &serial[i], clients[i] );
+				SV_EmitSnapshot( &serial[i], 0 );
+				SV_EndSnapshot( &serial[i] );
+			}
+
+			serial_time += Sys_DoubleTime() - start;
+
+			for( i = 0; i < count; i++ )
+				serialframes[i] = *serial[i].frame;
+
+			// parallel path must take the same packet entities
+			svs.next_client_entities = first_entity;
+
+			for( i = 0; i < count; i++ )
+			{
+				clients[i]->events = events[i];
+				clients[i]->edict->v.fixangle = fixangle[i];
+				clients[i]->edict->v.avelocity[YAW] = avelocity[i];
+			}
+
+			start = Sys_DoubleTime();
+			SV_BuildSnapshots( parallel, clients, count );
+			parallel_time += Sys_DoubleTime() - start;
+
+			for( i = 0; i < count; i++ )
+			{
+				if( parallel[i].frame->first_entity != serialframes[i].first_entity
+					|| parallel[i].frame->num_entities != serialframes[i].num_entities )
+					mismatches++;
+				else if( MSG_GetNumBitsWritten( &serial[i].msg ) != MSG_GetNumBitsWritten( &parallel[i].msg )
+					|| memcmp( serial[i].msg_buf, parallel[i].msg_buf, MSG_GetNumBytesWritten( &serial[i].msg )))
+					mismatches++;
+			}
+		}
+
+		Con_Printf( "%2i clients: serial %.3f ms, parallel %.3f ms per frame, %i mismatches\n", count,
+			serial_time * 1000.0 / numframes, parallel_time * 1000.0 / numframes, mismatches );
+	}
+
+	sv.current_client = NULL;
+
+	for( i = 0; i < numclients; i++ )
+	{
+		cl = clients[i];
+		cl->events = events[i];
+		cl->edict->v.fixangle = fixangle[i];
+		cl->edict->v.avelocity[YAW] = avelocity[i];
+		cl->delta_sequence = delta_sequence[i];
+
+		if( tempframes[i] )
+		{
+			Z_Free( cl->frames );
+			cl->frames = NULL;
+		}
+	}
+
+	Z_Free( serial );
+	Z_Free( events );
+}
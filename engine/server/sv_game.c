@@ -581,7 +581,7 @@ qboolean SV_CreateStaticEntity( sizebuf_t *msg, int index )
 	offset = SV_FindBestBaselineForStatic( index, &baseline, state );
 
 	MSG_BeginServerCmd( msg, svc_spawnstatic );
-	MSG_WriteDeltaEntity( baseline, state, msg, true, DELTA_STATIC, sv.time, offset );
+	MSG_WriteDeltaEntity( baseline, state, msg, true, DELTA_STATIC, sv.time, offset, -1 );
 
 	return true;
 }
@@ -1005,6 +1005,9 @@ void SV_InitEdict( edict_t *pEdict )
 	pEdict->v.controller[2] = 0x7F;
 	pEdict->v.controller[3] = 0x7F;
 	pEdict->free = false;
+
+	// not linked yet, game dll will see stale leafnums
+	SV_ResetEdictIndex( pEdict );
 }
 
 /*
@@ -1021,6 +1024,7 @@ void SV_FreeEdict( edict_t *pEdict )
 
 	// unlink from world
 	SV_UnlinkEdict( pEdict );
+	SV_ResetEdictIndex( pEdict );
 
 	SV_FreePrivateData( pEdict );
 
@@ -3154,7 +3158,7 @@ static void SV_AllocStringPool( void )
 	svgame.globals->pStringBase = "";
 #endif // !XASH_64BIT
 
-	svgame.stringspool = Mem_AllocPool( "Server Strings" );
+	svgame.stringspool = Mem_AllocPoolExt( "Server Strings", MEMPOOL_ARENA );
 }
 
 static void SV_FreeStringPool( void )
@@ -4245,7 +4249,14 @@ pfnGetCurrentPlayer
 */
 static int GAME_EXPORT pfnGetCurrentPlayer( void )
 {
-	int	idx = sv.current_client - svs.clients;
+	int	idx = Delta_EncodeClient();
+
+	// entities may be encoded on worker threads, where
+	// current client is not the one they are sent to
+	if( idx != -1 )
+		return idx;
+
+	idx = sv.current_client - svs.clients;
 
 	if( idx < 0 || idx >= svs.maxclients )
 		return -1;
@@ -5152,6 +5163,9 @@ void SV_UnloadProgs( void )
 	Z_Free( svs.baselines );
 	svs.baselines = NULL;
 
+	SV_FreeEntityIndex();
+	SV_FreeAreaTree();
+
 	// remove server cmds
 	SV_KillOperatorCommands();
 
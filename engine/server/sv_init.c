@@ -546,7 +546,7 @@ static void SV_CreateBaseline( void )
 		// take current state as baseline
 		base = &svs.baselines[entnum];
 
-		MSG_WriteDeltaEntity( &nullstate, base, &sv.signon, true, delta_type, 1.0f, 0 );
+		MSG_WriteDeltaEntity( &nullstate, base, &sv.signon, true, delta_type, 1.0f, 0, -1 );
 	}
 
 	MSG_WriteUBitLong( &sv.signon, LAST_EDICT, MAX_ENTITY_BITS ); // end of baselines
@@ -555,7 +555,7 @@ static void SV_CreateBaseline( void )
 	for( entnum = 0; entnum < sv.num_instanced; entnum++ )
 	{
 		base = &sv.instanced[entnum].baseline;
-		MSG_WriteDeltaEntity( &nullstate, base, &sv.signon, true, DELTA_ENTITY, 1.0f, 0 );
+		MSG_WriteDeltaEntity( &nullstate, base, &sv.signon, true, DELTA_ENTITY, 1.0f, 0, -1 );
 	}
 }
 
@@ -1161,6 +1161,9 @@ qboolean SV_SpawnServer( const char *mapname, const char *startspot, qboolean ba
 	// clear physics interaction links
 	SV_ClearWorld();
 
+	// positions from previous map can't be rewound to
+	SV_ClearUnlagHistory();
+
 	// pregenerate test packet
 	SV_GenerateTestPacket();
 
@@ -28,11 +28,21 @@ CVAR_DEFINE_AUTO( sv_unlag, "1", 0, "allow lag compensation on server-side" );
 CVAR_DEFINE_AUTO( sv_maxunlag, "0.5", 0, "max latency value which can be interpolated (by default ping should not exceed 500 units)" );
 CVAR_DEFINE_AUTO( sv_unlagpush, "0.0", 0, "interpolation bias for unlag time" );
 CVAR_DEFINE_AUTO( sv_unlagsamples, "1", 0, "max samples to interpolate" );
+CVAR_DEFINE_AUTO( sv_unlaghistory, "0", FCVAR_ARCHIVE, "rewind players using saved positions instead of searching client frames" );
 CVAR_DEFINE_AUTO( rcon_password, "", FCVAR_PROTECTED | FCVAR_PRIVILEGED, "remote connect password" );
 CVAR_DEFINE_AUTO( rcon_enable, "1", FCVAR_PROTECTED, "enable accepting remote commands on server" );
 // TODO: CVAR_DEFINE_AUTO( sv_filterban, "1", 0, "filter banned users" );
 CVAR_DEFINE_AUTO( sv_cheats, "0", FCVAR_SERVER, "allow cheats on server" );
 CVAR_DEFINE_AUTO( sv_instancedbaseline, "1", 0, "allow to use instanced baselines to saves network overhead" );
+CVAR_DEFINE_AUTO( sv_parallel_snapshots, "0", FCVAR_ARCHIVE, "delta compress client snapshots on worker threads (see host_jobthreads)" );
+CVAR_DEFINE_AUTO( sv_deltacache, "0", FCVAR_ARCHIVE, "encode identical entity deltas once per frame and share them between clients" );
+static CVAR_DEFINE_AUTO( sv_deltacache_stats, "", FCVAR_READ_ONLY, "entity delta cache hits and misses during last second" );
+CVAR_DEFINE_AUTO( sv_entity_index, "0", FCVAR_ARCHIVE, "only pass entities from visible leafs to AddToFullPack, may break mods that send entities outside of PVS" );
+CVAR_DEFINE_AUTO( sv_area_tree, "0", FCVAR_ARCHIVE, "use dynamic bounding box tree instead of area nodes for traces, touch and water checks" );
+static CVAR_DEFINE_AUTO( sv_area_tree_stats, "", FCVAR_READ_ONLY, "entity traces and clip candidates tested during last second" );
+CVAR_DEFINE_AUTO( sv_ratelimit, "0", FCVAR_ARCHIVE, "connectionless packets per second accepted from single address (getchallenge, connect, rcon, queries), 0 - unlimited" );
+CVAR_DEFINE_AUTO( sv_ratelimit_burst, "10", FCVAR_ARCHIVE, "how many connectionless packets single address can send at once before sv_ratelimit kicks in" );
+static CVAR_DEFINE_AUTO( sv_latencystats, "0", 0, "record time between packet arrival and its processing, see sv_latency" );
 static CVAR_DEFINE_AUTO( sv_contact, "", FCVAR_ARCHIVE|FCVAR_SERVER, "server techincal support contact address or web-page" );
 CVAR_DEFINE_AUTO( sv_minupdaterate, "25.0", FCVAR_ARCHIVE, "minimal value for 'cl_updaterate' window" );
 CVAR_DEFINE_AUTO( sv_maxupdaterate, "60.0", FCVAR_ARCHIVE, "maximal value for 'cl_updaterate' window" );
@@ -371,6 +381,98 @@ static void SV_ProcessFile( sv_client_t *cl, const char *filename )
 	if( bError ) Con_Printf( S_ERROR "parsing custom decal from %s\n", cl->name );
 }
 
+#define LATENCY_BUCKETS	12
+
+// upper bounds of histogram buckets in seconds, last one is unbounded
+static const double sv_latency_bounds[LATENCY_BUCKETS - 1] =
+{
+	0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1
+};
+
+static struct
+{
+	int	counts[LATENCY_BUCKETS];
+	int	total;
+	double	sum;
+	double	max;
+} sv_latency;
+
+/*
+=================
+SV_RecordLatency
+
+client message is going to be executed right now
+=================
+*/
+static void SV_RecordLatency( void )
+{
+	double	latency;
+	int	i;
+
+	if( !sv_latencystats.value )
+		return;
+
+	latency = Q_max( 0.0, Sys_DoubleTime() - NET_PacketTime( ));
+
+	for( i = 0; i < LATENCY_BUCKETS - 1; i++ )
+	{
+		if( latency < sv_latency_bounds[i] )
+			break;
+	}
+
+	sv_latency.counts[i]++;
+	sv_latency.total++;
+	sv_latency.sum += latency;
+	sv_latency.max = Q_max( sv_latency.max, latency );
+}
+
+/*
+=================
+SV_Latency_f
+
+print packet arrival to processing latency histogram
+=================
+*/
+void SV_Latency_f( void )
+{
+	int	i, j, bar, maxcount = 1;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		memset( &sv_latency, 0, sizeof( sv_latency ));
+		return;
+	}
+
+	if( !sv_latencystats.value )
+		Con_Printf( "sv_latencystats is disabled, nothing is recorded\n" );
+
+	if( !sv_latency.total )
+	{
+		Con_Printf( "no client messages were recorded\n" );
+		return;
+	}
+
+	for( i = 0; i < LATENCY_BUCKETS; i++ )
+		maxcount = Q_max( maxcount, sv_latency.counts[i] );
+
+	for( i = 0; i < LATENCY_BUCKETS; i++ )
+	{
+		if( i < LATENCY_BUCKETS - 1 )
+			Con_Printf( "  < %7.2f ms ", sv_latency_bounds[i] * 1000.0 );
+		else Con_Printf( " >= %7.2f ms ", sv_latency_bounds[i - 1] * 1000.0 );
+
+		Con_Printf( "%8i %5.1f%% ", sv_latency.counts[i], sv_latency.counts[i] * 100.0 / sv_latency.total );
+
+		bar = sv_latency.counts[i] * 32 / maxcount;
+		for( j = 0; j < bar; j++ )
+			Con_Printf( "#" );
+		Con_Printf( "\n" );
+	}
+
+	Con_Printf( "%i messages, avg %.3f ms, max %.3f ms\n", sv_latency.total,
+		sv_latency.sum * 1000.0 / sv_latency.total, sv_latency.max * 1000.0 );
+}
+
 /*
 =================
 SV_ReadPackets
@@ -379,9 +481,11 @@ SV_ReadPackets
 static void SV_ReadPackets( void )
 {
 	sv_client_t	*cl;
-	int		i, qport;
+	int		qport;
 	size_t		curSize;
 
+	NET_TrackPacketTimes( sv_latencystats.value != 0.0f );
+
 	while( NET_GetPacket( NS_SERVER, &net_from, net_message_buffer, &curSize ))
 	{
 		MSG_Init( &net_message, "ClientPacket", net_message_buffer, curSize );
@@ -401,65 +505,53 @@ static void SV_ReadPackets( void )
 		qport = (int)MSG_ReadShort( &net_message ) & 0xffff;
 
 		// check for packets from connected clients
-		for( i = 0, sv.current_client = svs.clients; i < svs.maxclients; i++, sv.current_client++ )
-		{
-			cl = sv.current_client;
-
-			if( cl->state == cs_free || FBitSet( cl->flags, FCL_FAKECLIENT ))
-				continue;
+		cl = sv.current_client = SV_ClientFromAddress( net_from, qport );
+		if( !cl )
+			continue;
 
-			if( !NET_CompareBaseAdr( net_from, cl->netchan.remote_address ))
-				continue;
+		if( cl->netchan.remote_address.port != net_from.port )
+			cl->netchan.remote_address.port = net_from.port;
 
-			if( cl->netchan.qport != qport )
-				continue;
+		if( Netchan_Process( &cl->netchan, &net_message ))
+		{
+			if(( svs.maxclients == 1 && !host_limitlocal.value ) || ( cl->state != cs_spawned ))
+				SetBits( cl->flags, FCL_SEND_NET_MESSAGE ); // reply at end of frame
 
-			if( cl->netchan.remote_address.port != net_from.port )
-				cl->netchan.remote_address.port = net_from.port;
+			// this is a valid, sequenced packet, so process it
+			if( cl->frames != NULL && cl->state != cs_zombie )
+			{
+				SV_RecordLatency();
+				SV_ExecuteClientMessage( cl, &net_message );
+				svgame.globals->frametime = sv.frametime;
+				svgame.globals->time = sv.time;
+			}
+		}
 
-			if( Netchan_Process( &cl->netchan, &net_message ))
+		// fragmentation/reassembly sending takes priority over all game messages, want this in the future?
+		if( Netchan_IncomingReady( &cl->netchan ))
+		{
+			if( Netchan_CopyNormalFragments( &cl->netchan, &net_message, &curSize ))
 			{
+				MSG_Init( &net_message, "ClientPacket", net_message_buffer, curSize );
+
 				if(( svs.maxclients == 1 && !host_limitlocal.value ) || ( cl->state != cs_spawned ))
 					SetBits( cl->flags, FCL_SEND_NET_MESSAGE ); // reply at end of frame
 
 				// this is a valid, sequenced packet, so process it
 				if( cl->frames != NULL && cl->state != cs_zombie )
 				{
+					SV_RecordLatency();
 					SV_ExecuteClientMessage( cl, &net_message );
 					svgame.globals->frametime = sv.frametime;
 					svgame.globals->time = sv.time;
 				}
 			}
 
-			// fragmentation/reassembly sending takes priority over all game messages, want this in the future?
-			if( Netchan_IncomingReady( &cl->netchan ))
+			if( Netchan_CopyFileFragments( &cl->netchan, &net_message ))
 			{
-				if( Netchan_CopyNormalFragments( &cl->netchan, &net_message, &curSize ))
-				{
-					MSG_Init( &net_message, "ClientPacket", net_message_buffer, curSize );
-
-					if(( svs.maxclients == 1 && !host_limitlocal.value ) || ( cl->state != cs_spawned ))
-						SetBits( cl->flags, FCL_SEND_NET_MESSAGE ); // reply at end of frame
-
-					// this is a valid, sequenced packet, so process it
-					if( cl->frames != NULL && cl->state != cs_zombie )
-					{
-						SV_ExecuteClientMessage( cl, &net_message );
-						svgame.globals->frametime = sv.frametime;
-						svgame.globals->time = sv.time;
-					}
-				}
-
-				if( Netchan_CopyFileFragments( &cl->netchan, &net_message ))
-				{
-					SV_ProcessFile( cl, cl->netchan.incomingfilename );
-				}
+				SV_ProcessFile( cl, cl->netchan.incomingfilename );
 			}
-			break;
 		}
-
-		if( i != svs.maxclients )
-			continue;
 	}
 
 	sv.current_client = NULL;
@@ -653,6 +745,29 @@ static void SV_UpdateStatusLine( void )
 #endif // XASH_PLATFORM_HAVE_STATUS
 }
 
+/*
+==================
+SV_NextTickTime
+
+how long until server runs next physics frame,
+zero if it runs every host frame
+==================
+*/
+double SV_NextTickTime( void )
+{
+	double	fps;
+
+	if( !svs.initialized || sv_fps.value == 0.0f )
+		return 0.0;
+
+	// time isn't accumulated, see Host_ServerFrame
+	if( !sv.simulating && sv.state == ss_active )
+		return 0.0;
+
+	fps = (1.0 / (double)( sv_fps.value - 0.01f ));
+	return Q_max( 0.0, fps - sv.time_residual );
+}
+
 /*
 ==================
 Host_ServerFrame
@@ -692,12 +807,18 @@ void Host_ServerFrame( void )
 	// let everything in the world think and move
 	if( !SV_RunGameFrame ()) return;
 
+	// save player positions for lag compensation
+	SV_RecordUnlagHistory ();
+
 	// send messages back to the clients that had packets read this frame
 	SV_SendClientMessages ();
 
 	// clear edict flags for next frame
 	SV_PrepWorldFrame ();
 
+	// update trace counters once a second
+	SV_UpdateAreaStats ();
+
 	// send a heartbeat to the master if needed
 	NET_MasterHeartbeat ();
 }
@@ -902,6 +1023,7 @@ void SV_Init( void )
 	Cvar_RegisterVariable( &sv_maxunlag );
 	Cvar_RegisterVariable( &sv_unlagpush );
 	Cvar_RegisterVariable( &sv_unlagsamples );
+	Cvar_RegisterVariable( &sv_unlaghistory );
 	Cvar_RegisterVariable( &sv_allow_upload );
 	Cvar_RegisterVariable( &sv_allow_download );
 	Cvar_RegisterVariable( &sv_allow_dlfile );
@@ -963,6 +1085,15 @@ void SV_Init( void )
 	Cvar_RegisterVariable( &sv_log_outofband );
 	Cvar_RegisterVariable( &sv_allow_testpacket );
 	Cvar_RegisterVariable( &sv_expose_player_list );
+	Cvar_RegisterVariable( &sv_parallel_snapshots );
+	Cvar_RegisterVariable( &sv_entity_index );
+	Cvar_RegisterVariable( &sv_area_tree );
+	Cvar_RegisterVariable( &sv_area_tree_stats );
+	Cvar_RegisterVariable( &sv_deltacache );
+	Cvar_RegisterVariable( &sv_deltacache_stats );
+	Cvar_RegisterVariable( &sv_latencystats );
+	Cvar_RegisterVariable( &sv_ratelimit );
+	Cvar_RegisterVariable( &sv_ratelimit_burst );
 
 	// when we in developer-mode automatically turn cheats on
 	if( host_developer.value ) Cvar_SetValue( "sv_cheats", 1.0f );
@@ -1054,6 +1185,9 @@ static void SV_FreeClients( void )
 			svs.num_client_entities = 0;
 			svs.next_client_entities = 0;
 		}
+
+		SV_FreeSnapshots();
+		SV_ClearUnlagHistory();
 	}
 }
 
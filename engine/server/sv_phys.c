@@ -2037,6 +2037,11 @@ static trace_t GAME_EXPORT SV_MoveNormal( const vec3_t start, vec3_t mins, vec3_
 	return SV_Move( start, mins, maxs, end, type, e, false );
 }
 
+static void GAME_EXPORT SV_MoveNormalBatch( int count, const float *start, const float *end, float *mins, float *maxs, int type, edict_t *e, trace_t *traces )
+{
+	SV_MoveBatch( count, (const vec3_t *)start, (const vec3_t *)end, mins, maxs, type, e, false, traces );
+}
+
 /*
 =============
 pfnWriteBytes
@@ -2122,7 +2127,8 @@ static server_physics_api_t gPhysicsAPI =
 	COM_SaveFile,
 	pfnLoadImagePixels,
 	pfnGetModelName,
-	Sys_GetNativeObject
+	Sys_GetNativeObject,
+	SV_MoveNormalBatch,
 };
 
 /*
@@ -704,7 +704,255 @@ static qboolean SV_UnlagCheckTeleport( vec3_t old_pos, vec3_t new_pos )
 	return false;
 }
 
-static void SV_SetupMoveInterpolant( sv_client_t *cl )
+/*
+===============================================================================
+
+	UNLAG HISTORY
+
+player positions saved every server frame, so rewinding them doesn't
+have to search through packet entities of every client frame
+
+===============================================================================
+*/
+#define SV_UNLAG_HISTORY	1024	// must be power of two
+#define SV_UNLAG_MASK	( SV_UNLAG_HISTORY - 1 )
+#define SV_UNLAG_CMDS	1024	// usercmds kept for sv_unlag_bench, must be power of two
+#define SV_UNLAG_CMDS_MASK	( SV_UNLAG_CMDS - 1 )
+
+typedef struct
+{
+	int		client;
+	short		lerp_msec;
+	float		latency;
+} unlagcmd_t;
+
+static struct
+{
+	// samples from oldest to newest are ( head - count, head ]
+	double		time[SV_UNLAG_HISTORY];
+	vec3_t		(*origin)[SV_UNLAG_HISTORY];	// [MAX_CLIENTS], allocated when history is enabled
+	double		breaktime[MAX_CLIENTS];	// samples up to this time can't be interpolated from
+	double		movetime[MAX_CLIENTS];	// last sample where player has moved
+	int		head;
+	int		count;
+
+	unlagcmd_t	cmds[SV_UNLAG_CMDS];
+	uint		numcmds;		// total recorded, wraps around
+} sv_unlag_history;
+
+/*
+===============
+SV_ClearUnlagHistory
+
+===============
+*/
+void SV_ClearUnlagHistory( void )
+{
+	if( sv_unlag_history.origin )
+		Mem_Free( sv_unlag_history.origin );
+
+	memset( &sv_unlag_history, 0, sizeof( sv_unlag_history ));
+}
+
+/*
+===============
+SV_AllocUnlagHistory
+
+positions take a few hundred kilobytes, so
+don't keep them when history is disabled
+===============
+*/
+static void SV_AllocUnlagHistory( void )
+{
+	sv_unlag_history.origin = Mem_Malloc( host.mempool, sizeof( *sv_unlag_history.origin ) * MAX_CLIENTS );
+	sv_unlag_history.count = 0;
+}
+
+/*
+===============
+SV_AdvanceUnlagHistory
+
+returns index of the new sample
+===============
+*/
+static int SV_AdvanceUnlagHistory( double time )
+{
+	int	cur = sv_unlag_history.head = ( sv_unlag_history.head + 1 ) & SV_UNLAG_MASK;
+
+	sv_unlag_history.time[cur] = time;
+	sv_unlag_history.count = Q_min( sv_unlag_history.count + 1, SV_UNLAG_HISTORY );
+
+	return cur;
+}
+
+/*
+===============
+SV_RecordUnlagOrigin
+
+ent is NULL if player wasn't in the game
+===============
+*/
+static void SV_RecordUnlagOrigin( int client, edict_t *ent, int prev, int cur )
+{
+	double	time = sv_unlag_history.time[cur];
+
+	if( !ent )
+	{
+		sv_unlag_history.breaktime[client] = time;
+		return;
+	}
+
+	VectorCopy( ent->v.origin, sv_unlag_history.origin[client][cur] );
+
+	// same checks as done for packet entities
+	if( ent->v.health <= 0 || FBitSet( ent->v.effects, EF_NOINTERP ))
+		sv_unlag_history.breaktime[client] = time;
+
+	if( sv_unlag_history.count == 1 || sv_unlag_history.breaktime[client] == sv_unlag_history.time[prev] )
+	{
+		sv_unlag_history.movetime[client] = time;
+		return;
+	}
+
+	if( !VectorCompare( sv_unlag_history.origin[client][prev], ent->v.origin ))
+	{
+		sv_unlag_history.movetime[client] = time;
+
+		if( SV_UnlagCheckTeleport( sv_unlag_history.origin[client][prev], ent->v.origin ))
+			sv_unlag_history.breaktime[client] = Q_max( sv_unlag_history.breaktime[client], sv_unlag_history.time[prev] );
+	}
+}
+
+/*
+===============
+SV_RecordUnlagHistory
+
+called each frame after physics, player positions
+are the same as the ones that go into client frames
+===============
+*/
+void SV_RecordUnlagHistory( void )
+{
+	int		i, prev, cur;
+	sv_client_t	*cl;
+
+	if( !sv_unlaghistory.value || svs.maxclients <= 1 )
+	{
+		sv_unlag_history.count = 0;
+		return;
+	}
+
+	if( !sv_unlag_history.origin )
+		SV_AllocUnlagHistory();
+
+	cur = SV_AdvanceUnlagHistory( host.realtime );
+	prev = ( cur - 1 ) & SV_UNLAG_MASK;
+
+	for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+	{
+		if( cl->state != cs_spawned || !SV_IsValidEdict( cl->edict ))
+			SV_RecordUnlagOrigin( i, NULL, prev, cur );
+		else SV_RecordUnlagOrigin( i, cl->edict, prev, cur );
+	}
+}
+
+/*
+===============
+SV_FindUnlagSample
+
+binary search for newest sample older than time,
+returns sample index or -1 if history doesn't go that far
+===============
+*/
+static int SV_FindUnlagSample( double time )
+{
+	int	oldest = sv_unlag_history.head - sv_unlag_history.count + 1;
+	int	lo = 0, hi = sv_unlag_history.count - 1, mid;
+
+	if( !sv_unlag_history.count || sv_unlag_history.time[oldest & SV_UNLAG_MASK] >= time )
+		return -1;
+
+	while( lo < hi )
+	{
+		mid = ( lo + hi + 1 ) / 2;
+
+		if( sv_unlag_history.time[( oldest + mid ) & SV_UNLAG_MASK] < time )
+			lo = mid;
+		else hi = mid - 1;
+	}
+
+	return ( oldest + lo ) & SV_UNLAG_MASK;
+}
+
+/*
+===============
+SV_UnlagHistoryOrigin
+
+position of client at finalpush, sample is the one found by
+SV_FindUnlagSample, returns false if player shouldn't be moved
+===============
+*/
+static qboolean SV_UnlagHistoryOrigin( int client, int sample, float finalpush, const vec3_t origin, vec3_t out )
+{
+	int	next = ( sample + 1 ) & SV_UNLAG_MASK;
+	double	time = sv_unlag_history.time[sample];
+	float	lerpFrac = 0.0f;
+
+	// died, teleported or wasn't there
+	if( sv_unlag_history.breaktime[client] >= time )
+		return false;
+
+	// didn't move since then
+	if( sv_unlag_history.movetime[client] <= time && VectorCompare( sv_unlag_history.origin[client][sv_unlag_history.head], origin ))
+		return false;
+
+	if( sample != sv_unlag_history.head && sv_unlag_history.time[next] != time )
+	{
+		lerpFrac = ( finalpush - time ) / ( sv_unlag_history.time[next] - time );
+		lerpFrac = bound( 0.0f, lerpFrac, 1.0f );
+	}
+	else next = sample;
+
+	VectorLerp( sv_unlag_history.origin[client][sample], lerpFrac, sv_unlag_history.origin[client][next], out );
+	return true;
+}
+
+/*
+===============
+SV_InterpolateFromHistory
+
+===============
+*/
+static void SV_InterpolateFromHistory( sv_client_t *cl, int sample, float finalpush )
+{
+	int		i;
+	vec3_t		curpos;
+	sv_client_t	*check;
+	sv_interp_t	*lerp;
+
+	for( i = 0, check = svs.clients; i < svs.maxclients; i++, check++ )
+	{
+		lerp = &svgame.interp[i];
+
+		if( !lerp->active || check == cl )
+			continue;
+
+		if( !SV_UnlagHistoryOrigin( i, sample, finalpush, check->edict->v.origin, curpos ))
+			continue;
+
+		VectorCopy( curpos, lerp->curpos );
+		VectorCopy( curpos, lerp->newpos );
+
+		if( !VectorCompare( curpos, check->edict->v.origin ))
+		{
+			VectorCopy( curpos, check->edict->v.origin );
+			SV_LinkEdict( check->edict, false );
+			lerp->moving = true;
+		}
+	}
+}
+
+static void SV_SetupMoveInterpolant( sv_client_t *cl, qboolean history )
 {
 	int		i, j, clientnum;
 	float		finalpush, lerp_msec;
@@ -754,6 +1002,19 @@ static void SV_SetupMoveInterpolant( sv_client_t *cl )
 	finalpush = ( host.realtime - latency - lerp_msec ) + sv_unlagpush.value;
 	if( finalpush > host.realtime ) finalpush = host.realtime; // pushed too much ?
 
+	if( history && ( i = SV_FindUnlagSample( finalpush )) != -1 )
+	{
+		if( finalpush - sv_unlag_history.time[i] > 1.0f )
+		{
+			memset( svgame.interp, 0, sizeof( svgame.interp ));
+			has_update = false;
+			return;
+		}
+
+		SV_InterpolateFromHistory( cl, i, finalpush );
+		return;
+	}
+
 	frame = frame2 = NULL;
 
 	for( i = 0; i < SV_UPDATE_BACKUP; i++, frame2 = frame )
@@ -941,7 +1202,19 @@ void SV_RunCmd( sv_client_t *cl, usercmd_t *ucmd, int random_seed )
 	}
 
 	if( !FBitSet( cl->flags, FCL_FAKECLIENT ))
-		SV_SetupMoveInterpolant( cl );
+	{
+		if( sv_unlaghistory.value )
+		{
+			unlagcmd_t	*rec = &sv_unlag_history.cmds[sv_unlag_history.numcmds++ & SV_UNLAG_CMDS_MASK];
+
+			// remember what lag compensation depends on for sv_unlag_bench
+			rec->client = cl - svs.clients;
+			rec->lerp_msec = cmd.lerp_msec;
+			rec->latency = cl->latency;
+		}
+
+		SV_SetupMoveInterpolant( cl, sv_unlaghistory.value != 0.0f );
+	}
 
 	svgame.dllFuncs.pfnCmdStart( cl->edict, ucmd, random_seed );
 
@@ -1025,3 +1298,237 @@ void SV_RunCmd( sv_client_t *cl, usercmd_t *ucmd, int random_seed )
 		SV_RestoreMoveInterpolant( cl );
 	}
 }
+
+/*
+===========
+SV_UnlagBench_f
+
+replays lag compensation for recent usercmds
+with client frames and with position history
+===========
+*/
+void SV_UnlagBench_f( void )
+{
+	int		i, j, k, passes = 10, numcmds;
+	int		moved[2] = { 0 };
+	double		elapsed[2], start;
+	short		lerp_msec;
+	float		latency;
+	unlagcmd_t	*rec;
+	sv_client_t	*cl;
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "server is not running\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 )
+		passes = Q_max( 1, Q_atoi( Cmd_Argv( 1 )));
+
+	numcmds = Q_min( sv_unlag_history.numcmds, (uint)SV_UNLAG_CMDS );
+
+	if( !numcmds )
+	{
+		Con_Printf( "no usercmds recorded\n" );
+		return;
+	}
+
+	for( k = 0; k < 2; k++ )
+	{
+		start = Sys_DoubleTime();
+
+		for( j = 0; j < passes; j++ )
+		{
+			for( i = 0; i < numcmds; i++ )
+			{
+				int	n;
+
+				rec = &sv_unlag_history.cmds[i];
+				if( rec->client >= svs.maxclients )
+					continue;
+
+				cl = &svs.clients[rec->client];
+				if( cl->state != cs_spawned )
+					continue;
+
+				lerp_msec = cl->lastcmd.lerp_msec;
+				latency = cl->latency;
+				cl->lastcmd.lerp_msec = rec->lerp_msec;
+				cl->latency = rec->latency;
+
+				SV_SetupMoveInterpolant( cl, k );
+
+				if( j == 0 )
+				{
+					for( n = 0; n < svs.maxclients; n++ )
+					{
+						if( svgame.interp[n].moving )
+							moved[k]++;
+					}
+				}
+
+				SV_RestoreMoveInterpolant( cl );
+
+				cl->lastcmd.lerp_msec = lerp_msec;
+				cl->latency = latency;
+			}
+		}
+
+		elapsed[k] = Sys_DoubleTime() - start;
+	}
+
+	Con_Printf( "%i usercmds, %i passes, %i history samples\n", numcmds, passes, sv_unlag_history.count );
+	Con_Printf( "client frames: %.3f ms per pass, %i players rewound\n", elapsed[0] * 1000.0 / passes, moved[0] );
+	Con_Printf( "history: %.3f ms per pass, %i players rewound\n", elapsed[1] * 1000.0 / passes, moved[1] );
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static int Test_FindUnlagSampleLinear( double time )
+{
+	int	i, sample = -1;
+
+	for( i = 0; i < sv_unlag_history.count; i++ )
+	{
+		int	index = ( sv_unlag_history.head - sv_unlag_history.count + 1 + i ) & SV_UNLAG_MASK;
+
+		if( sv_unlag_history.time[index] < time )
+			sample = index;
+	}
+
+	return sample;
+}
+
+static void Test_UnlagHistory( void )
+{
+	double	time = 100.0;
+	int	i, j, mismatches = 0;
+
+	SV_ClearUnlagHistory();
+	TASSERT_EQi( SV_FindUnlagSample( time ), -1 );
+
+	// wrap the ring a few times, with some frames sharing the time
+	for( i = 0; i < SV_UNLAG_HISTORY * 3 + 17; i++ )
+	{
+		sv_unlag_history.head = ( sv_unlag_history.head + 1 ) & SV_UNLAG_MASK;
+		sv_unlag_history.time[sv_unlag_history.head] = time;
+		sv_unlag_history.count = Q_min( sv_unlag_history.count + 1, SV_UNLAG_HISTORY );
+
+		if( COM_RandomLong( 0, 7 ))
+			time += COM_RandomFloat( 0.001f, 0.05f );
+
+		for( j = 0; j < 4; j++ )
+		{
+			double	search = time - COM_RandomFloat( -0.1f, 1.0f );
+
+			if( SV_FindUnlagSample( search ) != Test_FindUnlagSampleLinear( search ))
+				mismatches++;
+		}
+	}
+
+	TASSERT_EQi( mismatches, 0 );
+	TASSERT_EQi( SV_FindUnlagSample( time + 1.0 ), sv_unlag_history.head );
+
+	SV_ClearUnlagHistory();
+}
+
+#define TEST_UNLAG_CLIENTS	5
+
+static void Test_UnlagRecordFrame( edict_t *ents, const qboolean *present, double time )
+{
+	int	i, cur = SV_AdvanceUnlagHistory( time );
+
+	for( i = 0; i < TEST_UNLAG_CLIENTS; i++ )
+		SV_RecordUnlagOrigin( i, present[i] ? &ents[i] : NULL, ( cur - 1 ) & SV_UNLAG_MASK, cur );
+}
+
+static qboolean Test_UnlagRewind( edict_t *ents, int client, float finalpush, vec3_t out )
+{
+	int	sample = SV_FindUnlagSample( finalpush );
+
+	if( sample == -1 )
+		return false;
+
+	return SV_UnlagHistoryOrigin( client, sample, finalpush, ents[client].v.origin, out );
+}
+
+static void Test_UnlagRecord( void )
+{
+	edict_t		ents[TEST_UNLAG_CLIENTS];
+	qboolean	present[TEST_UNLAG_CLIENTS];
+	vec3_t		out;
+	int		i, frame;
+
+	SV_ClearUnlagHistory();
+	TASSERT( sv_unlag_history.origin == NULL );
+	SV_AllocUnlagHistory();
+	memset( ents, 0, sizeof( ents ));
+
+	for( i = 0; i < TEST_UNLAG_CLIENTS; i++ )
+	{
+		ents[i].v.health = 100.0f;
+		ents[i].v.origin[1] = i * 128.0f;
+		present[i] = true;
+	}
+
+	// ten frames from 10.0 to 10.9
+	for( frame = 0; frame < 10; frame++ )
+	{
+		// 0 walks, 1 stands still
+		ents[0].v.origin[0] = frame * 8.0f;
+
+		// 2 teleports between 10.5 and 10.6
+		ents[2].v.origin[0] = frame * 8.0f + ( frame >= 6 ? 1000.0f : 0.0f );
+
+		// 3 is dead from 10.3 to 10.6, respawns in the other place
+		ents[3].v.health = ( frame >= 3 && frame <= 6 ) ? 0.0f : 100.0f;
+		ents[3].v.origin[0] = frame * 8.0f + ( frame >= 7 ? 500.0f : 0.0f );
+
+		// 4 disconnects at 10.4, another player takes the slot at 10.6
+		present[4] = frame < 4 || frame >= 6;
+		ents[4].v.origin[0] = frame * 8.0f + ( frame >= 6 ? -700.0f : 0.0f );
+
+		Test_UnlagRecordFrame( ents, present, 10.0 + frame * 0.1 );
+	}
+
+	// in between of samples
+	TASSERT( Test_UnlagRewind( ents, 0, 10.45f, out ));
+	TASSERT( fabs( out[0] - 36.0f ) < 0.01f );
+	TASSERT( out[1] == 0.0f );
+
+	// too old
+	TASSERT( !Test_UnlagRewind( ents, 0, 9.95f, out ));
+
+	// hasn't moved
+	TASSERT( !Test_UnlagRewind( ents, 1, 10.45f, out ));
+
+	// not before teleport, but after it
+	TASSERT( !Test_UnlagRewind( ents, 2, 10.45f, out ));
+	TASSERT( Test_UnlagRewind( ents, 2, 10.65f, out ));
+	TASSERT( fabs( out[0] - 1052.0f ) < 0.01f );
+
+	// not while dead and not from before respawn
+	TASSERT( !Test_UnlagRewind( ents, 3, 10.25f, out ));
+	TASSERT( !Test_UnlagRewind( ents, 3, 10.55f, out ));
+	TASSERT( !Test_UnlagRewind( ents, 3, 10.65f, out ));
+	TASSERT( Test_UnlagRewind( ents, 3, 10.75f, out ));
+	TASSERT( fabs( out[0] - 560.0f ) < 0.01f );
+
+	// old player in the slot is never applied to the new one
+	TASSERT( !Test_UnlagRewind( ents, 4, 10.15f, out ));
+	TASSERT( !Test_UnlagRewind( ents, 4, 10.55f, out ));
+	TASSERT( Test_UnlagRewind( ents, 4, 10.65f, out ));
+	TASSERT( fabs( out[0] + 648.0f ) < 0.01f );
+
+	SV_ClearUnlagHistory();
+	TASSERT( sv_unlag_history.origin == NULL );
+}
+
+void Test_RunUnlagHistory( void )
+{
+	TRUN( Test_UnlagHistory() );
+	TRUN( Test_UnlagRecord() );
+}
+#endif /* XASH_ENGINE_TESTS */
@@ -2091,7 +2091,7 @@ qboolean SV_LoadGame( const char *pPath )
 		return false;
 
 	svs.initialized = true;
-	pFile = FS_Open( pPath, "rb", true );
+	pFile = FS_Open( pPath, "rbS", true );
 
 	if( pFile )
 	{
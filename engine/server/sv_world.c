@@ -25,6 +25,8 @@ typedef struct moveclip_s
 	float		*mins, *maxs;	// size of the moving object
 	vec3_t		mins2, maxs2;	// size when clipping against mosnters
 	const float	*start, *end;
+	vec3_t		trace_endpos;	// where world trace ended
+	float		trace_fraction;
 	edict_t		*passedict;
 	trace_t		trace;
 	int		type;		// move type
@@ -462,316 +464,1371 @@ static areanode_t *SV_CreateAreaNode( int depth, vec3_t mins, vec3_t maxs )
 }
 
 /*
-===============
-SV_ClearWorld
+===============================================================================
 
-===============
+TRACE RECORDING
+
+stream of SV_Move calls that can be replayed by sv_trace_bench
+
+===============================================================================
 */
-void SV_ClearWorld( void )
+#define TRACEFILE_IDENT	(('C'<<24)+('R'<<16)+('T'<<8)+'X') // little-endian "XTRC"
+#define TRACEFILE_VERSION	1
+
+typedef struct tracefileheader_s
 {
-	int	i;
+	int	ident;
+	int	version;
+} tracefileheader_t;
 
-	SV_InitBoxHull(); // for box testing
+typedef struct tracerecord_s
+{
+	vec3_t	start, end;
+	vec3_t	mins, maxs;
+	int	type;
+	int	passent;		// -1 if there is none
+	int	monsterclip;
+} tracerecord_t;
 
-	// clear lightstyles
-	for( i = 0; i < MAX_LIGHTSTYLES; i++ )
-	{
-		sv.lightstyles[i].value = 256.0f;
-		sv.lightstyles[i].time = 0.0f;
-	}
+static struct
+{
+	file_t	*file;
+	int	numtraces;
+} sv_tracerecord;
 
-	memset( sv_areanodes, 0, sizeof( sv_areanodes ));
-	iTouchLinkSemaphore = 0;
-	sv_numareanodes = 0;
+/*
+===============
+SV_StopTraceRecord
 
-	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
+===============
+*/
+static void SV_StopTraceRecord( void )
+{
+	if( !sv_tracerecord.file )
+		return;
+
+	FS_Close( sv_tracerecord.file );
+	Con_Printf( "recorded %i traces\n", sv_tracerecord.numtraces );
+	memset( &sv_tracerecord, 0, sizeof( sv_tracerecord ));
 }
 
 /*
 ===============
-SV_UnlinkEdict
+SV_RecordTrace
+
 ===============
 */
-void SV_UnlinkEdict( edict_t *ent )
+static void SV_RecordTrace( const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip )
 {
-	// not linked in anywhere
-	if( !ent->area.prev ) return;
-
-	RemoveLink( &ent->area );
-	ent->area.prev = NULL;
-	ent->area.next = NULL;
+	tracerecord_t	rec;
+
+	VectorCopy( start, rec.start );
+	VectorCopy( end, rec.end );
+	VectorCopy( mins, rec.mins );
+	VectorCopy( maxs, rec.maxs );
+	rec.type = type;
+	rec.passent = SV_IsValidEdict( e ) ? NUM_FOR_EDICT( e ) : -1;
+	rec.monsterclip = monsterclip;
+
+	FS_Write( sv_tracerecord.file, &rec, sizeof( rec ));
+	sv_tracerecord.numtraces++;
 }
 
 /*
-====================
-SV_TouchLinks
-====================
+===============
+SV_TraceRecord_f
+
+===============
 */
-static void SV_TouchLinks( edict_t *ent, areanode_t *node )
+void SV_TraceRecord_f( void )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
-	hull_t	*hull;
-	vec3_t	test, offset;
-	model_t	*mod;
+	tracefileheader_t	header;
 
-	// touch linked edicts
-	for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = next )
-	{
-		next = l->next;
-		touch = EDICT_FROM_AREA( l );
+	SV_StopTraceRecord();
 
-		if( svgame.physFuncs.SV_TriggerTouch != NULL )
-		{
-			// user dll can override trigger checking (Xash3D extension)
-			if( !svgame.physFuncs.SV_TriggerTouch( ent, touch ))
-				continue;
-		}
-		else
-		{
-			if( touch == ent || touch->v.solid != SOLID_TRIGGER ) // disabled ?
-				continue;
+	if( Cmd_Argc() < 2 )
+		return;
 
-			if( touch->v.groupinfo && ent->v.groupinfo )
-			{
-				if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
-					continue;
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "server is not running\n" );
+		return;
+	}
 
-				if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
-					continue;
-			}
+	sv_tracerecord.file = FS_Open( Cmd_Argv( 1 ), "wb", true );
+	if( !sv_tracerecord.file )
+	{
+		Con_Printf( S_ERROR "couldn't open %s\n", Cmd_Argv( 1 ));
+		return;
+	}
 
-			if( !BoundsIntersect( ent->v.absmin, ent->v.absmax, touch->v.absmin, touch->v.absmax ))
-				continue;
+	header.ident = TRACEFILE_IDENT;
+	header.version = TRACEFILE_VERSION;
+	FS_Write( sv_tracerecord.file, &header, sizeof( header ));
 
-			mod = SV_ModelHandle( touch->v.modelindex );
+	Con_Printf( "recording traces to %s, run sv_trace_record without arguments to stop\n", Cmd_Argv( 1 ));
+}
 
-			// check brush triggers accuracy
-			if( mod && mod->type == mod_brush )
-			{
-				// force to select bsp-hull
-				hull = SV_HullForBsp( touch, ent->v.mins, ent->v.maxs, offset );
+/*
+===============================================================================
 
-				// support for rotational triggers
-				if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
-				{
-					matrix4x4	matrix;
-					Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
-					Matrix4x4_VectorITransform( matrix, ent->v.origin, test );
-				}
-				else
-				{
-					// offset the test point appropriately for this hull.
-					VectorSubtract( ent->v.origin, offset, test );
-				}
+ENTITY AREA TREE
 
-				// test hull for intersection with this model
-				if( PM_HullPointContents( hull, hull->firstclipnode, test ) != CONTENTS_SOLID )
-					continue;
-			}
-		}
+dynamic bounding box tree over linked edicts, separate for solid, trigger
+and portal entities. leaf boxes are fattened, so entities that move a bit
+every frame don't have to be reinserted. area nodes are still filled for
+physics interface mods that walk them from SV_GetHeadNode
 
-		// never touch the triggers when "playersonly" is active
-		if( !sv.playersonly )
-		{
-			svgame.globals->time = sv.time;
-			svgame.dllFuncs.pfnTouch( touch, ent );
-		}
-	}
+===============================================================================
+*/
+#define AREATREE_NULL	-1
+#define AREATREE_MARGIN	16.0f	// leaf boxes are grown by this on every side
+#define AREATREE_STACK	256
+#define AREATREE_QUERY	256	// candidates that fit into query without allocation
+#define SV_MOVE_BATCH	32	// moves clipped together by SV_MoveBatch
 
-	// recurse down both sides
-	if( node->axis == -1 ) return;
+enum
+{
+	AREATREE_SOLID = 0,
+	AREATREE_TRIGGER,
+	AREATREE_PORTAL,
+	AREATREE_COUNT
+};
 
-	if( ent->v.absmax[node->axis] > node->dist )
-		SV_TouchLinks( ent, node->children[0] );
-	if( ent->v.absmin[node->axis] < node->dist )
-		SV_TouchLinks( ent, node->children[1] );
-}
+typedef struct areatreenode_s
+{
+	vec3_t	mins, maxs;
+	int	parent;		// next free node when unused
+	int	children[2];
+	int	height;		// 0 for leafs
+	int	edict;		// leafs only
+} areatreenode_t;
+
+typedef struct areaquery_s
+{
+	int	count;
+	int	maxcount;
+	int	*edicts;
+	int	local[AREATREE_QUERY];
+} areaquery_t;
+
+static struct
+{
+	areatreenode_t	*nodes;
+	int		numnodes;
+	int		freenode;
+	int		roots[AREATREE_COUNT];
+	int		maxedicts;
+	int		*leafs;		// [maxedicts] leaf node of edict
+	byte		*trees;		// [maxedicts] tree that leaf is in
+	int		traces;		// stats since last update
+	int		candidates;
+	double		nextstats;
+} sv_areatree;
 
 /*
 ===============
-SV_FindTouchedLeafs
+SV_AreaTreeAllocNode
 
 ===============
 */
-static void SV_FindTouchedLeafs( edict_t *ent, mnode_t *node, int *headnode )
+static int SV_AreaTreeAllocNode( void )
 {
-	int	sides;
-	mleaf_t	*leaf;
+	areatreenode_t	*node;
+	int		i, index;
 
-	if( node->contents == CONTENTS_SOLID )
-		return;
-
-	// add an efrag if the node is a leaf
-	if( node->contents < 0 )
+	if( sv_areatree.freenode == AREATREE_NULL )
 	{
-		if( ent->num_leafs > ( MAX_ENT_LEAFS - 1 ))
-		{
-			// continue counting leafs,
-			// so we know how many it's overrun
-			ent->num_leafs = (MAX_ENT_LEAFS + 1);
-		}
-		else
-		{
-			leaf = (mleaf_t *)node;
-			ent->leafnums[ent->num_leafs] = leaf->cluster;
-			ent->num_leafs++;
-		}
-		return;
+		int	count = Q_max( sv_areatree.numnodes * 2, 256 );
+
+		sv_areatree.nodes = Z_Realloc( sv_areatree.nodes, count * sizeof( areatreenode_t ));
+
+		for( i = sv_areatree.numnodes; i < count - 1; i++ )
+			sv_areatree.nodes[i].parent = i + 1;
+		sv_areatree.nodes[count - 1].parent = AREATREE_NULL;
+
+		sv_areatree.freenode = sv_areatree.numnodes;
+		sv_areatree.numnodes = count;
 	}
 
-	// NODE_MIXED
-	sides = BOX_ON_PLANE_SIDE( ent->v.absmin, ent->v.absmax, node->plane );
+	index = sv_areatree.freenode;
+	node = &sv_areatree.nodes[index];
+	sv_areatree.freenode = node->parent;
 
-	if(( sides == 3 ) && ( *headnode == -1 ))
-		*headnode = node - sv.worldmodel->nodes;
+	node->parent = AREATREE_NULL;
+	node->children[0] = node->children[1] = AREATREE_NULL;
+	node->height = 0;
+	node->edict = 0;
 
-	// recurse down the contacted sides
-	if( sides & 1 ) SV_FindTouchedLeafs( ent, node->children[0], headnode );
-	if( sides & 2 ) SV_FindTouchedLeafs( ent, node->children[1], headnode );
+	return index;
 }
 
 /*
 ===============
-SV_LinkEdict
+SV_AreaTreeFreeNode
+
 ===============
 */
-void GAME_EXPORT SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
+static void SV_AreaTreeFreeNode( int index )
 {
-	areanode_t	*node;
-	int		headnode;
-
-	if( ent->area.prev ) SV_UnlinkEdict( ent );	// unlink from old position
-	if( ent == svgame.edicts ) return;		// don't add the world
-	if( !SV_IsValidEdict( ent )) return;		// never add freed ents
+	sv_areatree.nodes[index].parent = sv_areatree.freenode;
+	sv_areatree.nodes[index].height = -1;
+	sv_areatree.freenode = index;
+}
 
-	// set the abs box
-	svgame.dllFuncs.pfnSetAbsBox( ent );
+/*
+===============
+SV_AreaTreeCost
 
-	if( ent->v.movetype == MOVETYPE_FOLLOW && SV_IsValidEdict( ent->v.aiment ))
-	{
-		memcpy( ent->leafnums, ent->v.aiment->leafnums, sizeof( ent->leafnums ));
-		ent->num_leafs = ent->v.aiment->num_leafs;
-		ent->headnode = ent->v.aiment->headnode;
-	}
-	else
-	{
-		// link to PVS leafs
-		ent->num_leafs = 0;
-		ent->headnode = -1;
-		headnode = -1;
+half of the box surface, chance of being hit by a random query
+===============
+*/
+static float SV_AreaTreeCost( const vec3_t mins, const vec3_t maxs )
+{
+	vec3_t	size;
 
-		if( ent->v.modelindex )
-			SV_FindTouchedLeafs( ent, sv.worldmodel->nodes, &headnode );
+	VectorSubtract( maxs, mins, size );
 
-		if( ent->num_leafs > MAX_ENT_LEAFS )
-		{
-			memset( ent->leafnums, -1, sizeof( ent->leafnums ));
-			ent->num_leafs = 0;	// so we use headnode instead
-			ent->headnode = headnode;
-		}
-	}
+	return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
 
-	// ignore non-solid bodies
-	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
-		return;
+/*
+===============
+SV_AreaTreeUnion
 
-	// find the first node that the ent's box crosses
-	node = sv_areanodes;
+===============
+*/
+static void SV_AreaTreeUnion( const areatreenode_t *a, const areatreenode_t *b, vec3_t mins, vec3_t maxs )
+{
+	int	i;
 
-	while( 1 )
+	for( i = 0; i < 3; i++ )
 	{
-		if( node->axis == -1 ) break;
-		if( ent->v.absmin[node->axis] > node->dist )
-			node = node->children[0];
-		else if( ent->v.absmax[node->axis] < node->dist )
-			node = node->children[1];
-		else break; // crosses the node
+		mins[i] = Q_min( a->mins[i], b->mins[i] );
+		maxs[i] = Q_max( a->maxs[i], b->maxs[i] );
 	}
+}
 
-	// link it in
-	if( ent->v.solid == SOLID_TRIGGER )
-		InsertLinkBefore( &ent->area, &node->trigger_edicts );
-	else if( ent->v.solid == SOLID_PORTAL )
-		InsertLinkBefore( &ent->area, &node->portal_edicts );
-	else InsertLinkBefore( &ent->area, &node->solid_edicts );
+/*
+===============
+SV_AreaTreeRefit
 
-	if( touch_triggers && !iTouchLinkSemaphore )
-	{
-		iTouchLinkSemaphore = true;
-		SV_TouchLinks( ent, sv_areanodes );
-		iTouchLinkSemaphore = false;
-	}
+recalc node box and height from children
+===============
+*/
+static void SV_AreaTreeRefit( int index )
+{
+	areatreenode_t	*node = &sv_areatree.nodes[index];
+	areatreenode_t	*child0 = &sv_areatree.nodes[node->children[0]];
+	areatreenode_t	*child1 = &sv_areatree.nodes[node->children[1]];
+
+	node->height = 1 + Q_max( child0->height, child1->height );
+	SV_AreaTreeUnion( child0, child1, node->mins, node->maxs );
 }
 
 /*
-===============================================================================
-
-POINT TESTING IN HULLS
+===============
+SV_AreaTreeReplaceChild
 
-===============================================================================
+===============
 */
-static void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
+static void SV_AreaTreeReplaceChild( int *root, int parent, int oldchild, int newchild )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
-	hull_t	*hull;
-	vec3_t	test, offset;
-	model_t	*mod;
+	areatreenode_t	*node;
 
-	// get water edicts
-	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	if( parent == AREATREE_NULL )
 	{
-		next = l->next;
-		touch = EDICT_FROM_AREA( l );
-
-		if( touch->v.solid != SOLID_NOT ) // disabled ?
-			continue;
+		*root = newchild;
+		return;
+	}
 
-		if( touch->v.groupinfo )
-		{
-			if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, svs.groupmask ))
-				continue;
+	node = &sv_areatree.nodes[parent];
 
-			if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, svs.groupmask ))
-				continue;
-		}
+	if( node->children[0] == oldchild )
+		node->children[0] = newchild;
+	else node->children[1] = newchild;
+}
 
-		mod = SV_ModelHandle( touch->v.modelindex );
+/*
+===============
+SV_AreaTreeBalance
 
-		// only brushes can have special contents
-		if( !mod || mod->type != mod_brush )
-			continue;
+rotates the higher grandchild of unbalanced node up,
+returns index of node that took its place
+===============
+*/
+static int SV_AreaTreeBalance( int *root, int index )
+{
+	areatreenode_t	*nodes = sv_areatree.nodes;
+	areatreenode_t	*a = &nodes[index];
+	areatreenode_t	*c, *f, *g;
+	int		ib, ic, ifc, igc, side, balance;
+
+	// height of a is not refit yet, look at the children only
+	ib = a->children[0];
+	ic = a->children[1];
+	balance = nodes[ic].height - nodes[ib].height;
+
+	if( balance >= -1 && balance <= 1 )
+		return index;
+
+	// c is the higher child going up, b stays with a
+	if( balance < 0 )
+		ic = ib;
+
+	side = ( a->children[0] == ic ) ? 0 : 1;
+	c = &nodes[ic];
+	ifc = c->children[0];
+	igc = c->children[1];
+	f = &nodes[ifc];
+	g = &nodes[igc];
+
+	// swap a and c
+	c->children[0] = index;
+	c->parent = a->parent;
+	a->parent = ic;
+	SV_AreaTreeReplaceChild( root, c->parent, index, ic );
+
+	// the higher grandchild stays with c, the other one goes to a
+	if( f->height < g->height )
+	{
+		int	tmp = ifc;
 
-		if( !BoundsIntersect( origin, origin, touch->v.absmin, touch->v.absmax ))
-			continue;
+		ifc = igc;
+		igc = tmp;
+	}
 
-		// check water brushes accuracy
-		hull = SV_HullForBsp( touch, vec3_origin, vec3_origin, offset );
+	c->children[1] = ifc;
+	a->children[side] = igc;
+	nodes[igc].parent = index;
 
-		// support for rotational water
-		if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
-		{
-			matrix4x4	matrix;
-			Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
-			Matrix4x4_VectorITransform( matrix, origin, test );
-		}
-		else
-		{
-			// offset the test point appropriately for this hull.
-			VectorSubtract( origin, offset, test );
-		}
+	SV_AreaTreeRefit( index );
+	SV_AreaTreeRefit( ic );
 
-		// test hull for intersection with this model
-		if( PM_HullPointContents( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
-			continue;
+	return ic;
+}
 
-		// compare contents ranking
-		if( RankForContents( touch->v.skin ) > RankForContents( *pCont ))
-			*pCont = touch->v.skin; // new content has more priority
-	}
+/*
+===============
+SV_AreaTreeFixParents
 
-	// recurse down both sides
+walks up from node restoring boxes and balance
+===============
+*/
+static void SV_AreaTreeFixParents( int *root, int index )
+{
+	while( index != AREATREE_NULL )
+	{
+		index = SV_AreaTreeBalance( root, index );
+		SV_AreaTreeRefit( index );
+		index = sv_areatree.nodes[index].parent;
+	}
+}
+
+/*
+===============
+SV_AreaTreeInsertLeaf
+
+===============
+*/
+static void SV_AreaTreeInsertLeaf( int *root, int leaf )
+{
+	areatreenode_t	*nodes;
+	int		index, parent, sibling;
+	vec3_t		mins, maxs;
+
+	if( *root == AREATREE_NULL )
+	{
+		*root = leaf;
+		sv_areatree.nodes[leaf].parent = AREATREE_NULL;
+		return;
+	}
+
+	// new parent must be allocated first, nodes can be moved
+	parent = SV_AreaTreeAllocNode();
+	nodes = sv_areatree.nodes;
+
+	// find the sibling that grows the tree least
+	for( index = *root; nodes[index].height > 0; )
+	{
+		float	area, cost, inherit, childcost[2];
+		int	i;
+
+		area = SV_AreaTreeCost( nodes[index].mins, nodes[index].maxs );
+		SV_AreaTreeUnion( &nodes[index], &nodes[leaf], mins, maxs );
+		cost = 2.0f * SV_AreaTreeCost( mins, maxs );
+
+		// going further down grows this node anyway
+		inherit = cost - 2.0f * area;
+
+		for( i = 0; i < 2; i++ )
+		{
+			areatreenode_t	*child = &nodes[nodes[index].children[i]];
+
+			SV_AreaTreeUnion( child, &nodes[leaf], mins, maxs );
+			childcost[i] = SV_AreaTreeCost( mins, maxs ) + inherit;
+			if( child->height > 0 )
+				childcost[i] -= SV_AreaTreeCost( child->mins, child->maxs );
+		}
+
+		if( cost < childcost[0] && cost < childcost[1] )
+			break;
+
+		index = nodes[index].children[childcost[0] < childcost[1] ? 0 : 1];
+	}
+
+	sibling = index;
+	nodes[parent].parent = nodes[sibling].parent;
+	nodes[parent].children[0] = sibling;
+	nodes[parent].children[1] = leaf;
+	SV_AreaTreeReplaceChild( root, nodes[sibling].parent, sibling, parent );
+	nodes[sibling].parent = parent;
+	nodes[leaf].parent = parent;
+
+	SV_AreaTreeFixParents( root, parent );
+}
+
+/*
+===============
+SV_AreaTreeRemoveLeaf
+
+===============
+*/
+static void SV_AreaTreeRemoveLeaf( int *root, int leaf )
+{
+	areatreenode_t	*nodes = sv_areatree.nodes;
+	int		parent, grandparent, sibling;
+
+	if( leaf == *root )
+	{
+		*root = AREATREE_NULL;
+		return;
+	}
+
+	parent = nodes[leaf].parent;
+	grandparent = nodes[parent].parent;
+	sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+
+	// sibling takes place of the parent
+	SV_AreaTreeReplaceChild( root, grandparent, parent, sibling );
+	nodes[sibling].parent = grandparent;
+	SV_AreaTreeFreeNode( parent );
+
+	SV_AreaTreeFixParents( root, grandparent );
+}
+
+/*
+===============
+SV_AreaTreeUnlinkEdict
+
+===============
+*/
+static void SV_AreaTreeUnlinkEdict( edict_t *ent )
+{
+	int	e = NUM_FOR_EDICT( ent );
+	int	leaf;
+
+	if( !sv_areatree.leafs || e < 0 || e >= sv_areatree.maxedicts )
+		return;
+
+	leaf = sv_areatree.leafs[e];
+	if( leaf == AREATREE_NULL )
+		return;
+
+	SV_AreaTreeRemoveLeaf( &sv_areatree.roots[sv_areatree.trees[e]], leaf );
+	SV_AreaTreeFreeNode( leaf );
+	sv_areatree.leafs[e] = AREATREE_NULL;
+}
+
+/*
+===============
+SV_AreaTreeLinkEdict
+
+moves the edict leaf if it left the fattened box
+===============
+*/
+static void SV_AreaTreeLinkEdict( edict_t *ent, int tree )
+{
+	int		e = NUM_FOR_EDICT( ent );
+	areatreenode_t	*node;
+	int		i, leaf;
+
+	if( !sv_areatree.leafs || e < 0 || e >= sv_areatree.maxedicts )
+		return;
+
+	leaf = sv_areatree.leafs[e];
+
+	if( leaf != AREATREE_NULL )
+	{
+		node = &sv_areatree.nodes[leaf];
+
+		if( sv_areatree.trees[e] == tree )
+		{
+			for( i = 0; i < 3; i++ )
+			{
+				// left the box or fat box is too big since entity shrunk
+				if( ent->v.absmin[i] < node->mins[i] || ent->v.absmax[i] > node->maxs[i] )
+					break;
+				if( ent->v.absmin[i] - node->mins[i] > AREATREE_MARGIN * 4.0f )
+					break;
+				if( node->maxs[i] - ent->v.absmax[i] > AREATREE_MARGIN * 4.0f )
+					break;
+			}
+
+			if( i == 3 )
+				return;
+		}
+
+		SV_AreaTreeRemoveLeaf( &sv_areatree.roots[sv_areatree.trees[e]], leaf );
+	}
+	else
+	{
+		leaf = SV_AreaTreeAllocNode();
+		sv_areatree.nodes[leaf].edict = e;
+		sv_areatree.leafs[e] = leaf;
+	}
+
+	node = &sv_areatree.nodes[leaf];
+
+	for( i = 0; i < 3; i++ )
+	{
+		node->mins[i] = ent->v.absmin[i] - AREATREE_MARGIN;
+		node->maxs[i] = ent->v.absmax[i] + AREATREE_MARGIN;
+	}
+
+	sv_areatree.trees[e] = tree;
+	SV_AreaTreeInsertLeaf( &sv_areatree.roots[tree], leaf );
+}
+
+/*
+===============
+SV_AreaTreeCompare
+
+===============
+*/
+static int SV_AreaTreeCompare( const void *a, const void *b )
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/*
+===============
+SV_AreaQueryInit
+
+===============
+*/
+static void SV_AreaQueryInit( areaquery_t *query )
+{
+	query->count = 0;
+	query->maxcount = AREATREE_QUERY;
+	query->edicts = query->local;
+}
+
+/*
+===============
+SV_AreaQueryAdd
+
+===============
+*/
+static void SV_AreaQueryAdd( areaquery_t *query, int e )
+{
+	if( query->count == query->maxcount )
+	{
+		int	*edicts = Z_Malloc( query->maxcount * 2 * sizeof( int ));
+
+		memcpy( edicts, query->edicts, query->count * sizeof( int ));
+		if( query->edicts != query->local )
+			Z_Free( query->edicts );
+
+		query->edicts = edicts;
+		query->maxcount *= 2;
+	}
+
+	query->edicts[query->count++] = e;
+}
+
+/*
+===============
+SV_AreaQueryFree
+
+===============
+*/
+static void SV_AreaQueryFree( areaquery_t *query )
+{
+	if( query->edicts != query->local )
+		Z_Free( query->edicts );
+}
+
+/*
+===============
+SV_AreaTreeQuery
+
+collects edicts which fattened boxes intersect the given box,
+sorted by number, so results don't depend on the tree shape.
+caller must check edicts, they could be changed by callbacks
+===============
+*/
+static void SV_AreaTreeQuery( int tree, const vec3_t mins, const vec3_t maxs, areaquery_t *query )
+{
+	int		stack[AREATREE_STACK];
+	int		sp = 0;
+	areatreenode_t	*node;
+
+	SV_AreaQueryInit( query );
+
+	if( sv_areatree.roots[tree] == AREATREE_NULL )
+		return;
+
+	stack[sp++] = sv_areatree.roots[tree];
+
+	while( sp > 0 )
+	{
+		node = &sv_areatree.nodes[stack[--sp]];
+
+		if( !BoundsIntersect( mins, maxs, node->mins, node->maxs ))
+			continue;
+
+		if( node->height > 0 )
+		{
+			if( sp + 2 > AREATREE_STACK )
+				Host_Error( "%s: stack overflow\n", __func__ );
+
+			stack[sp++] = node->children[1];
+			stack[sp++] = node->children[0];
+			continue;
+		}
+
+		SV_AreaQueryAdd( query, node->edict );
+	}
+
+	if( query->count > 1 )
+		qsort( query->edicts, query->count, sizeof( int ), SV_AreaTreeCompare );
+}
+
+/*
+===============
+SV_InitAreaTree
+
+===============
+*/
+static void SV_InitAreaTree( void )
+{
+	int	i, maxedicts = GI->max_edicts;
+
+	if( sv_areatree.maxedicts != maxedicts )
+	{
+		sv_areatree.maxedicts = maxedicts;
+		sv_areatree.leafs = Z_Realloc( sv_areatree.leafs, maxedicts * sizeof( int ));
+		sv_areatree.trees = Z_Realloc( sv_areatree.trees, maxedicts );
+	}
+
+	// put all nodes back to the free list
+	for( i = 0; i < sv_areatree.numnodes; i++ )
+		sv_areatree.nodes[i].parent = ( i + 1 < sv_areatree.numnodes ) ? i + 1 : AREATREE_NULL;
+	sv_areatree.freenode = sv_areatree.numnodes ? 0 : AREATREE_NULL;
+
+	for( i = 0; i < AREATREE_COUNT; i++ )
+		sv_areatree.roots[i] = AREATREE_NULL;
+
+	for( i = 0; i < maxedicts; i++ )
+		sv_areatree.leafs[i] = AREATREE_NULL;
+}
+
+/*
+===============
+SV_FreeAreaTree
+
+===============
+*/
+void SV_FreeAreaTree( void )
+{
+	SV_StopTraceRecord();
+
+	if( sv_areatree.nodes ) Z_Free( sv_areatree.nodes );
+	if( sv_areatree.leafs ) Z_Free( sv_areatree.leafs );
+	if( sv_areatree.trees ) Z_Free( sv_areatree.trees );
+	memset( &sv_areatree, 0, sizeof( sv_areatree ));
+}
+
+/*
+===============
+SV_UpdateAreaStats
+
+===============
+*/
+void SV_UpdateAreaStats( void )
+{
+	if( sv_areatree.nextstats > host.realtime )
+		return;
+
+	Cvar_FullSet( "sv_area_tree_stats", va( "%i traces, %.1f candidates per trace (%s)", sv_areatree.traces,
+		sv_areatree.traces ? (float)sv_areatree.candidates / sv_areatree.traces : 0.0f,
+		sv_area_tree.value ? "area tree" : "area nodes" ), FCVAR_READ_ONLY );
+
+	sv_areatree.traces = sv_areatree.candidates = 0;
+	sv_areatree.nextstats = host.realtime + 1.0;
+}
+
+/*
+===============================================================================
+
+ENTITY VISIBILITY INDEX
+
+keeps a list of entities for every world cluster, so client frames
+only have to visit entities that can pass pfnCheckVisibility
+
+===============================================================================
+*/
+#define ENTINDEX_NONE	0	// never linked or can't be indexed, always visited
+#define ENTINDEX_LEAFS	1	// linked to the cluster lists
+
+static struct
+{
+	int	numclusters;
+	int	maxedicts;
+	double	updatetime;	// sv.time when always list was updated
+	qboolean	dirty;		// edict was indexed, unindexed or freed since update
+	int	*heads;		// [numclusters] first link in cluster
+	int	*next;		// [maxedicts * MAX_ENT_LEAFS]
+	int	*prev;		// [maxedicts * MAX_ENT_LEAFS]
+	int	*clusters;	// [maxedicts * MAX_ENT_LEAFS]
+	byte	*state;		// [maxedicts]
+	byte	*numlinks;	// [maxedicts]
+	uint32_t	*always;		// [maxedicts / 32] entities to visit regardless of PVS
+} sv_entindex;
+
+/*
+===============
+SV_InitEntityIndex
+
+===============
+*/
+static void SV_InitEntityIndex( void )
+{
+	int	maxedicts = GI->max_edicts;
+	int	numlinks = maxedicts * MAX_ENT_LEAFS;
+	int	i;
+
+	if( sv_entindex.maxedicts != maxedicts )
+	{
+		sv_entindex.maxedicts = maxedicts;
+		sv_entindex.next = Z_Realloc( sv_entindex.next, numlinks * sizeof( int ));
+		sv_entindex.prev = Z_Realloc( sv_entindex.prev, numlinks * sizeof( int ));
+		sv_entindex.clusters = Z_Realloc( sv_entindex.clusters, numlinks * sizeof( int ));
+		sv_entindex.state = Z_Realloc( sv_entindex.state, maxedicts );
+		sv_entindex.numlinks = Z_Realloc( sv_entindex.numlinks, maxedicts );
+		sv_entindex.always = Z_Realloc( sv_entindex.always, (( maxedicts + 31 ) >> 5 ) * sizeof( uint32_t ));
+	}
+
+	sv_entindex.numclusters = Q_min( sv.worldmodel->numleafs, world.visbytes << 3 );
+	sv_entindex.heads = Z_Realloc( sv_entindex.heads, Q_max( sv_entindex.numclusters, 1 ) * sizeof( int ));
+	sv_entindex.updatetime = -1.0;
+	sv_entindex.dirty = true;
+
+	for( i = 0; i < sv_entindex.numclusters; i++ )
+		sv_entindex.heads[i] = -1;
+
+	memset( sv_entindex.state, ENTINDEX_NONE, maxedicts );
+	memset( sv_entindex.numlinks, 0, maxedicts );
+}
+
+/*
+===============
+SV_FreeEntityIndex
+
+===============
+*/
+void SV_FreeEntityIndex( void )
+{
+	if( sv_entindex.heads ) Z_Free( sv_entindex.heads );
+	if( sv_entindex.next ) Z_Free( sv_entindex.next );
+	if( sv_entindex.prev ) Z_Free( sv_entindex.prev );
+	if( sv_entindex.clusters ) Z_Free( sv_entindex.clusters );
+	if( sv_entindex.state ) Z_Free( sv_entindex.state );
+	if( sv_entindex.numlinks ) Z_Free( sv_entindex.numlinks );
+	if( sv_entindex.always ) Z_Free( sv_entindex.always );
+	memset( &sv_entindex, 0, sizeof( sv_entindex ));
+}
+
+/*
+===============
+SV_UnindexEdict
+
+remove edict from the cluster lists
+===============
+*/
+static void SV_UnindexEdict( int e )
+{
+	int	i, link;
+
+	for( i = 0; i < sv_entindex.numlinks[e]; i++ )
+	{
+		link = e * MAX_ENT_LEAFS + i;
+
+		if( sv_entindex.prev[link] != -1 )
+			sv_entindex.next[sv_entindex.prev[link]] = sv_entindex.next[link];
+		else sv_entindex.heads[sv_entindex.clusters[link]] = sv_entindex.next[link];
+
+		if( sv_entindex.next[link] != -1 )
+			sv_entindex.prev[sv_entindex.next[link]] = sv_entindex.prev[link];
+	}
+
+	sv_entindex.numlinks[e] = 0;
+	sv_entindex.state[e] = ENTINDEX_NONE;
+}
+
+/*
+===============
+SV_IndexEdict
+
+put edict into the lists of clusters it touches,
+called when leafnums was updated
+===============
+*/
+static void SV_IndexEdict( edict_t *ent )
+{
+	int	i, link, cluster;
+	int	e = NUM_FOR_EDICT( ent );
+	qboolean	indexed;
+
+	if( !sv_entindex.heads || e >= sv_entindex.maxedicts )
+		return;
+
+	indexed = sv_entindex.state[e] == ENTINDEX_LEAFS;
+	SV_UnindexEdict( e );
+
+	// headnode checks change leafnums on the fly
+	if( ent->headnode >= 0 )
+	{
+		// moved to always list
+		if( indexed ) sv_entindex.dirty = true;
+		return;
+	}
+
+	for( i = 0; i < ent->num_leafs; i++ )
+	{
+		if( ent->leafnums[i] < 0 || ent->leafnums[i] >= sv_entindex.numclusters )
+			break;
+	}
+
+	if( i != ent->num_leafs )
+	{
+		// out of vis range, leave it in always list
+		if( indexed ) sv_entindex.dirty = true;
+		return;
+	}
+
+	// moved out of always list
+	if( !indexed ) sv_entindex.dirty = true;
+
+	for( i = 0; i < ent->num_leafs; i++ )
+	{
+		link = e * MAX_ENT_LEAFS + i;
+		cluster = ent->leafnums[i];
+
+		sv_entindex.clusters[link] = cluster;
+		sv_entindex.prev[link] = -1;
+		sv_entindex.next[link] = sv_entindex.heads[cluster];
+		if( sv_entindex.next[link] != -1 )
+			sv_entindex.prev[sv_entindex.next[link]] = link;
+		sv_entindex.heads[cluster] = link;
+	}
+
+	sv_entindex.numlinks[e] = ent->num_leafs;
+	sv_entindex.state[e] = ENTINDEX_LEAFS;
+}
+
+/*
+===============
+SV_ResetEdictIndex
+
+called when edict is allocated or freed
+===============
+*/
+void SV_ResetEdictIndex( edict_t *ent )
+{
+	int	e = NUM_FOR_EDICT( ent );
+
+	if( sv_entindex.heads && e >= 0 && e < sv_entindex.maxedicts )
+	{
+		SV_UnindexEdict( e );
+		sv_entindex.dirty = true;
+	}
+}
+
+/*
+===============
+SV_UpdateAlwaysVisible
+
+entities with flags that affect visibility checks in the game dll,
+players and not indexed entities are visited every time
+===============
+*/
+static void SV_UpdateAlwaysVisible( void )
+{
+	int	e, numEntities = Q_min( svgame.numEntities, sv_entindex.maxedicts );
+	edict_t	*ent;
+
+	memset( sv_entindex.always, 0, (( sv_entindex.maxedicts + 31 ) >> 5 ) * sizeof( uint32_t ));
+
+	for( e = 1; e < numEntities; e++ )
+	{
+		ent = EDICT_NUM( e );
+
+		if( ent->free )
+			continue;
+
+		if( e <= svs.maxclients || sv_entindex.state[e] != ENTINDEX_LEAFS
+			|| FBitSet( ent->v.effects, EF_REQUEST_PHS|EF_MERGE_VISIBILITY )
+			|| FBitSet( ent->v.flags, FL_CUSTOMENTITY ))
+			SetBits( sv_entindex.always[e >> 5], BIT( e & 31 ));
+	}
+
+	sv_entindex.updatetime = sv.time;
+	sv_entindex.dirty = false;
+}
+
+/*
+===============
+SV_EntityIndexCandidates
+
+fills candidates bitmask with entities that may be visible from
+pvs, returns false if index can't be used and caller should check everything
+===============
+*/
+qboolean SV_EntityIndexCandidates( const byte *pvs, uint32_t *candidates )
+{
+	int	i, bit, link, cluster, numwords;
+
+	if( !pvs || !sv_entindex.heads || svgame.numEntities > sv_entindex.maxedicts )
+		return false;
+
+	// effects and flags are changed by game dll without
+	// telling the engine, check them once per frame
+	if( sv_entindex.dirty || sv_entindex.updatetime != sv.time )
+		SV_UpdateAlwaysVisible();
+
+	numwords = ( svgame.numEntities + 31 ) >> 5;
+	memcpy( candidates, sv_entindex.always, numwords * sizeof( uint32_t ));
+
+	for( i = 0; i < ( sv_entindex.numclusters + 7 ) >> 3; i++ )
+	{
+		if( !pvs[i] )
+			continue;
+
+		for( bit = 0; bit < 8; bit++ )
+		{
+			if( !FBitSet( pvs[i], BIT( bit )))
+				continue;
+
+			cluster = ( i << 3 ) + bit;
+			if( cluster >= sv_entindex.numclusters )
+				break;
+
+			for( link = sv_entindex.heads[cluster]; link != -1; link = sv_entindex.next[link] )
+			{
+				int e = link / MAX_ENT_LEAFS;
+
+				if( !EDICT_NUM( e )->free )
+					SetBits( candidates[e >> 5], BIT( e & 31 ));
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+===============
+SV_ClearWorld
+
+===============
+*/
+void SV_ClearWorld( void )
+{
+	int	i;
+
+	SV_InitBoxHull(); // for box testing
+
+	// clear lightstyles
+	for( i = 0; i < MAX_LIGHTSTYLES; i++ )
+	{
+		sv.lightstyles[i].value = 256.0f;
+		sv.lightstyles[i].time = 0.0f;
+	}
+
+	memset( sv_areanodes, 0, sizeof( sv_areanodes ));
+	iTouchLinkSemaphore = 0;
+	sv_numareanodes = 0;
+
+	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
+	SV_InitAreaTree();
+	SV_StopTraceRecord(); // recorded traces belong to the previous map
+	SV_InitEntityIndex();
+}
+
+/*
+===============
+SV_UnlinkEdict
+===============
+*/
+void SV_UnlinkEdict( edict_t *ent )
+{
+	SV_AreaTreeUnlinkEdict( ent );
+
+	// not linked in anywhere
+	if( !ent->area.prev ) return;
+
+	RemoveLink( &ent->area );
+	ent->area.prev = NULL;
+	ent->area.next = NULL;
+}
+
+/*
+====================
+SV_TouchEdict
+====================
+*/
+static void SV_TouchEdict( edict_t *ent, edict_t *touch )
+{
+	hull_t	*hull;
+	vec3_t	test, offset;
+	model_t	*mod;
+
+	if( svgame.physFuncs.SV_TriggerTouch != NULL )
+	{
+		// user dll can override trigger checking (Xash3D extension)
+		if( !svgame.physFuncs.SV_TriggerTouch( ent, touch ))
+			return;
+	}
+	else
+	{
+		if( touch == ent || touch->v.solid != SOLID_TRIGGER ) // disabled ?
+			return;
+
+		if( touch->v.groupinfo && ent->v.groupinfo )
+		{
+			if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
+				return;
+
+			if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
+				return;
+		}
+
+		if( !BoundsIntersect( ent->v.absmin, ent->v.absmax, touch->v.absmin, touch->v.absmax ))
+			return;
+
+		mod = SV_ModelHandle( touch->v.modelindex );
+
+		// check brush triggers accuracy
+		if( mod && mod->type == mod_brush )
+		{
+			// force to select bsp-hull
+			hull = SV_HullForBsp( touch, ent->v.mins, ent->v.maxs, offset );
+
+			// support for rotational triggers
+			if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
+			{
+				matrix4x4	matrix;
+				Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
+				Matrix4x4_VectorITransform( matrix, ent->v.origin, test );
+			}
+			else
+			{
+				// offset the test point appropriately for this hull.
+				VectorSubtract( ent->v.origin, offset, test );
+			}
+
+			// test hull for intersection with this model
+			if( PM_HullPointContents( hull, hull->firstclipnode, test ) != CONTENTS_SOLID )
+				return;
+		}
+	}
+
+	// never touch the triggers when "playersonly" is active
+	if( !sv.playersonly )
+	{
+		svgame.globals->time = sv.time;
+		svgame.dllFuncs.pfnTouch( touch, ent );
+	}
+}
+
+/*
+====================
+SV_TouchLinks
+====================
+*/
+static void SV_TouchLinks( edict_t *ent, areanode_t *node )
+{
+	link_t	*l, *next;
+
+	// touch linked edicts
+	for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = next )
+	{
+		next = l->next;
+		SV_TouchEdict( ent, EDICT_FROM_AREA( l ));
+	}
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( ent->v.absmax[node->axis] > node->dist )
+		SV_TouchLinks( ent, node->children[0] );
+	if( ent->v.absmin[node->axis] < node->dist )
+		SV_TouchLinks( ent, node->children[1] );
+}
+
+/*
+====================
+SV_TouchTree
+
+triggers are collected first, touch functions can relink them
+====================
+*/
+static void SV_TouchTree( edict_t *ent )
+{
+	areaquery_t	query;
+	edict_t		*touch;
+	int		i;
+
+	SV_AreaTreeQuery( AREATREE_TRIGGER, ent->v.absmin, ent->v.absmax, &query );
+
+	for( i = 0; i < query.count; i++ )
+	{
+		touch = EDICT_NUM( query.edicts[i] );
+
+		// removed by previous touch
+		if( touch->free || !touch->area.prev )
+			continue;
+
+		SV_TouchEdict( ent, touch );
+	}
+
+	SV_AreaQueryFree( &query );
+}
+
+/*
+===============
+SV_FindTouchedLeafs
+
+===============
+*/
+static void SV_FindTouchedLeafs( edict_t *ent, mnode_t *node, int *headnode )
+{
+	int	sides;
+	mleaf_t	*leaf;
+
+	if( node->contents == CONTENTS_SOLID )
+		return;
+
+	// add an efrag if the node is a leaf
+	if( node->contents < 0 )
+	{
+		if( ent->num_leafs > ( MAX_ENT_LEAFS - 1 ))
+		{
+			// continue counting leafs,
+			// so we know how many it's overrun
+			ent->num_leafs = (MAX_ENT_LEAFS + 1);
+		}
+		else
+		{
+			leaf = (mleaf_t *)node;
+			ent->leafnums[ent->num_leafs] = leaf->cluster;
+			ent->num_leafs++;
+		}
+		return;
+	}
+
+	// NODE_MIXED
+	sides = BOX_ON_PLANE_SIDE( ent->v.absmin, ent->v.absmax, node->plane );
+
+	if(( sides == 3 ) && ( *headnode == -1 ))
+		*headnode = node - sv.worldmodel->nodes;
+
+	// recurse down the contacted sides
+	if( sides & 1 ) SV_FindTouchedLeafs( ent, node->children[0], headnode );
+	if( sides & 2 ) SV_FindTouchedLeafs( ent, node->children[1], headnode );
+}
+
+/*
+===============
+SV_LinkEdict
+===============
+*/
+void GAME_EXPORT SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
+{
+	areanode_t	*node;
+	int		headnode;
+
+	// unlink from old position, tree leaf is kept to be moved only if needed
+	if( ent->area.prev )
+	{
+		RemoveLink( &ent->area );
+		ent->area.prev = ent->area.next = NULL;
+	}
+
+	if( ent == svgame.edicts ) return;		// don't add the world
+	if( !SV_IsValidEdict( ent )) return;		// never add freed ents
+
+	// set the abs box
+	svgame.dllFuncs.pfnSetAbsBox( ent );
+
+	if( ent->v.movetype == MOVETYPE_FOLLOW && SV_IsValidEdict( ent->v.aiment ))
+	{
+		memcpy( ent->leafnums, ent->v.aiment->leafnums, sizeof( ent->leafnums ));
+		ent->num_leafs = ent->v.aiment->num_leafs;
+		ent->headnode = ent->v.aiment->headnode;
+	}
+	else
+	{
+		// link to PVS leafs
+		ent->num_leafs = 0;
+		ent->headnode = -1;
+		headnode = -1;
+
+		if( ent->v.modelindex )
+			SV_FindTouchedLeafs( ent, sv.worldmodel->nodes, &headnode );
+
+		if( ent->num_leafs > MAX_ENT_LEAFS )
+		{
+			memset( ent->leafnums, -1, sizeof( ent->leafnums ));
+			ent->num_leafs = 0;	// so we use headnode instead
+			ent->headnode = headnode;
+		}
+	}
+
+	SV_IndexEdict( ent );
+
+	// ignore non-solid bodies
+	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
+	{
+		SV_AreaTreeUnlinkEdict( ent );
+		return;
+	}
+
+	// find the first node that the ent's box crosses
+	node = sv_areanodes;
+
+	while( 1 )
+	{
+		if( node->axis == -1 ) break;
+		if( ent->v.absmin[node->axis] > node->dist )
+			node = node->children[0];
+		else if( ent->v.absmax[node->axis] < node->dist )
+			node = node->children[1];
+		else break; // crosses the node
+	}
+
+	// link it in
+	if( ent->v.solid == SOLID_TRIGGER )
+	{
+		InsertLinkBefore( &ent->area, &node->trigger_edicts );
+		SV_AreaTreeLinkEdict( ent, AREATREE_TRIGGER );
+	}
+	else if( ent->v.solid == SOLID_PORTAL )
+	{
+		InsertLinkBefore( &ent->area, &node->portal_edicts );
+		SV_AreaTreeLinkEdict( ent, AREATREE_PORTAL );
+	}
+	else
+	{
+		InsertLinkBefore( &ent->area, &node->solid_edicts );
+		SV_AreaTreeLinkEdict( ent, AREATREE_SOLID );
+	}
+
+	if( touch_triggers && !iTouchLinkSemaphore )
+	{
+		iTouchLinkSemaphore = true;
+		if( sv_area_tree.value )
+			SV_TouchTree( ent );
+		else SV_TouchLinks( ent, sv_areanodes );
+		iTouchLinkSemaphore = false;
+	}
+}
+
+/*
+===============================================================================
+
+POINT TESTING IN HULLS
+
+===============================================================================
+*/
+/*
+====================
+SV_WaterEdictContents
+
+====================
+*/
+static void SV_WaterEdictContents( const vec3_t origin, int *pCont, edict_t *touch )
+{
+	hull_t	*hull;
+	vec3_t	test, offset;
+	model_t	*mod;
+
+	if( touch->v.solid != SOLID_NOT ) // disabled ?
+		return;
+
+	if( touch->v.groupinfo )
+	{
+		if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, svs.groupmask ))
+			return;
+
+		if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, svs.groupmask ))
+			return;
+	}
+
+	mod = SV_ModelHandle( touch->v.modelindex );
+
+	// only brushes can have special contents
+	if( !mod || mod->type != mod_brush )
+		return;
+
+	if( !BoundsIntersect( origin, origin, touch->v.absmin, touch->v.absmax ))
+		return;
+
+	// check water brushes accuracy
+	hull = SV_HullForBsp( touch, vec3_origin, vec3_origin, offset );
+
+	// support for rotational water
+	if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
+	{
+		matrix4x4	matrix;
+		Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
+		Matrix4x4_VectorITransform( matrix, origin, test );
+	}
+	else
+	{
+		// offset the test point appropriately for this hull.
+		VectorSubtract( origin, offset, test );
+	}
+
+	// test hull for intersection with this model
+	if( PM_HullPointContents( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
+		return;
+
+	// compare contents ranking
+	if( RankForContents( touch->v.skin ) > RankForContents( *pCont ))
+		*pCont = touch->v.skin; // new content has more priority
+}
+
+/*
+====================
+SV_WaterLinks
+
+====================
+*/
+static void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
+{
+	link_t	*l, *next;
+
+	// get water edicts
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	{
+		next = l->next;
+		SV_WaterEdictContents( origin, pCont, EDICT_FROM_AREA( l ));
+	}
+
+	// recurse down both sides
 	if( node->axis == -1 ) return;
 
 	if( origin[node->axis] > node->dist )
@@ -780,6 +1837,25 @@ static void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
 		SV_WaterLinks( origin, pCont, node->children[1] );
 }
 
+/*
+====================
+SV_WaterTree
+
+====================
+*/
+static void SV_WaterTree( const vec3_t origin, int *pCont )
+{
+	areaquery_t	query;
+	int		i;
+
+	SV_AreaTreeQuery( AREATREE_SOLID, origin, origin, &query );
+
+	for( i = 0; i < query.count; i++ )
+		SV_WaterEdictContents( origin, pCont, EDICT_NUM( query.edicts[i] ));
+
+	SV_AreaQueryFree( &query );
+}
+
 /*
 =============
 SV_TruePointContents
@@ -797,7 +1873,9 @@ int SV_TruePointContents( const vec3_t p )
 	cont = PM_HullPointContents( &sv.worldmodel->hulls[0], 0, p );
 
 	// check all water entities
-	SV_WaterLinks( p, &cont, sv_areanodes );
+	if( sv_area_tree.value )
+		SV_WaterTree( p, &cont );
+	else SV_WaterLinks( p, &cont, sv_areanodes );
 
 	return cont;
 }
@@ -1107,6 +2185,8 @@ static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
 	trace_t	trace;
 	model_t	*mod;
 
+	sv_areatree.candidates++;
+
 	if( touch->v.groupinfo && SV_IsValidEdict( clip->passedict ) && clip->passedict->v.groupinfo != 0 )
 	{
 		if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, clip->passedict->v.groupinfo ))
@@ -1194,170 +2274,544 @@ static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
 		SV_ClipMoveToEntity( touch, clip->start, clip->mins2, clip->maxs2, clip->end, &trace );
 	else SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
 
-	clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
+	clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
+
+	return true;
+}
+
+/*
+====================
+SV_ClipToLinks
+
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+static void SV_ClipToLinks( areanode_t *node, moveclip_t *clip )
+{
+	link_t	*l, *next;
+	edict_t	*touch;
+
+	// touch linked edicts
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	{
+		next = l->next;
+
+		touch = EDICT_FROM_AREA( l );
+
+		if( !SV_ClipToEntity( touch, clip ))
+			return; // trace.allsoild
+	}
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( clip->boxmaxs[node->axis] > node->dist )
+		SV_ClipToLinks( node->children[0], clip );
+	if( clip->boxmins[node->axis] < node->dist )
+		SV_ClipToLinks( node->children[1], clip );
+}
+
+/*
+====================
+SV_ClipToPortals
+
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+static void SV_ClipToPortals( areanode_t *node, moveclip_t *clip )
+{
+	link_t	*l, *next;
+	edict_t	*touch;
+
+	// touch linked edicts
+	for( l = node->portal_edicts.next; l != &node->portal_edicts; l = next )
+	{
+		next = l->next;
+
+		touch = EDICT_FROM_AREA( l );
+
+		if( !SV_ClipToEntity( touch, clip ))
+			return; // trace.allsoild
+	}
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( clip->boxmaxs[node->axis] > node->dist )
+		SV_ClipToPortals( node->children[0], clip );
+	if( clip->boxmins[node->axis] < node->dist )
+		SV_ClipToPortals( node->children[1], clip );
+}
+
+/*
+====================
+SV_ClipToWorldBrushEdict
+
+====================
+*/
+static qboolean SV_ClipToWorldBrushEdict( edict_t *touch, moveclip_t *clip )
+{
+	trace_t	trace;
+
+	sv_areatree.candidates++;
+
+	if( touch->v.solid != SOLID_BSP || touch == clip->passedict || !( touch->v.flags & FL_WORLDBRUSH ))
+		return true;
+
+	if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
+		return true;
+
+	if( clip->trace.allsolid ) return false;
+
+	SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+
+	clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
+
+	return true;
+}
+
+/*
+====================
+SV_ClipToWorldBrush
+
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+static void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
+{
+	link_t	*l, *next;
+
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	{
+		next = l->next;
+
+		if( !SV_ClipToWorldBrushEdict( EDICT_FROM_AREA( l ), clip ))
+			return; // trace.allsolid
+	}
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( clip->boxmaxs[node->axis] > node->dist )
+		SV_ClipToWorldBrush( node->children[0], clip );
+
+	if( clip->boxmins[node->axis] < node->dist )
+		SV_ClipToWorldBrush( node->children[1], clip );
+}
+
+/*
+====================
+SV_ClipToTree
+
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+static void SV_ClipToTree( int tree, moveclip_t *clip, qboolean (*pfnClip)( edict_t *touch, moveclip_t *clip ))
+{
+	areaquery_t	query;
+	int		i;
+
+	SV_AreaTreeQuery( tree, clip->boxmins, clip->boxmaxs, &query );
+
+	for( i = 0; i < query.count; i++ )
+	{
+		if( !pfnClip( EDICT_NUM( query.edicts[i] ), clip ))
+			break; // trace.allsolid
+	}
+
+	SV_AreaQueryFree( &query );
+}
+
+/*
+====================
+SV_AreaNodesQuery
+
+collects edicts from area nodes crossed by the box,
+in the same order as SV_ClipToLinks visits them
+====================
+*/
+static void SV_AreaNodesQuery( areanode_t *node, qboolean portals, const vec3_t mins, const vec3_t maxs, areaquery_t *query )
+{
+	link_t	*list = portals ? &node->portal_edicts : &node->solid_edicts;
+	link_t	*l;
+
+	for( l = list->next; l != list; l = l->next )
+		SV_AreaQueryAdd( query, NUM_FOR_EDICT( EDICT_FROM_AREA( l )));
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( maxs[node->axis] > node->dist )
+		SV_AreaNodesQuery( node->children[0], portals, mins, maxs, query );
+	if( mins[node->axis] < node->dist )
+		SV_AreaNodesQuery( node->children[1], portals, mins, maxs, query );
+}
+
+/*
+====================
+SV_ClipToCandidates
+
+candidates outside of the move box are skipped before
+SV_ClipToEntity, so unlike SV_Move this never calls
+pfnShouldCollide or checks for triggers on them
+====================
+*/
+static void SV_ClipToCandidates( const areaquery_t *query, moveclip_t *clip )
+{
+	edict_t	*touch;
+	int	i;
+
+	for( i = 0; i < query->count; i++ )
+	{
+		touch = EDICT_NUM( query->edicts[i] );
+
+		if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
+			continue;
+
+		if( !SV_ClipToEntity( touch, clip ))
+			return; // trace.allsolid
+	}
+}
+
+/*
+==================
+SV_BeginMoveClip
+
+clips move against the world, returns false
+if there is nothing left to clip against entities
+==================
+*/
+static qboolean SV_BeginMoveClip( moveclip_t *clip, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip )
+{
+	memset( clip, 0, sizeof( moveclip_t ));
+	SV_ClipMoveToEntity( EDICT_NUM( 0 ), start, mins, maxs, end, &clip->trace );
+
+	if( clip->trace.fraction == 0.0f )
+		return false;
+
+	VectorCopy( clip->trace.endpos, clip->trace_endpos );
+	clip->trace_fraction = clip->trace.fraction;
+	clip->trace.fraction = 1.0f;
+	clip->start = start;
+	clip->end = clip->trace_endpos;
+	clip->type = (type & 0xFF);
+	clip->ignoretrans = type >> 8;
+	clip->monsterclip = false;
+	clip->passedict = (e) ? e : EDICT_NUM( 0 );
+	clip->mins = mins;
+	clip->maxs = maxs;
+
+	if( monsterclip && !FBitSet( host.features, ENGINE_QUAKE_COMPATIBLE ))
+		clip->monsterclip = true;
+
+	if( clip->type == MOVE_MISSILE )
+	{
+		VectorSet( clip->mins2, -15.0f, -15.0f, -15.0f );
+		VectorSet( clip->maxs2,  15.0f,  15.0f,  15.0f );
+	}
+	else
+	{
+		VectorCopy( mins, clip->mins2 );
+		VectorCopy( maxs, clip->maxs2 );
+	}
+
+	World_MoveBounds( start, clip->mins2, clip->maxs2, clip->trace_endpos, clip->boxmins, clip->boxmaxs );
+	sv_areatree.traces++;
 
 	return true;
 }
 
 /*
-====================
-SV_ClipToLinks
+==================
+SV_EndMoveClip
 
-Mins and maxs enclose the entire area swept by the move
-====================
+==================
 */
-static void SV_ClipToLinks( areanode_t *node, moveclip_t *clip )
+static void SV_EndMoveClip( moveclip_t *clip )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
-
-	// touch linked edicts
-	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
-	{
-		next = l->next;
-
-		touch = EDICT_FROM_AREA( l );
-
-		if( !SV_ClipToEntity( touch, clip ))
-			return; // trace.allsoild
-	}
-
-	// recurse down both sides
-	if( node->axis == -1 ) return;
-
-	if( clip->boxmaxs[node->axis] > node->dist )
-		SV_ClipToLinks( node->children[0], clip );
-	if( clip->boxmins[node->axis] < node->dist )
-		SV_ClipToLinks( node->children[1], clip );
+	clip->trace.fraction *= clip->trace_fraction;
+	svgame.globals->trace_ent = clip->trace.ent;
 }
 
 /*
-====================
-SV_ClipToPortals
-
-Mins and maxs enclose the entire area swept by the move
-====================
+==================
+SV_Move
+==================
 */
-static void SV_ClipToPortals( areanode_t *node, moveclip_t *clip )
+trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
+	moveclip_t	clip;
 
-	// touch linked edicts
-	for( l = node->portal_edicts.next; l != &node->portal_edicts; l = next )
-	{
-		next = l->next;
+	if( sv_tracerecord.file )
+		SV_RecordTrace( start, mins, maxs, end, type, e, monsterclip );
 
-		touch = EDICT_FROM_AREA( l );
+	if( SV_BeginMoveClip( &clip, start, mins, maxs, end, type, e, monsterclip ))
+	{
+		if( sv_area_tree.value )
+		{
+			SV_ClipToTree( AREATREE_SOLID, &clip, SV_ClipToEntity );
+			SV_ClipToTree( AREATREE_PORTAL, &clip, SV_ClipToEntity );
+		}
+		else
+		{
+			SV_ClipToLinks( sv_areanodes, &clip );
+			SV_ClipToPortals( sv_areanodes, &clip );
+		}
 
-		if( !SV_ClipToEntity( touch, clip ))
-			return; // trace.allsoild
+		SV_EndMoveClip( &clip );
 	}
 
-	// recurse down both sides
-	if( node->axis == -1 ) return;
+	SV_CopyTraceToGlobal( &clip.trace );
 
-	if( clip->boxmaxs[node->axis] > node->dist )
-		SV_ClipToPortals( node->children[0], clip );
-	if( clip->boxmins[node->axis] < node->dist )
-		SV_ClipToPortals( node->children[1], clip );
+	return clip.trace;
 }
 
 /*
-====================
-SV_ClipToWorldBrush
+==================
+SV_MoveBatch
 
-Mins and maxs enclose the entire area swept by the move
-====================
+traces a number of moves with the same size and filter, entities
+around all of them are collected once. traces are the same as from
+calling SV_Move for every move, in the same order, but pfnShouldCollide
+may be called for a different set of entities
+==================
 */
-static void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
+void SV_MoveBatch( int count, const vec3_t *start, const vec3_t *end, vec3_t mins, vec3_t maxs, int type, edict_t *e, qboolean monsterclip, trace_t *traces )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
-	trace_t	trace;
+	moveclip_t	clips[SV_MOVE_BATCH];
+	qboolean		active[SV_MOVE_BATCH];
+	areaquery_t	solids, portals;
+	vec3_t		boxmins, boxmaxs;
+	int		i, first, num, numactive;
 
-	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	for( first = 0; first < count; first += num )
 	{
-		next = l->next;
+		num = Q_min( count - first, SV_MOVE_BATCH );
+		numactive = 0;
+		ClearBounds( boxmins, boxmaxs );
 
-		touch = EDICT_FROM_AREA( l );
+		for( i = 0; i < num; i++ )
+		{
+			if( sv_tracerecord.file )
+				SV_RecordTrace( start[first + i], mins, maxs, end[first + i], type, e, monsterclip );
 
-		if( touch->v.solid != SOLID_BSP || touch == clip->passedict || !( touch->v.flags & FL_WORLDBRUSH ))
-			continue;
+			active[i] = SV_BeginMoveClip( &clips[i], start[first + i], mins, maxs, end[first + i], type, e, monsterclip );
+			if( !active[i] )
+				continue;
 
-		if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
-			continue;
+			AddPointToBounds( clips[i].boxmins, boxmins, boxmaxs );
+			AddPointToBounds( clips[i].boxmaxs, boxmins, boxmaxs );
+			numactive++;
+		}
+
+		if( numactive )
+		{
+			if( sv_area_tree.value )
+			{
+				SV_AreaTreeQuery( AREATREE_SOLID, boxmins, boxmaxs, &solids );
+				SV_AreaTreeQuery( AREATREE_PORTAL, boxmins, boxmaxs, &portals );
+			}
+			else
+			{
+				SV_AreaQueryInit( &solids );
+				SV_AreaQueryInit( &portals );
+				SV_AreaNodesQuery( sv_areanodes, false, boxmins, boxmaxs, &solids );
+				SV_AreaNodesQuery( sv_areanodes, true, boxmins, boxmaxs, &portals );
+			}
+
+			for( i = 0; i < num; i++ )
+			{
+				if( !active[i] )
+					continue;
 
-		if( clip->trace.allsolid ) return;
+				SV_ClipToCandidates( &solids, &clips[i] );
+				SV_ClipToCandidates( &portals, &clips[i] );
+				SV_EndMoveClip( &clips[i] );
+			}
 
-		SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+			SV_AreaQueryFree( &solids );
+			SV_AreaQueryFree( &portals );
+		}
 
-		clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
+		for( i = 0; i < num; i++ )
+			traces[first + i] = clips[i].trace;
 	}
 
-	// recurse down both sides
-	if( node->axis == -1 ) return;
+	if( count > 0 )
+		SV_CopyTraceToGlobal( &traces[count - 1] );
+}
 
-	if( clip->boxmaxs[node->axis] > node->dist )
-		SV_ClipToWorldBrush( node->children[0], clip );
+/*
+==================
+SV_CompareTraces
 
-	if( clip->boxmins[node->axis] < node->dist )
-		SV_ClipToWorldBrush( node->children[1], clip );
+==================
+*/
+static qboolean SV_CompareTraces( const trace_t *a, const trace_t *b )
+{
+	if( a->allsolid != b->allsolid || a->startsolid != b->startsolid )
+		return false;
+
+	if( a->inopen != b->inopen || a->inwater != b->inwater )
+		return false;
+
+	if( a->fraction != b->fraction || !VectorCompare( a->endpos, b->endpos ))
+		return false;
+
+	if( !VectorCompare( a->plane.normal, b->plane.normal ) || a->plane.dist != b->plane.dist )
+		return false;
+
+	return a->ent == b->ent && a->hitgroup == b->hitgroup;
 }
 
 /*
 ==================
-SV_Move
+SV_TraceBench_f
+
+replays recorded traces one by one and batched,
+traces with the same size and filter in a row are batched
 ==================
 */
-trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip )
+void SV_TraceBench_f( void )
 {
-	moveclip_t	clip;
-	vec3_t		trace_endpos;
-	float		trace_fraction;
+	const tracerecord_t	*records, *rec;
+	const tracefileheader_t	*header;
+	trace_t		*scalar, *batched;
+	vec3_t		*starts, *ends;
+	edict_t		**passents;
+	int		*batches;
+	int		i, j, numtraces, numbatches = 0;
+	int		passes = 10, mismatches = 0;
+	double		scalar_time, batched_time, start;
+	file_t		*recordfile;
+	fs_offset_t	len;
+	byte		*data;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "sv_trace_bench <file> [passes]\n" );
+		return;
+	}
 
-	memset( &clip, 0, sizeof( moveclip_t ));
-	SV_ClipMoveToEntity( EDICT_NUM( 0 ), start, mins, maxs, end, &clip.trace );
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "server is not running\n" );
+		return;
+	}
 
-	if( clip.trace.fraction != 0.0f )
+	if( Cmd_Argc() > 2 )
+		passes = Q_max( 1, Q_atoi( Cmd_Argv( 2 )));
+
+	data = FS_LoadFile( Cmd_Argv( 1 ), &len, false );
+	if( !data )
 	{
-		VectorCopy( clip.trace.endpos, trace_endpos );
-		trace_fraction = clip.trace.fraction;
-		clip.trace.fraction = 1.0f;
-		clip.start = start;
-		clip.end = trace_endpos;
-		clip.type = (type & 0xFF);
-		clip.ignoretrans = type >> 8;
-		clip.monsterclip = false;
-		clip.passedict = (e) ? e : EDICT_NUM( 0 );
-		clip.mins = mins;
-		clip.maxs = maxs;
+		Con_Printf( S_ERROR "couldn't load %s\n", Cmd_Argv( 1 ));
+		return;
+	}
+
+	header = (const tracefileheader_t *)data;
+	if( len < (fs_offset_t)sizeof( *header ) || header->ident != TRACEFILE_IDENT || header->version != TRACEFILE_VERSION )
+	{
+		Con_Printf( S_ERROR "%s is not a trace file\n", Cmd_Argv( 1 ));
+		Mem_Free( data );
+		return;
+	}
+
+	records = (const tracerecord_t *)( data + sizeof( *header ));
+	numtraces = ( len - sizeof( *header )) / sizeof( tracerecord_t );
+
+	if( !numtraces )
+	{
+		Con_Printf( "%s has no traces\n", Cmd_Argv( 1 ));
+		Mem_Free( data );
+		return;
+	}
+
+	scalar = Z_Malloc( numtraces * sizeof( trace_t ));
+	batched = Z_Malloc( numtraces * sizeof( trace_t ));
+	starts = Z_Malloc( numtraces * sizeof( vec3_t ));
+	ends = Z_Malloc( numtraces * sizeof( vec3_t ));
+	passents = Z_Malloc( numtraces * sizeof( edict_t * ));
+	batches = Z_Malloc(( numtraces + 1 ) * sizeof( int ));
+
+	for( i = 0; i < numtraces; i++ )
+	{
+		rec = &records[i];
+		VectorCopy( rec->start, starts[i] );
+		VectorCopy( rec->end, ends[i] );
+
+		if( rec->passent >= 0 && rec->passent < svgame.numEntities && SV_IsValidEdict( EDICT_NUM( rec->passent )))
+			passents[i] = EDICT_NUM( rec->passent );
+		else passents[i] = NULL;
+
+		// same size and filter as previous one goes to the same batch
+		if( i > 0 && VectorCompare( rec->mins, rec[-1].mins ) && VectorCompare( rec->maxs, rec[-1].maxs )
+			&& rec->type == rec[-1].type && passents[i] == passents[i - 1] && rec->monsterclip == rec[-1].monsterclip )
+			continue;
+
+		batches[numbatches++] = i;
+	}
+	batches[numbatches] = numtraces;
+
+	// don't record the replay
+	recordfile = sv_tracerecord.file;
+	sv_tracerecord.file = NULL;
 
-		if( monsterclip && !FBitSet( host.features, ENGINE_QUAKE_COMPATIBLE ))
-			clip.monsterclip = true;
+	start = Sys_DoubleTime();
 
-		if( clip.type == MOVE_MISSILE )
+	for( j = 0; j < passes; j++ )
+	{
+		for( i = 0; i < numtraces; i++ )
 		{
-			VectorSet( clip.mins2, -15.0f, -15.0f, -15.0f );
-			VectorSet( clip.maxs2,  15.0f,  15.0f,  15.0f );
+			vec3_t	mins, maxs;
+
+			rec = &records[i];
+			VectorCopy( rec->mins, mins );
+			VectorCopy( rec->maxs, maxs );
+			scalar[i] = SV_Move( starts[i], mins, maxs, ends[i], rec->type, passents[i], rec->monsterclip );
 		}
-		else
+	}
+
+	scalar_time = Sys_DoubleTime() - start;
+	start = Sys_DoubleTime();
+
+	for( j = 0; j < passes; j++ )
+	{
+		for( i = 0; i < numbatches; i++ )
 		{
-			VectorCopy( mins, clip.mins2 );
-			VectorCopy( maxs, clip.maxs2 );
+			int	first = batches[i];
+			vec3_t	mins, maxs;
+
+			rec = &records[first];
+			VectorCopy( rec->mins, mins );
+			VectorCopy( rec->maxs, maxs );
+			SV_MoveBatch( batches[i + 1] - first, &starts[first], &ends[first], mins, maxs, rec->type, passents[first], rec->monsterclip, &batched[first] );
 		}
+	}
 
-		World_MoveBounds( start, clip.mins2, clip.maxs2, trace_endpos, clip.boxmins, clip.boxmaxs );
-		SV_ClipToLinks( sv_areanodes, &clip );
-		SV_ClipToPortals( sv_areanodes, &clip );
+	batched_time = Sys_DoubleTime() - start;
+	sv_tracerecord.file = recordfile;
 
-		clip.trace.fraction *= trace_fraction;
-		svgame.globals->trace_ent = clip.trace.ent;
+	for( i = 0; i < numtraces; i++ )
+	{
+		if( !SV_CompareTraces( &scalar[i], &batched[i] ))
+			mismatches++;
 	}
 
-	SV_CopyTraceToGlobal( &clip.trace );
+	Con_Printf( "%i traces in %i batches, %i passes\n", numtraces, numbatches, passes );
+	Con_Printf( "scalar: %.3f ms, batched: %.3f ms per pass\n", scalar_time * 1000.0 / passes, batched_time * 1000.0 / passes );
 
-	return clip.trace;
+	if( mismatches )
+		Con_Printf( S_ERROR "%i traces differ\n", mismatches );
+	else Con_Printf( "all traces match\n" );
+
+	Z_Free( scalar );
+	Z_Free( batched );
+	Z_Free( starts );
+	Z_Free( ends );
+	Z_Free( passents );
+	Z_Free( batches );
+	Mem_Free( data );
 }
 
 /*
@@ -1392,8 +2846,18 @@ trace_t GAME_EXPORT SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs,
 		VectorCopy( maxs, clip.maxs2 );
 
 		World_MoveBounds( start, clip.mins2, clip.maxs2, trace_endpos, clip.boxmins, clip.boxmaxs );
-		SV_ClipToWorldBrush( sv_areanodes, &clip );
-		SV_ClipToPortals( sv_areanodes, &clip );
+
+		if( sv_area_tree.value )
+		{
+			SV_ClipToTree( AREATREE_SOLID, &clip, SV_ClipToWorldBrushEdict );
+			SV_ClipToTree( AREATREE_PORTAL, &clip, SV_ClipToEntity );
+		}
+		else
+		{
+			SV_ClipToWorldBrush( sv_areanodes, &clip );
+			SV_ClipToPortals( sv_areanodes, &clip );
+		}
+		sv_areatree.traces++;
 
 		clip.trace.fraction *= trace_fraction;
 		svgame.globals->trace_ent = clip.trace.ent;
@@ -1663,3 +3127,166 @@ int SV_LightForEntity( edict_t *pEdict )
 
 	return VectorAvg( sv_pointColor );
 }
+
+#if XASH_ENGINE_TESTS
+
+#include "tests.h"
+
+#define TEST_AREATREE_LEAFS	512
+
+static int Test_CheckAreaTreeNode( int index, int parent, int *numleafs )
+{
+	areatreenode_t	*node = &sv_areatree.nodes[index];
+	areatreenode_t	*child;
+	int		i, height[2];
+
+	if( node->parent != parent )
+		return -1;
+
+	if( node->height == 0 )
+	{
+		( *numleafs )++;
+		return 0;
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		child = &sv_areatree.nodes[node->children[i]];
+
+		if( child->mins[0] < node->mins[0] || child->mins[1] < node->mins[1] || child->mins[2] < node->mins[2] )
+			return -1;
+
+		if( child->maxs[0] > node->maxs[0] || child->maxs[1] > node->maxs[1] || child->maxs[2] > node->maxs[2] )
+			return -1;
+
+		height[i] = Test_CheckAreaTreeNode( node->children[i], index, numleafs );
+		if( height[i] < 0 )
+			return -1;
+	}
+
+	if( node->height != 1 + Q_max( height[0], height[1] ))
+		return -1;
+
+	return node->height;
+}
+
+static void Test_SetAreaTreeLeaf( int leaf )
+{
+	areatreenode_t	*node = &sv_areatree.nodes[leaf];
+	int		i;
+
+	for( i = 0; i < 3; i++ )
+	{
+		node->mins[i] = COM_RandomFloat( -4096.0f, 4096.0f );
+		node->maxs[i] = node->mins[i] + COM_RandomFloat( 0.0f, i == 2 ? 128.0f : 512.0f );
+	}
+}
+
+static void Test_AreaTree( void )
+{
+	int		leafs[TEST_AREATREE_LEAFS];
+	int		*root = &sv_areatree.roots[AREATREE_SOLID];
+	int		i, j, k, numleafs, height, expected, mismatches = 0;
+	areaquery_t	query;
+	vec3_t		mins, maxs;
+
+	// fixed data set, so the result doesn't depend on the run
+	COM_SetRandomSeed( 1 );
+
+	SV_FreeAreaTree();
+	sv_areatree.freenode = AREATREE_NULL;
+	for( i = 0; i < AREATREE_COUNT; i++ )
+		sv_areatree.roots[i] = AREATREE_NULL;
+
+	for( i = 0; i < TEST_AREATREE_LEAFS; i++ )
+	{
+		leafs[i] = SV_AreaTreeAllocNode();
+		sv_areatree.nodes[leafs[i]].edict = i;
+		Test_SetAreaTreeLeaf( leafs[i] );
+		SV_AreaTreeInsertLeaf( root, leafs[i] );
+	}
+
+	// move entities around, removing some of them for good
+	for( i = 0; i < TEST_AREATREE_LEAFS * 4; i++ )
+	{
+		j = COM_RandomLong( 0, TEST_AREATREE_LEAFS - 1 );
+		if( leafs[j] == AREATREE_NULL )
+			continue;
+
+		SV_AreaTreeRemoveLeaf( root, leafs[j] );
+
+		if( i % 8 == 0 )
+		{
+			SV_AreaTreeFreeNode( leafs[j] );
+			leafs[j] = AREATREE_NULL;
+			continue;
+		}
+
+		Test_SetAreaTreeLeaf( leafs[j] );
+		SV_AreaTreeInsertLeaf( root, leafs[j] );
+	}
+
+	for( i = expected = 0; i < TEST_AREATREE_LEAFS; i++ )
+	{
+		if( leafs[i] != AREATREE_NULL )
+			expected++;
+	}
+
+	numleafs = 0;
+	height = Test_CheckAreaTreeNode( *root, AREATREE_NULL, &numleafs );
+	TASSERT( height > 0 && height < 24 );
+	TASSERT_EQi( numleafs, expected );
+
+	// query must return exactly the leafs that intersect the box, in order
+	for( i = 0; i < 256; i++ )
+	{
+		for( j = 0; j < 3; j++ )
+		{
+			mins[j] = COM_RandomFloat( -4096.0f, 4096.0f );
+			maxs[j] = mins[j] + COM_RandomFloat( 0.0f, 1024.0f );
+		}
+
+		SV_AreaTreeQuery( AREATREE_SOLID, mins, maxs, &query );
+
+		for( j = k = 0; j < TEST_AREATREE_LEAFS; j++ )
+		{
+			areatreenode_t *node;
+
+			if( leafs[j] == AREATREE_NULL )
+				continue;
+
+			node = &sv_areatree.nodes[leafs[j]];
+			if( !BoundsIntersect( mins, maxs, node->mins, node->maxs ))
+				continue;
+
+			if( k >= query.count || query.edicts[k] != j )
+				break;
+			k++;
+		}
+
+		if( j != TEST_AREATREE_LEAFS || k != query.count )
+			mismatches++;
+
+		SV_AreaQueryFree( &query );
+	}
+
+	TASSERT_EQi( mismatches, 0 );
+
+	// everything removed gives empty tree
+	for( i = 0; i < TEST_AREATREE_LEAFS; i++ )
+	{
+		if( leafs[i] != AREATREE_NULL )
+			SV_AreaTreeRemoveLeaf( root, leafs[i] );
+	}
+
+	TASSERT_EQi( *root, AREATREE_NULL );
+
+	SV_FreeAreaTree();
+}
+
+void Test_RunAreaTree( void )
+{
+	TRUN( Test_AreaTree() );
+}
+
+#endif // XASH_ENGINE_TESTS
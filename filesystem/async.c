@@ -0,0 +1,553 @@
+/*
+async.c - asynchronous file loading
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "build.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "port.h"
+#include "filesystem_internal.h"
+#include "crtlib.h"
+#include "crclib.h"
+#include "xash3d_mathlib.h"
+#include "common/com_strings.h"
+
+/*
+========================================================================
+ASYNCHRONOUS LOADING
+
+Requests wait in a priority queue and only a few of them are read at
+once, so every file is opened just before it's read. Everything except
+the read itself runs on the main thread: the file is found when the
+request is made, opened and given a buffer when it's started, and closed
+when the read is finished. Workers only do positional reads and inflate
+deflated ZIP entries, so they never touch the zone allocator, the console
+or the shared file offsets.
+
+Files that need a special loader (WAD lumps, Android assets) and
+platforms without positional reads are loaded right away instead.
+========================================================================
+*/
+#define MAX_ASYNC_RUNNING	4	// requests being read at once
+
+typedef enum
+{
+	ASYNC_QUEUED = 0,
+	ASYNC_RUNNING,
+	ASYNC_DONE
+} asyncstate_t;
+
+struct fs_async_s
+{
+	char		path[MAX_SYSPATH];
+	int		priority;
+	uint		sequence;		// keeps requests of the same priority in order
+	asyncstate_t	state;
+	int		heapindex;	// while queued
+
+	searchpath_t	*search;
+	int		pack_ind;
+	file_t		*file;		// while running
+	void		*task;
+
+	byte		*data;
+	fs_offset_t	size;
+	qboolean		ok;		// set by the worker
+	fs_filehashes_t	*hashes;		// sums of the data are written here, if set
+
+	pfnFileLoaded_t	callback;
+	void		*userdata;
+	fs_async_t	*next;		// in running or completed list
+};
+
+static struct
+{
+	fs_async_t	**queue;		// binary heap
+	int		numqueued;
+	int		maxqueued;
+	uint		sequence;
+
+	fs_async_t	*running;
+	int		numrunning;
+
+	fs_async_t	*completed;	// waiting for AsyncUpdate to call the callback
+	fs_async_t	*lastcompleted;
+} fs_async;
+
+/*
+============
+FS_AsyncBefore
+
+requests with higher priority go first, then older ones
+============
+*/
+static qboolean FS_AsyncBefore( const fs_async_t *a, const fs_async_t *b )
+{
+	if( a->priority != b->priority )
+		return a->priority > b->priority;
+
+	return (int)( a->sequence - b->sequence ) < 0;
+}
+
+static void FS_AsyncSetQueued( int i, fs_async_t *request )
+{
+	fs_async.queue[i] = request;
+	request->heapindex = i;
+}
+
+static void FS_AsyncSiftUp( int i )
+{
+	fs_async_t *request = fs_async.queue[i];
+
+	while( i > 0 )
+	{
+		int parent = ( i - 1 ) / 2;
+
+		if( !FS_AsyncBefore( request, fs_async.queue[parent] ))
+			break;
+
+		FS_AsyncSetQueued( i, fs_async.queue[parent] );
+		i = parent;
+	}
+
+	FS_AsyncSetQueued( i, request );
+}
+
+static void FS_AsyncSiftDown( int i )
+{
+	fs_async_t *request = fs_async.queue[i];
+
+	while( true )
+	{
+		int child = i * 2 + 1;
+
+		if( child >= fs_async.numqueued )
+			break;
+
+		if( child + 1 < fs_async.numqueued && FS_AsyncBefore( fs_async.queue[child + 1], fs_async.queue[child] ))
+			child++;
+
+		if( !FS_AsyncBefore( fs_async.queue[child], request ))
+			break;
+
+		FS_AsyncSetQueued( i, fs_async.queue[child] );
+		i = child;
+	}
+
+	FS_AsyncSetQueued( i, request );
+}
+
+static void FS_AsyncPush( fs_async_t *request )
+{
+	if( fs_async.numqueued == fs_async.maxqueued )
+	{
+		fs_async.maxqueued = Q_max( fs_async.maxqueued * 2, 64 );
+		fs_async.queue = (fs_async_t **)Mem_Realloc( fs_mempool, fs_async.queue, sizeof( *fs_async.queue ) * fs_async.maxqueued );
+	}
+
+	request->state = ASYNC_QUEUED;
+	FS_AsyncSetQueued( fs_async.numqueued++, request );
+	FS_AsyncSiftUp( request->heapindex );
+}
+
+static void FS_AsyncRemoveQueued( fs_async_t *request )
+{
+	int i = request->heapindex;
+	fs_async_t *last = fs_async.queue[--fs_async.numqueued];
+
+	if( last != request )
+	{
+		FS_AsyncSetQueued( i, last );
+		FS_AsyncSiftUp( i );
+		FS_AsyncSiftDown( last->heapindex );
+	}
+
+	request->heapindex = -1;
+}
+
+/*
+============
+FS_AsyncHash
+
+============
+*/
+static void FS_AsyncHash( fs_async_t *request )
+{
+	MD5Context_t md5;
+
+	if( !request->hashes || !request->data )
+		return;
+
+	CRC32_Init( &request->hashes->crc );
+	CRC32_ProcessBuffer( &request->hashes->crc, request->data, request->size );
+
+	memset( &md5, 0, sizeof( md5 ));
+	MD5Init( &md5 );
+	MD5Update( &md5, request->data, request->size );
+	MD5Final( request->hashes->md5, &md5 );
+}
+
+/*
+============
+FS_AsyncJob
+
+runs on a worker thread
+============
+*/
+static void FS_AsyncJob( void *data, int index )
+{
+	fs_async_t *request = (fs_async_t *)data;
+
+	if( request->file->ztk )
+		request->ok = FS_InflateAt_ZIP( request->file, request->data );
+	else request->ok = FS_SysReadAt( request->file, request->data, 0, request->size );
+
+	if( request->ok )
+		FS_AsyncHash( request );
+}
+
+static void FS_AsyncLinkCompleted( fs_async_t *request )
+{
+	request->next = NULL;
+
+	if( fs_async.lastcompleted )
+		fs_async.lastcompleted->next = request;
+	else fs_async.completed = request;
+
+	fs_async.lastcompleted = request;
+}
+
+/*
+============
+FS_AsyncComplete
+
+waits for the read if it's still going and releases the file
+============
+*/
+static void FS_AsyncComplete( fs_async_t *request )
+{
+	fs_async_t **prev;
+
+	for( prev = &fs_async.running; *prev != request; prev = &( *prev )->next );
+	*prev = request->next;
+	fs_async.numrunning--;
+
+	if( request->task )
+	{
+		g_engfuncs._Jobs_WaitTask( request->task );
+		request->task = NULL;
+	}
+
+	FS_Close( request->file );
+	request->file = NULL;
+
+	if( !request->ok )
+	{
+		Con_Printf( S_ERROR "%s: couldn't read %s\n", __func__, request->path );
+		Mem_Free( request->data );
+		request->data = NULL;
+		request->size = 0;
+	}
+
+	request->state = ASYNC_DONE;
+
+	if( request->callback )
+		FS_AsyncLinkCompleted( request );
+}
+
+/*
+============
+FS_AsyncStart
+
+opens the file and hands the read over to a worker
+============
+*/
+static void FS_AsyncStart( fs_async_t *request )
+{
+	file_t *file;
+
+	file = request->search->pfnOpenFile( request->search, request->path, "rb", request->pack_ind );
+
+	if( !file )
+	{
+		request->state = ASYNC_DONE;
+		if( request->callback )
+			FS_AsyncLinkCompleted( request );
+		return;
+	}
+
+	request->file = file;
+	request->size = file->real_length;
+	request->data = (byte *)Mem_Malloc( fs_mempool, request->size + 1 );
+	request->data[request->size] = '\0';
+	request->ok = false;
+	request->state = ASYNC_RUNNING;
+
+	request->next = fs_async.running;
+	fs_async.running = request;
+	fs_async.numrunning++;
+
+	request->task = g_engfuncs._Jobs_PostTask( FS_AsyncJob, request );
+
+	// couldn't post, do it here
+	if( !request->task )
+	{
+		FS_AsyncJob( request, 0 );
+		FS_AsyncComplete( request );
+	}
+}
+
+/*
+============
+FS_AsyncPoll
+
+collects finished reads and starts the queued ones
+============
+*/
+static void FS_AsyncPoll( void )
+{
+	fs_async_t *request, *next;
+
+	for( request = fs_async.running; request; request = next )
+	{
+		next = request->next;
+
+		if( g_engfuncs._Jobs_IsTaskDone( request->task ))
+			FS_AsyncComplete( request );
+	}
+
+	while( fs_async.numqueued > 0 && fs_async.numrunning < MAX_ASYNC_RUNNING )
+	{
+		request = fs_async.queue[0];
+		FS_AsyncRemoveQueued( request );
+		FS_AsyncStart( request );
+	}
+}
+
+/*
+============
+FS_AsyncFlush
+
+finishes every request, must be called before
+searchpaths are released
+============
+*/
+void FS_AsyncFlush( void )
+{
+	while( fs_async.running )
+		FS_AsyncComplete( fs_async.running );
+
+	while( fs_async.numqueued > 0 )
+	{
+		fs_async_t *request = fs_async.queue[0];
+
+		FS_AsyncRemoveQueued( request );
+		FS_AsyncStart( request );
+
+		if( request->state == ASYNC_RUNNING )
+			FS_AsyncComplete( request );
+	}
+}
+
+/*
+============
+FS_AsyncShutdown
+
+============
+*/
+void FS_AsyncShutdown( void )
+{
+	fs_async_t *request, *next;
+
+	FS_AsyncFlush();
+
+	// nobody is going to deliver these
+	for( request = fs_async.completed; request; request = next )
+	{
+		next = request->next;
+		if( request->data )
+			Mem_Free( request->data );
+		Mem_Free( request );
+	}
+
+	if( fs_async.queue )
+		Mem_Free( fs_async.queue );
+
+	memset( &fs_async, 0, sizeof( fs_async ));
+}
+
+/*
+============
+FS_AsyncCanRead
+
+whether files from this searchpath can be read in background
+============
+*/
+static qboolean FS_AsyncCanRead( const searchpath_t *search )
+{
+#if HAVE_PREAD
+	// ZIP only loads files itself to decompress them, which can be done in background too
+	return !search->pfnLoadFile || search->type == SEARCHPATH_ZIP;
+#else // !HAVE_PREAD
+	return false;
+#endif // !HAVE_PREAD
+}
+
+/*
+============
+FS_LoadFileAsyncHashed
+
+also computes CRC32 and MD5 of the file in background
+============
+*/
+fs_async_t *FS_LoadFileAsyncHashed( const char *path, int priority, qboolean gamedironly, pfnFileLoaded_t callback, void *userdata, fs_filehashes_t *hashes )
+{
+	fs_async_t *request;
+	searchpath_t *search;
+	char netpath[MAX_SYSPATH];
+	int pack_ind;
+
+	search = FS_FindFileToLoad( path, &pack_ind, netpath, sizeof( netpath ), gamedironly );
+
+	if( !search )
+		return NULL;
+
+	request = (fs_async_t *)Mem_Calloc( fs_mempool, sizeof( *request ));
+	Q_strncpy( request->path, netpath, sizeof( request->path ));
+	request->priority = priority;
+	request->sequence = fs_async.sequence++;
+	request->heapindex = -1;
+	request->search = search;
+	request->pack_ind = pack_ind;
+	request->callback = callback;
+	request->userdata = userdata;
+	request->hashes = hashes;
+
+	if( FS_AsyncCanRead( search ))
+	{
+		FS_AsyncPush( request );
+		FS_AsyncPoll();
+		return request;
+	}
+
+	request->data = FS_LoadFileFromArchive( search, netpath, pack_ind, &request->size, false );
+	request->state = ASYNC_DONE;
+	FS_AsyncHash( request );
+
+	if( callback )
+		FS_AsyncLinkCompleted( request );
+
+	return request;
+}
+
+/*
+============
+FS_LoadFileAsync
+
+============
+*/
+fs_async_t *FS_LoadFileAsync( const char *path, int priority, qboolean gamedironly, pfnFileLoaded_t callback, void *userdata )
+{
+	return FS_LoadFileAsyncHashed( path, priority, gamedironly, callback, userdata, NULL );
+}
+
+/*
+============
+FS_AsyncIsDone
+
+============
+*/
+qboolean FS_AsyncIsDone( fs_async_t *request )
+{
+	FS_AsyncPoll();
+
+	return request->state == ASYNC_DONE;
+}
+
+/*
+============
+FS_AsyncFinish
+
+waits for the request and releases it, returns the loaded data,
+requests with callback are delivered through it and NULL is returned
+============
+*/
+byte *FS_AsyncFinish( fs_async_t *request, fs_offset_t *filesizeptr )
+{
+	byte *data;
+
+	if( filesizeptr ) *filesizeptr = 0;
+
+	if( request->state == ASYNC_QUEUED )
+	{
+		FS_AsyncRemoveQueued( request );
+		FS_AsyncStart( request );
+	}
+
+	if( request->state == ASYNC_RUNNING )
+		FS_AsyncComplete( request );
+
+	if( request->callback )
+	{
+		fs_async_t **prev, *last = NULL;
+
+		for( prev = &fs_async.completed; *prev && *prev != request; prev = &( *prev )->next )
+			last = *prev;
+
+		// already taken by FS_AsyncUpdate, it will call the callback
+		if( !*prev )
+			return NULL;
+
+		*prev = request->next;
+		if( fs_async.lastcompleted == request )
+			fs_async.lastcompleted = last;
+
+		request->callback( request->path, request->data, request->size, request->userdata );
+		Mem_Free( request );
+		FS_AsyncPoll();
+		return NULL;
+	}
+
+	data = request->data;
+	if( filesizeptr ) *filesizeptr = request->size;
+	Mem_Free( request );
+
+	FS_AsyncPoll();
+	return data;
+}
+
+/*
+============
+FS_AsyncUpdate
+
+keeps the queue going and calls the callbacks of finished requests
+============
+*/
+void FS_AsyncUpdate( void )
+{
+	fs_async_t *request, *next;
+
+	FS_AsyncPoll();
+
+	// callbacks may queue new requests
+	request = fs_async.completed;
+	fs_async.completed = fs_async.lastcompleted = NULL;
+
+	for( ; request; request = next )
+	{
+		next = request->next;
+		request->callback( request->path, request->data, request->size, request->userdata );
+		Mem_Free( request );
+	}
+}
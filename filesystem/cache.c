@@ -0,0 +1,472 @@
+/*
+cache.c - persistent archive and directory index cache
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "build.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include "port.h"
+#include "filesystem_internal.h"
+#include "crtlib.h"
+#include "crclib.h"
+#include "common/com_strings.h"
+
+/*
+========================================================================
+INDEX CACHE
+
+Sorted entry tables of archives and directory listings are kept in
+<rootdir>/.fscache, one file per game directory. Every record is keyed
+by the path, size and modification time of its source, so changed
+archives are parsed again and the cache file is rewritten. Directories
+have no size, so they're only cached when they weren't changed recently.
+Only used when XASH3D_INDEX_CACHE environment variable is set to 1.
+
+Caches are opened while the game directory is queued for mounting,
+looked up by the loaders, possibly from several threads at once,
+and written back when mounting is finished.
+========================================================================
+*/
+#define IDINDEXCACHEHEADER	(('I'<<24)+('F'<<16)+('X'<<8)+'X')	// little-endian "XXFI"
+#define INDEXCACHE_VERSION	1
+#define INDEXCACHE_DIRECTORY	".fscache"
+#define INDEXCACHE_MIN_AGE	2	// seconds since the last change of the source
+#define INDEXCACHE_MIN_DIR_AGE	10
+
+typedef struct
+{
+	int		ident;
+	int		version;
+	int		numrecords;
+	uint32_t		crc;		// of everything after the header
+} dindexcacheheader_t;
+
+typedef struct
+{
+	int64_t		size;		// of the source, 0 for directories
+	int64_t		mtime;
+	int		type;		// searchpathtype_t
+	int		numentries;
+	int		pathlen;		// including terminator
+	int		datasize;
+} dindexrecord_t;
+
+typedef struct indexrecord_s
+{
+	dindexrecord_t	info;
+	const char	*path;
+	const byte	*data;
+	qboolean		used;
+	struct indexrecord_s	*next;	// only for stored records
+} indexrecord_t;
+
+typedef struct indexcache_s
+{
+	char		dir[MAX_SYSPATH];
+	byte		*buffer;		// cache file contents
+	indexrecord_t	*records;		// loaded from disk, never changed while mounting
+	int		numrecords;
+	indexrecord_t	*stored;		// added while mounting
+	qboolean		dirty;
+	struct indexcache_s	*next;
+} indexcache_t;
+
+static qboolean     fs_indexcache_enabled;
+static indexcache_t *fs_indexcaches;
+
+/*
+====================
+FS_IndexCachePath
+====================
+*/
+static void FS_IndexCachePath( const char *dir, char *dst, size_t size )
+{
+	char name[MAX_SYSPATH];
+	int i;
+
+	Q_strncpy( name, dir, sizeof( name ));
+
+	for( i = 0; name[i]; i++ )
+	{
+		if( name[i] == '/' || name[i] == '\\' || name[i] == ':' )
+			name[i] = '_';
+	}
+
+	Q_snprintf( dst, size, "%s/" INDEXCACHE_DIRECTORY "/%s.idx", fs_rootdir, name );
+}
+
+/*
+====================
+FS_ParseIndexCache
+
+returns false if cache file is damaged or made by other version
+====================
+*/
+static qboolean FS_ParseIndexCache( indexcache_t *cache, fs_offset_t length )
+{
+	const dindexcacheheader_t *header = (const dindexcacheheader_t *)cache->buffer;
+	fs_offset_t ofs = sizeof( *header );
+	uint32_t crc;
+	int i;
+
+	if( length < sizeof( *header ) || header->ident != IDINDEXCACHEHEADER || header->version != INDEXCACHE_VERSION )
+		return false;
+
+	if( header->numrecords <= 0 || header->numrecords > length / sizeof( dindexrecord_t ))
+		return false;
+
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, cache->buffer + ofs, length - ofs );
+
+	if( CRC32_Final( crc ) != header->crc )
+		return false;
+
+	cache->records = (indexrecord_t *)Mem_Calloc( fs_mempool, sizeof( *cache->records ) * header->numrecords );
+	cache->numrecords = header->numrecords;
+
+	for( i = 0; i < cache->numrecords; i++ )
+	{
+		indexrecord_t *rec = &cache->records[i];
+
+		if( ofs + sizeof( rec->info ) > length )
+			return false;
+
+		memcpy( &rec->info, cache->buffer + ofs, sizeof( rec->info ));
+		ofs += sizeof( rec->info );
+
+		if( rec->info.pathlen <= 0 || rec->info.datasize < 0 || length - ofs < (fs_offset_t)rec->info.pathlen + rec->info.datasize )
+			return false;
+
+		rec->path = (const char *)cache->buffer + ofs;
+		rec->data = cache->buffer + ofs + rec->info.pathlen;
+		ofs += rec->info.pathlen + rec->info.datasize;
+
+		if( rec->path[rec->info.pathlen - 1] != '\0' )
+			return false;
+	}
+
+	return true;
+}
+
+/*
+====================
+FS_OpenIndexCache
+
+loads the cache of the game directory, if there is any
+====================
+*/
+void FS_OpenIndexCache( const char *dir )
+{
+	char path[MAX_SYSPATH];
+	indexcache_t *cache;
+	file_t *f;
+
+	if( !fs_indexcache_enabled )
+		return;
+
+	for( cache = fs_indexcaches; cache; cache = cache->next )
+	{
+		if( !Q_strcmp( cache->dir, dir ))
+			return;
+	}
+
+	cache = (indexcache_t *)Mem_Calloc( fs_mempool, sizeof( *cache ));
+	Q_strncpy( cache->dir, dir, sizeof( cache->dir ));
+	cache->next = fs_indexcaches;
+	fs_indexcaches = cache;
+
+	FS_IndexCachePath( dir, path, sizeof( path ));
+
+	if( !FS_SysFileExists( path ) || !( f = FS_SysOpen( path, "rb" )))
+	{
+		cache->dirty = true;
+		return;
+	}
+
+	// whole file with one read, records point into it
+	cache->buffer = (byte *)Mem_Malloc( fs_mempool, f->real_length + 1 );
+
+	if( FS_Read( f, cache->buffer, f->real_length ) != f->real_length || !FS_ParseIndexCache( cache, f->real_length ))
+	{
+		Con_Reportf( S_WARN "%s: %s is outdated or damaged, rebuilding\n", __func__, path );
+
+		if( cache->records )
+			Mem_Free( cache->records );
+		Mem_Free( cache->buffer );
+		cache->records = NULL;
+		cache->numrecords = 0;
+		cache->buffer = NULL;
+		cache->dirty = true;
+	}
+
+	FS_Close( f );
+}
+
+/*
+====================
+FS_FindIndexCacheFor
+
+picks the cache of the deepest game directory containing the path
+====================
+*/
+static indexcache_t *FS_FindIndexCacheFor( const char *path )
+{
+	indexcache_t *cache, *best = NULL;
+	size_t bestlen = 0;
+
+	for( cache = fs_indexcaches; cache; cache = cache->next )
+	{
+		size_t len = Q_strlen( cache->dir );
+
+		if( len > bestlen && !Q_strncmp( cache->dir, path, len ))
+		{
+			best = cache;
+			bestlen = len;
+		}
+	}
+
+	return best;
+}
+
+/*
+====================
+FS_FindIndexCache
+
+returns cached entry table of the archive or directory,
+NULL if there is no up to date one
+====================
+*/
+const byte *FS_FindIndexCache( const char *path, int type, fs_offset_t size, int mtime, int *numentries, size_t *datasize )
+{
+	indexcache_t *cache = FS_FindIndexCacheFor( path );
+	int i;
+
+	if( !cache )
+		return NULL;
+
+	for( i = 0; i < cache->numrecords; i++ )
+	{
+		indexrecord_t *rec = &cache->records[i];
+
+		if( rec->info.type != type || Q_strcmp( rec->path, path ))
+			continue;
+
+		if( rec->info.size != size || rec->info.mtime != mtime )
+			return NULL; // source has changed, the record will be dropped
+
+		// each path is only looked up by one thread
+		rec->used = true;
+		*numentries = rec->info.numentries;
+		*datasize = rec->info.datasize;
+
+		return rec->data;
+	}
+
+	return NULL;
+}
+
+/*
+====================
+FS_StoreIndexCache
+
+remembers freshly parsed entry table, written to disk when mounting is finished
+====================
+*/
+void FS_StoreIndexCache( const char *path, int type, fs_offset_t size, int mtime, int numentries, const void *data, size_t datasize )
+{
+	indexcache_t *cache = FS_FindIndexCacheFor( path );
+	indexrecord_t *rec;
+	size_t pathlen;
+
+	if( !cache || mtime <= 0 || datasize > INT_MAX )
+		return;
+
+	// timestamps have one second precision, don't trust the very recent ones.
+	// directories have nothing but the timestamp to check and it can be even
+	// coarser on some filesystems, so only ones left alone for a while are kept
+	if( time( NULL ) - mtime < ( type == SEARCHPATH_PLAIN ? INDEXCACHE_MIN_DIR_AGE : INDEXCACHE_MIN_AGE ))
+		return;
+
+	pathlen = Q_strlen( path ) + 1;
+	rec = (indexrecord_t *)Mem_Malloc( fs_mempool, sizeof( *rec ) + pathlen + datasize );
+	rec->info.size = size;
+	rec->info.mtime = mtime;
+	rec->info.type = type;
+	rec->info.numentries = numentries;
+	rec->info.pathlen = pathlen;
+	rec->info.datasize = datasize;
+	rec->path = (const char *)( rec + 1 );
+	rec->data = (const byte *)rec->path + pathlen;
+	rec->used = true;
+	memcpy( (char *)rec->path, path, pathlen );
+	memcpy( (byte *)rec->data, data, datasize );
+
+	// loaders may run in parallel, allocator takes care of itself
+	g_engfuncs._Jobs_EnterCritical();
+	rec->next = cache->stored;
+	cache->stored = rec;
+	cache->dirty = true;
+	g_engfuncs._Jobs_LeaveCritical();
+}
+
+/*
+====================
+FS_WriteIndexRecord
+====================
+*/
+static void FS_WriteIndexRecord( file_t *f, const indexrecord_t *rec, uint32_t *crc )
+{
+	FS_Write( f, &rec->info, sizeof( rec->info ));
+	FS_Write( f, rec->path, rec->info.pathlen );
+	FS_Write( f, rec->data, rec->info.datasize );
+
+	CRC32_ProcessBuffer( crc, &rec->info, sizeof( rec->info ));
+	CRC32_ProcessBuffer( crc, rec->path, rec->info.pathlen );
+	CRC32_ProcessBuffer( crc, rec->data, rec->info.datasize );
+}
+
+/*
+====================
+FS_SaveIndexCache
+
+keeps the records that were used during this mount and adds the new ones
+====================
+*/
+static void FS_SaveIndexCache( indexcache_t *cache )
+{
+	dindexcacheheader_t header;
+	char path[MAX_SYSPATH];
+	const indexrecord_t *rec;
+	file_t *f;
+	int i;
+
+	for( i = 0; i < cache->numrecords; i++ )
+	{
+		if( !cache->records[i].used )
+			cache->dirty = true; // archive was removed or changed
+	}
+
+	if( !cache->dirty )
+		return;
+
+	header.ident = IDINDEXCACHEHEADER;
+	header.version = INDEXCACHE_VERSION;
+	header.numrecords = 0;
+	CRC32_Init( &header.crc );
+
+	for( i = 0; i < cache->numrecords; i++ )
+		header.numrecords += cache->records[i].used;
+
+	for( rec = cache->stored; rec; rec = rec->next )
+		header.numrecords++;
+
+	FS_IndexCachePath( cache->dir, path, sizeof( path ));
+
+	if( !header.numrecords )
+	{
+		if( FS_SysFileExists( path ))
+			remove( path );
+		return;
+	}
+
+	FS_CreatePath( path );
+
+	if( !( f = FS_SysOpen( path, "wb" )))
+		return; // read-only storage, never mind
+
+	FS_Write( f, &header, sizeof( header ));
+
+	for( i = 0; i < cache->numrecords; i++ )
+	{
+		if( cache->records[i].used )
+			FS_WriteIndexRecord( f, &cache->records[i], &header.crc );
+	}
+
+	for( rec = cache->stored; rec; rec = rec->next )
+		FS_WriteIndexRecord( f, rec, &header.crc );
+
+	header.crc = CRC32_Final( header.crc );
+	FS_Seek( f, 0, SEEK_SET );
+	FS_Write( f, &header, sizeof( header ));
+	FS_Close( f );
+
+	Con_Reportf( "%s: %s, %i records\n", __func__, path, header.numrecords );
+}
+
+/*
+====================
+FS_CloseIndexCaches
+
+writes back every changed cache and frees them
+====================
+*/
+void FS_CloseIndexCaches( void )
+{
+	while( fs_indexcaches )
+	{
+		indexcache_t *cache = fs_indexcaches;
+
+		fs_indexcaches = cache->next;
+
+		FS_SaveIndexCache( cache );
+
+		while( cache->stored )
+		{
+			indexrecord_t *rec = cache->stored;
+
+			cache->stored = rec->next;
+			Mem_Free( rec );
+		}
+
+		if( cache->records )
+			Mem_Free( cache->records );
+		if( cache->buffer )
+			Mem_Free( cache->buffer );
+		Mem_Free( cache );
+	}
+}
+
+/*
+====================
+FS_IndexCacheFile
+
+path of some other file kept in the cache directory,
+returns false if caching is disabled
+====================
+*/
+qboolean FS_IndexCacheFile( const char *name, char *dst, size_t size )
+{
+	if( !fs_indexcache_enabled )
+		return false;
+
+	Q_snprintf( dst, size, "%s/" INDEXCACHE_DIRECTORY "/%s", fs_rootdir, name );
+	return true;
+}
+
+/*
+====================
+FS_InitIndexCache
+====================
+*/
+void FS_InitIndexCache( void )
+{
+	const char *str = getenv( "XASH3D_INDEX_CACHE" );
+
+	fs_indexcache_enabled = COM_CheckString( str ) && Q_atoi( str ) != 0;
+
+	if( fs_indexcache_enabled )
+		Con_Reportf( "%s: archive index cache enabled\n", __func__ );
+}
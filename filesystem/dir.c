@@ -115,9 +115,67 @@ static void FS_InitDirEntries( dir_t *dir, const stringlist_t *list )
 	qsort( dir->entries, dir->numentries, sizeof( dir->entries[0] ), FS_SortDirEntries );
 }
 
+static qboolean FS_LoadDirEntriesFromCache( stringlist_t *list, const char *path, int mtime )
+{
+	const byte *cached;
+	const char *name, *end;
+	int numentries;
+	size_t size;
+
+	cached = FS_FindIndexCache( path, SEARCHPATH_PLAIN, 0, mtime, &numentries, &size );
+
+	if( !cached )
+		return false;
+
+	// NUL separated names
+	for( name = (const char *)cached, end = name + size; name < end && list->numstrings < numentries; name += Q_strlen( name ) + 1 )
+	{
+		if( !memchr( name, '\0', end - name ))
+			break;
+
+		stringlistappend( list, name );
+	}
+
+	if( list->numstrings != numentries )
+	{
+		stringlistfreecontents( list );
+		stringlistinit( list );
+		return false;
+	}
+
+	return true;
+}
+
+static void FS_StoreDirEntriesInCache( const stringlist_t *list, const char *path, int mtime )
+{
+	size_t size = 0;
+	char *buf, *p;
+	int i;
+
+	for( i = 0; i < list->numstrings; i++ )
+		size += Q_strlen( list->strings[i] ) + 1;
+
+	if( !size )
+		return;
+
+	p = buf = (char *)Mem_Malloc( fs_mempool, size );
+
+	for( i = 0; i < list->numstrings; i++ )
+	{
+		size_t len = Q_strlen( list->strings[i] ) + 1;
+
+		memcpy( p, list->strings[i], len );
+		p += len;
+	}
+
+	FS_StoreIndexCache( path, SEARCHPATH_PLAIN, 0, mtime, list->numstrings, buf, size );
+	Mem_Free( buf );
+}
+
 static void FS_PopulateDirEntries( dir_t *dir, const char *path )
 {
 	stringlist_t list;
+	int mtime;
 
 	if( !FS_SysFolderExists( path ))
 	{
@@ -133,8 +191,16 @@ static void FS_PopulateDirEntries( dir_t *dir, const char *path )
 		return;
 	}
 
+	// directory timestamp changes when something is added or removed
+	mtime = FS_SysFileTime( path );
+
 	stringlistinit( &list );
-	listdirectory( &list, path );
+	if( !FS_LoadDirEntriesFromCache( &list, path, mtime ))
+	{
+		listdirectory( &list, path );
+		FS_StoreDirEntriesInCache( &list, path, mtime );
+	}
+
 	if( !list.numstrings )
 	{
 		dir->numentries = DIRENTRY_EMPTY_DIRECTORY;
@@ -32,6 +32,15 @@ GNU General Public License for more details.
 #endif
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
+#if XASH_POSIX && !defined( XASH_REDUCE_FD )
+#include <sys/mman.h>
+#include <unistd.h>
+#define HAVE_MMAP 1
+#endif
+#if (( XASH_LINUX && !XASH_ANDROID ) || XASH_FREEBSD ) && !defined( XASH_REDUCE_FD )
+#define HAVE_FADVISE 1
+#endif
 #include "port.h"
 #include "defaults.h"
 #include "const.h"
@@ -44,6 +53,9 @@ GNU General Public License for more details.
 #include "common/protocol.h"
 
 #define FILE_COPY_SIZE		(1024 * 1024)
+#define FILE_INDEX_MIN_BUCKETS	1024	// power of two
+#define FILE_MAP_MIN_SIZE		(64 * 1024)	// smaller files are cheaper to copy
+#define FILE_INDEX_MAX_HITS		16	// same name in this many archives falls back to pfnFindFile
 
 fs_globals_t FI;
 qboolean      fs_ext_path = false;	// attempt to read\write from ./ or ../ pathes
@@ -53,6 +65,51 @@ char          fs_rootdir[MAX_SYSPATH];
 searchpath_t *fs_writepath;
 
 static searchpath_t *fs_searchpaths = NULL;	// chain
+
+// merged index of all archives with fixed contents (PAK, PK3)
+typedef struct fsindexentry_s
+{
+	const char	*name;		// owned by the archive
+	uint		hash;
+	int		pack_ind;
+	searchpath_t	*search;
+	struct fsindexentry_s	*next;	// bucket chain
+} fsindexentry_t;
+
+typedef struct fsindexblock_s
+{
+	searchpath_t	*search;
+	struct fsindexblock_s	*next;
+	int		numentries;
+	fsindexentry_t	entries[]; // flexible
+} fsindexblock_t;
+
+static struct
+{
+	fsindexentry_t	**buckets;
+	uint		numbuckets;
+	uint		numentries;
+	fsindexblock_t	*blocks;
+
+	// FS_FindFile statistics
+	uint		lookups;
+	uint		hits;
+	uint		misses;
+	uint		probes;		// pfnFindFile calls for unindexed searchpaths
+} fs_index;
+
+#if HAVE_MMAP
+// live FS_MapFile results that are mappings rather than copies
+typedef struct fsview_s
+{
+	byte		*data;
+	void		*base;	// page aligned
+	size_t		length;
+	struct fsview_s	*next;
+} fsview_t;
+
+static fsview_t *fs_views;
+#endif
 static char			fs_basedir[MAX_SYSPATH];	// base game directory
 static char			fs_gamedir[MAX_SYSPATH];	// game current directory
 
@@ -124,6 +181,7 @@ static void FS_BackupFileName( file_t *file, const char *path, uint options ) {}
 
 static void FS_InitMemory( void );
 static void FS_Purge( file_t* file );
+static void FS_SetFileAccess( file_t *file, const char *mode );
 
 void _Mem_Free( void *data, const char *filename, int fileline )
 {
@@ -274,11 +332,11 @@ OTHER PRIVATE FUNCTIONS
 FS_PathToWideChar
 
 Converts input UTF-8 string to wide char string.
+Buffer is provided by the caller because archives are opened from many threads.
 ====================
 */
-static const wchar_t *FS_PathToWideChar( const char *path )
+static const wchar_t *FS_PathToWideChar( const char *path, wchar_t pathBuffer[MAX_PATH] )
 {
-	static wchar_t pathBuffer[MAX_PATH];
 	MultiByteToWideChar( CP_UTF8, 0, path, -1, pathBuffer, MAX_PATH );
 	return pathBuffer;
 }
@@ -308,23 +366,211 @@ void FS_CreatePath( char *path )
 	}
 }
 
-searchpath_t *FS_AddArchive_Fullpath( const fs_archive_t *archive, const char *file, int flags )
+/*
+============
+FS_HashFileName
+
+case insensitive, same as Q_stricmp used by archive lookups
+============
+*/
+static uint FS_HashFileName( const char *name )
+{
+	uint hash = 2166136261u;
+
+	for( ; *name; name++ )
+	{
+		hash ^= (byte)Q_tolower( *name );
+		hash *= 16777619u;
+	}
+
+	return hash ^ ( hash >> 16 );
+}
+
+/*
+============
+FS_ResizeFileIndex
+
+============
+*/
+static void FS_ResizeFileIndex( uint numbuckets )
+{
+	fsindexblock_t *block;
+	int i;
+
+	if( fs_index.buckets )
+		Mem_Free( fs_index.buckets );
+
+	fs_index.buckets = Mem_Calloc( fs_mempool, numbuckets * sizeof( *fs_index.buckets ));
+	fs_index.numbuckets = numbuckets;
+
+	for( block = fs_index.blocks; block; block = block->next )
+	{
+		for( i = 0; i < block->numentries; i++ )
+		{
+			fsindexentry_t *e = &block->entries[i];
+			fsindexentry_t **bucket = &fs_index.buckets[e->hash & ( numbuckets - 1 )];
+
+			e->next = *bucket;
+			*bucket = e;
+		}
+	}
+}
+
+/*
+============
+FS_IndexArchive
+
+adds all files of the archive to the global file index
+============
+*/
+static void FS_IndexArchive( searchpath_t *search )
+{
+	fsindexblock_t *block;
+	uint numbuckets;
+	int i, count;
+
+	if( !search->pfnGetFileName )
+		return;
+
+	for( count = 0; search->pfnGetFileName( search, count ); count++ );
+
+	block = Mem_Malloc( fs_mempool, sizeof( *block ) + count * sizeof( block->entries[0] ));
+	block->search = search;
+	block->numentries = count;
+	block->next = fs_index.blocks;
+	fs_index.blocks = block;
+	fs_index.numentries += count;
+
+	for( i = 0; i < count; i++ )
+	{
+		fsindexentry_t *e = &block->entries[i];
+
+		e->name = search->pfnGetFileName( search, i );
+		e->hash = FS_HashFileName( e->name );
+		e->pack_ind = i;
+		e->search = search;
+		e->next = NULL;
+	}
+
+	// keep load factor below one, resizing links the new block too
+	numbuckets = Q_max( fs_index.numbuckets, FILE_INDEX_MIN_BUCKETS );
+	while( numbuckets < fs_index.numentries )
+		numbuckets <<= 1;
+
+	if( numbuckets != fs_index.numbuckets )
+	{
+		FS_ResizeFileIndex( numbuckets );
+		return;
+	}
+
+	for( i = 0; i < count; i++ )
+	{
+		fsindexentry_t *e = &block->entries[i];
+		fsindexentry_t **bucket = &fs_index.buckets[e->hash & ( numbuckets - 1 )];
+
+		e->next = *bucket;
+		*bucket = e;
+	}
+}
+
+/*
+============
+FS_UnindexArchive
+
+============
+*/
+static void FS_UnindexArchive( searchpath_t *search )
+{
+	fsindexblock_t *block, **prev;
+	int i;
+
+	for( prev = &fs_index.blocks; *prev; prev = &( *prev )->next )
+	{
+		if( ( *prev )->search == search )
+			break;
+	}
+
+	if( !*prev )
+		return;
+
+	block = *prev;
+	*prev = block->next;
+
+	for( i = 0; i < block->numentries; i++ )
+	{
+		fsindexentry_t *e = &block->entries[i];
+		fsindexentry_t **link = &fs_index.buckets[e->hash & ( fs_index.numbuckets - 1 )];
+
+		while( *link != e )
+			link = &( *link )->next;
+		*link = e->next;
+	}
+
+	fs_index.numentries -= block->numentries;
+	Mem_Free( block );
+}
+
+/*
+============
+FS_ShutdownFileIndex
+
+============
+*/
+static void FS_ShutdownFileIndex( void )
+{
+	while( fs_index.blocks )
+		FS_UnindexArchive( fs_index.blocks->search );
+
+	if( fs_index.buckets )
+		Mem_Free( fs_index.buckets );
+
+	memset( &fs_index, 0, sizeof( fs_index ));
+}
+
+static searchpath_t *FS_FindLoadedArchive( const fs_archive_t *archive, const char *file )
 {
 	searchpath_t *search;
 
 	for( search = fs_searchpaths; search; search = search->next )
 	{
 		if( search->type == archive->type && !Q_stricmp( search->filename, file ))
-			return search; // already loaded
+			return search;
 	}
 
-	search = archive->pfnAddArchive_Fullpath( file, flags );
+	return NULL;
+}
 
-	if( !search )
-		return NULL;
+/*
+================
+FS_LoadSearchPath
+
+calls the archive loader and remembers how long it took,
+safe to call from several threads at once while mounting
+================
+*/
+static searchpath_t *FS_LoadSearchPath( FS_ADDARCHIVE_FULLPATH pfnAddArchive_Fullpath, const char *file, int flags )
+{
+	double start = g_engfuncs._Sys_DoubleTime();
+	searchpath_t *search = pfnAddArchive_Fullpath( file, flags );
+
+	if( search )
+		search->loadtime = g_engfuncs._Sys_DoubleTime() - start;
+
+	return search;
+}
 
+/*
+================
+FS_LinkArchive
+
+puts freshly loaded archive to the head of the search path
+================
+*/
+static void FS_LinkArchive( const fs_archive_t *archive, searchpath_t *search, const char *file, int flags )
+{
 	search->next = fs_searchpaths;
 	fs_searchpaths = search;
+	FS_IndexArchive( search );
 
 	// time to add in search list all the wads from this archive
 	if( archive->load_wads && !FBitSet( flags, FS_SKIP_ARCHIVED_WADS ))
@@ -342,7 +588,7 @@ searchpath_t *FS_AddArchive_Fullpath( const fs_archive_t *archive, const char *f
 			char fullpath[MAX_SYSPATH];
 
 			Q_snprintf( fullpath, sizeof( fullpath ), "%s/%s", file, list.strings[i] );
-			if(( wad = FS_AddWad_Fullpath( fullpath, flags | FS_LOAD_PACKED_WAD )))
+			if(( wad = FS_LoadSearchPath( FS_AddWad_Fullpath, fullpath, flags | FS_LOAD_PACKED_WAD )))
 			{
 				wad->next = fs_searchpaths;
 				fs_searchpaths = wad;
@@ -351,13 +597,289 @@ searchpath_t *FS_AddArchive_Fullpath( const fs_archive_t *archive, const char *f
 
 		stringlistfreecontents( &list );
 	}
+}
+
+searchpath_t *FS_AddArchive_Fullpath( const fs_archive_t *archive, const char *file, int flags )
+{
+	searchpath_t *search;
+
+	if(( search = FS_FindLoadedArchive( archive, file )))
+		return search; // already loaded
+
+	search = FS_LoadSearchPath( archive->pfnAddArchive_Fullpath, file, flags );
+
+	if( !search )
+		return NULL;
+
+	FS_LinkArchive( archive, search, file, flags );
 
 	return search;
 }
 
+/*
+=============================================================================
+
+PARALLEL MOUNTING
+
+FS_AddGameDirectory only queues its archives and directories, they are
+loaded on the engine thread pool when the outermost FS_EndMount is reached
+and then linked to the search path in the order they were queued, so the
+result is the same as if they were mounted one by one
+
+=============================================================================
+*/
+typedef struct fsmount_s
+{
+	const fs_archive_t	*archive;
+	char		file[MAX_SYSPATH];
+	int		flags;
+	qboolean		serial;		// loader isn't thread-safe, load while linking
+	qboolean		writepath;	// becomes fs_writepath when linked
+	searchpath_t	*search;
+} fsmount_t;
+
+static struct
+{
+	fsmount_t		*mounts;
+	int		nummounts;
+	int		maxmounts;
+	int		depth;
+
+	// engine functions replaced by the locked versions below while loading
+	fs_interface_t	unlocked;
+} fs_mount;
+
+static poolhandle_t Mem_AllocPoolLocked( const char *name, const char *filename, int fileline )
+{
+	poolhandle_t pool;
+
+	g_engfuncs._Jobs_EnterCritical();
+	pool = fs_mount.unlocked._Mem_AllocPool( name, filename, fileline );
+	g_engfuncs._Jobs_LeaveCritical();
+
+	return pool;
+}
+
+static void Mem_FreePoolLocked( poolhandle_t *poolptr, const char *filename, int fileline )
+{
+	g_engfuncs._Jobs_EnterCritical();
+	fs_mount.unlocked._Mem_FreePool( poolptr, filename, fileline );
+	g_engfuncs._Jobs_LeaveCritical();
+}
+
+static void *Mem_AllocLocked( poolhandle_t poolptr, size_t size, qboolean clear, const char *filename, int fileline )
+{
+	void *ptr;
+
+	g_engfuncs._Jobs_EnterCritical();
+	ptr = fs_mount.unlocked._Mem_Alloc( poolptr, size, clear, filename, fileline );
+	g_engfuncs._Jobs_LeaveCritical();
+
+	return ptr;
+}
+
+static void *Mem_ReallocLocked( poolhandle_t poolptr, void *memptr, size_t size, qboolean clear, const char *filename, int fileline )
+{
+	void *ptr;
+
+	g_engfuncs._Jobs_EnterCritical();
+	ptr = fs_mount.unlocked._Mem_Realloc( poolptr, memptr, size, clear, filename, fileline );
+	g_engfuncs._Jobs_LeaveCritical();
+
+	return ptr;
+}
+
+static void Mem_FreeLocked( void *data, const char *filename, int fileline )
+{
+	g_engfuncs._Jobs_EnterCritical();
+	fs_mount.unlocked._Mem_Free( data, filename, fileline );
+	g_engfuncs._Jobs_LeaveCritical();
+}
+
+static void Con_PrintfLocked( void (*pfnPrintf)( const char *fmt, ... ), const char *fmt, va_list ap )
+{
+	char buffer[MAX_PRINT_MSG];
+
+	Q_vsnprintf( buffer, sizeof( buffer ), fmt, ap );
+
+	g_engfuncs._Jobs_EnterCritical();
+	pfnPrintf( "%s", buffer );
+	g_engfuncs._Jobs_LeaveCritical();
+}
+
+static void Con_PrintfLocked_( const char *fmt, ... )
+{
+	va_list ap;
+
+	va_start( ap, fmt );
+	Con_PrintfLocked( fs_mount.unlocked._Con_Printf, fmt, ap );
+	va_end( ap );
+}
+
+static void Con_DPrintfLocked( const char *fmt, ... )
+{
+	va_list ap;
+
+	va_start( ap, fmt );
+	Con_PrintfLocked( fs_mount.unlocked._Con_DPrintf, fmt, ap );
+	va_end( ap );
+}
+
+static void Con_ReportfLocked( const char *fmt, ... )
+{
+	va_list ap;
+
+	va_start( ap, fmt );
+	Con_PrintfLocked( fs_mount.unlocked._Con_Reportf, fmt, ap );
+	va_end( ap );
+}
+
+/*
+================
+FS_LoadMountJob
+
+runs on the thread pool, only touches its own fsmount_t
+================
+*/
+static void FS_LoadMountJob( void *data, int index )
+{
+	fsmount_t *mount = (fsmount_t *)data + index;
+
+	if( !mount->serial )
+		mount->search = FS_LoadSearchPath( mount->archive->pfnAddArchive_Fullpath, mount->file, mount->flags );
+}
+
+/*
+================
+FS_BeginMount
+================
+*/
+static void FS_BeginMount( void )
+{
+	fs_mount.depth++;
+}
+
+/*
+================
+FS_QueueMount
+================
+*/
+static void FS_QueueMount( const fs_archive_t *archive, const char *file, int flags, qboolean serial, qboolean writepath )
+{
+	fsmount_t *mount;
+	int i;
+
+	// don't waste time on loading something that is already there,
+	// it would be thrown away when linking anyway
+	if( !writepath && FS_FindLoadedArchive( archive, file ))
+		return;
+
+	for( i = 0; i < fs_mount.nummounts && !writepath; i++ )
+	{
+		if( fs_mount.mounts[i].archive->type == archive->type && !Q_stricmp( fs_mount.mounts[i].file, file ))
+			return;
+	}
+
+	if( fs_mount.nummounts == fs_mount.maxmounts )
+	{
+		fs_mount.maxmounts = Q_max( fs_mount.maxmounts * 2, 32 );
+		fs_mount.mounts = Mem_Realloc( fs_mempool, fs_mount.mounts, fs_mount.maxmounts * sizeof( *fs_mount.mounts ));
+	}
+
+	mount = &fs_mount.mounts[fs_mount.nummounts++];
+	mount->archive = archive;
+	Q_strncpy( mount->file, file, sizeof( mount->file ));
+	mount->flags = flags;
+	mount->serial = serial;
+	mount->writepath = writepath;
+	mount->search = NULL;
+}
+
 /*
 ================
-FS_AddArchive_Fullpath
+FS_EndMount
+
+loads everything queued since the outermost FS_BeginMount in parallel
+and links it to the search path in the queue order
+================
+*/
+static void FS_EndMount( void )
+{
+	double start, loadtime = 0.0;
+	int i, count = fs_mount.nummounts;
+
+	if( --fs_mount.depth > 0 )
+		return;
+
+	if( !count )
+	{
+		FS_CloseIndexCaches();
+		return;
+	}
+
+	start = g_engfuncs._Sys_DoubleTime();
+
+	if( count > 1 )
+	{
+		// engine allocator and console aren't thread-safe
+		fs_mount.unlocked = g_engfuncs;
+		g_engfuncs._Mem_AllocPool = Mem_AllocPoolLocked;
+		g_engfuncs._Mem_FreePool = Mem_FreePoolLocked;
+		g_engfuncs._Mem_Alloc = Mem_AllocLocked;
+		g_engfuncs._Mem_Realloc = Mem_ReallocLocked;
+		g_engfuncs._Mem_Free = Mem_FreeLocked;
+		g_engfuncs._Con_Printf = Con_PrintfLocked_;
+		g_engfuncs._Con_DPrintf = Con_DPrintfLocked;
+		g_engfuncs._Con_Reportf = Con_ReportfLocked;
+
+		g_engfuncs._Jobs_RunParallel( FS_LoadMountJob, fs_mount.mounts, count );
+
+		g_engfuncs = fs_mount.unlocked;
+	}
+	else FS_LoadMountJob( fs_mount.mounts, 0 );
+
+	for( i = 0; i < count; i++ )
+	{
+		fsmount_t *mount = &fs_mount.mounts[i];
+		searchpath_t *search = FS_FindLoadedArchive( mount->archive, mount->file );
+
+		if( search )
+		{
+			// same path was queued twice or was mounted by someone else meanwhile
+			if( mount->search )
+			{
+				mount->search->pfnClose( mount->search );
+				Mem_Free( mount->search );
+			}
+		}
+		else
+		{
+			search = mount->search;
+
+			if( mount->serial )
+				search = FS_LoadSearchPath( mount->archive->pfnAddArchive_Fullpath, mount->file, mount->flags );
+
+			if( search )
+			{
+				loadtime += search->loadtime;
+				FS_LinkArchive( mount->archive, search, mount->file, mount->flags );
+			}
+		}
+
+		if( mount->writepath )
+			fs_writepath = search;
+	}
+
+	fs_mount.nummounts = 0;
+	FS_CloseIndexCaches();
+
+	Con_Reportf( "%s: %i search paths mounted in %.2f ms, %.2f ms spent in loaders\n",
+		__func__, count, ( g_engfuncs._Sys_DoubleTime() - start ) * 1000.0, loadtime * 1000.0 );
+}
+
+/*
+================
+FS_MountArchive_Fullpath
 ================
 */
 static searchpath_t *FS_MountArchive_Fullpath( const char *file, int flags )
@@ -386,7 +908,6 @@ void FS_AddGameDirectory( const char *dir, uint flags )
 {
 	const fs_archive_t *archive;
 	stringlist_t list;
-	searchpath_t *search;
 	char fullpath[MAX_SYSPATH];
 	int i;
 
@@ -394,6 +915,9 @@ void FS_AddGameDirectory( const char *dir, uint flags )
 	listdirectory( &list, dir );
 	stringlistsort( &list );
 
+	FS_BeginMount();
+	FS_OpenIndexCache( dir );
+
 	for( archive = g_archives; archive->ext; archive++ )
 	{
 		for( i = 0; i < list.numstrings; i++ )
@@ -404,21 +928,21 @@ void FS_AddGameDirectory( const char *dir, uint flags )
 				continue;
 
 			Q_snprintf( fullpath, sizeof( fullpath ), "%s%s", dir, list.strings[i] );
-			FS_AddArchive_Fullpath( archive, fullpath, flags );
+			FS_QueueMount( archive, fullpath, flags, false, false );
 		}
 	}
 
 	stringlistfreecontents( &list );
 
 #if XASH_ANDROID
-	FS_AddArchive_Fullpath( &g_android_archive, dir, flags );
+	FS_QueueMount( &g_android_archive, dir, flags, true, false );
 #endif
 
 	// add the directory to the search path
 	// (unpacked files have the priority over packed files)
-	search = FS_AddArchive_Fullpath( &g_directory_archive, dir, flags );
-	if( !FBitSet( flags, FS_NOWRITE_PATH ))
-		fs_writepath = search;
+	FS_QueueMount( &g_directory_archive, dir, flags, false, !FBitSet( flags, FS_NOWRITE_PATH ));
+
+	FS_EndMount();
 }
 
 /*
@@ -430,6 +954,9 @@ void FS_ClearSearchPath( void )
 {
 	searchpath_t *cur, **prev;
 
+	// pending loads hold files from these searchpaths
+	FS_AsyncFlush();
+
 	prev = &fs_searchpaths;
 
 	while( true )
@@ -447,6 +974,7 @@ void FS_ClearSearchPath( void )
 		}
 
 		*prev = cur->next;
+		FS_UnindexArchive( cur );
 		cur->pfnClose( cur );
 		Mem_Free( cur );
 	}
@@ -1240,11 +1768,14 @@ void FS_Rescan( void )
 	if( COM_CheckString( str ))
 		FS_MountArchive_Fullpath( str, extrasFlags );
 
+	// every game directory is loaded at once and linked in this order
+	FS_BeginMount();
 	if( Q_stricmp( GI->basedir, GI->gamefolder ))
 		FS_AddGameHierarchy( GI->basedir, 0 );
 	if( Q_stricmp( GI->basedir, GI->falldir ) && Q_stricmp( GI->gamefolder, GI->falldir ))
 		FS_AddGameHierarchy( GI->falldir, 0 );
 	FS_AddGameHierarchy( GI->gamefolder, FS_GAMEDIR_PATH );
+	FS_EndMount();
 }
 
 /*
@@ -1474,6 +2005,41 @@ static void *Sys_GetNativeObjectStub( const char *object )
 	return NULL;
 }
 
+static void Jobs_RunParallelStub( void (*job)( void *data, int index ), void *data, int count )
+{
+	int i;
+
+	for( i = 0; i < count; i++ )
+		job( data, i );
+}
+
+static void Jobs_CriticalStub( void )
+{
+	// stub
+}
+
+static double Sys_DoubleTimeStub( void )
+{
+	return 0.0;
+}
+
+static void *Jobs_PostTaskStub( void (*job)( void *data, int index ), void *data )
+{
+	// no threads, complete the task right away
+	job( data, 0 );
+	return (void *)1;
+}
+
+static qboolean Jobs_IsTaskDoneStub( void *task )
+{
+	return true;
+}
+
+static void Jobs_WaitTaskStub( void *task )
+{
+	// stub
+}
+
 /*
 ================
 FS_Init
@@ -1498,6 +2064,9 @@ qboolean FS_InitStdio( qboolean unused_set_to_true, const char *rootdir, const c
 	Q_strncpy( fs_basedir, basedir, sizeof( fs_basedir ));
 	Q_strncpy( fs_rodir, rodir, sizeof( fs_rodir ));
 
+	FS_InitIndexCache();
+	FS_InitHashCache();
+
 	// add readonly directories first
 	if( COM_CheckStringEmpty( fs_rodir ))
 	{
@@ -1555,12 +2124,14 @@ qboolean FS_InitStdio( qboolean unused_set_to_true, const char *rootdir, const c
 	}
 
 	// build list of game directories here
+	FS_BeginMount();
 	if( COM_CheckStringEmpty( fs_rodir ))
 	{
 		Q_snprintf( buf, sizeof( buf ), "%s/", fs_rodir );
 		FS_AddGameDirectory( buf, FS_STATIC_PATH|FS_NOWRITE_PATH );
 	}
 	FS_AddGameDirectory( "./", FS_STATIC_PATH );
+	FS_EndMount();
 
 	for( i = 0; i < dirs.numstrings; i++ )
 	{
@@ -1601,7 +2172,16 @@ void FS_ShutdownStdio( void )
 			Mem_Free( FI.games[i] );
 	}
 
+	FS_AsyncShutdown();
+	FS_ShutdownHashCache();
 	FS_ClearSearchPath(); // release all wad files too
+	FS_ShutdownFileIndex();
+	FS_CloseIndexCaches();
+
+	if( fs_mount.mounts )
+		Mem_Free( fs_mount.mounts );
+	memset( &fs_mount, 0, sizeof( fs_mount ));
+
 	Mem_FreePool( &fs_mempool );
 }
 
@@ -1632,8 +2212,13 @@ void FS_Path_f( void )
 		if( s->flags & FS_NOWRITE_PATH ) Con_Printf( " ^2nowrite^7" );
 		if( s->flags & FS_STATIC_PATH ) Con_Printf( " ^2static^7" );
 
-		Con_Printf( "\n" );
+		Con_Printf( " (%.2f ms)\n", s->loadtime * 1000.0 );
 	}
+
+	Con_Printf( "File index: %u files in %u buckets, %u lookups, %u hits, %u misses, %u unindexed probes\n",
+		fs_index.numentries, fs_index.numbuckets, fs_index.lookups, fs_index.hits, fs_index.misses, fs_index.probes );
+
+	FS_HashCacheInfo();
 }
 
 /*
@@ -1647,7 +2232,8 @@ int FS_SysFileTime( const char *filename )
 {
 #if XASH_WIN32
 	struct _stat buf;
-	if( _wstat( FS_PathToWideChar( filename ), &buf ) < 0 )
+	wchar_t wpath[MAX_PATH];
+	if( _wstat( FS_PathToWideChar( filename, wpath ), &buf ) < 0 )
 #else
 	struct stat buf;
 	if( stat( filename, &buf ) < 0 )
@@ -1713,7 +2299,10 @@ file_t *FS_SysOpen( const char *filepath, const char *mode )
 	file->ungetc = EOF;
 
 #if XASH_WIN32
-	file->handle = _wopen( FS_PathToWideChar( filepath ), mod | opt, 0666 );
+	{
+		wchar_t wpath[MAX_PATH];
+		file->handle = _wopen( FS_PathToWideChar( filepath, wpath ), mod | opt, 0666 );
+	}
 #else
 	file->handle = open( filepath, mod|opt, 0666 );
 #endif
@@ -1816,7 +2405,8 @@ qboolean FS_SysFileExists( const char *path )
 {
 #if XASH_WIN32
 	struct _stat buf;
-	if( _wstat( FS_PathToWideChar( path ), &buf ) < 0 )
+	wchar_t wpath[MAX_PATH];
+	if( _wstat( FS_PathToWideChar( path, wpath ), &buf ) < 0 )
 #else
 	struct stat buf;
 	if( stat( path, &buf ) < 0 )
@@ -1837,7 +2427,8 @@ qboolean FS_SysFolderExists( const char *path )
 {
 #if XASH_WIN32
 	struct _stat buf;
-	if( _wstat( FS_PathToWideChar( path ), &buf ) < 0 )
+	wchar_t wpath[MAX_PATH];
+	if( _wstat( FS_PathToWideChar( path, wpath ), &buf ) < 0 )
 #else
 	struct stat buf;
 	if( stat( path, &buf ) < 0 )
@@ -1858,7 +2449,8 @@ qboolean FS_SysFileOrFolderExists( const char *path )
 {
 #if XASH_WIN32
 	struct _stat buf;
-	return _wstat( FS_PathToWideChar( path ), &buf ) >= 0;
+	wchar_t wpath[MAX_PATH];
+	return _wstat( FS_PathToWideChar( path, wpath ), &buf ) >= 0;
 #else
 	struct stat buf;
 	return stat( path, &buf ) >= 0;
@@ -1876,7 +2468,8 @@ TODO: make this non-fatal
 int FS_SetCurrentDirectory( const char *path )
 {
 #if XASH_WIN32
-	if( !SetCurrentDirectoryW( FS_PathToWideChar( path )))
+	wchar_t wpath[MAX_PATH];
+	if( !SetCurrentDirectoryW( FS_PathToWideChar( path, wpath )))
 	{
 		const DWORD fm_flags = FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS | FORMAT_MESSAGE_MAX_WIDTH_MASK;
 		DWORD errorcode;
@@ -1936,6 +2529,32 @@ and the file index in the package if relevant
 searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t len, qboolean gamedironly )
 {
 	searchpath_t	*search;
+	fsindexentry_t	*hits[FILE_INDEX_MAX_HITS];
+	int		i, numhits = 0;
+	qboolean		overflow = false;
+
+	fs_index.lookups++;
+
+	// collect every archive that has this file with a single probe
+	if( fs_index.numentries > 0 )
+	{
+		uint hash = FS_HashFileName( name );
+		fsindexentry_t *e;
+
+		for( e = fs_index.buckets[hash & ( fs_index.numbuckets - 1 )]; e; e = e->next )
+		{
+			if( e->hash != hash || Q_stricmp( e->name, name ))
+				continue;
+
+			if( numhits == FILE_INDEX_MAX_HITS )
+			{
+				overflow = true;
+				break;
+			}
+
+			hits[numhits++] = e;
+		}
+	}
 
 	// search through the path, one element at a time
 	for( search = fs_searchpaths; search; search = search->next )
@@ -1945,11 +2564,34 @@ searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t
 		if( gamedironly & !FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
 			continue;
 
+		// indexed archives only need to be checked against the hits
+		if( search->pfnGetFileName && !overflow )
+		{
+			for( i = 0; i < numhits; i++ )
+			{
+				if( hits[i]->search != search )
+					continue;
+
+				if( fixedname )
+					Q_strncpy( fixedname, hits[i]->name, len );
+				if( index )
+					*index = hits[i]->pack_ind;
+
+				fs_index.hits++;
+				return search;
+			}
+			continue;
+		}
+
+		fs_index.probes++;
+
 		pack_ind = search->pfnFindFile( search, name, fixedname, len );
 		if( pack_ind >= 0 )
 		{
 			if( index )
 				*index = pack_ind;
+
+			fs_index.hits++;
 			return search;
 		}
 	}
@@ -1991,6 +2633,7 @@ searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t
 			if( index != NULL )
 				*index = 0;
 
+			fs_index.hits++;
 			return &fs_directpath;
 		}
 	}
@@ -1998,6 +2641,7 @@ searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t
 	if( index != NULL )
 		*index = -1;
 
+	fs_index.misses++;
 	return NULL;
 }
 
@@ -2067,6 +2711,8 @@ Open a file. The syntax is the same as fopen
 */
 file_t *FS_Open( const char *filepath, const char *mode, qboolean gamedironly )
 {
+	file_t *file;
+
 	if( !fs_searchpaths )
 		return NULL;
 
@@ -2091,11 +2737,18 @@ file_t *FS_Open( const char *filepath, const char *mode, qboolean gamedironly )
 
 		FS_CreatePath( real_path ); // Create directories up to the file
 
-		return FS_SysOpen( real_path, mode );
+		file = FS_SysOpen( real_path, mode );
+	}
+	else
+	{
+		// else, we look at the various search paths and open the file in read-only mode
+		file = FS_OpenReadFile( filepath, mode, gamedironly );
 	}
 
-	// else, we look at the various search paths and open the file in read-only mode
-	return FS_OpenReadFile( filepath, mode, gamedironly );
+	if( file )
+		FS_SetFileAccess( file, mode );
+
+	return file;
 }
 
 /*
@@ -2111,6 +2764,12 @@ int FS_Close( file_t *file )
 
 	FS_BackupFileName( file, NULL, 0 );
 
+	if( file->ztk )
+		FS_CloseDeflated_ZIP( file );
+
+	if( file->buff_ext )
+		Mem_Free( file->buff_ext );
+
 	if( file->handle >= 0 )
 	{
 		if( close( file->handle ))
@@ -2179,6 +2838,126 @@ fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
 	return result;
 }
 
+/*
+====================
+FS_SetFileAccess
+
+'S' in open mode is for sequential and 'R' is for random access,
+like in MSVC fopen, otherwise buffer size adapts to the reads
+====================
+*/
+static void FS_SetFileAccess( file_t *file, const char *mode )
+{
+	if( Q_strchr( mode, 'S' ))
+	{
+		file->access = FS_ACCESS_SEQUENTIAL;
+#if HAVE_FADVISE
+		posix_fadvise( file->handle, file->offset, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+	}
+	else if( Q_strchr( mode, 'R' ))
+	{
+		file->access = FS_ACCESS_RANDOM;
+#if HAVE_FADVISE
+		posix_fadvise( file->handle, file->offset, 0, POSIX_FADV_RANDOM );
+#endif
+	}
+}
+
+/*
+====================
+FS_ReadFillSize
+
+Returns how much to read into the empty buffer, growing it
+after a few refills in a row, seeks bring it back to default
+====================
+*/
+static fs_offset_t FS_ReadFillSize( file_t *file )
+{
+	fs_offset_t fill = file->buff_fill ? file->buff_fill : (fs_offset_t)sizeof( file->buff );
+
+	if( file->access == FS_ACCESS_RANDOM || fill >= FILE_BUFF_MAX_SIZE )
+		return fill;
+
+	if( file->access == FS_ACCESS_SEQUENTIAL )
+	{
+		fill = FILE_BUFF_MAX_SIZE;
+	}
+	else
+	{
+		if( ++file->seq_fills < FILE_SEQUENTIAL_FILLS )
+			return fill;
+
+		file->seq_fills = 0;
+		fill = Q_min( fill * 4, FILE_BUFF_MAX_SIZE );
+	}
+
+	// keep the largest one, so going back and forth doesn't reallocate
+	if( fill > file->buff_ext_size )
+	{
+		if( file->buff_ext )
+			Mem_Free( file->buff_ext );
+
+		file->buff_ext = (byte *)Mem_Malloc( fs_mempool, fill );
+		file->buff_ext_size = fill;
+	}
+
+	file->buff_fill = fill;
+	return fill;
+}
+
+/*
+====================
+FS_ReadAtPosition
+
+Read unbuffered data at the current file position
+====================
+*/
+static fs_offset_t FS_ReadAtPosition( file_t *file, void *buffer, fs_offset_t count )
+{
+	if( file->ztk )
+		return FS_ReadDeflated_ZIP( file, buffer, count );
+
+	lseek( file->handle, file->offset + file->position, SEEK_SET );
+	return read( file->handle, buffer, count );
+}
+
+/*
+====================
+FS_SysReadAt
+
+Read exactly "length" bytes at "offset" from the start of the file,
+doesn't use the file position, so it can be called from other threads
+====================
+*/
+qboolean FS_SysReadAt( file_t *file, void *buffer, fs_offset_t offset, fs_offset_t length )
+{
+#if HAVE_PREAD
+	byte *p = (byte *)buffer;
+
+	offset += file->offset;
+
+	while( length > 0 )
+	{
+		ssize_t c = pread( file->handle, p, length, offset );
+
+		if( c < 0 && errno == EINTR )
+			continue;
+
+		if( c <= 0 )
+			return false;
+
+		p += c;
+		offset += c;
+		length -= c;
+	}
+
+	return true;
+#else // !HAVE_PREAD
+	return false;
+#endif // !HAVE_PREAD
+}
+
 /*
 ====================
 FS_Read
@@ -2188,9 +2967,11 @@ Read up to "buffersize" bytes from a file
 */
 fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 {
+	byte		*buff = file->buff_ext ? file->buff_ext : file->buff;
 	fs_offset_t	done;
 	fs_offset_t	nb;
 	fs_offset_t	count;
+	fs_offset_t	fill;
 
 	// nothing to copy
 	if( buffersize == 0 ) return 1;
@@ -2212,7 +2993,7 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 		count = ( buffersize > count ) ? count : (fs_offset_t)buffersize;
 
 		done += count;
-		memcpy( buffer, &file->buff[file->buff_ind], count );
+		memcpy( buffer, &buff[file->buff_ind], count );
 		file->buff_ind += count;
 
 		buffersize -= count;
@@ -2220,19 +3001,23 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 			return done;
 	}
 
-	// NOTE: at this point, the read buffer is always empty
+	// NOTE: at this point, the read buffer is always consumed, drop it
+	// before FS_ReadFillSize may switch to a bigger one
+	FS_Purge( file );
 
 	FS_EnsureOpenFile( file );
 	// we must take care to not read after the end of the file
 	count = file->real_length - file->position;
 
+	fill = FS_ReadFillSize( file );
+	buff = file->buff_ext ? file->buff_ext : file->buff;
+
 	// if we have a lot of data to get, put them directly into "buffer"
-	if( buffersize > sizeof( file->buff ) / 2 )
+	if( (fs_offset_t)buffersize > fill / 2 )
 	{
 		if( count > (fs_offset_t)buffersize )
 			count = (fs_offset_t)buffersize;
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, &((byte *)buffer)[done], count );
+		nb = FS_ReadAtPosition( file, &((byte *)buffer)[done], count );
 
 		if( nb > 0 )
 		{
@@ -2244,10 +3029,9 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 	}
 	else
 	{
-		if( count > (fs_offset_t)sizeof( file->buff ))
-			count = (fs_offset_t)sizeof( file->buff );
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, file->buff, count );
+		if( count > fill )
+			count = fill;
+		nb = FS_ReadAtPosition( file, buff, count );
 
 		if( nb > 0 )
 		{
@@ -2256,7 +3040,7 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 
 			// copy the requested data in "buffer" (as much as we can)
 			count = (fs_offset_t)buffersize > file->buff_len ? file->buff_len : (fs_offset_t)buffersize;
-			memcpy( &((byte *)buffer)[done], file->buff, count );
+			memcpy( &((byte *)buffer)[done], buff, count );
 			file->buff_ind = count;
 			done += count;
 		}
@@ -2438,7 +3222,13 @@ int FS_Seek( file_t *file, fs_offset_t offset, int whence )
 	// Purge cached data
 	FS_Purge( file );
 
-	if( lseek( file->handle, file->offset + offset, SEEK_SET ) == -1 )
+	// not sequential anymore, start over with a small buffer
+	file->seq_fills = 0;
+	if( file->access != FS_ACCESS_SEQUENTIAL )
+		file->buff_fill = 0;
+
+	// deflated files catch up on the next read
+	if( !file->ztk && lseek( file->handle, file->offset + offset, SEEK_SET ) == -1 )
 		return -1;
 	file->position = offset;
 
@@ -2495,7 +3285,7 @@ static void FS_CustomFree( void *data )
 	Mem_Free( data );
 }
 
-static byte *FS_LoadFileFromArchive( searchpath_t *sp, const char *path, int pack_ind, fs_offset_t *filesizeptr, const qboolean sys_malloc )
+byte *FS_LoadFileFromArchive( searchpath_t *sp, const char *path, int pack_ind, fs_offset_t *filesizeptr, const qboolean sys_malloc )
 {
 	fs_offset_t	filesize;
 	file_t *file;
@@ -2532,19 +3322,14 @@ static byte *FS_LoadFileFromArchive( searchpath_t *sp, const char *path, int pac
 
 /*
 ============
-FS_LoadFile
+FS_FindFileToLoad
 
-Filename are relative to the xash directory.
-Always appends a 0 byte.
+FS_FindFile with the path cleanup shared by all the loading functions
 ============
 */
-static byte *FS_LoadFile_( const char *path, fs_offset_t *filesizeptr, const qboolean gamedironly, const qboolean custom_alloc )
+searchpath_t *FS_FindFileToLoad( const char *path, int *pack_ind, char *netpath, size_t len, qboolean gamedironly )
 {
-	searchpath_t *search;
-	char netpath[MAX_SYSPATH];
-	int pack_ind;
-
-	// some mappers used leading '/' or '\' in path to models or sounds
+	// some mappers used leading '/' or '\\' in path to models or sounds
 	if( path[0] == '/' || path[0] == '\\' )
 		path++;
 
@@ -2554,7 +3339,24 @@ static byte *FS_LoadFile_( const char *path, fs_offset_t *filesizeptr, const qbo
 	if( !fs_searchpaths || FS_CheckNastyPath( path ))
 		return NULL;
 
-	search = FS_FindFile( path, &pack_ind, netpath, sizeof( netpath ), gamedironly );
+	return FS_FindFile( path, pack_ind, netpath, len, gamedironly );
+}
+
+/*
+============
+FS_LoadFile
+
+Filename are relative to the xash directory.
+Always appends a 0 byte.
+============
+*/
+static byte *FS_LoadFile_( const char *path, fs_offset_t *filesizeptr, const qboolean gamedironly, const qboolean custom_alloc )
+{
+	searchpath_t *search;
+	char netpath[MAX_SYSPATH];
+	int pack_ind;
+
+	search = FS_FindFileToLoad( path, &pack_ind, netpath, sizeof( netpath ), gamedironly );
 
 	if( !search )
 		return NULL;
@@ -2572,67 +3374,129 @@ byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamediro
 	return FS_LoadFile_( path, filesizeptr, gamedironly, true );
 }
 
-qboolean CRC32_File( dword *crcvalue, const char *filename )
+#if HAVE_MMAP
+/*
+============
+FS_MapFileFromArchive
+
+maps a file that lies on disk as is, returns NULL if it can't
+============
+*/
+static byte *FS_MapFileFromArchive( searchpath_t *sp, const char *path, int pack_ind, fs_offset_t *filesizeptr )
 {
-	char	buffer[1024];
-	int	num_bytes;
-	file_t	*f;
+	fs_offset_t start, filesize;
+	size_t length;
+	long pagesize;
+	fsview_t *view;
+	file_t *file;
+	void *base;
 
-	f = FS_Open( filename, "rb", false );
-	if( !f ) return false;
+	file = sp->pfnOpenFile( sp, path, "rb", pack_ind );
 
-	CRC32_Init( crcvalue );
+	if( !file )
+		return NULL;
 
-	while( 1 )
+	// loaders expect aligned data, FS_LoadFile gives them that
+	if( file->ztk || file->handle < 0 || file->real_length < FILE_MAP_MIN_SIZE || ( file->offset & 3 ) != 0 )
 	{
-		num_bytes = FS_Read( f, buffer, sizeof( buffer ));
+		FS_Close( file );
+		return NULL;
+	}
 
-		if( num_bytes > 0 )
-			CRC32_ProcessBuffer( crcvalue, buffer, num_bytes );
+	pagesize = sysconf( _SC_PAGESIZE );
+	start = file->offset & ~((fs_offset_t)pagesize - 1 );
+	filesize = file->real_length;
+	length = file->offset - start + filesize;
 
-		if( FS_Eof( f )) break;
+	// private writable mapping, so loaders that patch their input in place still work
+	base = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, file->handle, start );
+	if( base == MAP_FAILED )
+	{
+		FS_Close( file );
+		return NULL;
 	}
 
-	FS_Close( f );
-	return true;
+	view = (fsview_t *)Mem_Malloc( fs_mempool, sizeof( *view ));
+	view->data = (byte *)base + ( file->offset - start );
+	view->base = base;
+	view->length = length;
+	view->next = fs_views;
+	fs_views = view;
+
+	// mapping outlives the descriptor
+	FS_Close( file );
+
+	if( filesizeptr ) *filesizeptr = filesize;
+
+	return view->data;
 }
+#endif
+
+/*
+============
+FS_MapFile
 
-qboolean MD5_HashFile( byte digest[16], const char *pszFileName, uint seed[4] )
+Same as FS_LoadFile, but big files that are stored uncompressed
+are mapped straight from disk without copying. The data doesn't have
+a 0 byte appended and must be released with FS_UnmapFile.
+============
+*/
+byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
 {
-	file_t		*file;
-	byte		buffer[1024];
-	MD5Context_t	MD5_Hash;
-	int		bytes;
+#if HAVE_MMAP
+	searchpath_t *search;
+	char netpath[MAX_SYSPATH];
+	int pack_ind;
+	byte *data;
 
-	if(( file = FS_Open( pszFileName, "rb", false )) == NULL )
-		return false;
+	search = FS_FindFileToLoad( path, &pack_ind, netpath, sizeof( netpath ), gamedironly );
 
-	memset( &MD5_Hash, 0, sizeof( MD5Context_t ));
+	if( !search )
+		return NULL;
 
-	MD5Init( &MD5_Hash );
+	data = FS_MapFileFromArchive( search, netpath, pack_ind, filesizeptr );
 
-	if( seed )
-	{
-		MD5Update( &MD5_Hash, (const byte *)seed, 16 );
-	}
+	if( data )
+		return data;
 
-	while( 1 )
+	return FS_LoadFileFromArchive( search, netpath, pack_ind, filesizeptr, false );
+#else
+	return FS_LoadFile( path, filesizeptr, gamedironly );
+#endif
+}
+
+/*
+============
+FS_UnmapFile
+
+============
+*/
+void FS_UnmapFile( byte *data )
+{
+#if HAVE_MMAP
+	fsview_t *view, **prev;
+
+	if( !data )
+		return;
+
+	for( prev = &fs_views; *prev; prev = &view->next )
 	{
-		bytes = FS_Read( file, buffer, sizeof( buffer ));
+		view = *prev;
 
-		if( bytes > 0 )
-			MD5Update( &MD5_Hash, buffer, bytes );
+		if( view->data != data )
+			continue;
 
-		if( FS_Eof( file ))
-			break;
+		*prev = view->next;
+		munmap( view->base, view->length );
+		Mem_Free( view );
+		return;
 	}
+#endif
 
-	FS_Close( file );
-	MD5Final( digest, &MD5_Hash );
-
-	return true;
+	Mem_Free( data );
 }
 
+
 /*
 ============
 FS_LoadFile
@@ -3041,12 +3905,22 @@ fs_interface_t g_engfuncs =
 	Mem_ReallocStub,
 	Mem_FreeStub,
 	Sys_GetNativeObjectStub,
+	Jobs_RunParallelStub,
+	Jobs_CriticalStub,
+	Jobs_CriticalStub,
+	Sys_DoubleTimeStub,
+	Jobs_PostTaskStub,
+	Jobs_IsTaskDoneStub,
+	Jobs_WaitTaskStub,
 };
 
+// last version without threading, timing and background task functions
+#define FS_API_VERSION_NO_JOBS 3
+
 static qboolean FS_InitInterface( int version, const fs_interface_t *engfuncs )
 {
-	// to be extended in future interface revisions
-	if( version != FS_API_VERSION )
+	// older engines pass shorter interface, don't read past it
+	if( version < FS_API_VERSION_NO_JOBS || version > FS_API_VERSION )
 	{
 		Con_Printf( S_ERROR "filesystem optional interface version mismatch: expected %d, got %d\n",
 			FS_API_VERSION, version );
@@ -3088,6 +3962,28 @@ static qboolean FS_InitInterface( int version, const fs_interface_t *engfuncs )
 		Con_Reportf( "filesystem_stdio: custom platform-specific functions found\n" );
 	}
 
+	if( version == FS_API_VERSION_NO_JOBS )
+		return true;
+
+	if( engfuncs->_Jobs_RunParallel && engfuncs->_Jobs_EnterCritical && engfuncs->_Jobs_LeaveCritical )
+	{
+		g_engfuncs._Jobs_RunParallel = engfuncs->_Jobs_RunParallel;
+		g_engfuncs._Jobs_EnterCritical = engfuncs->_Jobs_EnterCritical;
+		g_engfuncs._Jobs_LeaveCritical = engfuncs->_Jobs_LeaveCritical;
+		Con_Reportf( "filesystem_stdio: custom threading functions found\n" );
+	}
+
+	if( engfuncs->_Sys_DoubleTime )
+		g_engfuncs._Sys_DoubleTime = engfuncs->_Sys_DoubleTime;
+
+	if( engfuncs->_Jobs_PostTask && engfuncs->_Jobs_IsTaskDone && engfuncs->_Jobs_WaitTask )
+	{
+		g_engfuncs._Jobs_PostTask = engfuncs->_Jobs_PostTask;
+		g_engfuncs._Jobs_IsTaskDone = engfuncs->_Jobs_IsTaskDone;
+		g_engfuncs._Jobs_WaitTask = engfuncs->_Jobs_WaitTask;
+		Con_Reportf( "filesystem_stdio: custom background task functions found\n" );
+	}
+
 	return true;
 }
 
@@ -3159,6 +4055,16 @@ const fs_api_t g_api =
 	FS_LoadFileFromArchive,
 
 	FS_GetRootDirectory,
+
+	FS_MapFile,
+	FS_UnmapFile,
+
+	FS_LoadFileAsync,
+	FS_AsyncIsDone,
+	FS_AsyncFinish,
+	FS_AsyncUpdate,
+
+	FS_PrecacheFileHash,
 };
 
 int EXPORT GetFSAPI( int version, fs_api_t *api, fs_globals_t **globals, fs_interface_t *engfuncs );
@@ -3167,8 +4073,16 @@ int EXPORT GetFSAPI( int version, fs_api_t *api, fs_globals_t **globals, fs_inte
 	if( engfuncs && !FS_InitInterface( version, engfuncs ))
 		return 0;
 
-	*api = g_api;
 	*globals = &FI;
 
+	// older engines have shorter fs_api_t, don't write past it
+	if( version == FS_API_VERSION_NO_JOBS )
+	{
+		memcpy( api, &g_api, offsetof( fs_api_t, MapFile ));
+		return FS_API_VERSION_NO_JOBS;
+	}
+
+	*api = g_api;
+
 	return FS_API_VERSION;
 }
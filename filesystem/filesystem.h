@@ -32,8 +32,8 @@ extern "C"
 {
 #endif // __cplusplus
 
-#define FS_API_VERSION 3 // not stable yet!
-#define FS_API_CREATEINTERFACE_TAG   "XashFileSystem002" // follow FS_API_VERSION!!!
+#define FS_API_VERSION 4 // not stable yet!
+#define FS_API_CREATEINTERFACE_TAG   "XashFileSystem003" // follow FS_API_VERSION!!!
 #define FILESYSTEM_INTERFACE_VERSION "VFileSystem009" // never change this!
 
 // search path flags
@@ -53,6 +53,13 @@ enum
 
 typedef struct searchpath_s searchpath_t;
 
+// asynchronous load request, see LoadFileAsync
+typedef struct fs_async_s fs_async_t;
+
+// called on the thread running AsyncUpdate or AsyncFinish, data is NULL if the file
+// couldn't be read, otherwise it's zero terminated and must be freed with Mem_Free
+typedef void (*pfnFileLoaded_t)( const char *path, byte *data, fs_offset_t size, void *userdata );
+
 // IsArchiveExtensionSupported flags
 enum
 {
@@ -160,6 +167,7 @@ typedef struct fs_api_t
 	void (*LoadGameInfo)( const char *rootfolder );
 
 	// file ops
+	// mode is like in fopen, 'S' or 'R' tell that the file is read sequentially or randomly
 	file_t *(*Open)( const char *filepath, const char *mode, qboolean gamedironly );
 	fs_offset_t (*Write)( file_t *file, const void *data, size_t datasize );
 	fs_offset_t (*Read)( file_t *file, void *buffer, size_t buffersize );
@@ -226,6 +234,25 @@ typedef struct fs_api_t
 
 	// gets current root directory, set by InitStdio
 	qboolean (*GetRootDirectory)( char *path, size_t size );
+
+	// like LoadFile but big uncompressed files are mapped into memory instead of copied
+	// the result is writable but changes never reach the disk, doesn't append a 0 byte
+	// must be released with UnmapFile
+	byte *(*MapFile)( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+	void (*UnmapFile)( byte *data );
+
+	// asynchronous LoadFile, requests with higher priority are started first
+	// returns NULL if the file doesn't exist, AsyncUpdate must be called regularly
+	// if callback is set, it receives the data and the request is released after it
+	// otherwise poll with AsyncIsDone and get the data with AsyncFinish, which waits if needed
+	fs_async_t *(*LoadFileAsync)( const char *path, int priority, qboolean gamedironly, pfnFileLoaded_t callback, void *userdata );
+	qboolean (*AsyncIsDone)( fs_async_t *request );
+	byte *(*AsyncFinish)( fs_async_t *request, fs_offset_t *filesizeptr );
+	void (*AsyncUpdate)( void );
+
+	// CRC32_File and MD5_HashFile results are cached, this computes both in background
+	// for files that aren't in the cache yet, so they can be returned without waiting
+	void (*PrecacheFileHash)( const char *path, qboolean gamedironly );
 } fs_api_t;
 
 typedef struct fs_interface_t
@@ -248,6 +275,22 @@ typedef struct fs_interface_t
 
 	// platform
 	void *(*_Sys_GetNativeObject)( const char *object );
+
+	// threading, used to mount search paths in parallel
+	// job is called once for every index in [0, count) and all of them are finished on return
+	// code between _Jobs_EnterCritical and _Jobs_LeaveCritical never runs on two threads at once
+	void  (*_Jobs_RunParallel)( void (*job)( void *data, int index ), void *data, int count );
+	void  (*_Jobs_EnterCritical)( void );
+	void  (*_Jobs_LeaveCritical)( void );
+
+	// timing
+	double (*_Sys_DoubleTime)( void );
+
+	// background tasks for asynchronous loading, job is called once with index 0
+	// task must be released with _Jobs_WaitTask, even if _Jobs_IsTaskDone returned true
+	void    *(*_Jobs_PostTask)( void (*job)( void *data, int index ), void *data );
+	qboolean (*_Jobs_IsTaskDone)( void *task );
+	void     (*_Jobs_WaitTask)( void *task );
 } fs_interface_t;
 
 typedef int (*FSAPI)( int version, fs_api_t *api, fs_globals_t **globals, const fs_interface_t *interface );
@@ -38,8 +38,24 @@ typedef struct zip_s zip_t;
 typedef struct pack_s pack_t;
 typedef struct wfile_s wfile_t;
 typedef struct android_assets_s android_assets_t;
+typedef struct ztoolkit_s ztoolkit_t;
 
 #define FILE_BUFF_SIZE (2048)
+#define FILE_BUFF_MAX_SIZE ( 64 * 1024 ) // sequential reads grow the buffer up to this
+#define FILE_SEQUENTIAL_FILLS 4 // buffer refills without seeking before it grows
+
+// access pattern requested in open mode
+enum
+{
+	FS_ACCESS_DEFAULT = 0, // adapt to the reads
+	FS_ACCESS_SEQUENTIAL, // 'S', largest buffer right away
+	FS_ACCESS_RANDOM, // 'R', never grow the buffer
+};
+
+// positional reads that don't share the file offset, see FS_SysReadAt
+#if XASH_POSIX && !defined( XASH_REDUCE_FD )
+#define HAVE_PREAD 1
+#endif
 
 struct file_s
 {
@@ -50,11 +66,17 @@ struct file_s
 	fs_offset_t  real_length; // uncompressed file size (for files opened in "read" mode)
 	fs_offset_t  position;    // current position in the file
 	fs_offset_t  offset;      // offset into the package (0 if external file)
+	ztoolkit_t   *ztk;        // inflate state for deflated files from ZIP, position is in uncompressed bytes
 	
 	// contents buffer
 	fs_offset_t buff_ind; // buffer current index
 	fs_offset_t buff_len; // buffer current length
 	byte		buff[FILE_BUFF_SIZE]; // intermediate buffer
+	byte        *buff_ext;     // larger buffer for sequential reads, used instead of buff when set
+	fs_offset_t buff_ext_size;
+	fs_offset_t buff_fill;     // how much to read at once, 0 means sizeof( buff )
+	int         access;        // FS_ACCESS_*
+	int         seq_fills;     // buffer refills since the last seek
 
 #ifdef XASH_REDUCE_FD
 	const char *backup_path;
@@ -86,6 +108,7 @@ typedef struct searchpath_s
 	string           filename;
 	searchpathtype_t type;
 	int              flags;
+	double           loadtime; // seconds spent in pfnAddArchive_Fullpath
 
 	union
 	{
@@ -105,6 +128,9 @@ typedef struct searchpath_s
 	int     (*pfnFindFile)( struct searchpath_s *search, const char *path, char *fixedname, size_t len );
 	void    (*pfnSearch)( struct searchpath_s *search, stringlist_t *list, const char *pattern, int caseinsensitive );
 	byte   *(*pfnLoadFile)( struct searchpath_s *search, const char *path, int pack_ind, fs_offset_t *filesize, void *( *pfnAlloc )( size_t ), void ( *pfnFree )( void * ));
+
+	// optional, archives with fixed contents list their files here to be put in the global file index
+	const char *(*pfnGetFileName)( struct searchpath_s *search, int pack_ind );
 } searchpath_t;
 
 typedef searchpath_t *(*FS_ADDARCHIVE_FULLPATH)( const char *path, int flags );
@@ -194,12 +220,11 @@ byte *FS_LoadFileMalloc( const char *path, fs_offset_t *filesizeptr, qboolean ga
 	MALLOC_LIKE( free, 1 ) WARN_UNUSED_RESULT;
 byte *FS_LoadDirectFile( const char *path, fs_offset_t *filesizeptr )
 	MALLOC_LIKE( _Mem_Free, 1 ) WARN_UNUSED_RESULT;
+void FS_UnmapFile( byte *data );
+byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
+	MALLOC_LIKE( FS_UnmapFile, 1 ) WARN_UNUSED_RESULT;
 qboolean FS_WriteFile( const char *filename, const void *data, fs_offset_t len );
 
-// file hashing
-qboolean CRC32_File( dword *crcvalue, const char *filename );
-qboolean MD5_HashFile( byte digest[16], const char *pszFileName, uint seed[4] );
-
 // stringlist ops
 void stringlistinit( stringlist_t *list );
 void stringlistfreecontents( stringlist_t *list );
@@ -225,6 +250,9 @@ int           FS_SysFileTime( const char *filename );
 file_t       *FS_OpenHandle( searchpath_t *search, int handle, fs_offset_t offset, fs_offset_t len );
 file_t       *FS_SysOpen( const char *filepath, const char *mode );
 searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t len, qboolean gamedironly );
+searchpath_t *FS_FindFileToLoad( const char *path, int *pack_ind, char *netpath, size_t len, qboolean gamedironly );
+byte         *FS_LoadFileFromArchive( searchpath_t *sp, const char *path, int pack_ind, fs_offset_t *filesizeptr, const qboolean sys_malloc );
+qboolean      FS_SysReadAt( file_t *file, void *buffer, fs_offset_t offset, fs_offset_t length );
 qboolean FS_FullPathToRelativePath( char *dst, const char *src, size_t size );
 
 //
@@ -241,6 +269,9 @@ searchpath_t *FS_AddWad_Fullpath( const char *wadfile, int flags );
 // zip.c
 //
 searchpath_t *FS_AddZip_Fullpath( const char *zipfile, int flags );
+fs_offset_t FS_ReadDeflated_ZIP( file_t *file, void *buffer, fs_offset_t count );
+qboolean FS_InflateAt_ZIP( file_t *file, byte *buffer );
+void FS_CloseDeflated_ZIP( file_t *file );
 
 //
 // dir.c
@@ -249,6 +280,43 @@ searchpath_t *FS_AddDir_Fullpath( const char *path, int flags );
 qboolean FS_FixFileCase( dir_t *dir, const char *path, char *dst, const size_t len, qboolean createpath );
 void FS_InitDirectorySearchpath( searchpath_t *search, const char *path, int flags );
 
+//
+// cache.c
+//
+void FS_InitIndexCache( void );
+void FS_OpenIndexCache( const char *dir );
+void FS_CloseIndexCaches( void );
+qboolean FS_IndexCacheFile( const char *name, char *dst, size_t size );
+const byte *FS_FindIndexCache( const char *path, int type, fs_offset_t size, int mtime, int *numentries, size_t *datasize );
+void FS_StoreIndexCache( const char *path, int type, fs_offset_t size, int mtime, int numentries, const void *data, size_t datasize );
+
+//
+// async.c
+//
+typedef struct fs_filehashes_s
+{
+	uint32_t crc; // not finalized, like CRC32_File
+	byte     md5[16];
+} fs_filehashes_t;
+
+void FS_AsyncFlush( void );
+void FS_AsyncShutdown( void );
+fs_async_t *FS_LoadFileAsync( const char *path, int priority, qboolean gamedironly, pfnFileLoaded_t callback, void *userdata );
+fs_async_t *FS_LoadFileAsyncHashed( const char *path, int priority, qboolean gamedironly, pfnFileLoaded_t callback, void *userdata, fs_filehashes_t *hashes );
+qboolean FS_AsyncIsDone( fs_async_t *request );
+byte *FS_AsyncFinish( fs_async_t *request, fs_offset_t *filesizeptr );
+void FS_AsyncUpdate( void );
+
+//
+// hashcache.c
+//
+void FS_InitHashCache( void );
+void FS_ShutdownHashCache( void );
+void FS_HashCacheInfo( void );
+qboolean CRC32_File( dword *crcvalue, const char *filename );
+qboolean MD5_HashFile( byte digest[16], const char *pszFileName, uint seed[4] );
+void FS_PrecacheFileHash( const char *path, qboolean gamedironly );
+
 //
 // android.c
 //
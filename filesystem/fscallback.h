@@ -69,12 +69,21 @@ extern fs_globals_t *FI;
 #ifndef FSCALLBACK_OVERRIDE_MALLOC_LIKE
 #define FS_LoadFile (*g_fsapi.LoadFile)
 #define FS_LoadDirectFile (*g_fsapi.LoadDirectFile)
+#define FS_MapFile (*g_fsapi.MapFile)
+#define FS_UnmapFile (*g_fsapi.UnmapFile)
 #endif
 #define FS_WriteFile (*g_fsapi.WriteFile)
 
+// asynchronous loading
+#define FS_LoadFileAsync (*g_fsapi.LoadFileAsync)
+#define FS_AsyncIsDone (*g_fsapi.AsyncIsDone)
+#define FS_AsyncFinish (*g_fsapi.AsyncFinish)
+#define FS_AsyncUpdate (*g_fsapi.AsyncUpdate)
+
 // file hashing
 #define CRC32_File (*g_fsapi.CRC32_File)
 #define MD5_HashFile (*g_fsapi.MD5_HashFile)
+#define FS_PrecacheFileHash (*g_fsapi.PrecacheFileHash)
 
 // filesystem ops
 #define FS_FileExists (*g_fsapi.FileExists)
@@ -0,0 +1,535 @@
+/*
+hashcache.c - file checksum cache
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "build.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include "port.h"
+#include "filesystem_internal.h"
+#include "crtlib.h"
+#include "crclib.h"
+#include "common/com_strings.h"
+
+/*
+========================================================================
+FILE HASH CACHE
+
+CRC32_File and MD5_HashFile remember their results, keyed by the
+searchpath and the name of the file and checked against its size and
+modification time, so files that didn't change are never read again.
+Files inside archives use the time of the archive.
+
+PrecacheFileHash computes both sums in background through the
+asynchronous loader, when the file isn't known or has changed.
+
+The cache is kept in <rootdir>/.fscache/hashes.dat between runs,
+when the index cache is enabled.
+========================================================================
+*/
+#define IDHASHCACHEHEADER	(('H'<<24)+('F'<<16)+('X'<<8)+'X')	// little-endian "XXFH"
+#define HASHCACHE_VERSION	1
+#define HASHCACHE_FILE	"hashes.dat"
+#define HASHCACHE_BUCKETS	1024
+
+#define FILEHASH_CRC32	BIT( 0 )
+#define FILEHASH_MD5	BIT( 1 )
+
+typedef struct
+{
+	int		ident;
+	int		version;
+	int		numrecords;
+	uint32_t		crc;		// of everything after the header
+} dhashcacheheader_t;
+
+typedef struct
+{
+	int64_t		size;
+	int64_t		mtime;
+	uint32_t		crc;
+	byte		md5[16];
+	int		flags;
+	int		namelen;		// including terminator
+} dfilehash_t;
+
+typedef struct filehash_s
+{
+	dfilehash_t	info;
+	fs_async_t	*pending;		// background hashing
+	int		pending_mtime;
+	fs_filehashes_t	pending_hashes;	// filled by the worker
+	struct filehash_s	*next;
+	char		*name;		// searchpath and file name, follows the record
+} filehash_t;
+
+static struct
+{
+	filehash_t	**buckets;
+	int		numrecords;
+	qboolean		dirty;
+	uint		hits;
+	uint		misses;
+	uint		background;
+} fs_hashcache;
+
+/*
+====================
+FS_FileHashKey
+====================
+*/
+static void FS_FileHashKey( const searchpath_t *search, const char *name, char *dst, size_t size )
+{
+	Q_snprintf( dst, size, "%s|%s", search->filename, name );
+}
+
+/*
+====================
+FS_FindFileHash
+
+finds or creates the record
+====================
+*/
+static filehash_t *FS_FindFileHash( const char *key, qboolean create )
+{
+	filehash_t *rec;
+	size_t namelen;
+	uint hash;
+
+	if( !fs_hashcache.buckets )
+	{
+		if( !create )
+			return NULL;
+
+		fs_hashcache.buckets = (filehash_t **)Mem_Calloc( fs_mempool, sizeof( *fs_hashcache.buckets ) * HASHCACHE_BUCKETS );
+	}
+
+	hash = COM_HashKey( key, HASHCACHE_BUCKETS );
+
+	for( rec = fs_hashcache.buckets[hash]; rec; rec = rec->next )
+	{
+		if( !Q_strcmp( rec->name, key ))
+			return rec;
+	}
+
+	if( !create )
+		return NULL;
+
+	namelen = Q_strlen( key ) + 1;
+	rec = (filehash_t *)Mem_Calloc( fs_mempool, sizeof( *rec ) + namelen );
+	rec->info.namelen = namelen;
+	rec->name = (char *)( rec + 1 );
+	memcpy( rec->name, key, namelen );
+
+	rec->next = fs_hashcache.buckets[hash];
+	fs_hashcache.buckets[hash] = rec;
+	fs_hashcache.numrecords++;
+
+	return rec;
+}
+
+/*
+====================
+FS_UpdateFileHash
+
+remembers the sums, unless the file was changed too recently
+to be sure it won't change again within the same second
+====================
+*/
+static void FS_UpdateFileHash( filehash_t *rec, fs_offset_t size, int mtime, int flags, uint32_t crc, const byte *md5 )
+{
+	if( mtime <= 0 || time( NULL ) - mtime < 2 )
+		return;
+
+	// keep the other sum if the file is the same
+	if( rec->info.size != size || rec->info.mtime != mtime )
+		rec->info.flags = 0;
+
+	rec->info.size = size;
+	rec->info.mtime = mtime;
+	rec->info.flags |= flags;
+
+	if( FBitSet( flags, FILEHASH_CRC32 ))
+		rec->info.crc = crc;
+
+	if( FBitSet( flags, FILEHASH_MD5 ))
+		memcpy( rec->info.md5, md5, sizeof( rec->info.md5 ));
+
+	fs_hashcache.dirty = true;
+}
+
+/*
+====================
+FS_FileHashed
+
+background hashing is finished
+====================
+*/
+static void FS_FileHashed( const char *path, byte *data, fs_offset_t size, void *userdata )
+{
+	filehash_t *rec = (filehash_t *)userdata;
+
+	rec->pending = NULL;
+
+	if( !data )
+		return;
+
+	FS_UpdateFileHash( rec, size, rec->pending_mtime, FILEHASH_CRC32|FILEHASH_MD5, rec->pending_hashes.crc, rec->pending_hashes.md5 );
+	Mem_Free( data );
+}
+
+/*
+====================
+FS_FileHash
+
+returns the sums from the cache or reads the file
+====================
+*/
+static qboolean FS_FileHash( const char *path, int flags, uint32_t *crcvalue, byte *digest )
+{
+	char netpath[MAX_SYSPATH], key[MAX_SYSPATH * 2];
+	searchpath_t *search;
+	filehash_t *rec;
+	MD5Context_t md5;
+	byte buffer[4096];
+	uint32_t crc;
+	file_t *f;
+	int pack_ind, mtime;
+
+	search = FS_FindFileToLoad( path, &pack_ind, netpath, sizeof( netpath ), false );
+	if( !search )
+		return false;
+
+	f = search->pfnOpenFile( search, netpath, "rb", pack_ind );
+	if( !f )
+		return false;
+
+	mtime = search->pfnFileTime( search, netpath );
+	FS_FileHashKey( search, netpath, key, sizeof( key ));
+	rec = FS_FindFileHash( key, true );
+
+	// it's being hashed already, wait for it
+	if( rec->pending )
+		FS_AsyncFinish( rec->pending, NULL );
+
+	if( rec->info.size == f->real_length && rec->info.mtime == mtime && FBitSet( rec->info.flags, flags ) == flags )
+	{
+		if( crcvalue ) *crcvalue = rec->info.crc;
+		if( digest ) memcpy( digest, rec->info.md5, sizeof( rec->info.md5 ));
+
+		fs_hashcache.hits++;
+		FS_Close( f );
+		return true;
+	}
+
+	fs_hashcache.misses++;
+
+	CRC32_Init( &crc );
+	memset( &md5, 0, sizeof( md5 ));
+	MD5Init( &md5 );
+
+	while( 1 )
+	{
+		fs_offset_t bytes = FS_Read( f, buffer, sizeof( buffer ));
+
+		if( bytes > 0 )
+		{
+			if( FBitSet( flags, FILEHASH_CRC32 ))
+				CRC32_ProcessBuffer( &crc, buffer, bytes );
+
+			if( FBitSet( flags, FILEHASH_MD5 ))
+				MD5Update( &md5, buffer, bytes );
+		}
+
+		if( FS_Eof( f ) || bytes <= 0 )
+			break;
+	}
+
+	if( FBitSet( flags, FILEHASH_MD5 ))
+		MD5Final( digest, &md5 );
+
+	if( crcvalue ) *crcvalue = crc;
+
+	FS_UpdateFileHash( rec, f->real_length, mtime, flags, crc, digest );
+	FS_Close( f );
+
+	return true;
+}
+
+/*
+====================
+CRC32_File
+
+the sum isn't finalized
+====================
+*/
+qboolean CRC32_File( dword *crcvalue, const char *filename )
+{
+	return FS_FileHash( filename, FILEHASH_CRC32, crcvalue, NULL );
+}
+
+/*
+====================
+MD5_HashFile
+
+====================
+*/
+qboolean MD5_HashFile( byte digest[16], const char *pszFileName, uint seed[4] )
+{
+	file_t		*file;
+	byte		buffer[1024];
+	MD5Context_t	MD5_Hash;
+	int		bytes;
+
+	// only the plain sums are cached
+	if( !seed )
+		return FS_FileHash( pszFileName, FILEHASH_MD5, NULL, digest );
+
+	if(( file = FS_Open( pszFileName, "rb", false )) == NULL )
+		return false;
+
+	memset( &MD5_Hash, 0, sizeof( MD5Context_t ));
+
+	MD5Init( &MD5_Hash );
+	MD5Update( &MD5_Hash, (const byte *)seed, 16 );
+
+	while( 1 )
+	{
+		bytes = FS_Read( file, buffer, sizeof( buffer ));
+
+		if( bytes > 0 )
+			MD5Update( &MD5_Hash, buffer, bytes );
+
+		if( FS_Eof( file ))
+			break;
+	}
+
+	FS_Close( file );
+	MD5Final( digest, &MD5_Hash );
+
+	return true;
+}
+
+/*
+====================
+FS_PrecacheFileHash
+
+starts hashing the file in background, unless
+the cache already has up to date sums for it
+====================
+*/
+void FS_PrecacheFileHash( const char *path, qboolean gamedironly )
+{
+	char netpath[MAX_SYSPATH], key[MAX_SYSPATH * 2];
+	searchpath_t *search;
+	filehash_t *rec;
+	int pack_ind, mtime;
+
+	search = FS_FindFileToLoad( path, &pack_ind, netpath, sizeof( netpath ), gamedironly );
+	if( !search )
+		return;
+
+	mtime = search->pfnFileTime( search, netpath );
+	FS_FileHashKey( search, netpath, key, sizeof( key ));
+	rec = FS_FindFileHash( key, true );
+
+	if( rec->pending )
+		return;
+
+	if( rec->info.mtime == mtime && FBitSet( rec->info.flags, FILEHASH_CRC32|FILEHASH_MD5 ) == ( FILEHASH_CRC32|FILEHASH_MD5 ))
+		return;
+
+	// below anything that is actually needed
+	rec->pending_mtime = mtime;
+	rec->pending = FS_LoadFileAsyncHashed( path, INT_MIN, gamedironly, FS_FileHashed, rec, &rec->pending_hashes );
+
+	if( rec->pending )
+		fs_hashcache.background++;
+}
+
+/*
+====================
+FS_LoadHashCache
+
+====================
+*/
+static void FS_LoadHashCache( void )
+{
+	const dhashcacheheader_t *header;
+	char path[MAX_SYSPATH];
+	fs_offset_t ofs, length;
+	byte *buffer;
+	uint32_t crc;
+	file_t *f;
+	int i;
+
+	if( !FS_IndexCacheFile( HASHCACHE_FILE, path, sizeof( path )) || !FS_SysFileExists( path ))
+		return;
+
+	if( !( f = FS_SysOpen( path, "rb" )))
+		return;
+
+	length = f->real_length;
+	buffer = (byte *)Mem_Malloc( fs_mempool, length + 1 );
+	header = (const dhashcacheheader_t *)buffer;
+	ofs = sizeof( *header );
+
+	if( FS_Read( f, buffer, length ) != length || length < ofs || header->ident != IDHASHCACHEHEADER || header->version != HASHCACHE_VERSION )
+		goto damaged;
+
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, buffer + ofs, length - ofs );
+
+	if( CRC32_Final( crc ) != header->crc )
+		goto damaged;
+
+	for( i = 0; i < header->numrecords; i++ )
+	{
+		dfilehash_t info;
+		filehash_t *rec;
+
+		if( length - ofs < sizeof( info ))
+			goto damaged;
+
+		memcpy( &info, buffer + ofs, sizeof( info ));
+		ofs += sizeof( info );
+
+		if( info.namelen <= 0 || length - ofs < info.namelen || buffer[ofs + info.namelen - 1] != '\0' )
+			goto damaged;
+
+		rec = FS_FindFileHash( (const char *)buffer + ofs, true );
+		rec->info = info;
+		ofs += info.namelen;
+	}
+
+	Mem_Free( buffer );
+	FS_Close( f );
+	return;
+
+damaged:
+	Con_Reportf( S_WARN "%s: %s is outdated or damaged, rebuilding\n", __func__, path );
+	fs_hashcache.dirty = true;
+	Mem_Free( buffer );
+	FS_Close( f );
+}
+
+/*
+====================
+FS_SaveHashCache
+
+====================
+*/
+static void FS_SaveHashCache( void )
+{
+	dhashcacheheader_t header;
+	char path[MAX_SYSPATH];
+	file_t *f;
+	int i;
+
+	if( !fs_hashcache.dirty || !fs_hashcache.buckets || !FS_IndexCacheFile( HASHCACHE_FILE, path, sizeof( path )))
+		return;
+
+	FS_CreatePath( path );
+
+	if( !( f = FS_SysOpen( path, "wb" )))
+		return; // read-only storage, never mind
+
+	header.ident = IDHASHCACHEHEADER;
+	header.version = HASHCACHE_VERSION;
+	header.numrecords = 0;
+	CRC32_Init( &header.crc );
+	FS_Write( f, &header, sizeof( header ));
+
+	for( i = 0; i < HASHCACHE_BUCKETS; i++ )
+	{
+		const filehash_t *rec;
+
+		for( rec = fs_hashcache.buckets[i]; rec; rec = rec->next )
+		{
+			if( !rec->info.flags )
+				continue;
+
+			FS_Write( f, &rec->info, sizeof( rec->info ));
+			FS_Write( f, rec->name, rec->info.namelen );
+			CRC32_ProcessBuffer( &header.crc, &rec->info, sizeof( rec->info ));
+			CRC32_ProcessBuffer( &header.crc, rec->name, rec->info.namelen );
+			header.numrecords++;
+		}
+	}
+
+	header.crc = CRC32_Final( header.crc );
+	FS_Seek( f, 0, SEEK_SET );
+	FS_Write( f, &header, sizeof( header ));
+	FS_Close( f );
+
+	fs_hashcache.dirty = false;
+	Con_Reportf( "%s: %s, %i records\n", __func__, path, header.numrecords );
+}
+
+/*
+====================
+FS_InitHashCache
+
+====================
+*/
+void FS_InitHashCache( void )
+{
+	FS_LoadHashCache();
+}
+
+/*
+====================
+FS_ShutdownHashCache
+
+pending requests must be finished before
+====================
+*/
+void FS_ShutdownHashCache( void )
+{
+	int i;
+
+	FS_SaveHashCache();
+
+	if( fs_hashcache.buckets )
+	{
+		for( i = 0; i < HASHCACHE_BUCKETS; i++ )
+		{
+			while( fs_hashcache.buckets[i] )
+			{
+				filehash_t *rec = fs_hashcache.buckets[i];
+
+				fs_hashcache.buckets[i] = rec->next;
+				Mem_Free( rec );
+			}
+		}
+
+		Mem_Free( fs_hashcache.buckets );
+	}
+
+	memset( &fs_hashcache, 0, sizeof( fs_hashcache ));
+}
+
+/*
+====================
+FS_HashCacheInfo
+
+====================
+*/
+void FS_HashCacheInfo( void )
+{
+	Con_Printf( "Hash cache: %i files, %u hits, %u misses, %u hashed in background\n",
+		fs_hashcache.numrecords, fs_hashcache.hits, fs_hashcache.misses, fs_hashcache.background );
+}
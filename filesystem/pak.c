@@ -87,40 +87,24 @@ static int FS_SortPak( const void *_a, const void *_b )
 
 /*
 =================
-FS_LoadPackPAK
-
-Takes an explicit (not game tree related) path to a pak file.
+FS_ReadPackDirectory
 
-Loads the header and directory, adding the files at the beginning
-of the list so they override previous pack files.
+Reads and sorts the directory of opened pak file
 =================
 */
-static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
+static pack_t *FS_ReadPackDirectory( const char *packfile, file_t *packhandle, int *error )
 {
 	dpackheader_t header;
-	file_t *packhandle;
 	int         numpackfiles;
 	pack_t      *pack;
 	fs_size_t     c;
 
-	// TODO: use FS_Open to allow PK3 to be included into other archives
-	// Currently, it doesn't work with rodir due to FS_FindFile logic
-	packhandle = FS_SysOpen( packfile, "rb" );
-
-	if( packhandle == NULL )
-	{
-		Con_Reportf( "%s couldn't open: %s\n", packfile, strerror( errno ));
-		if( error ) *error = PAK_LOAD_COULDNT_OPEN;
-		return NULL;
-	}
-
 	c = FS_Read( packhandle, (void *)&header, sizeof( header ));
 
 	if( c != sizeof( header ) || header.ident != IDPACKV1HEADER )
 	{
 		Con_Reportf( "%s is not a packfile. Ignored.\n", packfile );
 		if( error ) *error = PAK_LOAD_BAD_HEADER;
-		FS_Close( packhandle );
 		return NULL;
 	}
 
@@ -128,7 +112,6 @@ static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
 	{
 		Con_Reportf( S_ERROR "%s has an invalid directory size. Ignored.\n", packfile );
 		if( error ) *error = PAK_LOAD_BAD_FOLDERS;
-		FS_Close( packhandle );
 		return NULL;
 	}
 
@@ -138,7 +121,6 @@ static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
 	{
 		Con_Reportf( S_ERROR "%s has too many files ( %i ). Ignored.\n", packfile, numpackfiles );
 		if( error ) *error = PAK_LOAD_TOO_MANY_FILES;
-		FS_Close( packhandle );
 		return NULL;
 	}
 
@@ -146,7 +128,6 @@ static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
 	{
 		Con_Reportf( "%s has no files. Ignored.\n", packfile );
 		if( error ) *error = PAK_LOAD_NO_FILES;
-		FS_Close( packhandle );
 		return NULL;
 	}
 
@@ -158,17 +139,67 @@ static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
 		Con_Reportf( "%s is an incomplete PAK, not loading\n", packfile );
 		if( error )
 			*error = PAK_LOAD_CORRUPTED;
-		FS_Close( packhandle );
 		Mem_Free( pack );
 		return NULL;
 	}
 
 	// TODO: validate directory?
 
-	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	qsort( pack->files, pack->numfiles, sizeof( pack->files[0] ), FS_SortPak );
 
+	FS_StoreIndexCache( packfile, SEARCHPATH_PAK, packhandle->real_length, packhandle->filetime,
+		pack->numfiles, pack->files, sizeof( pack->files[0] ) * pack->numfiles );
+
+	return pack;
+}
+
+/*
+=================
+FS_LoadPackPAK
+
+Takes an explicit (not game tree related) path to a pak file.
+
+Loads the header and directory, adding the files at the beginning
+of the list so they override previous pack files.
+=================
+*/
+static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
+{
+	file_t *packhandle;
+	const byte *cached;
+	int         numpackfiles;
+	size_t      cachedsize;
+	pack_t      *pack;
+
+	// TODO: use FS_Open to allow PK3 to be included into other archives
+	// Currently, it doesn't work with rodir due to FS_FindFile logic
+	packhandle = FS_SysOpen( packfile, "rb" );
+
+	if( packhandle == NULL )
+	{
+		Con_Reportf( "%s couldn't open: %s\n", packfile, strerror( errno ));
+		if( error ) *error = PAK_LOAD_COULDNT_OPEN;
+		return NULL;
+	}
+
+	cached = FS_FindIndexCache( packfile, SEARCHPATH_PAK, packhandle->real_length, packhandle->filetime, &numpackfiles, &cachedsize );
+
+	if( cached && numpackfiles > 0 && numpackfiles <= MAX_FILES_IN_PACK && cachedsize == sizeof( dpackfile_t ) * numpackfiles )
+	{
+		// already sorted
+		pack = (pack_t *)Mem_Malloc( fs_mempool, sizeof( pack_t ) + cachedsize );
+		memcpy( pack->files, cached, cachedsize );
+		pack->numfiles = numpackfiles;
+	}
+	else if( !( pack = FS_ReadPackDirectory( packfile, packhandle, error )))
+	{
+		FS_Close( packhandle );
+		return NULL;
+	}
+
+	pack->handle = packhandle;
+
 #ifdef XASH_REDUCE_FD
 	// will reopen when needed
 	close( pack->handle );
@@ -234,6 +265,20 @@ static int FS_FindFile_PAK( searchpath_t *search, const char *path, char *fixedn
 	return -1;
 }
 
+/*
+===========
+FS_GetFileName_PAK
+
+===========
+*/
+static const char *FS_GetFileName_PAK( searchpath_t *search, int pack_ind )
+{
+	if( pack_ind < 0 || pack_ind >= search->pack->numfiles )
+		return NULL;
+
+	return search->pack->files[pack_ind].name;
+}
+
 /*
 ===========
 FS_Search_PAK
@@ -359,6 +404,7 @@ searchpath_t *FS_AddPak_Fullpath( const char *pakfile, int flags )
 	search->pfnFileTime = FS_FileTime_PAK;
 	search->pfnFindFile = FS_FindFile_PAK;
 	search->pfnSearch = FS_Search_PAK;
+	search->pfnGetFileName = FS_GetFileName_PAK;
 
 	Con_Reportf( "Adding PAK: %s (%i files)\n", pakfile, pak->numfiles );
 
@@ -0,0 +1,275 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "filesystem.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#elif XASH_WIN32
+#include <windows.h>
+#endif
+
+#define NUM_FILES 8
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+// tasks are only run when the test says so, to see the order they're started in
+typedef struct
+{
+	void (*job)( void *data, int index );
+	void *data;
+	qboolean done;
+} task_t;
+
+static task_t g_tasks[64];
+static int g_numtasks;
+static int g_delivered[NUM_FILES];
+
+static void *PostTask( void (*job)( void *data, int index ), void *data )
+{
+	task_t *task = &g_tasks[g_numtasks++];
+
+	task->job = job;
+	task->data = data;
+	task->done = false;
+	return task;
+}
+
+static qboolean IsTaskDone( void *task )
+{
+	return ((task_t *)task)->done;
+}
+
+static void WaitTask( void *task )
+{
+	task_t *t = task;
+
+	if( !t->done )
+	{
+		t->job( t->data, 0 );
+		t->done = true;
+	}
+}
+
+static void RunTasks( void )
+{
+	int i;
+
+	for( i = 0; i < g_numtasks; i++ )
+		WaitTask( &g_tasks[i] );
+}
+
+static qboolean LoadFilesystem( void )
+{
+	fs_interface_t engfuncs = { 0 };
+
+	engfuncs._Jobs_PostTask = PostTask;
+	engfuncs._Jobs_IsTaskDone = IsTaskDone;
+	engfuncs._Jobs_WaitTask = WaitTask;
+
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, &engfuncs ))
+		return false;
+
+	return true;
+}
+
+static qboolean CheckData( int i, const byte *data, fs_offset_t size )
+{
+	char expected[32];
+
+	snprintf( expected, sizeof( expected ), "async file %i", i );
+
+	if( !data || size != (fs_offset_t)strlen( expected ) || memcmp( data, expected, size + 1 ))
+	{
+		printf( "file %i contents fail\n", i );
+		return false;
+	}
+
+	return true;
+}
+
+static void FileLoaded( const char *path, byte *data, fs_offset_t size, void *userdata )
+{
+	int i = (int)(size_t)userdata;
+
+	if( CheckData( i, data, size ))
+		g_delivered[i]++;
+
+	free( data );
+}
+
+static qboolean TestPriority( void )
+{
+	fs_async_t *requests[NUM_FILES];
+	int i;
+
+	g_numtasks = 0;
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		char path[32];
+
+		snprintf( path, sizeof( path ), "async/%i.txt", i );
+		requests[i] = g_fs.LoadFileAsync( path, i, true, NULL, NULL );
+		if( !requests[i] )
+		{
+			printf( "LoadFileAsync fail\n" );
+			return false;
+		}
+	}
+
+	// first requests are started right away, the others wait
+	if( g_numtasks != 4 || g_fs.AsyncIsDone( requests[0] ) || g_fs.AsyncIsDone( requests[7] ))
+	{
+		printf( "running requests fail\n" );
+		return false;
+	}
+
+	// once they're done, queued ones start from the highest priority
+	RunTasks();
+	g_fs.AsyncUpdate();
+
+	if( g_numtasks != 8 || !g_fs.AsyncIsDone( requests[0] ))
+	{
+		printf( "queued requests fail\n" );
+		return false;
+	}
+
+	for( i = 0; i < 4; i++ )
+	{
+		if( g_tasks[4 + i].data != requests[7 - i] )
+		{
+			printf( "priority order fail\n" );
+			return false;
+		}
+	}
+
+	// finish waits for the rest
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		fs_offset_t size;
+		byte *data = g_fs.AsyncFinish( requests[i], &size );
+		qboolean ok = CheckData( i, data, size );
+
+		free( data );
+		if( !ok )
+			return false;
+	}
+
+	return true;
+}
+
+static qboolean TestCallback( void )
+{
+	fs_async_t *request;
+	int i;
+
+	g_numtasks = 0;
+	memset( g_delivered, 0, sizeof( g_delivered ));
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		char path[32];
+
+		snprintf( path, sizeof( path ), "async/%i.txt", i );
+		request = g_fs.LoadFileAsync( path, 0, true, FileLoaded, (void *)(size_t)i );
+		if( !request )
+		{
+			printf( "LoadFileAsync fail\n" );
+			return false;
+		}
+	}
+
+	// the last one is still queued, it's loaded on finish and delivered to callback
+	if( g_fs.AsyncFinish( request, NULL ) != NULL || g_delivered[NUM_FILES - 1] != 1 )
+	{
+		printf( "AsyncFinish with callback fail\n" );
+		return false;
+	}
+
+	// two batches left
+	for( i = 0; i < 2; i++ )
+	{
+		RunTasks();
+		g_fs.AsyncUpdate();
+	}
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		if( g_delivered[i] != 1 )
+		{
+			printf( "callback %i fail\n", i );
+			return false;
+		}
+	}
+
+	if( g_fs.LoadFileAsync( "async/missing.txt", 0, true, NULL, NULL ))
+	{
+		printf( "missing file fail\n" );
+		return false;
+	}
+
+	return true;
+}
+
+static qboolean TestAsync( void )
+{
+	qboolean ok;
+	int i;
+
+	g_fs.AddGameDirectory( "./", FS_GAMEDIR_PATH );
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		char path[32], contents[32];
+		file_t *f;
+
+		snprintf( path, sizeof( path ), "async/%i.txt", i );
+		snprintf( contents, sizeof( contents ), "async file %i", i );
+
+		f = g_fs.Open( path, "wb", true );
+		g_fs.Write( f, contents, strlen( contents ));
+		g_fs.Close( f );
+	}
+
+	ok = TestPriority() && TestCallback();
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		char path[32];
+
+		snprintf( path, sizeof( path ), "async/%i.txt", i );
+		g_fs.Delete( path );
+	}
+	g_fs.Delete( "async" );
+
+	return ok;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	if( !TestAsync())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
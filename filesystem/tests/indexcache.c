@@ -0,0 +1,250 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "filesystem.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#include <unistd.h>
+#include <utime.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#elif XASH_WIN32
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#define mkdir( x, y ) _mkdir( x )
+#define chdir( x ) _chdir( x )
+#define rmdir( x ) _rmdir( x )
+#endif
+
+#define TEST_DIR   "indexcache"
+#define ZIP_NAME   "indexcache.pk3"
+#define CACHE_NAME ".fscache/._.idx" // cache of "./" game directory
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+static char g_env[] = "XASH3D_INDEX_CACHE=1";
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static byte *PutShort( byte *p, uint val )
+{
+	p[0] = val & 0xff;
+	p[1] = ( val >> 8 ) & 0xff;
+	return p + 2;
+}
+
+static byte *PutLong( byte *p, uint val )
+{
+	p = PutShort( p, val & 0xffff );
+	return PutShort( p, val >> 16 );
+}
+
+// stored zip with a single "cache/<name>.txt" file, name is always 3 letters,
+// so only the archive comment changes the size
+static qboolean WriteZip( const char *name, const char *comment, time_t mtime )
+{
+	const char data[] = "index cache test";
+	const uint datalen = sizeof( data ) - 1;
+	const uint commentlen = strlen( comment );
+	char filename[32];
+	byte buffer[256], *p = buffer;
+	struct utimbuf times;
+	uint namelen, cdfofs;
+	FILE *f;
+
+	snprintf( filename, sizeof( filename ), "cache/%s.txt", name );
+	namelen = strlen( filename );
+
+	// local file header
+	p = PutLong( p, 0x04034b50 );
+	p = PutShort( p, 10 ); // version
+	p = PutShort( p, 0 ); // flags
+	p = PutShort( p, 0 ); // stored
+	p = PutLong( p, 0 ); // dos date
+	p = PutLong( p, 0 ); // crc, not checked
+	p = PutLong( p, datalen );
+	p = PutLong( p, datalen );
+	p = PutShort( p, namelen );
+	p = PutShort( p, 0 ); // extra field
+	memcpy( p, filename, namelen );
+	p += namelen;
+	memcpy( p, data, datalen );
+	p += datalen;
+	cdfofs = p - buffer;
+
+	// central directory
+	p = PutLong( p, 0x02014b50 );
+	p = PutShort( p, 10 ); // version
+	p = PutShort( p, 10 ); // version needed
+	p = PutShort( p, 0 ); // flags
+	p = PutShort( p, 0 ); // stored
+	p = PutShort( p, 0 ); // time
+	p = PutShort( p, 0 ); // date
+	p = PutLong( p, 0 ); // crc
+	p = PutLong( p, datalen );
+	p = PutLong( p, datalen );
+	p = PutShort( p, namelen );
+	p = PutShort( p, 0 ); // extra field
+	p = PutShort( p, 0 ); // comment
+	p = PutShort( p, 0 ); // disk start
+	p = PutShort( p, 0 ); // internal attributes
+	p = PutLong( p, 0 ); // external attributes
+	p = PutLong( p, 0 ); // local header offset
+	memcpy( p, filename, namelen );
+	p += namelen;
+
+	// end of central directory
+	p = PutLong( p, 0x06054b50 );
+	p = PutShort( p, 0 ); // disk number
+	p = PutShort( p, 0 ); // central directory disk
+	p = PutShort( p, 1 ); // records on this disk
+	p = PutShort( p, 1 ); // total records
+	p = PutLong( p, 46 + namelen ); // central directory size
+	p = PutLong( p, cdfofs );
+	p = PutShort( p, commentlen );
+	memcpy( p, comment, commentlen );
+	p += commentlen;
+
+	f = fopen( ZIP_NAME, "wb" );
+	if( !f || fwrite( buffer, p - buffer, 1, f ) != 1 )
+	{
+		printf( "write fail\n" );
+		if( f ) fclose( f );
+		return false;
+	}
+	fclose( f );
+
+	// cache never trusts fresh timestamps
+	times.actime = times.modtime = mtime;
+	return utime( ZIP_NAME, &times ) == 0;
+}
+
+// flips the last byte, which is covered by the checksum
+static qboolean CorruptCache( void )
+{
+	FILE *f = fopen( CACHE_NAME, "r+b" );
+	int c;
+
+	if( !f )
+		return false;
+
+	fseek( f, -1, SEEK_END );
+	c = fgetc( f );
+	fseek( f, -1, SEEK_END );
+	fputc( c ^ 0xff, f );
+	fclose( f );
+
+	return true;
+}
+
+// mounts everything again and checks which of the names the archive has
+static qboolean Remount( const char *expected, const char *stale )
+{
+	char path[32];
+	qboolean ok;
+
+	if( !g_fs.InitStdio( true, ".", "valve", "valve", "" ))
+	{
+		printf( "init fail\n" );
+		return false;
+	}
+
+	snprintf( path, sizeof( path ), "cache/%s.txt", expected );
+	ok = g_fs.FileExists( path, false );
+
+	snprintf( path, sizeof( path ), "cache/%s.txt", stale );
+	ok = ok && !g_fs.FileExists( path, false );
+
+	g_fs.ShutdownStdio();
+
+	if( !ok )
+		printf( "expected %s, not %s\n", expected, stale );
+
+	return ok;
+}
+
+static qboolean TestIndexCache( void )
+{
+	time_t mtime = time( NULL ) - 100;
+	struct stat st;
+	qboolean ok = true;
+
+	// first mount parses the archive and writes the cache
+	ok = ok && WriteZip( "one", "", mtime ) && Remount( "one", "two" );
+
+	if( ok && stat( CACHE_NAME, &st ) != 0 )
+	{
+		printf( "cache not written\n" );
+		ok = false;
+	}
+
+	// same size and time, so the archive isn't parsed again and the old name is seen
+	ok = ok && WriteZip( "two", "", mtime ) && Remount( "one", "two" );
+
+	// changed time
+	ok = ok && WriteZip( "two", "", mtime + 1 ) && Remount( "two", "one" );
+
+	// changed size
+	ok = ok && WriteZip( "six", "size", mtime + 1 ) && Remount( "six", "two" );
+
+	// damaged cache is thrown away
+	ok = ok && WriteZip( "ten", "size", mtime + 1 ) && CorruptCache( ) && Remount( "ten", "six" );
+
+	// and was rebuilt
+	ok = ok && WriteZip( "one", "size", mtime + 1 ) && Remount( "ten", "one" );
+
+	return ok;
+}
+
+int main( void )
+{
+	qboolean ok;
+
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	// private directory, other tests may be mounting archives in parallel
+	mkdir( TEST_DIR, 0777 );
+	if( chdir( TEST_DIR ) != 0 )
+		return EXIT_FAILURE;
+
+	putenv( g_env );
+	remove( CACHE_NAME ); // left from an interrupted run
+
+	ok = TestIndexCache();
+
+	remove( ZIP_NAME );
+	remove( CACHE_NAME );
+	rmdir( ".fscache" );
+
+	if( !ok )
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
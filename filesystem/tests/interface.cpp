@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <time.h>
 #include "port.h"
 #include "build.h"
@@ -58,10 +59,38 @@ static bool LoadFilesystem()
 	return true;
 }
 
+// engines built against version 3 have fs_api_t that ends before MapFile
+static bool TestOlderVersion()
+{
+	const size_t oldsize = offsetof( fs_api_t, MapFile );
+	fs_globals_t *globals = NULL;
+	unsigned char api[sizeof( fs_api_t )];
+	size_t i;
+
+	memset( api, 0xcc, sizeof( api ));
+
+	if( g_pfnGetFSAPI( 3, reinterpret_cast<fs_api_t *>( api ), &globals, NULL ) != 3 || !globals )
+		return false;
+
+	if( memcmp( api, &g_fs, oldsize ))
+		return false;
+
+	for( i = oldsize; i < sizeof( api ); i++ )
+	{
+		if( api[i] != 0xcc )
+			return false;
+	}
+
+	return true;
+}
+
 int main()
 {
 	if( !LoadFilesystem() )
 		return EXIT_FAILURE;
 
+	if( !TestOlderVersion() )
+		return EXIT_FAILURE;
+
 	return EXIT_SUCCESS;
 }
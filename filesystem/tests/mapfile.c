@@ -0,0 +1,331 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "filesystem.h"
+#include "wadfile.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#include <unistd.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#elif XASH_WIN32
+#include <windows.h>
+#endif
+
+// filesystem_stdio maps files only where it has mmap
+#if XASH_POSIX && !defined( XASH_REDUCE_FD )
+#define HAVE_MMAP 1
+#define CAN_MAP true
+#else
+#define CAN_MAP false
+#endif
+
+#define BIG_SIZE   ( 256 * 1024 )
+#define LUMP_SIZE  ( 128 * 1024 )
+#define SMALL_SIZE 100
+
+// lump offsets, chosen so a mapping can be told apart from a malloc'ed copy:
+// a mapping keeps the offset within the page, copies are at least 8 byte aligned
+#define SMALL_POS  12 // right after the header, too small to be mapped
+#define BIG_POS    0x1100 // aligned, mapped
+#define ODD_POS    ( BIG_POS + LUMP_SIZE + 1 ) // unaligned, copied
+#define INFO_POS   ( ODD_POS + LUMP_SIZE )
+
+#define WAD_NAME   "mapfile.wad"
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+// on-disk wad layout
+typedef struct
+{
+	int		ident;
+	int		numlumps;
+	int		infotableofs;
+} wadheader_t;
+
+typedef struct
+{
+	int		filepos;
+	int		disksize;
+	int		size;
+	signed char	type;
+	signed char	attribs;
+	signed char	pad0;
+	signed char	pad1;
+	char		name[16];
+} wadlump_t;
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static byte Pattern( int seed, fs_offset_t offset )
+{
+	return (byte)( offset * 7 + ( offset >> 12 ) + seed );
+}
+
+static qboolean CheckData( const byte *data, int seed, fs_offset_t offset, fs_offset_t size )
+{
+	fs_offset_t i;
+
+	for( i = 0; i < size; i++ )
+	{
+		if( data[i] != Pattern( seed, offset + i ))
+			return false;
+	}
+
+	return true;
+}
+
+static void FillData( byte *data, int seed, fs_offset_t size )
+{
+	fs_offset_t i;
+
+	for( i = 0; i < size; i++ )
+		data[i] = Pattern( seed, i );
+}
+
+static qboolean IsMapped( const byte *data, fs_offset_t fileofs )
+{
+#if HAVE_MMAP
+	size_t mask = sysconf( _SC_PAGESIZE ) - 1;
+
+	return ((size_t)data & mask ) == ((size_t)fileofs & mask );
+#else
+	return false;
+#endif
+}
+
+static qboolean WriteTestFile( const char *name, int seed, fs_offset_t size )
+{
+	byte *data = malloc( size );
+	qboolean ok;
+
+	FillData( data, seed, size );
+	ok = g_fs.WriteFile( name, data, size );
+	free( data );
+
+	return ok;
+}
+
+static void SetLump( wadlump_t *lump, const char *name, signed char type, int filepos, int size )
+{
+	memset( lump, 0, sizeof( *lump ));
+	strncpy( lump->name, name, sizeof( lump->name ) - 1 );
+	lump->type = type;
+	lump->filepos = filepos;
+	lump->disksize = lump->size = size;
+}
+
+static qboolean CreateTestWad( void )
+{
+	const size_t size = INFO_POS + 3 * sizeof( wadlump_t );
+	byte *data = calloc( 1, size );
+	wadheader_t *header = (wadheader_t *)data;
+	wadlump_t lumps[3];
+	qboolean ok;
+
+	header->ident = IDWAD3HEADER;
+	header->numlumps = 3;
+	header->infotableofs = INFO_POS;
+
+	SetLump( &lumps[0], "SMALL", TYP_GFXPIC, SMALL_POS, SMALL_SIZE );
+	SetLump( &lumps[1], "BIG", TYP_MIPTEX, BIG_POS, LUMP_SIZE );
+	SetLump( &lumps[2], "ODD", TYP_MIPTEX, ODD_POS, LUMP_SIZE );
+	memcpy( data + INFO_POS, lumps, sizeof( lumps ));
+
+	FillData( data + SMALL_POS, 1, SMALL_SIZE );
+	FillData( data + BIG_POS, 2, LUMP_SIZE );
+	FillData( data + ODD_POS, 3, LUMP_SIZE );
+
+	ok = g_fs.WriteFile( WAD_NAME, data, size );
+	free( data );
+
+	return ok;
+}
+
+// maps the file, checks it and whether it was mapped or copied
+static qboolean TestMap( const char *name, int seed, fs_offset_t size, fs_offset_t fileofs, qboolean mapped )
+{
+	fs_offset_t len = 0;
+	byte *data = g_fs.MapFile( name, &len, false );
+
+	if( !data || len != size || !CheckData( data, seed, 0, size ))
+	{
+		printf( "map %s fail\n", name );
+		g_fs.UnmapFile( data );
+		return false;
+	}
+
+	if( IsMapped( data, fileofs ) != mapped )
+	{
+		printf( "%s is %s\n", name, mapped ? "copied" : "mapped" );
+		g_fs.UnmapFile( data );
+		return false;
+	}
+
+	// must be writable, even when mapped
+	data[0] ^= 0xff;
+	g_fs.UnmapFile( data );
+
+	return true;
+}
+
+static qboolean TestPlainFiles( void )
+{
+	fs_offset_t len = 0;
+	qboolean ok;
+	byte *data;
+
+	if( !WriteTestFile( "mapfile/big.bin", 4, BIG_SIZE ) || !WriteTestFile( "mapfile/small.bin", 5, SMALL_SIZE ))
+	{
+		printf( "write fail\n" );
+		return false;
+	}
+
+	ok = TestMap( "mapfile/big.bin", 4, BIG_SIZE, 0, CAN_MAP );
+
+	if( ok )
+	{
+		// small file is copied, doesn't matter where it is
+		data = g_fs.MapFile( "mapfile/small.bin", &len, false );
+		ok = data && len == SMALL_SIZE && CheckData( data, 5, 0, SMALL_SIZE );
+		g_fs.UnmapFile( data );
+
+		if( !ok )
+			printf( "map small fail\n" );
+	}
+
+	// changes to the private mapping never reach the disk
+	if( ok )
+	{
+		data = g_fs.LoadFileMalloc( "mapfile/big.bin", &len, false );
+		ok = data && len == BIG_SIZE && CheckData( data, 4, 0, BIG_SIZE );
+		free( data );
+
+		if( !ok )
+			printf( "mapping was written back\n" );
+	}
+
+	if( g_fs.MapFile( "mapfile/missing.bin", &len, false ))
+	{
+		printf( "mapped missing file\n" );
+		ok = false;
+	}
+
+	g_fs.Delete( "mapfile/big.bin" );
+	g_fs.Delete( "mapfile/small.bin" );
+	g_fs.Delete( "mapfile" );
+
+	return ok;
+}
+
+static qboolean TestWadLumps( void )
+{
+	qboolean ok;
+
+	if( !CreateTestWad( ) || !g_fs.MountArchive_Fullpath( WAD_NAME, 0 ))
+	{
+		printf( "mount fail\n" );
+		return false;
+	}
+
+	ok = TestMap( "big.mip", 2, LUMP_SIZE, BIG_POS, CAN_MAP );
+	ok = ok && TestMap( "odd.mip", 3, LUMP_SIZE, ODD_POS, false );
+	ok = ok && TestMap( "small.lmp", 1, SMALL_SIZE, SMALL_POS, false );
+
+	// previous view was changed and dropped, new one sees the disk data again
+	ok = ok && TestMap( "big.mip", 2, LUMP_SIZE, BIG_POS, CAN_MAP );
+
+	return ok;
+}
+
+// lumps used to fail to open, now they read as their raw disk data
+static qboolean TestWadOpen( void )
+{
+	byte *buffer = malloc( LUMP_SIZE );
+	fs_offset_t len = 0;
+	qboolean ok = true;
+	byte *data;
+	file_t *f;
+
+	f = g_fs.Open( "odd.mip", "rb", false );
+	if( !f || g_fs.FileLength( f ) != LUMP_SIZE )
+	{
+		printf( "open lump fail\n" );
+		if( f ) g_fs.Close( f );
+		free( buffer );
+		return false;
+	}
+
+	ok = ok && g_fs.Read( f, buffer, LUMP_SIZE ) == LUMP_SIZE && CheckData( buffer, 3, 0, LUMP_SIZE );
+	ok = ok && g_fs.Read( f, buffer, 1 ) == 0 && g_fs.Eof( f );
+	ok = ok && g_fs.Seek( f, 1000, SEEK_SET ) == 0 && g_fs.Read( f, buffer, 10 ) == 10 && CheckData( buffer, 3, 1000, 10 );
+	g_fs.Close( f );
+
+	if( !ok )
+		printf( "read lump fail\n" );
+
+	// same bytes as the lump loader gives
+	f = g_fs.Open( "small.lmp", "rb", false );
+	data = g_fs.LoadFileMalloc( "small.lmp", &len, false );
+
+	if( !f || !data || len != SMALL_SIZE || g_fs.Read( f, buffer, LUMP_SIZE ) != SMALL_SIZE || memcmp( buffer, data, SMALL_SIZE ))
+	{
+		printf( "open small lump fail\n" );
+		ok = false;
+	}
+
+	if( f ) g_fs.Close( f );
+	free( data );
+	free( buffer );
+
+	if( g_fs.Open( "missing.mip", "rb", false ))
+	{
+		printf( "opened missing lump\n" );
+		ok = false;
+	}
+
+	return ok;
+}
+
+int main( void )
+{
+	qboolean ok;
+
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	remove( WAD_NAME ); // left from an interrupted run
+	g_fs.AddGameDirectory( "./", FS_GAMEDIR_PATH );
+
+	ok = TestPlainFiles() && TestWadLumps() && TestWadOpen();
+
+	g_fs.ClearSearchPath();
+	remove( WAD_NAME );
+
+	if( !ok )
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,270 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "filesystem.h"
+#include "xash3d_mathlib.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#elif XASH_WIN32
+#include <windows.h>
+#endif
+
+#define FILE_SIZE ( 16 * 1024 * 1024 )
+#define FILE_NAME "readahead.bin"
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static double Time( void )
+{
+#if XASH_WIN32
+	LARGE_INTEGER counter, frequency;
+
+	QueryPerformanceCounter( &counter );
+	QueryPerformanceFrequency( &frequency );
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+static byte Pattern( fs_offset_t offset )
+{
+	return (byte)( offset * 7 + ( offset >> 12 ));
+}
+
+static qboolean CheckChunk( const byte *data, fs_offset_t offset, fs_offset_t size )
+{
+	fs_offset_t i;
+
+	for( i = 0; i < size; i++ )
+	{
+		if( data[i] != Pattern( offset + i ))
+			return false;
+	}
+
+	return true;
+}
+
+static qboolean CreateTestFile( void )
+{
+	byte *data = malloc( FILE_SIZE );
+	fs_offset_t i;
+	file_t *f;
+
+	for( i = 0; i < FILE_SIZE; i++ )
+		data[i] = Pattern( i );
+
+	f = g_fs.Open( FILE_NAME, "wb", true );
+	if( !f || g_fs.Write( f, data, FILE_SIZE ) != FILE_SIZE )
+	{
+		printf( "write fail\n" );
+		free( data );
+		return false;
+	}
+
+	g_fs.Close( f );
+	free( data );
+	return true;
+}
+
+// reads the whole file with given chunk size, prints MB/s
+static qboolean BenchRead( const char *mode, fs_offset_t chunk, qboolean print )
+{
+	byte *data = malloc( chunk );
+	fs_offset_t offset = 0;
+	double start, elapsed;
+	file_t *f;
+
+	start = Time();
+
+	f = g_fs.Open( FILE_NAME, mode, true );
+	if( !f )
+	{
+		printf( "open fail\n" );
+		free( data );
+		return false;
+	}
+
+	while( offset < FILE_SIZE )
+	{
+		fs_offset_t size = g_fs.Read( f, data, chunk );
+
+		// only check the ends, to measure reading rather than checking
+		if( size <= 0 || !CheckChunk( data, offset, 1 ) || !CheckChunk( data + size - 1, offset + size - 1, 1 ))
+		{
+			printf( "read fail at %li\n", (long)offset );
+			g_fs.Close( f );
+			free( data );
+			return false;
+		}
+
+		offset += size;
+	}
+
+	g_fs.Close( f );
+	elapsed = Time() - start;
+
+	if( print )
+		printf( "%-4s %7li bytes: %8.1f MB/s\n", mode, (long)chunk, FILE_SIZE / ( 1024.0 * 1024.0 ) / elapsed );
+
+	free( data );
+	return true;
+}
+
+// small reads mixed with seeks, buffer must follow them
+static qboolean TestSeeks( void )
+{
+	byte data[256];
+	file_t *f;
+	int i;
+
+	f = g_fs.Open( FILE_NAME, "rb", true );
+
+	for( i = 0; i < 200000; i++ )
+	{
+		fs_offset_t offset = g_fs.Tell( f );
+		fs_offset_t size = 1 + rand() % sizeof( data );
+
+		if( offset + size > FILE_SIZE )
+		{
+			g_fs.Seek( f, 0, SEEK_SET );
+			offset = 0;
+		}
+
+		if( g_fs.Read( f, data, size ) != size || !CheckChunk( data, offset, size ))
+		{
+			printf( "seek read fail at %li\n", (long)offset );
+			g_fs.Close( f );
+			return false;
+		}
+
+		// mostly sequential, sometimes jump around
+		if( rand() % 64 == 0 )
+			g_fs.Seek( f, rand() % ( FILE_SIZE - sizeof( data )), SEEK_SET );
+		else if( rand() % 16 == 0 )
+			g_fs.Seek( f, -( rand() % ( size + 1 )), SEEK_CUR );
+	}
+
+	g_fs.Close( f );
+	return true;
+}
+
+// small file read once and then scanned backwards from the end,
+// like the zip loader looks for the central directory
+static qboolean TestBackwardScan( void )
+{
+	const fs_offset_t size = 1000;
+	fs_offset_t offset;
+	byte data[4];
+	file_t *f;
+
+	f = g_fs.Open( "readahead_small.bin", "wb", true );
+	if( !f )
+		return false;
+
+	for( offset = 0; offset < size; offset++ )
+	{
+		data[0] = Pattern( offset );
+		g_fs.Write( f, data, 1 );
+	}
+
+	g_fs.Close( f );
+
+	f = g_fs.Open( "readahead_small.bin", "rb", true );
+	g_fs.Read( f, data, sizeof( data ));
+
+	// starts past the end, reads at the end mustn't break the buffer
+	for( offset = size; offset >= 0; offset-- )
+	{
+		fs_offset_t expected = Q_min( size - offset, (fs_offset_t)sizeof( data ));
+
+		g_fs.Seek( f, offset, SEEK_SET );
+
+		if( g_fs.Read( f, data, sizeof( data )) != expected || !CheckChunk( data, offset, expected ))
+		{
+			printf( "backward read fail at %li\n", (long)offset );
+			g_fs.Close( f );
+			return false;
+		}
+	}
+
+	g_fs.Close( f );
+	g_fs.Delete( "readahead_small.bin" );
+
+	return true;
+}
+
+static qboolean TestReadahead( void )
+{
+	const char *modes[] = { "rb", "rbS", "rbR" };
+	fs_offset_t chunk;
+	qboolean ok;
+	size_t i;
+
+	g_fs.AddGameDirectory( "./", FS_GAMEDIR_PATH );
+
+	if( !CreateTestFile( ))
+		return false;
+
+	// warm up the page cache first
+	ok = BenchRead( "rb", 1024 * 1024, false );
+
+	for( i = 0; i < sizeof( modes ) / sizeof( modes[0] ) && ok; i++ )
+	{
+		for( chunk = 4 * 1024; chunk <= 1024 * 1024 && ok; chunk *= 4 )
+			ok = BenchRead( modes[i], chunk, true );
+	}
+
+	if( ok )
+		ok = TestSeeks();
+
+	if( ok )
+		ok = TestBackwardScan();
+
+	g_fs.Delete( FILE_NAME );
+
+	return ok;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	srand( time( NULL ));
+
+	if( !TestReadahead())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
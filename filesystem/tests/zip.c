@@ -0,0 +1,314 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "filesystem.h"
+#include "xash3d_mathlib.h"
+#include "miniz.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#elif XASH_WIN32
+#include <windows.h>
+#endif
+
+// big enough to need many refills of the compressed input buffer
+#define DATA_SIZE ( 1024 * 1024 + 123 )
+#define ZIP_NAME  "zipstream.pk3"
+#define DATA_NAME "zipstream/data.bin"
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+static byte *g_data;
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static byte *PutShort( byte *p, uint val )
+{
+	p[0] = val & 0xff;
+	p[1] = ( val >> 8 ) & 0xff;
+	return p + 2;
+}
+
+static byte *PutLong( byte *p, uint val )
+{
+	p = PutShort( p, val & 0xffff );
+	return PutShort( p, val >> 16 );
+}
+
+// stores a single deflated file, without any extra fields
+static qboolean CreateTestZip( void )
+{
+	const size_t namelen = strlen( DATA_NAME );
+	byte header[64], *p;
+	size_t complen = 0;
+	uint crc, cdfofs;
+	void *comp;
+	file_t *f;
+
+	// raw deflate stream, like the zip format wants
+	comp = tdefl_compress_mem_to_heap( g_data, DATA_SIZE, &complen, TDEFL_DEFAULT_MAX_PROBES );
+	if( !comp )
+	{
+		printf( "deflate fail\n" );
+		return false;
+	}
+
+	crc = (uint)mz_crc32( MZ_CRC32_INIT, g_data, DATA_SIZE );
+	f = g_fs.Open( ZIP_NAME, "wb", true );
+	if( !f )
+	{
+		printf( "write fail\n" );
+		free( comp );
+		return false;
+	}
+
+	// local file header
+	p = PutLong( header, 0x04034b50 );
+	p = PutShort( p, 20 ); // version
+	p = PutShort( p, 0 ); // flags
+	p = PutShort( p, 8 ); // deflated
+	p = PutLong( p, 0 ); // dos date
+	p = PutLong( p, crc );
+	p = PutLong( p, (uint)complen );
+	p = PutLong( p, DATA_SIZE );
+	p = PutShort( p, (uint)namelen );
+	p = PutShort( p, 0 ); // extra field
+	g_fs.Write( f, header, p - header );
+	g_fs.Write( f, DATA_NAME, namelen );
+	g_fs.Write( f, comp, complen );
+	cdfofs = (uint)g_fs.Tell( f );
+
+	// central directory
+	p = PutLong( header, 0x02014b50 );
+	p = PutShort( p, 20 ); // version
+	p = PutShort( p, 20 ); // version needed
+	p = PutShort( p, 0 ); // flags
+	p = PutShort( p, 8 ); // deflated
+	p = PutShort( p, 0 ); // time
+	p = PutShort( p, 0 ); // date
+	p = PutLong( p, crc );
+	p = PutLong( p, (uint)complen );
+	p = PutLong( p, DATA_SIZE );
+	p = PutShort( p, (uint)namelen );
+	p = PutShort( p, 0 ); // extra field
+	p = PutShort( p, 0 ); // comment
+	p = PutShort( p, 0 ); // disk start
+	p = PutShort( p, 0 ); // internal attributes
+	p = PutLong( p, 0 ); // external attributes
+	p = PutLong( p, 0 ); // local header offset
+	g_fs.Write( f, header, p - header );
+	g_fs.Write( f, DATA_NAME, namelen );
+
+	// end of central directory
+	p = PutLong( header, 0x06054b50 );
+	p = PutShort( p, 0 ); // disk number
+	p = PutShort( p, 0 ); // central directory disk
+	p = PutShort( p, 1 ); // records on this disk
+	p = PutShort( p, 1 ); // total records
+	p = PutLong( p, (uint)( 46 + namelen )); // central directory size
+	p = PutLong( p, cdfofs );
+	p = PutShort( p, 0 ); // comment
+	g_fs.Write( f, header, p - header );
+
+	g_fs.Close( f );
+	free( comp );
+
+	// make sure it really was compressed, otherwise nothing is tested
+	if( complen >= DATA_SIZE / 2 || complen < 64 * 1024 )
+	{
+		printf( "unexpected compressed size %lu\n", (unsigned long)complen );
+		return false;
+	}
+
+	return true;
+}
+
+static qboolean CheckRead( file_t *f, byte *buffer, fs_offset_t size )
+{
+	fs_offset_t offset = g_fs.Tell( f );
+	fs_offset_t expected = Q_min( size, DATA_SIZE - offset );
+	fs_offset_t done = g_fs.Read( f, buffer, size );
+
+	if( done != expected || memcmp( buffer, g_data + offset, expected ))
+	{
+		printf( "read fail at %li, %li bytes (%li read)\n", (long)offset, (long)size, (long)done );
+		return false;
+	}
+
+	return true;
+}
+
+// whole file with fixed chunk size, through the read buffer and around it
+static qboolean TestSequential( const char *mode, fs_offset_t chunk )
+{
+	byte *buffer = malloc( chunk );
+	qboolean ok = true;
+	file_t *f;
+
+	f = g_fs.Open( DATA_NAME, mode, false );
+	if( !f )
+	{
+		printf( "open fail\n" );
+		free( buffer );
+		return false;
+	}
+
+	if( g_fs.FileLength( f ) != DATA_SIZE )
+	{
+		printf( "length fail\n" );
+		ok = false;
+	}
+
+	while( ok && g_fs.Tell( f ) < DATA_SIZE )
+		ok = CheckRead( f, buffer, chunk );
+
+	if( ok && ( g_fs.Read( f, buffer, chunk ) != 0 || !g_fs.Eof( f )))
+	{
+		printf( "read past the end\n" );
+		ok = false;
+	}
+
+	g_fs.Close( f );
+	free( buffer );
+	return ok;
+}
+
+// backward seeks restart the stream, forward seeks skip the data
+static qboolean TestSeeks( void )
+{
+	byte *buffer = malloc( 65536 );
+	qboolean ok = true;
+	file_t *f;
+	int i;
+
+	f = g_fs.Open( DATA_NAME, "rb", false );
+
+	ok = ok && CheckRead( f, buffer, 100 );
+	ok = ok && g_fs.Seek( f, DATA_SIZE / 2, SEEK_SET ) == 0 && CheckRead( f, buffer, 5000 );
+	ok = ok && g_fs.Seek( f, 10, SEEK_SET ) == 0 && CheckRead( f, buffer, 3 ); // restart
+	ok = ok && g_fs.Seek( f, -1, SEEK_CUR ) == 0 && CheckRead( f, buffer, 1 ); // inside read buffer
+	ok = ok && g_fs.Seek( f, 300000, SEEK_CUR ) == 0 && CheckRead( f, buffer, 65536 ); // skip
+	ok = ok && g_fs.Seek( f, -50000, SEEK_CUR ) == 0 && CheckRead( f, buffer, 65536 ); // restart, big read
+	ok = ok && g_fs.Seek( f, -100, SEEK_END ) == 0 && CheckRead( f, buffer, 1000 ); // truncated at the end
+	ok = ok && g_fs.Seek( f, 0, SEEK_SET ) == 0 && CheckRead( f, buffer, 65536 );
+
+	if( !ok )
+		printf( "seek fail\n" );
+
+	// mostly sequential, sometimes jump around
+	for( i = 0; i < 20000 && ok; i++ )
+	{
+		fs_offset_t size = 1 + rand() % 4096;
+
+		if( g_fs.Tell( f ) + size > DATA_SIZE )
+			g_fs.Seek( f, 0, SEEK_SET );
+
+		ok = CheckRead( f, buffer, size );
+
+		if( rand() % 64 == 0 )
+			g_fs.Seek( f, rand() % ( DATA_SIZE - 4096 ), SEEK_SET );
+		else if( rand() % 16 == 0 )
+			g_fs.Seek( f, -( rand() % ( size + 1 )), SEEK_CUR );
+	}
+
+	g_fs.Close( f );
+	free( buffer );
+	return ok;
+}
+
+static qboolean TestLoadFile( void )
+{
+	fs_offset_t size = 0;
+	byte *data = g_fs.LoadFileMalloc( DATA_NAME, &size, false );
+	qboolean ok = data && size == DATA_SIZE && !memcmp( data, g_data, DATA_SIZE );
+
+	if( !ok )
+		printf( "load fail\n" );
+
+	if( data )
+		free( data );
+
+	return ok;
+}
+
+static qboolean TestZip( void )
+{
+	const char *modes[] = { "rb", "rbS", "rbR" };
+	const fs_offset_t chunks[] = { 1, 7, 1000, 2048, 5000, 65536, 300000 };
+	qboolean ok = true;
+	uint state = 12345;
+	size_t i, j;
+
+	g_data = malloc( DATA_SIZE );
+
+	// few random bits per byte, so it compresses but not too well
+	for( i = 0; i < DATA_SIZE; i++ )
+	{
+		state = state * 1103515245 + 12345;
+		g_data[i] = "zipstrea"[state >> 29];
+	}
+
+	remove( ZIP_NAME ); // left from an interrupted run
+	g_fs.AddGameDirectory( "./", FS_GAMEDIR_PATH );
+
+	if( !CreateTestZip( ) || !g_fs.MountArchive_Fullpath( ZIP_NAME, 0 ))
+	{
+		printf( "mount fail\n" );
+		ok = false;
+	}
+
+	if( ok )
+		ok = TestLoadFile();
+
+	for( i = 0; i < sizeof( modes ) / sizeof( modes[0] ) && ok; i++ )
+	{
+		for( j = 0; j < sizeof( chunks ) / sizeof( chunks[0] ) && ok; j++ )
+			ok = TestSequential( modes[i], chunks[j] );
+	}
+
+	if( ok )
+		ok = TestSeeks();
+
+	g_fs.ClearSearchPath();
+	remove( ZIP_NAME );
+	free( g_data );
+
+	return ok;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	srand( time( NULL ));
+
+	if( !TestZip())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
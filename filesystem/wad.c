@@ -276,7 +276,14 @@ FS_OpenFile_WAD
 */
 static file_t *FS_OpenFile_WAD( searchpath_t *search, const char *filename, const char *mode, int pack_ind )
 {
-	return NULL;
+	const wfile_t *wad = search->wad;
+	const dlumpinfo_t *lump = &wad->lumps[pack_ind];
+
+	// lumps are stored as is, unless the wad itself is compressed
+	if( wad->handle->ztk )
+		return NULL;
+
+	return FS_OpenHandle( search, wad->handle->handle, wad->handle->offset + lump->filepos, lump->disksize );
 }
 
 /*
@@ -350,6 +357,25 @@ static wfile_t *W_Open( const char *filename, int *error, uint flags )
 
 	wad->infotableofs = header.infotableofs; // save infotableofs position
 
+	// packed wads have no timestamp of their own
+	if( !FBitSet( flags, FS_LOAD_PACKED_WAD ))
+	{
+		const byte *cached;
+		size_t cachedsize;
+		int numlumps;
+
+		cached = FS_FindIndexCache( filename, SEARCHPATH_WAD, wad->handle->real_length, wad->filetime, &numlumps, &cachedsize );
+
+		if( cached && numlumps > 0 && numlumps <= lumpcount && cachedsize == numlumps * sizeof( dlumpinfo_t ))
+		{
+			// already cleaned up and sorted
+			wad->lumps = (dlumpinfo_t *)Mem_Malloc( wad->mempool, cachedsize );
+			memcpy( wad->lumps, cached, cachedsize );
+			wad->numlumps = numlumps;
+			return wad;
+		}
+	}
+
 	if( FS_Seek( wad->handle, wad->infotableofs, SEEK_SET ) == -1 )
 	{
 		Con_Reportf( S_ERROR "%s: %s can't find lump allocation table\n", __func__, filename );
@@ -399,6 +425,9 @@ static wfile_t *W_Open( const char *filename, int *error, uint flags )
 	// release source lumps
 	Mem_Free( srclumps );
 
+	if( !FBitSet( flags, FS_LOAD_PACKED_WAD ))
+		FS_StoreIndexCache( filename, SEARCHPATH_WAD, wad->handle->real_length, wad->filetime, wad->numlumps, wad->lumps, wad->numlumps * sizeof( dlumpinfo_t ));
+
 	// and leave the file open
 	return wad;
 }
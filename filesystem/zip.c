@@ -26,6 +26,7 @@ GNU General Public License for more details.
 #include "port.h"
 #include "filesystem_internal.h"
 #include "crtlib.h"
+#include "xash3d_mathlib.h"
 #include "common/com_strings.h"
 #include "miniz.h"
 
@@ -40,6 +41,8 @@ GNU General Public License for more details.
 
 #define ZIP_ZIP64 0xffffffff
 
+#define ZIP_INFLATE_BUFFER_SIZE	( 16 * 1024 )	// compressed data read at once by FS_ReadDeflated_ZIP
+
 #pragma pack( push, 1 )
 typedef struct zip_header_s
 {
@@ -128,6 +131,26 @@ struct zip_s
 	zipfile_t files[]; // flexible
 };
 
+// streaming decompression state of a deflated file opened with FS_Open
+struct ztoolkit_s
+{
+	fs_offset_t	comp_length;	// size of compressed data at file->offset
+	fs_offset_t	in_position;	// compressed bytes read so far
+	fs_offset_t	out_position;	// uncompressed bytes produced so far
+	z_stream	zstream;
+	byte		input[ZIP_INFLATE_BUFFER_SIZE];
+};
+
+// zipfile_t as stored in the index cache, followed by the name without terminator
+typedef struct
+{
+	int64_t		offset;
+	int64_t		size;
+	int64_t		compressed_size;
+	uint16_t		flags;
+	uint16_t		namelen;
+} dzipcacheentry_t;
+
 // #define ENABLE_CRC_CHECK // known to be buggy because of possible libpublic crc32 bug, disabled
 
 /*
@@ -163,6 +186,101 @@ static int FS_SortZip( const void *a, const void *b )
 	return Q_stricmp(((zipfile_t *)a )->name, ((zipfile_t *)b )->name );
 }
 
+/*
+============
+FS_LoadZipFromCache
+
+rebuilds the sorted file table from the index cache
+============
+*/
+static zip_t *FS_LoadZipFromCache( const char *zipfile, file_t *handle )
+{
+	const byte *cached, *p, *end;
+	int numfiles, i;
+	size_t size;
+	zip_t *zip;
+
+	cached = FS_FindIndexCache( zipfile, SEARCHPATH_ZIP, handle->real_length, handle->filetime, &numfiles, &size );
+
+	if( !cached || numfiles <= 0 || size / sizeof( dzipcacheentry_t ) < numfiles )
+		return NULL;
+
+	zip = (zip_t *)Mem_Malloc( fs_mempool, sizeof( *zip ) + sizeof( zip->files[0] ) * numfiles );
+
+	for( i = 0, p = cached, end = cached + size; i < numfiles; i++ )
+	{
+		zipfile_t *info = &zip->files[i];
+		dzipcacheentry_t entry;
+
+		if( end - p < sizeof( entry ))
+			break;
+
+		memcpy( &entry, p, sizeof( entry ));
+		p += sizeof( entry );
+
+		if( end - p < entry.namelen || entry.namelen >= sizeof( info->name ))
+			break;
+
+		memcpy( info->name, p, entry.namelen );
+		info->name[entry.namelen] = '\0';
+		p += entry.namelen;
+
+		info->offset = entry.offset;
+		info->size = entry.size;
+		info->compressed_size = entry.compressed_size;
+		info->flags = entry.flags;
+	}
+
+	if( i != numfiles )
+	{
+		Mem_Free( zip );
+		return NULL;
+	}
+
+	zip->handle = handle;
+	zip->numfiles = numfiles;
+
+	return zip;
+}
+
+/*
+============
+FS_StoreZipInCache
+============
+*/
+static void FS_StoreZipInCache( const char *zipfile, const zip_t *zip )
+{
+	size_t size = 0;
+	byte *buf, *p;
+	int i;
+
+	for( i = 0; i < zip->numfiles; i++ )
+		size += sizeof( dzipcacheentry_t ) + Q_strlen( zip->files[i].name );
+
+	p = buf = (byte *)Mem_Malloc( fs_mempool, size );
+
+	for( i = 0; i < zip->numfiles; i++ )
+	{
+		const zipfile_t *info = &zip->files[i];
+		dzipcacheentry_t entry;
+
+		memset( &entry, 0, sizeof( entry ));
+		entry.offset = info->offset;
+		entry.size = info->size;
+		entry.compressed_size = info->compressed_size;
+		entry.flags = info->flags;
+		entry.namelen = Q_strlen( info->name );
+
+		memcpy( p, &entry, sizeof( entry ));
+		p += sizeof( entry );
+		memcpy( p, info->name, entry.namelen );
+		p += entry.namelen;
+	}
+
+	FS_StoreIndexCache( zipfile, SEARCHPATH_ZIP, zip->handle->real_length, zip->handle->filetime, zip->numfiles, buf, size );
+	Mem_Free( buf );
+}
+
 /*
 ============
 FS_LoadZip
@@ -178,6 +296,7 @@ static zip_t *FS_LoadZip( const char *zipfile, int *error )
 	zipfile_t	  *info = NULL;
 	char		  filename_buffer[MAX_SYSPATH];
 	zip_t         *zip = (zip_t *)Mem_Calloc( fs_mempool, sizeof( *zip ));
+	zip_t         *cached;
 	fs_size_t       c;
 
 	// TODO: use FS_Open to allow PK3 to be included into other archives
@@ -206,6 +325,16 @@ static zip_t *FS_LoadZip( const char *zipfile, int *error )
 		return NULL;
 	}
 
+	if(( cached = FS_LoadZipFromCache( zipfile, zip->handle )))
+	{
+		Mem_Free( zip ); // handle is owned by the cached one now
+
+		if( error )
+			*error = ZIP_LOAD_OK;
+
+		return cached;
+	}
+
 	FS_Seek( zip->handle, 0, SEEK_SET );
 
 	c = FS_Read( zip->handle, &signature, sizeof( signature ));
@@ -372,6 +501,7 @@ static zip_t *FS_LoadZip( const char *zipfile, int *error )
 
 	zip->numfiles = numpackfiles;
 	qsort( zip->files, zip->numfiles, sizeof( *zip->files ), FS_SortZip );
+	FS_StoreZipInCache( zipfile, zip );
 
 	if( error )
 		*error = ZIP_LOAD_OK;
@@ -379,6 +509,149 @@ static zip_t *FS_LoadZip( const char *zipfile, int *error )
 	return zip;
 }
 
+/*
+===========
+FS_InflateChunk
+
+inflates up to count bytes at the current stream position
+===========
+*/
+static fs_offset_t FS_InflateChunk( file_t *file, byte *buffer, fs_offset_t count )
+{
+	ztoolkit_t *ztk = file->ztk;
+	z_stream *zs = &ztk->zstream;
+	fs_offset_t done;
+
+	zs->next_out = buffer;
+	zs->avail_out = count;
+
+	while( zs->avail_out > 0 )
+	{
+		int zlib_result;
+
+		// inflater may still hold some output when all input is consumed
+		if( zs->avail_in == 0 && ztk->in_position < ztk->comp_length )
+		{
+			fs_offset_t len = Q_min( ztk->comp_length - ztk->in_position, (fs_offset_t)sizeof( ztk->input ));
+
+			// handle may be shared with the archive, always seek
+			lseek( file->handle, file->offset + ztk->in_position, SEEK_SET );
+			len = read( file->handle, ztk->input, len );
+
+			if( len <= 0 )
+				break;
+
+			ztk->in_position += len;
+			zs->next_in = ztk->input;
+			zs->avail_in = len;
+		}
+
+		zlib_result = inflate( zs, Z_SYNC_FLUSH );
+
+		if( zlib_result == Z_STREAM_END )
+			break;
+
+		// no progress possible, compressed data is truncated
+		if( zlib_result == Z_BUF_ERROR && zs->avail_in == 0 )
+			break;
+
+		if( zlib_result != Z_OK )
+		{
+			Con_Reportf( S_ERROR "%s: error while file decompressing. Zlib return code %d.\n", __func__, zlib_result );
+			break;
+		}
+	}
+
+	done = count - zs->avail_out;
+	ztk->out_position += done;
+
+	return done;
+}
+
+/*
+===========
+FS_ReadDeflated_ZIP
+
+reads count bytes of uncompressed data at file->position,
+going backwards restarts the stream, going forwards skips
+the data in between, so sequential reads are the cheapest
+===========
+*/
+fs_offset_t FS_ReadDeflated_ZIP( file_t *file, void *buffer, fs_offset_t count )
+{
+	ztoolkit_t *ztk = file->ztk;
+
+	if( file->position < ztk->out_position )
+	{
+		inflateReset( &ztk->zstream );
+		ztk->zstream.avail_in = 0;
+		ztk->in_position = 0;
+		ztk->out_position = 0;
+	}
+
+	while( ztk->out_position < file->position )
+	{
+		fs_offset_t skip = Q_min( file->position - ztk->out_position, (fs_offset_t)sizeof( file->buff ));
+
+		// read buffer is always empty when we get here
+		if( FS_InflateChunk( file, file->buff, skip ) != skip )
+			return 0;
+	}
+
+	return FS_InflateChunk( file, buffer, count );
+}
+
+/*
+===========
+FS_InflateAt_ZIP
+
+decompresses the whole file into buffer, which must hold file->real_length bytes,
+only uses positional reads and doesn't touch the zstream, so it's safe on any thread
+===========
+*/
+qboolean FS_InflateAt_ZIP( file_t *file, byte *buffer )
+{
+	fs_offset_t comp_length = file->ztk->comp_length;
+	z_stream zstream = { 0 };
+	byte *input;
+	int result;
+
+	// fs_mempool isn't thread-safe
+	input = (byte *)malloc( comp_length );
+	if( !input )
+		return false;
+
+	if( !FS_SysReadAt( file, input, 0, comp_length ) || inflateInit2( &zstream, -MAX_WBITS ) != Z_OK )
+	{
+		free( input );
+		return false;
+	}
+
+	zstream.next_in = input;
+	zstream.avail_in = comp_length;
+	zstream.next_out = buffer;
+	zstream.avail_out = file->real_length;
+
+	result = inflate( &zstream, Z_FINISH );
+	inflateEnd( &zstream );
+	free( input );
+
+	return result == Z_STREAM_END && zstream.total_out == file->real_length;
+}
+
+/*
+===========
+FS_CloseDeflated_ZIP
+
+===========
+*/
+void FS_CloseDeflated_ZIP( file_t *file )
+{
+	inflateEnd( &file->ztk->zstream );
+	Mem_Free( file->ztk );
+	file->ztk = NULL;
+}
+
 /*
 ===========
 FS_OpenZipFile
@@ -389,15 +662,36 @@ Open a packed file using its package file descriptor
 static file_t *FS_OpenFile_ZIP( searchpath_t *search, const char *filename, const char *mode, int pack_ind )
 {
 	zipfile_t *pfile = &search->zip->files[pack_ind];
+	ztoolkit_t *ztk;
+	file_t *file;
+
+	if( pfile->flags == ZIP_COMPRESSION_NO_COMPRESSION )
+		return FS_OpenHandle( search, search->zip->handle->handle, pfile->offset, pfile->size );
 
-	// compressed files handled in Zip_LoadFile
-	if( pfile->flags != ZIP_COMPRESSION_NO_COMPRESSION )
+	if( pfile->flags != ZIP_COMPRESSION_DEFLATED )
 	{
-		Con_Printf( S_ERROR "%s: can't open compressed file %s\n", __func__, pfile->name );
+		Con_Printf( S_ERROR "%s: %s: file compressed with unknown algorithm.\n", __func__, pfile->name );
 		return NULL;
 	}
 
-	return FS_OpenHandle( search, search->zip->handle->handle, pfile->offset, pfile->size );
+	// deflated files are decompressed on demand in FS_Read
+	file = FS_OpenHandle( search, search->zip->handle->handle, pfile->offset, pfile->size );
+	if( !file )
+		return NULL;
+
+	ztk = (ztoolkit_t *)Mem_Calloc( fs_mempool, sizeof( *ztk ));
+	ztk->comp_length = pfile->compressed_size;
+
+	if( inflateInit2( &ztk->zstream, -MAX_WBITS ) != Z_OK )
+	{
+		Con_Printf( S_ERROR "%s: inflateInit2 failed\n", __func__ );
+		Mem_Free( ztk );
+		FS_Close( file );
+		return NULL;
+	}
+
+	file->ztk = ztk;
+	return file;
 }
 
 /*
@@ -601,6 +895,20 @@ static int FS_FindFile_ZIP( searchpath_t *search, const char *path, char *fixedn
 	return -1;
 }
 
+/*
+===========
+FS_GetFileName_ZIP
+
+===========
+*/
+static const char *FS_GetFileName_ZIP( searchpath_t *search, int pack_ind )
+{
+	if( pack_ind < 0 || pack_ind >= search->zip->numfiles )
+		return NULL;
+
+	return search->zip->files[pack_ind].name;
+}
+
 /*
 ===========
 FS_Search_ZIP
@@ -680,6 +988,7 @@ searchpath_t *FS_AddZip_Fullpath( const char *zipfile, int flags )
 	search->pfnFileTime = FS_FileTime_ZIP;
 	search->pfnFindFile = FS_FindFile_ZIP;
 	search->pfnSearch = FS_Search_ZIP;
+	search->pfnGetFileName = FS_GetFileName_ZIP;
 	search->pfnLoadFile = FS_LoadZIPFile;
 
 	Con_Reportf( "Adding ZIP: %s (%i files)\n", zipfile, zip->numfiles );